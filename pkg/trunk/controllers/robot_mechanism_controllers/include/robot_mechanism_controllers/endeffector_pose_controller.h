@@ -37,6 +37,7 @@
 #include <vector>
 #include "kdl/chain.hpp"
 #include "kdl/frames.hpp"
+#include "kdl/jntarray.hpp"
 #include "ros/node.h"
 #include "std_msgs/PoseStamped.h"
 #include "misc_utils/subscription_guard.h"
@@ -71,6 +72,9 @@ private:
   KDL::Chain             chain_;
   KDL::ChainFkSolverPos* jnt_to_pose_solver_;
 
+  // workspace for getPose(), allocated in initXml so the realtime loop does not allocate
+  KDL::JntArray*         jnt_pos_;
+
   // to get joint positions, velocities, and to set joint torques
   std::vector<mechanism::JointState*> joints_; 
 
@@ -37,6 +37,7 @@
 #include <vector>
 #include "kdl/chain.hpp"
 #include "kdl/frames.hpp"
+#include "kdl/jntarrayvel.hpp"
 #include "ros/node.h"
 #include "robot_msgs/Twist.h"
 #include "misc_utils/subscription_guard.h"
@@ -79,6 +80,9 @@ private:
   KDL::Chain             chain_;
   KDL::ChainFkSolverVel* jnt_to_twist_solver_;
 
+  // workspace for update(), allocated in initXml so the realtime loop does not allocate
+  KDL::JntArrayVel*      jnt_posvel_;
+
   // to get joint positions, velocities, and to set joint torques
   std::vector<mechanism::JointState*> joints_; 
 
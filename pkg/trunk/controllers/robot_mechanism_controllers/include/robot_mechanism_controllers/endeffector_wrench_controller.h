@@ -37,6 +37,8 @@
 #include <vector>
 #include "kdl/chain.hpp"
 #include "kdl/frames.hpp"
+#include "kdl/jntarray.hpp"
+#include "kdl/jacobian.hpp"
 #include "ros/node.h"
 #include "robot_msgs/Wrench.h"
 #include "misc_utils/subscription_guard.h"
@@ -66,6 +68,10 @@ private:
   KDL::Chain                 chain_;
   KDL::ChainJntToJacSolver*  jnt_to_jac_solver_;
 
+  // workspace for update(), allocated in initXml so the realtime loop does not allocate
+  KDL::JntArray*             jnt_pos_;
+  KDL::Jacobian*             jacobian_;
+
   // to get joint positions, velocities, and to set joint torques
   std::vector<mechanism::JointState*> joints_; 
 
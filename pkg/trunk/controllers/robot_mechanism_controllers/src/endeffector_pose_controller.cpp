@@ -53,12 +53,14 @@ ROS_REGISTER_CONTROLLER(EndeffectorPoseController)
 
 EndeffectorPoseController::EndeffectorPoseController()
 : jnt_to_pose_solver_(NULL),
+  jnt_pos_(NULL),
   joints_(0,(mechanism::JointState*)NULL)
 {}
 
 EndeffectorPoseController::~EndeffectorPoseController()
 {
   if (jnt_to_pose_solver_) delete jnt_to_pose_solver_;
+  if (jnt_pos_) delete jnt_pos_;
 }
 
 
@@ -85,6 +87,7 @@ bool EndeffectorPoseController::initXml(mechanism::RobotState *robot, TiXmlEleme
   num_segments_ = chain_.getNrOfSegments();
   printf("Extracted KDL Chain with %u Joints and %u segments\n", num_joints_, num_segments_ );
   jnt_to_pose_solver_ = new ChainFkSolverPos_recursive(chain_);
+  jnt_pos_            = new JntArray(num_joints_);
 
   // test if we got robot pointer
   assert(robot);
@@ -177,13 +180,12 @@ Frame EndeffectorPoseController::getPose()
   }
 
   // get the joint positions 
-  JntArray jnt_pos(num_joints_);
   for (unsigned int i=0; i<num_joints_; i++)
-    jnt_pos(i) = joints_[i]->position_;
+    (*jnt_pos_)(i) = joints_[i]->position_;
 
   // get endeffector pose
   Frame result;
-  jnt_to_pose_solver_->JntToCart(jnt_pos, result);
+  jnt_to_pose_solver_->JntToCart(*jnt_pos_, result);
 
   return result;
 }
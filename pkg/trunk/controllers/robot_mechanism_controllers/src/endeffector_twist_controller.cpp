@@ -46,6 +46,7 @@ ROS_REGISTER_CONTROLLER(EndeffectorTwistController)
 
 EndeffectorTwistController::EndeffectorTwistController()
 : jnt_to_twist_solver_(NULL),
+  jnt_posvel_(NULL),
   joints_(0,(mechanism::JointState*)NULL)
 {}
 
@@ -54,6 +55,7 @@ EndeffectorTwistController::EndeffectorTwistController()
 EndeffectorTwistController::~EndeffectorTwistController()
 {
   if (jnt_to_twist_solver_) delete jnt_to_twist_solver_;
+  if (jnt_posvel_) delete jnt_posvel_;
 }
 
 
@@ -107,6 +109,7 @@ bool EndeffectorTwistController::initXml(mechanism::RobotState *robot, TiXmlElem
   num_segments_ = chain_.getNrOfSegments();
   printf("Extracted KDL Chain with %u Joints and %u segments\n", num_joints_, num_segments_ );
   jnt_to_twist_solver_ = new ChainFkSolverVel_recursive(chain_);
+  jnt_posvel_          = new JntArrayVel(num_joints_);
 
   // get chain
   TiXmlElement *chain = config->FirstChildElement("chain");
@@ -182,15 +185,14 @@ void EndeffectorTwistController::update()
   }
 
   // get the joint positions and velocities
-  JntArrayVel jnt_posvel(num_joints_);
   for (unsigned int i=0; i<num_joints_; i++){
-    jnt_posvel.q(i)    = joints_[i]->position_;
-    jnt_posvel.qdot(i) = joints_[i]->velocity_;
+    jnt_posvel_->q(i)    = joints_[i]->position_;
+    jnt_posvel_->qdot(i) = joints_[i]->velocity_;
   }
 
   // get endeffector twist error
   FrameVel twist; 
-  jnt_to_twist_solver_->JntToCart(jnt_posvel, twist);
+  jnt_to_twist_solver_->JntToCart(*jnt_posvel_, twist);
   twist_meas_ = twist.deriv();
   Twist error = twist_meas_ - twist_desi_;
   double dt = time - last_time_;
@@ -49,6 +49,8 @@ ROS_REGISTER_CONTROLLER(EndeffectorWrenchController)
 
 EndeffectorWrenchController::EndeffectorWrenchController()
 : jnt_to_jac_solver_(NULL),
+  jnt_pos_(NULL),
+  jacobian_(NULL),
   joints_(0,(mechanism::JointState*)NULL)
 {
   printf("EndeffectorWrenchController constructor\n");
@@ -59,6 +61,8 @@ EndeffectorWrenchController::EndeffectorWrenchController()
 EndeffectorWrenchController::~EndeffectorWrenchController()
 {
   if (jnt_to_jac_solver_) delete jnt_to_jac_solver_;
+  if (jnt_pos_) delete jnt_pos_;
+  if (jacobian_) delete jacobian_;
 }
 
 
@@ -87,6 +91,8 @@ bool EndeffectorWrenchController::initXml(mechanism::RobotState *robot, TiXmlEle
   num_segments_ = chain_.getNrOfSegments();
   printf("Extracted KDL Chain with %u Joints and %u segments\n", num_joints_, num_segments_ );
   jnt_to_jac_solver_ = new ChainJntToJacSolver(chain_);
+  jnt_pos_           = new JntArray(num_joints_);
+  jacobian_          = new Jacobian(num_joints_, num_segments_);
 
   // get chain
   TiXmlElement *chain = config->FirstChildElement("chain");
@@ -158,21 +164,18 @@ void EndeffectorWrenchController::update()
   }
 
   // get the joint positions
-  JntArray jnt_pos(num_joints_);
   for (unsigned int i=0; i<num_joints_; i++)
-    jnt_pos(i) = joints_[i]->position_;
+    (*jnt_pos_)(i) = joints_[i]->position_;
 
   // get the chain jacobian
-  Jacobian jacobian(num_joints_, num_segments_);
-  jnt_to_jac_solver_->JntToJac(jnt_pos, jacobian);
+  jnt_to_jac_solver_->JntToJac(*jnt_pos_, *jacobian_);
 
   // convert the wrench into joint torques
-  JntArray jnt_torq(num_joints_);
   for (unsigned int i=0; i<num_joints_; i++){
-    jnt_torq(i) = 0;
+    double jnt_torq = 0;
     for (unsigned int j=0; j<6; j++)
-      jnt_torq(i) += (jacobian(j,i) * wrench_desi_(j));
-    joints_[i]->commanded_effort_ = jnt_torq(i);
+      jnt_torq += ((*jacobian_)(j,i) * wrench_desi_(j));
+    joints_[i]->commanded_effort_ = jnt_torq;
   }
 }
 
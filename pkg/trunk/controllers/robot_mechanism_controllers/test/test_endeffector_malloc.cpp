@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Checks that the end-effector controllers do not allocate in update().
+// Run through test_endeffector_malloc.xml, which loads the PR2 description.
+
+#include <string>
+#include <gtest/gtest.h>
+#include <ros/node.h>
+#include <urdf/parser.h>
+#include "mechanism_control/mechanism_control.h"
+#include "robot_mechanism_controllers/endeffector_wrench_controller.h"
+#include "robot_mechanism_controllers/endeffector_twist_controller.h"
+#include "robot_mechanism_controllers/endeffector_pose_controller.h"
+
+static const char *CONTROLLER_XML =
+  "<controller>"
+  "  <chain root=\"torso_lift_link\" tip=\"r_wrist_roll_link\" />"
+  "  <pid_trans p=\"20\" i=\"0.5\" d=\"0\" iClamp=\"1\" />"
+  "  <pid_rot p=\"0.5\" i=\"0.1\" d=\"0\" iClamp=\"0.2\" />"
+  "</controller>";
+
+class EndeffectorMallocTest : public testing::Test
+{
+protected:
+  EndeffectorMallocTest() : hw_(0), mc_(&hw_) {}
+
+  virtual void SetUp()
+  {
+    std::string robot_desc;
+    ros::node::instance()->param("robotdesc/pr2", robot_desc, std::string(""));
+    ASSERT_FALSE(robot_desc.empty()) << "robotdesc/pr2 is not set";
+    robot_xml_.Parse(robot_desc.c_str());
+    urdf::normalizeXml(robot_xml_.RootElement());
+    TiXmlElement *root = robot_xml_.FirstChildElement("robot");
+    ASSERT_TRUE(root != NULL);
+    ASSERT_TRUE(mc_.initXml(root));
+
+    // Uncalibrated joints make the controllers return before doing any work
+    for (unsigned int i = 0; i < mc_.state_->joint_states_.size(); ++i)
+      mc_.state_->joint_states_[i].calibrated_ = true;
+
+    config_xml_.Parse(CONTROLLER_XML);
+    ASSERT_TRUE(config_xml_.RootElement() != NULL);
+  }
+
+  // Runs mechanism control with the controller and counts allocations made inside update()
+  void expectNoMalloc(controller::Controller *c, const std::string &name)
+  {
+    ASSERT_TRUE(c->initXml(mc_.state_, config_xml_.RootElement()));
+    ASSERT_TRUE(mc_.addController(c, name));
+
+    if (!mc_.setMallocCheck(true))
+      FAIL() << "Allocation hooks are not available on this platform, the malloc check cannot run";
+
+    for (int i = 0; i < 100; ++i)
+    {
+      hw_.current_time_ += 0.001;
+      mc_.update();
+    }
+    EXPECT_EQ(mc_.getMallocCount(), 0u);
+
+    mc_.setMallocCheck(false);
+  }
+
+  HardwareInterface hw_;
+  MechanismControl mc_;
+  TiXmlDocument robot_xml_, config_xml_;
+};
+
+TEST_F(EndeffectorMallocTest, WrenchController)
+{
+  controller::EndeffectorWrenchController *c = new controller::EndeffectorWrenchController;
+  c->wrench_desi_.force(0) = 1.0;
+  expectNoMalloc(c, "wrench");
+}
+
+TEST_F(EndeffectorMallocTest, TwistController)
+{
+  controller::EndeffectorTwistController *c = new controller::EndeffectorTwistController;
+  c->twist_desi_.vel(0) = 0.1;
+  expectNoMalloc(c, "twist");
+}
+
+TEST_F(EndeffectorMallocTest, PoseController)
+{
+  controller::EndeffectorPoseController *c = new controller::EndeffectorPoseController;
+  c->pose_desi_.p(0) = 0.5;
+  expectNoMalloc(c, "pose");
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv);
+  ros::node *node = new ros::node("test_endeffector_malloc");
+
+  int ret = RUN_ALL_TESTS();
+
+  delete node;
+  ros::fini();
+  return ret;
+}
@@ -37,6 +37,8 @@
 #include <std_msgs/PointCloud.h>  // ROS point cloud type
 
 #include <stdlib.h>
+#include <algorithm>
+#include <boost/thread.hpp>
 #include "sample_consensus/sac_model.h"
 
 namespace sample_consensus
@@ -47,7 +49,7 @@ namespace sample_consensus
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Constructor for base SAC. */
-      SAC ()
+      SAC () : nr_threads_(1), count_barrier_(NULL), count_shutdown_(false), count_models_(NULL), count_counts_(NULL)
       {
         srand ((unsigned)time (0)); // set a random seed
       };
@@ -56,14 +58,15 @@ namespace sample_consensus
       /** \brief Constructor for base SAC.
         * \param model a SAmple Consensus model
         */
-      SAC (SACModel *model) : sac_model_(model)
+      SAC (SACModel *model) : sac_model_(model), nr_threads_(1), count_barrier_(NULL), count_shutdown_(false),
+                              count_models_(NULL), count_counts_(NULL)
       {
         srand ((unsigned)time (0)); // set a random seed
       };
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Destructor for base SAC. */
-      virtual ~SAC () { }
+      virtual ~SAC () { stopWorkers (); }
 
       ////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the threshold to model.
@@ -95,6 +98,14 @@ namespace sample_consensus
         this->probability_ = probability;
       }
 
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Set the number of threads used to evaluate batches of models. Methods which evaluate each model
+        * independently (e.g. RANSAC) draw MODELS_PER_THREAD models per thread at a time and score them concurrently.
+        * The threads are started here and kept until the number changes or the SAC is destroyed.
+        * \param nr_threads the number of threads (1 evaluates serially, in the calling thread)
+        */
+      void setNumberOfThreads (int nr_threads);
+
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Compute the actual model. Pure virtual. */
       virtual bool computeModel (int debug = 0) = 0;
@@ -132,7 +143,7 @@ namespace sample_consensus
       /** \brief Return the point cloud representing a set of given indices.
         * \param indices a set of indices that represent the data that we're interested in
         */
-      std_msgs::PointCloud getPointCloud (std::vector<int> indices);
+      std_msgs::PointCloud getPointCloud (const std::vector<int> &indices);
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Project a set of given points (using their indices) onto the model and return their projections.
@@ -140,7 +151,7 @@ namespace sample_consensus
         * \param model_coefficients the coefficients of the underlying model
         */
       virtual std_msgs::PointCloud
-        projectPointsToModel (std::vector<int> indices, std::vector<double> model_coefficients)
+        projectPointsToModel (const std::vector<int> &indices, const std::vector<double> &model_coefficients)
       {
         return (sac_model_->projectPoints (indices, model_coefficients));
       }
@@ -154,7 +165,7 @@ namespace sample_consensus
         * \param nr_samples the desired number of point indices
         */
       std::set<int>
-        getRandomSamples (std_msgs::PointCloud points, int nr_samples)
+        getRandomSamples (const std_msgs::PointCloud &points, int nr_samples)
       {
         std::set<int> random_idx;
         for (int i = 0; i < nr_samples; i++)
@@ -171,7 +182,7 @@ namespace sample_consensus
         * \param nr_samples the desired number of point indices
         */
       std::set<int>
-        getRandomSamples (std_msgs::PointCloud points, std::vector<int> indices, int nr_samples)
+        getRandomSamples (const std_msgs::PointCloud &points, const std::vector<int> &indices, int nr_samples)
       {
         std::set<int> random_idx;
         for (int i = 0; i < nr_samples; i++)
@@ -180,6 +191,15 @@ namespace sample_consensus
       }
 
     protected:
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Count the inliers of a batch of models, using nr_threads_ threads.
+        * \param models the coefficients of the models to evaluate
+        * \param best_count the number of inliers of the best model found so far. Models which cannot beat it are
+        * abandoned early, and their count is then only guaranteed to be smaller than best_count.
+        * \param counts the resultant number of inliers, one per model
+        */
+      void countWithinDistance (const std::vector<std::vector<double> > &models, int best_count, std::vector<int> &counts);
+
       /** \brief The underlying data model used (i.e. what is it that we attempt to search for). */
       SACModel *sac_model_;
 
@@ -194,6 +214,28 @@ namespace sample_consensus
 
       /** \brief Distance to model threshold. */
       double threshold_;
+
+      /** \brief Number of threads used to evaluate batches of models. */
+      int nr_threads_;
+
+      /** \brief Number of models drawn per thread for each batch, when there is more than one thread. */
+      static const int MODELS_PER_THREAD = 8;
+
+    private:
+      void countWithinDistanceWorker (int start, int step);
+      void countWorkerLoop (int thread);
+      void stopWorkers ();
+
+      /** \brief Synchronizes the calling thread and the workers at the start and end of each batch */
+      boost::barrier *count_barrier_;
+      /** \brief Threads that count inliers along with the calling thread, nr_threads_ - 1 of them */
+      boost::thread_group count_workers_;
+      /** \brief Tells the workers to exit at the start of the next batch */
+      bool count_shutdown_;
+      /** \brief The batch being counted */
+      const std::vector<std::vector<double> > *count_models_;
+      std::vector<int> *count_counts_;
+      int count_max_outliers_;
   };
 }
 
@@ -37,6 +37,10 @@
 #include <std_msgs/PointCloud.h>  // ROS point cloud type
 
 #include <set>
+#include <climits>
+
+/** \brief Number of points tested between checks for early termination when counting inliers */
+#define SAC_BLOCK_SIZE 1024
 
 namespace sample_consensus
 {
@@ -46,7 +50,7 @@ namespace sample_consensus
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Constructor for base SACModel. */
       SACModel () : cloud_(NULL) { }
-      SACModel (std_msgs::PointCloud cloud) : cloud_(&cloud) { }
+      SACModel (std_msgs::PointCloud *cloud) : cloud_(NULL) { setDataSet (cloud); }
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Destructor for base SACModel. */
@@ -60,54 +64,96 @@ namespace sample_consensus
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Test whether the given model coefficients are valid given the input point cloud data. Pure virtual.
        * \param model_coefficients the model coefficients that need to be tested */
-      virtual bool testModelCoefficients (std::vector<double> model_coefficients) = 0;
+      virtual bool testModelCoefficients (const std::vector<double> &model_coefficients) = 0;
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Check whether the given index samples can form a valid model, compute the model coefficients from
        * these samples and store them internally in model_coefficients_. Pure virtual.
        * \param indices the point indices found as possible good candidates for creating a valid model */
-      virtual bool computeModelCoefficients (std::vector<int> indices) = 0;
+      virtual bool computeModelCoefficients (const std::vector<int> &indices) = 0;
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Recompute the model coefficients using the given inlier set and return them to the user. Pure virtual.
        * @note: these are the coefficients of the model after refinement (eg. after a least-squares optimization)
        * \param inliers the data inliers found as supporting the model */
-      virtual std::vector<double> refitModel (std::vector<int> inliers) = 0;
+      virtual std::vector<double> refitModel (const std::vector<int> &inliers) = 0;
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Compute all distances from the cloud data to a given model. Pure virtual.
+       * \param model_coefficients the coefficients of a model that we need to compute distances to
+       * \param distances the resultant distances, one per point index. Reusing the same vector across calls avoids
+       * reallocating it for every model. */
+      virtual void getDistancesToModel (const std::vector<double> &model_coefficients, std::vector<double> &distances) = 0;
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Compute all distances from the cloud data to a given model.
        * \param model_coefficients the coefficients of a model that we need to compute distances to */
-      virtual std::vector<double> getDistancesToModel (std::vector<double> model_coefficients) = 0;
+      std::vector<double>
+        getDistancesToModel (const std::vector<double> &model_coefficients)
+      {
+        std::vector<double> distances;
+        getDistancesToModel (model_coefficients, distances);
+        return (distances);
+      }
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Select all the points which respect the given model coefficients as inliers. Pure virtual. 
        * \param model_coefficients the coefficients of a model that we need to compute distances to
        * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
        * @note: To get the refined inliers of a model, use:
-       *        ANNpoint refined_coeff = refitModel (...); selectWithinDistance (refined_coeff, threshold); */
-      virtual std::vector<int> selectWithinDistance (std::vector<double> model_coefficients, double threshold) = 0;
+       *        ANNpoint refined_coeff = refitModel (...); selectWithinDistance (refined_coeff, threshold); 
+       * \param inliers the resultant inliers, as point cloud indices */
+      virtual void selectWithinDistance (const std::vector<double> &model_coefficients, double threshold, std::vector<int> &inliers) = 0;
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Select all the points which respect the given model coefficients as inliers.
+       * \param model_coefficients the coefficients of a model that we need to compute distances to
+       * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers */
+      std::vector<int>
+        selectWithinDistance (const std::vector<double> &model_coefficients, double threshold)
+      {
+        std::vector<int> inliers;
+        selectWithinDistance (model_coefficients, threshold, inliers);
+        return (inliers);
+      }
+
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Count the points which respect the given model coefficients as inliers, without storing them. Pure virtual.
+       * Safe to call concurrently for different models, as it only reads the cached point data.
+       * \note Distances are evaluated in single precision, to score hypotheses quickly. A point within rounding error of
+       * the threshold may therefore be counted differently than by selectWithinDistance and getDistancesToModel, which
+       * work in double precision.
+       * \param model_coefficients the coefficients of a model that we need to compute distances to
+       * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+       * \param max_outliers stop counting as soon as more than this many outliers have been seen. The value returned
+       * is then smaller than (number of indices - max_outliers), which is all SAC methods need to discard a model
+       * that cannot beat the best one found so far. */
+      virtual int countWithinDistance (const std::vector<double> &model_coefficients, double threshold, int max_outliers = INT_MAX) = 0;
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Create a new point cloud with inliers projected onto the model. Pure virtual.
        * \param inliers the data inliers that we want to project on the model
        * \param model_coefficients the coefficients of a model */
-      virtual std_msgs::PointCloud projectPoints (std::vector<int> inliers, std::vector<double> model_coefficients) = 0;
+      virtual std_msgs::PointCloud projectPoints (const std::vector<int> &inliers, const std::vector<double> &model_coefficients) = 0;
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Project inliers (in place) onto the given model. Pure virtual. 
        * \param inliers the data inliers that we want to project on the model
        * \param model_coefficients the coefficients of a model */
-      virtual void projectPointsInPlace (std::vector<int> inliers, std::vector<double> model_coefficients) = 0;
+      virtual void projectPointsInPlace (const std::vector<int> &inliers, const std::vector<double> &model_coefficients) = 0;
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Verify whether a subset of indices verifies the internal model coefficients. Pure virtual.
-       * \param indices the data indices that need to be tested against the model
+       * \param indices positions in the current set of point indices (as returned by SAC::getRandomSamples) that need
+       * to be tested against the model
        * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers */
-      virtual bool doSamplesVerifyModel (std::set<int> indices, double threshold) = 0;
+      virtual bool doSamplesVerifyModel (const std::set<int> &indices, double threshold) = 0;
 
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the dataset
+       * \note The points are copied into an internal buffer for fast model evaluation. If the cloud changes
+       * afterwards, call setDataSet () again.
        * \param cloud the data set to be used */
       inline void
         setDataSet (std_msgs::PointCloud *cloud)
@@ -117,21 +163,23 @@ namespace sample_consensus
         indices_.resize (cloud_->pts.size ());
         for (unsigned int i = 0; i < cloud_->pts.size (); i++)
           indices_[i] = i;
+        cacheDataSet ();
       }
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the dataset and indices
        * \param cloud the data set to be used
        * \param indices the point indices used */
       inline void
-        setDataSet (std_msgs::PointCloud cloud, std::vector<int> indices)
+        setDataSet (std_msgs::PointCloud *cloud, const std::vector<int> &indices)
       {
-        this->cloud_   = &cloud;
+        this->cloud_   = cloud;
         this->indices_ = indices;
+        cacheDataSet ();
       }
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the indices
        * \param indices the point indices used */
-      void setDataIndices (std::vector<int> indices) { this->indices_ = indices; }
+      void setDataIndices (const std::vector<int> &indices) { this->indices_ = indices; cacheDataSet (); }
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Remove the inliers found from the initial set of given point indices. */
@@ -144,7 +192,7 @@ namespace sample_consensus
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the best set of inliers. Used by SAC methods. Do not call this except if you know what you're doing.
        * \param best_inliers the set of inliers for the best model */
-      void setBestInliers (std::vector<int> best_inliers) { this->best_inliers_ = best_inliers; }
+      void setBestInliers (const std::vector<int> &best_inliers) { this->best_inliers_ = best_inliers; }
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Return the best set of inliers found so far for this model. */
@@ -153,7 +201,7 @@ namespace sample_consensus
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Set the best model. Used by SAC methods. Do not call this except if you know what you're doing.
        * \param best_model the best model found so far */
-      void setBestModel (std::vector<int> best_model) { this->best_model_ = best_model; }
+      void setBestModel (const std::vector<int> &best_model) { this->best_model_ = best_model; }
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Return the best model found so far. */
@@ -161,7 +209,7 @@ namespace sample_consensus
 
       //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
       /** \brief Return the model coefficients of the best model found so far. */
-      std::vector<double> getModelCoefficients () { return (this->model_coefficients_); }
+      const std::vector<double>& getModelCoefficients () { return (this->model_coefficients_); }
 
       /** \brief Return a pointer to the point cloud data. */
       std_msgs::PointCloud* getCloud () { return (this->cloud_); }
@@ -171,12 +219,20 @@ namespace sample_consensus
 
     protected:
 
+      //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /** \brief Copy the points referenced by indices_ into points_x_, points_y_ and points_z_. */
+      void cacheDataSet ();
+
       /** \brief Holds a pointer to the point cloud data array, since we don't want to copy the whole thing here */
       std_msgs::PointCloud *cloud_;
 
       /** \brief The list of internal point indices used */
       std::vector<int> indices_;
 
+      /** \brief The coordinates of the points in indices_, stored as separate contiguous arrays (in the same order as
+        * indices_) so that distance kernels can stream through them four points at a time */
+      std::vector<float> points_x_, points_y_, points_z_;
+
       /** \brief The coefficients of our model computed directly from the best samples found */
       std::vector<double> model_coefficients_;
 
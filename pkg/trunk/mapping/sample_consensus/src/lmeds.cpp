@@ -69,6 +69,8 @@ namespace sample_consensus
     std::vector<int> best_model;
     std::vector<int> best_inliers;
     std::vector<int> selection;
+    // Reused across iterations, to avoid reallocating it for every model
+    std::vector<double> distances;
 
     // Iterate
     while (iterations_ < max_iterations_)
@@ -85,16 +87,17 @@ namespace sample_consensus
       // d_cur_penalty = sum (min (dist, threshold))
 
       // Iterate through the 3d points and calculate the distances from them to the model
-      std::vector<double> distances = sac_model_->getDistancesToModel (sac_model_->getModelCoefficients ());
-
-      std::sort (distances.begin (), distances.end ());
+      sac_model_->getDistancesToModel (sac_model_->getModelCoefficients (), distances);
 
       // d_cur_penalty = median (distances)
       int mid = sac_model_->getIndices ()->size () / 2;
 
+      // Only the middle of the distances is needed, so partition around it instead of sorting
+      std::nth_element (distances.begin (), distances.begin () + mid, distances.end ());
+
       // Do we have a "middle" point or should we "estimate" one ?
       if (sac_model_->getIndices ()->size () % 2 == 0)
-        d_cur_penalty = (sqrt (distances[mid-1]) + sqrt (distances[mid])) / 2;
+        d_cur_penalty = (sqrt (*std::max_element (distances.begin (), distances.begin () + mid)) + sqrt (distances[mid])) / 2;
       else
         d_cur_penalty = sqrt (distances[mid]);
 
@@ -120,7 +123,7 @@ namespace sample_consensus
 
       sac_model_->computeModelCoefficients (best_model);
       // Iterate through the 3d points and calculate the distances from them to the model
-      std::vector<double> distances = sac_model_->getDistancesToModel (sac_model_->getModelCoefficients ());
+      sac_model_->getDistancesToModel (sac_model_->getModelCoefficients (), distances);
 
       best_inliers.resize (sac_model_->getIndices ()->size ());
       int n_inliers_count = 0;
@@ -92,6 +92,10 @@ namespace sample_consensus
                     );
 
 
+    // Reused across iterations, to avoid reallocating them for every model
+    std::vector<double> distances;
+    std::vector<double> p_inlier_prob (sac_model_->getIndices ()->size ());
+
     // Iterate
     while (iterations_ < k)
     {
@@ -104,14 +108,13 @@ namespace sample_consensus
       sac_model_->computeModelCoefficients (selection);
 
       // Iterate through the 3d points and calculate the distances from them to the model
-      std::vector<double> distances = sac_model_->getDistancesToModel (sac_model_->getModelCoefficients ());
+      sac_model_->getDistancesToModel (sac_model_->getModelCoefficients (), distances);
 
       // Use Expectiation-Maximization to find out the right value for d_cur_penalty
       // ---[ Initial estimate for the gamma mixing parameter = 1/2
       double gamma = 0.5;
       double p_outlier_prob = 0;
 
-      std::vector<double> p_inlier_prob (sac_model_->getIndices ()->size ());
       for (int j = 0; j < iterations_EM_; j++)
       {
         // Likelihood of a datum given that it is an inlier
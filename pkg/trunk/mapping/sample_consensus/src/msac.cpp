@@ -73,6 +73,8 @@ namespace sample_consensus
     std::vector<int> best_model;
     std::vector<int> best_inliers, inliers;
     std::vector<int> selection;
+    // Reused across iterations, to avoid reallocating it for every model
+    std::vector<double> distances;
 
     int n_inliers_count = 0;
 
@@ -90,7 +92,7 @@ namespace sample_consensus
       double d_cur_penalty = 0;
       // d_cur_penalty = sum (min (dist, threshold))
       // Iterate through the 3d points and calculate the distances from them to the model
-      std::vector<double> distances = sac_model_->getDistancesToModel (sac_model_->getModelCoefficients ());
+      sac_model_->getDistancesToModel (sac_model_->getModelCoefficients (), distances);
       for (unsigned int i = 0; i < sac_model_->getIndices ()->size (); i++)
         d_cur_penalty += std::min ((double)distances[i], threshold_);
 
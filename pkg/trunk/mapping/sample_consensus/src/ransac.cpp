@@ -69,56 +69,94 @@ namespace sample_consensus
     double k = 1.0;
 
     std::vector<int> best_model;
-    std::vector<int> best_inliers, inliers;
+    std::vector<double> best_coefficients;
     std::vector<int> selection;
 
+    // A batch of models, drawn serially (sampling uses rand ()) and then scored concurrently
+    std::vector<std::vector<int> > selections;
+    std::vector<std::vector<double> > models;
+    std::vector<int> sample_iterations, counts;
+
     int n_inliers_count = 0;
+    bool done = false;
 
     // Iterate
-    while (iterations_ < k)
+    while (!done && iterations_ < k)
     {
-      // Get X samples which satisfy the model criteria
-      selection = sac_model_->getSamples (iterations_);
-
-      if (selection.size () == 0) break;
+      // Draw no more models than are still needed, so that a single thread does the same work as before. With
+      // several threads each one gets a few models per batch, to amortize the synchronization
+      int batch_size = (nr_threads_ > 1) ? nr_threads_ * MODELS_PER_THREAD : 1;
+      double remaining = ceil (k) - iterations_;
+      if (remaining < batch_size)
+        batch_size = std::max (1, (int)remaining);
+      selections.clear ();
+      models.clear ();
+      sample_iterations.clear ();
+      for (int b = 0; b < batch_size; b++)
+      {
+        // Get X samples which satisfy the model criteria
+        int sample_iter = 0;
+        selection = sac_model_->getSamples (sample_iter);
 
-      // Search for inliers in the point cloud for the current plane model M
-      sac_model_->computeModelCoefficients (selection);
+        if (selection.size () == 0) break;
 
-      inliers = sac_model_->selectWithinDistance (sac_model_->getModelCoefficients (), threshold_);
-      n_inliers_count = inliers.size ();
+        // Search for inliers in the point cloud for the current plane model M
+        sac_model_->computeModelCoefficients (selection);
 
-      // Better match ?
-      if (n_inliers_count > n_best_inliers_count)
-      {
-        n_best_inliers_count = n_inliers_count;
-        best_inliers = inliers;
-        //inliers.clear ();
-        best_model = selection;
-
-        // Compute the k parameter (k=log(z)/log(1-w^n))
-        double w = (double)((double)n_inliers_count / (double)sac_model_->getIndices ()->size ());
-        double p_no_outliers = 1 - pow (w, (double)selection.size ());
-        p_no_outliers = std::max (std::numeric_limits<double>::epsilon (), p_no_outliers);       // Avoid division by -Inf
-        p_no_outliers = std::min (1 - std::numeric_limits<double>::epsilon (), p_no_outliers);   // Avoid division by 0.
-        k = log (1 - probability_) / log (p_no_outliers);
+        selections.push_back (selection);
+        models.push_back (sac_model_->getModelCoefficients ());
+        sample_iterations.push_back (sample_iter);
       }
+      if (models.size () == 0) break;
 
-      iterations_ += 1;
-      if (debug > 1)
-        std::cerr << "[RANSAC::computeModel] Trial " << iterations_ << " out of " << ceil (k) << ": " << n_inliers_count << " inliers (best is: " << n_best_inliers_count << " so far)." << std::endl;
-      if (iterations_ > max_iterations_)
+      countWithinDistance (models, n_best_inliers_count, counts);
+
+      // Process the batch in order, exactly as if the models had been drawn and scored one at a time
+      for (unsigned int b = 0; b < models.size (); b++)
       {
-        if (debug > 0)
-          std::cerr << "[RANSAC::computeModel] RANSAC reached the maximum number of trials." << std::endl;
-        break;
+        iterations_ += sample_iterations[b];
+        n_inliers_count = counts[b];
+
+        // Better match ?
+        if (n_inliers_count > n_best_inliers_count)
+        {
+          n_best_inliers_count = n_inliers_count;
+          best_model = selections[b];
+          best_coefficients = models[b];
+
+          // Compute the k parameter (k=log(z)/log(1-w^n))
+          double w = (double)((double)n_inliers_count / (double)sac_model_->getIndices ()->size ());
+          double p_no_outliers = 1 - pow (w, (double)selections[b].size ());
+          p_no_outliers = std::max (std::numeric_limits<double>::epsilon (), p_no_outliers);       // Avoid division by -Inf
+          p_no_outliers = std::min (1 - std::numeric_limits<double>::epsilon (), p_no_outliers);   // Avoid division by 0.
+          k = log (1 - probability_) / log (p_no_outliers);
+        }
+
+        iterations_ += 1;
+        if (debug > 1)
+          std::cerr << "[RANSAC::computeModel] Trial " << iterations_ << " out of " << ceil (k) << ": " << n_inliers_count << " inliers (best is: " << n_best_inliers_count << " so far)." << std::endl;
+        if (iterations_ > max_iterations_)
+        {
+          if (debug > 0)
+            std::cerr << "[RANSAC::computeModel] RANSAC reached the maximum number of trials." << std::endl;
+          done = true;
+          break;
+        }
+        if (iterations_ >= k)
+          break;
       }
+      // A batch cut short by an empty selection ends the search, as before
+      if ((int)models.size () < batch_size)
+        break;
     }
 
     if (best_model.size () != 0)
     {
       if (debug > 0)
         std::cerr << "[RANSAC::computeModel] Model found: " << n_best_inliers_count << " inliers." << std::endl;
+      // Only the winning model needs its inliers stored
+      std::vector<int> best_inliers;
+      sac_model_->selectWithinDistance (best_coefficients, threshold_, best_inliers);
       sac_model_->setBestModel (best_model);
       sac_model_->setBestInliers (best_inliers);
       return (true);
@@ -72,7 +72,7 @@ namespace sample_consensus
     double k = 1.0;
 
     std::vector<int> best_model;
-    std::vector<int> best_inliers, inliers;
+    std::vector<double> best_coefficients;
     std::vector<int> selection;
 
     int n_inliers_count = 0;
@@ -100,16 +100,16 @@ namespace sample_consensus
         if (k != 1.0)
           continue;
 
-      inliers = sac_model_->selectWithinDistance (sac_model_->getModelCoefficients (), threshold_);
-      n_inliers_count = inliers.size ();
+      // Models with more outliers than this cannot beat the best one, so stop counting once they are exceeded
+      int max_outliers = sac_model_->getIndices ()->size () - std::max (0, n_best_inliers_count);
+      n_inliers_count = sac_model_->countWithinDistance (sac_model_->getModelCoefficients (), threshold_, max_outliers);
 
       // Better match ?
       if (n_inliers_count > n_best_inliers_count)
       {
         n_best_inliers_count = n_inliers_count;
-        best_inliers = inliers;
-        //inliers.clear ();
         best_model = selection;
+        best_coefficients = sac_model_->getModelCoefficients ();
 
         // Compute the k parameter (k=log(z)/log(1-w^n))
         double w = (double)((double)n_inliers_count / (double)sac_model_->getIndices ()->size ());
@@ -134,6 +134,9 @@ namespace sample_consensus
     {
       if (debug > 0)
         std::cerr << "[RRANSAC::computeModel] Model found: " << n_best_inliers_count << " inliers." << std::endl;
+      // Only the winning model needs its inliers stored
+      std::vector<int> best_inliers;
+      sac_model_->selectWithinDistance (best_coefficients, threshold_, best_inliers);
       sac_model_->setBestModel (best_model);
       sac_model_->setBestInliers (best_inliers);
       return (true);
@@ -30,6 +30,8 @@
 
 /** \author Radu Bogdan Rusu */
 
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 #include "sample_consensus/sac.h"
 
 using namespace sample_consensus;
@@ -38,7 +40,7 @@ using namespace sample_consensus;
 /** \brief return the point cloud representing a set of given indices.
   * \param indices a set of indices that represent the data that we're interested in */
 std_msgs::PointCloud
-  SAC::getPointCloud (std::vector<int> indices)
+  SAC::getPointCloud (const std::vector<int> &indices)
 {
   std_msgs::PointCloud i_points;
 
@@ -65,3 +67,88 @@ std_msgs::PointCloud
 
   return (i_points);
 }
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/** \brief Set the number of threads used to evaluate batches of models, and start the workers.
+  * \param nr_threads the number of threads (1 evaluates serially, in the calling thread) */
+void
+  SAC::setNumberOfThreads (int nr_threads)
+{
+  nr_threads = std::max (1, nr_threads);
+  if (nr_threads == nr_threads_)
+    return;
+
+  stopWorkers ();
+  nr_threads_ = nr_threads;
+  if (nr_threads_ > 1)
+  {
+    count_barrier_ = new boost::barrier (nr_threads_);
+    for (int t = 1; t < nr_threads_; t++)
+      count_workers_.create_thread (boost::bind (&SAC::countWorkerLoop, this, t));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/** \brief Stop and join the worker threads, if any. */
+void
+  SAC::stopWorkers ()
+{
+  if (count_barrier_ == NULL)
+    return;
+  count_shutdown_ = true;
+  count_barrier_->wait ();
+  count_workers_.join_all ();
+  delete count_barrier_;
+  count_barrier_ = NULL;
+  count_shutdown_ = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/** \brief Count the inliers of a batch of models, spreading the models over nr_threads_ threads.
+  * \param models the coefficients of the models to evaluate
+  * \param best_count the number of inliers of the best model found so far
+  * \param counts the resultant number of inliers, one per model */
+void
+  SAC::countWithinDistance (const std::vector<std::vector<double> > &models, int best_count, std::vector<int> &counts)
+{
+  counts.resize (models.size ());
+  count_models_ = &models;
+  count_counts_ = &counts;
+  // A model with more outliers than this has fewer inliers than the best one, and can be abandoned
+  count_max_outliers_ = (int)sac_model_->getIndices ()->size () - std::max (0, best_count);
+
+  if (count_barrier_ == NULL || models.size () <= 1)
+  {
+    countWithinDistanceWorker (0, 1);
+    return;
+  }
+
+  count_barrier_->wait ();
+  countWithinDistanceWorker (0, nr_threads_);
+  count_barrier_->wait ();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/** \brief Loop of a worker thread: wait for a batch, count its share of the models, and wait for the others. */
+void
+  SAC::countWorkerLoop (int thread)
+{
+  while (true)
+  {
+    count_barrier_->wait ();
+    if (count_shutdown_)
+      return;
+    countWithinDistanceWorker (thread, nr_threads_);
+    count_barrier_->wait ();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/** \brief Count the inliers of models start, start + step, ... of the current batch. Models are interleaved
+  * between threads so that each gets a similar share of the early terminations. */
+void
+  SAC::countWithinDistanceWorker (int start, int step)
+{
+  for (unsigned int i = start; i < count_models_->size (); i += step)
+    (*count_counts_)[i] = sac_model_->countWithinDistance ((*count_models_)[i], threshold_, count_max_outliers_);
+}
@@ -52,8 +52,25 @@ namespace sample_consensus
                     inserter (remaining_indices, remaining_indices.begin ()));
 
     indices_ = remaining_indices;
-
+    cacheDataSet ();
 
     return indices_.size ();
   }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Copy the points referenced by indices_ into the internal coordinate arrays. */
+  void
+    SACModel::cacheDataSet ()
+  {
+    points_x_.resize (indices_.size ());
+    points_y_.resize (indices_.size ());
+    points_z_.resize (indices_.size ());
+    for (unsigned int i = 0; i < indices_.size (); i++)
+    {
+      const std_msgs::Point32 &p = cloud_->pts[indices_[i]];
+      points_x_[i] = p.x;
+      points_y_[i] = p.y;
+      points_z_[i] = p.z;
+    }
+  }
 }
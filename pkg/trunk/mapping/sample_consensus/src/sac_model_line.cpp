@@ -30,6 +30,10 @@
 
 /** \author Radu Bogdan Rusu */
 
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "sample_consensus/sac_model_line.h"
 #include "cloud_geometry/point.h"
 #include "cloud_geometry/nearest.h"
@@ -62,79 +66,147 @@ namespace sample_consensus
     return (random_idx);
   }
 
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Test points i to i+3 of the coordinate arrays against a line and return a bitmask of the inliers.
+    * \param lx, ly, lz the second line point, P2
+    * \param dx, dy, dz the line direction, P2 - P1
+    * \param limit the squared threshold multiplied by the squared norm of the direction
+    * \note A point P0 is an inlier if ||(P2-P0) x (P2-P1)||^2 < T^2 * ||P2-P1||^2, which avoids a division per point.
+    * The test is evaluated in single precision, and the scalar and SSE paths perform the same operations in the same
+    * order, so counts do not depend on where the blocks of four fall.
+    */
+  static inline int
+    lineInliers4 (const float *px, const float *py, const float *pz, int i,
+                  float lx, float ly, float lz, float dx, float dy, float dz, float limit)
+  {
+#if defined(__SSE2__)
+    __m128 vdx = _mm_set1_ps (dx), vdy = _mm_set1_ps (dy), vdz = _mm_set1_ps (dz);
+    __m128 qx = _mm_sub_ps (_mm_set1_ps (lx), _mm_loadu_ps (px + i));
+    __m128 qy = _mm_sub_ps (_mm_set1_ps (ly), _mm_loadu_ps (py + i));
+    __m128 qz = _mm_sub_ps (_mm_set1_ps (lz), _mm_loadu_ps (pz + i));
+    __m128 cx = _mm_sub_ps (_mm_mul_ps (qy, vdz), _mm_mul_ps (qz, vdy));
+    __m128 cy = _mm_sub_ps (_mm_mul_ps (qz, vdx), _mm_mul_ps (qx, vdz));
+    __m128 cz = _mm_sub_ps (_mm_mul_ps (qx, vdy), _mm_mul_ps (qy, vdx));
+    __m128 sqr = _mm_add_ps (_mm_add_ps (_mm_mul_ps (cx, cx), _mm_mul_ps (cy, cy)), _mm_mul_ps (cz, cz));
+    return (_mm_movemask_ps (_mm_cmplt_ps (sqr, _mm_set1_ps (limit))));
+#else
+    int mask = 0;
+    for (int j = 0; j < 4; j++)
+    {
+      float qx = lx - px[i + j], qy = ly - py[i + j], qz = lz - pz[i + j];
+      float cx = qy * dz - qz * dy, cy = qz * dx - qx * dz, cz = qx * dy - qy * dx;
+      if ((cx * cx + cy * cy) + cz * cz < limit)
+        mask |= (1 << j);
+    }
+    return (mask);
+#endif
+  }
+
+  /** \brief Test a single point against a line, in the same way as lineInliers4 */
+  static inline bool
+    lineInlier (const float *px, const float *py, const float *pz, int i,
+                float lx, float ly, float lz, float dx, float dy, float dz, float limit)
+  {
+    float qx = lx - px[i], qy = ly - py[i], qz = lz - pz[i];
+    float cx = qy * dz - qz * dy, cy = qz * dx - qx * dz, cz = qx * dy - qy * dx;
+    return ((cx * cx + cy * cy) + cz * cz < limit);
+  }
+
+  /** \brief Number of set bits in a 4-bit inlier mask */
+  static const int mask_count[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   /** \brief Select all the points which respect the given model coefficients as inliers.
     * \param model_coefficients the coefficients of a line model that we need to compute distances to
     * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
-    * \note: To get the refined inliers of a model, use:
-    * ANNpoint refined_coeff = refitModel (...); selectWithinDistance (refined_coeff, threshold);
+    * \param inliers the resultant inliers
     */
-  std::vector<int>
-    SACModelLine::selectWithinDistance (std::vector<double> model_coefficients, double threshold)
+  void
+    SACModelLine::selectWithinDistance (const std::vector<double> &model_coefficients, double threshold, std::vector<int> &inliers)
   {
-    double sqr_threshold = threshold * threshold;
-
-    std::vector<int> inliers;
-
-    // Iterate through the 3d points and calculate the distances from them to the plane
-    for (unsigned int i = 0; i < indices_.size (); i++)
+    const double lx = model_coefficients.at (3), ly = model_coefficients.at (4), lz = model_coefficients.at (5);
+    const double dx = lx - model_coefficients.at (0), dy = ly - model_coefficients.at (1), dz = lz - model_coefficients.at (2);
+    const double d_norm = sqrt (dx * dx + dy * dy + dz * dz);
+    const int n = indices_.size ();
+    inliers.resize (n);
+    if (n == 0)
+      return;
+    const float *px = &points_x_[0], *py = &points_y_[0], *pz = &points_z_[0];
+
+    // The distances are computed in double precision, exactly as in getDistancesToModel
+    int nr_inliers = 0;
+    for (int i = 0; i < n; i++)
     {
       // Calculate the distance from the point to the line
       // D = ||(P2-P1) x (P1-P0)|| / ||P2-P1|| = norm (cross (p2-p1, p2-p0)) / norm(p2-p1)
       // P1, P2 = line points, P0 = query point
-      // P1P2 = <x2-x1, y2-y1, z2-z1> = <x3, y3, z3>
-      // P1P0 = < x-x1,  y-y1, z-z1 > = <x4, y4, z4>
-      // P1P2 x P1P0 = < y3*z4 - z3*y4, -(x3*z4 - x4*z3), x3*y4 - x4*y3 >
-      //             = < (y2-y1)*(z-z1) - (z2-z1)*(y-y1), -[(x2-x1)*(z-z1) - (x-x1)*(z2-z1)], (x2-x1)*(y-y1) - (x-x1)*(y2-y1) >
-      std_msgs::Point32 p3, p4;
-      p3.x = model_coefficients.at (3) - model_coefficients.at (0);
-      p3.y = model_coefficients.at (4) - model_coefficients.at (1);
-      p3.z = model_coefficients.at (5) - model_coefficients.at (2);
-
-      p4.x = model_coefficients.at (3) - cloud_->pts.at (indices_.at (i)).x;
-      p4.y = model_coefficients.at (4) - cloud_->pts.at (indices_.at (i)).y;
-      p4.z = model_coefficients.at (5) - cloud_->pts.at (indices_.at (i)).z;
-
-      // P1P2 = sqrt (x3^2 + y3^2 + z3^2)
-      // a = sqrt [(y3*z4 - z3*y4)^2 + (x3*z4 - x4*z3)^2 + (x3*y4 - x4*y3)^2]
-      //double distance = SQR_NORM (cANN::cross (p4, p3)) / SQR_NORM (p3);
-      std_msgs::Point32 c = cloud_geometry::cross (p4, p3);
-      double sqr_distance = (c.x * c.x + c.y * c.y + c.z * c.z) / (p3.x * p3.x + p3.y * p3.y + p3.z * p3.z);
+      double qx = lx - px[i], qy = ly - py[i], qz = lz - pz[i];
+      double cx = qy * dz - qz * dy, cy = qz * dx - qx * dz, cz = qx * dy - qy * dx;
+      if (sqrt (cx * cx + cy * cy + cz * cz) / d_norm < threshold)
+        inliers[nr_inliers++] = indices_[i];
+    }
+    inliers.resize (nr_inliers);
+  }
 
-      if (sqr_distance < sqr_threshold)
-        // Returns the indices of the points whose squared distances are smaller than the threshold
-        inliers.push_back (indices_[i]);
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Count all the points which respect the given model coefficients as inliers.
+    * \param model_coefficients the coefficients of a line model that we need to compute distances to
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    * \param max_outliers give up once more than this many outliers have been found
+    */
+  int
+    SACModelLine::countWithinDistance (const std::vector<double> &model_coefficients, double threshold, int max_outliers)
+  {
+    const float lx = model_coefficients.at (3), ly = model_coefficients.at (4), lz = model_coefficients.at (5);
+    const float dx = lx - model_coefficients.at (0), dy = ly - model_coefficients.at (1), dz = lz - model_coefficients.at (2);
+    const float limit = threshold * threshold * (dx * dx + dy * dy + dz * dz);
+    const int n = indices_.size ();
+    if (n == 0)
+      return (0);
+    const float *px = &points_x_[0], *py = &points_y_[0], *pz = &points_z_[0];
+
+    int nr_inliers = 0, i = 0;
+    while (i + 4 <= n)
+    {
+      // Check for an early exit once per block rather than once per point
+      int block_end = std::min (n - 3, i + SAC_BLOCK_SIZE);
+      for (; i < block_end; i += 4)
+        nr_inliers += mask_count[lineInliers4 (px, py, pz, i, lx, ly, lz, dx, dy, dz, limit)];
+      if (i - nr_inliers > max_outliers)
+        return (nr_inliers);
     }
-    return (inliers);
+    for (; i < n; i++)
+      if (lineInlier (px, py, pz, i, lx, ly, lz, dx, dy, dz, limit))
+        nr_inliers++;
+    return (nr_inliers);
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   /** \brief Compute all distances from the cloud data to a given line model.
     * \param model_coefficients the coefficients of a line model that we need to compute distances to
+    * \param distances the resultant distances
     */
-  std::vector<double>
-    SACModelLine::getDistancesToModel (std::vector<double> model_coefficients)
+  void
+    SACModelLine::getDistancesToModel (const std::vector<double> &model_coefficients, std::vector<double> &distances)
   {
-    std::vector<double> distances (indices_.size ());
+    const double lx = model_coefficients.at (3), ly = model_coefficients.at (4), lz = model_coefficients.at (5);
+    const double dx = lx - model_coefficients.at (0), dy = ly - model_coefficients.at (1), dz = lz - model_coefficients.at (2);
+    const double d_norm = sqrt (dx * dx + dy * dy + dz * dz);
+    const int n = indices_.size ();
+    distances.resize (n);
+    if (n == 0)
+      return;
+    const float *px = &points_x_[0], *py = &points_y_[0], *pz = &points_z_[0];
 
-    // Iterate through the 3d points and calculate the distances from them to the plane
-    for (unsigned int i = 0; i < indices_.size (); i++)
+    // Iterate through the 3d points and calculate the distances from them to the line
+    for (int i = 0; i < n; i++)
     {
       // Calculate the distance from the point to the line
       // D = ||(P2-P1) x (P1-P0)|| / ||P2-P1|| = norm (cross (p2-p1, p2-p0)) / norm(p2-p1)
-      std_msgs::Point32 p3, p4;
-      p3.x = model_coefficients.at (3) - model_coefficients.at (0);
-      p3.y = model_coefficients.at (4) - model_coefficients.at (1);
-      p3.z = model_coefficients.at (5) - model_coefficients.at (2);
-
-      p4.x = model_coefficients.at (3) - cloud_->pts.at (indices_.at (i)).x;
-      p4.y = model_coefficients.at (4) - cloud_->pts.at (indices_.at (i)).y;
-      p4.z = model_coefficients.at (5) - cloud_->pts.at (indices_.at (i)).z;
-
-      std_msgs::Point32 c = cloud_geometry::cross (p4, p3);
-      distances[i] = sqrt (c.x * c.x + c.y * c.y + c.z * c.z) / (p3.x * p3.x + p3.y * p3.y + p3.z * p3.z);
+      double qx = lx - px[i], qy = ly - py[i], qz = lz - pz[i];
+      double cx = qy * dz - qz * dy, cy = qz * dx - qx * dz, cz = qx * dy - qy * dx;
+      distances[i] = sqrt (cx * cx + cy * cy + cz * cz) / d_norm;
     }
-    return (distances);
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -143,7 +215,7 @@ namespace sample_consensus
     * \param model_coefficients the coefficients of a line model
     */
   std_msgs::PointCloud
-    SACModelLine::projectPoints (std::vector<int> inliers, std::vector<double> model_coefficients)
+    SACModelLine::projectPoints (const std::vector<int> &inliers, const std::vector<double> &model_coefficients)
   {
     std_msgs::PointCloud projected_cloud;
     // Allocate enough space
@@ -188,7 +260,7 @@ namespace sample_consensus
     * \param model_coefficients the coefficients of a line model
     */
   void
-    SACModelLine::projectPointsInPlace (std::vector<int> inliers, std::vector<double> model_coefficients)
+    SACModelLine::projectPointsInPlace (const std::vector<int> &inliers, const std::vector<double> &model_coefficients)
   {
     // Compute the line direction (P2 - P1)
     std_msgs::Point32 p21;
@@ -208,6 +280,9 @@ namespace sample_consensus
       cloud_->pts.at (inliers.at (i)).y = model_coefficients_.at (1) + k * p21.y;
       cloud_->pts.at (inliers.at (i)).z = model_coefficients_.at (2) + k * p21.z;
     }
+
+    // Keep the coordinate buffer used for model evaluation in sync with the cloud
+    cacheDataSet ();
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -217,7 +292,7 @@ namespace sample_consensus
     * \param indices the point indices found as possible good candidates for creating a valid model
     */
   bool
-    SACModelLine::computeModelCoefficients (std::vector<int> indices)
+    SACModelLine::computeModelCoefficients (const std::vector<int> &indices)
   {
     model_coefficients_.resize (6);
     model_coefficients_[0] = cloud_->pts.at (indices.at (0)).x;
@@ -236,7 +311,7 @@ namespace sample_consensus
     * \param inliers the data inliers found as supporting the model
     */
   std::vector<double>
-    SACModelLine::refitModel (std::vector<int> inliers)
+    SACModelLine::refitModel (const std::vector<int> &inliers)
   {
     if (inliers.size () == 0)
       return (model_coefficients_);
@@ -267,28 +342,28 @@ namespace sample_consensus
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   /** \brief Verify whether a subset of indices verifies the internal line model coefficients.
-    * \param indices the data indices that need to be tested against the line model
+    * \param indices positions in the current set of point indices that need to be tested against the line model
     * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
     */
   bool
-    SACModelLine::doSamplesVerifyModel (std::set<int> indices, double threshold)
+    SACModelLine::doSamplesVerifyModel (const std::set<int> &indices, double threshold)
   {
     double sqr_threshold = threshold * threshold;
-    for (std::set<int>::iterator it = indices.begin (); it != indices.end (); ++it)
+    for (std::set<int>::const_iterator it = indices.begin (); it != indices.end (); ++it)
     {
       std_msgs::Point32 p3, p4;
       p3.x = model_coefficients_.at (3) - model_coefficients_.at (0);
       p3.y = model_coefficients_.at (4) - model_coefficients_.at (1);
       p3.z = model_coefficients_.at (5) - model_coefficients_.at (2);
 
-      p4.x = model_coefficients_.at (3) - cloud_->pts.at (*it).x;
-      p4.y = model_coefficients_.at (4) - cloud_->pts.at (*it).y;
-      p4.z = model_coefficients_.at (5) - cloud_->pts.at (*it).z;
+      p4.x = model_coefficients_.at (3) - points_x_.at (*it);
+      p4.y = model_coefficients_.at (4) - points_y_.at (*it);
+      p4.z = model_coefficients_.at (5) - points_z_.at (*it);
 
       std_msgs::Point32 c = cloud_geometry::cross (p4, p3);
       double sqr_distance = (c.x * c.x + c.y * c.y + c.z * c.z) / (p3.x * p3.x + p3.y * p3.y + p3.z * p3.z);
 
-      if (sqr_distance < sqr_threshold)
+      if (sqr_distance > sqr_threshold)
         return (false);
     }
     return (true);
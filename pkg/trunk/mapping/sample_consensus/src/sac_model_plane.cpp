@@ -30,6 +30,10 @@
 
 /** \author Radu Bogdan Rusu */
 
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "sample_consensus/sac_model_plane.h"
 #include "cloud_geometry/nearest.h"
 
@@ -99,52 +103,125 @@ namespace sample_consensus
     return (random_idx);
   }
 
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Test points i to i+3 of the coordinate arrays against a plane and return a bitmask of the inliers.
+    * \note The inlier test is |a*x + b*y + c*z + d| < t, evaluated in single precision. The scalar and SSE paths
+    * perform the same operations in the same order, so counts do not depend on where the blocks of four fall.
+    */
+  static inline int
+    planeInliers4 (const float *px, const float *py, const float *pz, int i, float a, float b, float c, float d, float t)
+  {
+#if defined(__SSE2__)
+    const __m128 abs_mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+    __m128 e = _mm_add_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (_mm_set1_ps (a), _mm_loadu_ps (px + i)),
+                                                   _mm_mul_ps (_mm_set1_ps (b), _mm_loadu_ps (py + i))),
+                                       _mm_mul_ps (_mm_set1_ps (c), _mm_loadu_ps (pz + i))),
+                           _mm_set1_ps (d));
+    return (_mm_movemask_ps (_mm_cmplt_ps (_mm_and_ps (e, abs_mask), _mm_set1_ps (t))));
+#else
+    int mask = 0;
+    for (int j = 0; j < 4; j++)
+      if (fabsf (((a * px[i + j] + b * py[i + j]) + c * pz[i + j]) + d) < t)
+        mask |= (1 << j);
+    return (mask);
+#endif
+  }
+
+  /** \brief Test a single point against a plane, in the same way as planeInliers4 */
+  static inline bool
+    planeInlier (const float *px, const float *py, const float *pz, int i, float a, float b, float c, float d, float t)
+  {
+    return (fabsf (((a * px[i] + b * py[i]) + c * pz[i]) + d) < t);
+  }
+
+  /** \brief Number of set bits in a 4-bit inlier mask */
+  static const int mask_count[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   /** \brief Select all the points which respect the given model coefficients as inliers.
     * \param model_coefficients the coefficients of a plane model that we need to compute distances to
     * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    * \param inliers the resultant inliers
     * \note: we should compare (e^2) < (T^2) but instead we use fabs(e) because threshold is always positive
     * \note: To get the refined inliers of a model, use:
     * ANNpoint refined_coeff = refitModel (...); selectWithinDistance (refined_coeff, threshold);
     */
-  std::vector<int>
-    SACModelPlane::selectWithinDistance (std::vector<double> model_coefficients, double threshold)
+  void
+    SACModelPlane::selectWithinDistance (const std::vector<double> &model_coefficients, double threshold, std::vector<int> &inliers)
   {
-    std::vector<int> inliers;
-
-    // Iterate through the 3d points and calculate the distances from them to the plane
-    for (unsigned int i = 0; i < indices_.size (); i++)
+    const double a = model_coefficients.at (0), b = model_coefficients.at (1), c = model_coefficients.at (2),
+                 d = model_coefficients.at (3);
+    const int n = indices_.size ();
+    inliers.resize (n);
+    if (n == 0)
+      return;
+    const float *px = &points_x_[0], *py = &points_y_[0], *pz = &points_z_[0];
+
+    // The distances are computed in double precision, exactly as in getDistancesToModel
+    int nr_inliers = 0;
+    for (int i = 0; i < n; i++)
     {
       // Calculate the distance from the point to the plane normal as the dot product
       // D = (P-A).N/|N|
-      if (fabs (model_coefficients.at (0) * cloud_->pts.at (indices_.at (i)).x +
-                model_coefficients.at (1) * cloud_->pts.at (indices_.at (i)).y +
-                model_coefficients.at (2) * cloud_->pts.at (indices_.at (i)).z +
-                model_coefficients.at (3)) < threshold)
-        // Returns the indices of the points whose distances are smaller than the threshold
-        inliers.push_back (indices_[i]);
+      if (fabs (a * px[i] + b * py[i] + c * pz[i] + d) < threshold)
+        inliers[nr_inliers++] = indices_[i];
     }
-    return (inliers);
+    inliers.resize (nr_inliers);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  /** \brief Count all the points which respect the given model coefficients as inliers.
+    * \param model_coefficients the coefficients of a plane model that we need to compute distances to
+    * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
+    * \param max_outliers give up once more than this many outliers have been found
+    */
+  int
+    SACModelPlane::countWithinDistance (const std::vector<double> &model_coefficients, double threshold, int max_outliers)
+  {
+    const float a = model_coefficients.at (0), b = model_coefficients.at (1), c = model_coefficients.at (2),
+                d = model_coefficients.at (3), t = threshold;
+    const int n = indices_.size ();
+    if (n == 0)
+      return (0);
+    const float *px = &points_x_[0], *py = &points_y_[0], *pz = &points_z_[0];
+
+    int nr_inliers = 0, i = 0;
+    while (i + 4 <= n)
+    {
+      // Check for an early exit once per block rather than once per point
+      int block_end = std::min (n - 3, i + SAC_BLOCK_SIZE);
+      for (; i < block_end; i += 4)
+        nr_inliers += mask_count[planeInliers4 (px, py, pz, i, a, b, c, d, t)];
+      if (i - nr_inliers > max_outliers)
+        return (nr_inliers);
+    }
+    for (; i < n; i++)
+      if (planeInlier (px, py, pz, i, a, b, c, d, t))
+        nr_inliers++;
+    return (nr_inliers);
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   /** \brief Compute all distances from the cloud data to a given plane model.
     * \param model_coefficients the coefficients of a plane model that we need to compute distances to
+    * \param distances the resultant distances
     */
-  std::vector<double>
-    SACModelPlane::getDistancesToModel (std::vector<double> model_coefficients)
+  void
+    SACModelPlane::getDistancesToModel (const std::vector<double> &model_coefficients, std::vector<double> &distances)
   {
-    std::vector<double> distances (indices_.size ());
+    const double a = model_coefficients.at (0), b = model_coefficients.at (1), c = model_coefficients.at (2),
+                 d = model_coefficients.at (3);
+    const int n = indices_.size ();
+    distances.resize (n);
+    if (n == 0)
+      return;
+    const float *px = &points_x_[0], *py = &points_y_[0], *pz = &points_z_[0];
 
     // Iterate through the 3d points and calculate the distances from them to the plane
-    for (unsigned int i = 0; i < indices_.size (); i++)
+    for (int i = 0; i < n; i++)
       // Calculate the distance from the point to the plane normal as the dot product
       // D = (P-A).N/|N|
-      distances[i] = fabs (model_coefficients.at (0) * cloud_->pts.at (indices_[i]).x +
-                           model_coefficients.at (1) * cloud_->pts.at (indices_[i]).y +
-                           model_coefficients.at (2) * cloud_->pts.at (indices_[i]).z +
-                           model_coefficients.at (3));
-    return (distances);
+      distances[i] = fabs (a * px[i] + b * py[i] + c * pz[i] + d);
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -153,7 +230,7 @@ namespace sample_consensus
     * \param model_coefficients the coefficients of a plane model
     */
   std_msgs::PointCloud
-    SACModelPlane::projectPoints (std::vector<int> inliers, std::vector<double> model_coefficients)
+    SACModelPlane::projectPoints (const std::vector<int> &inliers, const std::vector<double> &model_coefficients)
   {
     std_msgs::PointCloud projected_cloud;
     // Allocate enough space
@@ -169,27 +246,28 @@ namespace sample_consensus
     }
 
     // Get the plane normal
+    std::vector<double> plane_coefficients = model_coefficients;
     // Calculate the 2-norm: norm (x) = sqrt (sum (abs (v)^2))
-    double n_norm = sqrt (model_coefficients.at (0) * model_coefficients.at (0) +
-                          model_coefficients.at (1) * model_coefficients.at (1) +
-                          model_coefficients.at (2) * model_coefficients.at (2));
-    model_coefficients.at (0) /= n_norm;
-    model_coefficients.at (1) /= n_norm;
-    model_coefficients.at (2) /= n_norm;
-    model_coefficients.at (3) /= n_norm;
+    double n_norm = sqrt (plane_coefficients.at (0) * plane_coefficients.at (0) +
+                          plane_coefficients.at (1) * plane_coefficients.at (1) +
+                          plane_coefficients.at (2) * plane_coefficients.at (2));
+    plane_coefficients.at (0) /= n_norm;
+    plane_coefficients.at (1) /= n_norm;
+    plane_coefficients.at (2) /= n_norm;
+    plane_coefficients.at (3) /= n_norm;
 
     // Iterate through the 3d points and calculate the distances from them to the plane
     for (unsigned int i = 0; i < inliers.size (); i++)
     {
       // Calculate the distance from the point to the plane
-      double distance_to_plane = model_coefficients.at (0) * cloud_->pts.at (inliers.at (i)).x +
-                                 model_coefficients.at (1) * cloud_->pts.at (inliers.at (i)).y +
-                                 model_coefficients.at (2) * cloud_->pts.at (inliers.at (i)).z +
-                                 model_coefficients.at (3) * 1;
+      double distance_to_plane = plane_coefficients.at (0) * cloud_->pts.at (inliers.at (i)).x +
+                                 plane_coefficients.at (1) * cloud_->pts.at (inliers.at (i)).y +
+                                 plane_coefficients.at (2) * cloud_->pts.at (inliers.at (i)).z +
+                                 plane_coefficients.at (3) * 1;
       // Calculate the projection of the point on the plane
-      projected_cloud.pts[i].x = cloud_->pts.at (inliers.at (i)).x - distance_to_plane * model_coefficients.at (0);
-      projected_cloud.pts[i].y = cloud_->pts.at (inliers.at (i)).y - distance_to_plane * model_coefficients.at (1);
-      projected_cloud.pts[i].z = cloud_->pts.at (inliers.at (i)).z - distance_to_plane * model_coefficients.at (2);
+      projected_cloud.pts[i].x = cloud_->pts.at (inliers.at (i)).x - distance_to_plane * plane_coefficients.at (0);
+      projected_cloud.pts[i].y = cloud_->pts.at (inliers.at (i)).y - distance_to_plane * plane_coefficients.at (1);
+      projected_cloud.pts[i].z = cloud_->pts.at (inliers.at (i)).z - distance_to_plane * plane_coefficients.at (2);
       // Copy the other attributes
       for (unsigned int d = 0; d < projected_cloud.get_chan_size (); d++)
         projected_cloud.chan[d].vals[i] = cloud_->chan[d].vals[inliers.at (i)];
@@ -203,31 +281,35 @@ namespace sample_consensus
     * \param model_coefficients the coefficients of a plane model
     */
   void
-    SACModelPlane::projectPointsInPlace (std::vector<int> inliers, std::vector<double> model_coefficients)
+    SACModelPlane::projectPointsInPlace (const std::vector<int> &inliers, const std::vector<double> &model_coefficients)
   {
     // Get the plane normal
+    std::vector<double> plane_coefficients = model_coefficients;
     // Calculate the 2-norm: norm (x) = sqrt (sum (abs (v)^2))
-    double n_norm = sqrt (model_coefficients.at (0) * model_coefficients.at (0) +
-                          model_coefficients.at (1) * model_coefficients.at (1) +
-                          model_coefficients.at (2) * model_coefficients.at (2));
-    model_coefficients.at (0) /= n_norm;
-    model_coefficients.at (1) /= n_norm;
-    model_coefficients.at (2) /= n_norm;
-    model_coefficients.at (3) /= n_norm;
+    double n_norm = sqrt (plane_coefficients.at (0) * plane_coefficients.at (0) +
+                          plane_coefficients.at (1) * plane_coefficients.at (1) +
+                          plane_coefficients.at (2) * plane_coefficients.at (2));
+    plane_coefficients.at (0) /= n_norm;
+    plane_coefficients.at (1) /= n_norm;
+    plane_coefficients.at (2) /= n_norm;
+    plane_coefficients.at (3) /= n_norm;
 
     // Iterate through the 3d points and calculate the distances from them to the plane
     for (unsigned int i = 0; i < inliers.size (); i++)
     {
       // Calculate the distance from the point to the plane
-      double distance_to_plane = model_coefficients.at (0) * cloud_->pts.at (inliers.at (i)).x +
-                                 model_coefficients.at (1) * cloud_->pts.at (inliers.at (i)).y +
-                                 model_coefficients.at (2) * cloud_->pts.at (inliers.at (i)).z +
-                                 model_coefficients.at (3) * 1;
+      double distance_to_plane = plane_coefficients.at (0) * cloud_->pts.at (inliers.at (i)).x +
+                                 plane_coefficients.at (1) * cloud_->pts.at (inliers.at (i)).y +
+                                 plane_coefficients.at (2) * cloud_->pts.at (inliers.at (i)).z +
+                                 plane_coefficients.at (3) * 1;
       // Calculate the projection of the point on the plane
-      cloud_->pts.at (inliers.at (i)).x = cloud_->pts.at (inliers.at (i)).x - distance_to_plane * model_coefficients.at (0);
-      cloud_->pts.at (inliers.at (i)).y = cloud_->pts.at (inliers.at (i)).y - distance_to_plane * model_coefficients.at (1);
-      cloud_->pts.at (inliers.at (i)).z = cloud_->pts.at (inliers.at (i)).z - distance_to_plane * model_coefficients.at (2);
+      cloud_->pts.at (inliers.at (i)).x = cloud_->pts.at (inliers.at (i)).x - distance_to_plane * plane_coefficients.at (0);
+      cloud_->pts.at (inliers.at (i)).y = cloud_->pts.at (inliers.at (i)).y - distance_to_plane * plane_coefficients.at (1);
+      cloud_->pts.at (inliers.at (i)).z = cloud_->pts.at (inliers.at (i)).z - distance_to_plane * plane_coefficients.at (2);
     }
+
+    // Keep the coordinate buffer used for model evaluation in sync with the cloud
+    cacheDataSet ();
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -237,7 +319,7 @@ namespace sample_consensus
     * \param indices the point indices found as possible good candidates for creating a valid model
     */
   bool
-    SACModelPlane::computeModelCoefficients (std::vector<int> indices)
+    SACModelPlane::computeModelCoefficients (const std::vector<int> &indices)
   {
     model_coefficients_.resize (4);
     double Dx1, Dy1, Dz1, Dx2, Dy2, Dz2, Dy1Dy2;
@@ -294,7 +376,7 @@ namespace sample_consensus
     * \param inliers the data inliers found as supporting the model
     */
   std::vector<double>
-    SACModelPlane::refitModel (std::vector<int> inliers)
+    SACModelPlane::refitModel (const std::vector<int> &inliers)
   {
     if (inliers.size () == 0)
     {
@@ -317,16 +399,16 @@ namespace sample_consensus
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   /** \brief Verify whether a subset of indices verifies the internal plane model coefficients.
-    * \param indices the data indices that need to be tested against the plane model
+    * \param indices positions in the current set of point indices that need to be tested against the plane model
     * \param threshold a maximum admissible distance threshold for determining the inliers from the outliers
     */
   bool
-    SACModelPlane::doSamplesVerifyModel (std::set<int> indices, double threshold)
+    SACModelPlane::doSamplesVerifyModel (const std::set<int> &indices, double threshold)
   {
-    for (std::set<int>::iterator it = indices.begin (); it != indices.end (); ++it)
-      if (fabs (model_coefficients_.at (0) * cloud_->pts.at (*it).x +
-                model_coefficients_.at (1) * cloud_->pts.at (*it).y +
-                model_coefficients_.at (2) * cloud_->pts.at (*it).z +
+    for (std::set<int>::const_iterator it = indices.begin (); it != indices.end (); ++it)
+      if (fabs (model_coefficients_.at (0) * points_x_.at (*it) +
+                model_coefficients_.at (1) * points_y_.at (*it) +
+                model_coefficients_.at (2) * points_z_.at (*it) +
                 model_coefficients_.at (3)) > threshold)
         return (false);
 
@@ -31,6 +31,7 @@
 /** \author Radu Bogdan Rusu */
 
 #include <gtest/gtest.h>
+#include <sys/time.h>
 #include "std_msgs/PointCloud.h"
 
 #include "sample_consensus/sac.h"
@@ -427,6 +428,95 @@ TEST (RMSAC, SACModelPlane)
   EXPECT_EQ (nr_points_left, 1);
 }
 
+TEST (RANSAC, SACModelPlaneLargeCloud)
+{
+  // Build a tilt-laser-like scan: a dense floor patch at z = 0.75 plus uniformly distributed clutter above it
+  std_msgs::PointCloud points;
+  int nr_plane = 400000, nr_clutter = 100000;
+  points.pts.resize (nr_plane + nr_clutter);
+
+  srand (0);
+  for (int i = 0; i < nr_plane; i++)
+  {
+    points.pts[i].x = 4.0 * rand () / (RAND_MAX + 1.0);
+    points.pts[i].y = 4.0 * rand () / (RAND_MAX + 1.0) - 2.0;
+    points.pts[i].z = 0.75 + 0.01 * rand () / (RAND_MAX + 1.0) - 0.005;
+  }
+  for (int i = nr_plane; i < nr_plane + nr_clutter; i++)
+  {
+    points.pts[i].x = 4.0 * rand () / (RAND_MAX + 1.0);
+    points.pts[i].y = 4.0 * rand () / (RAND_MAX + 1.0) - 2.0;
+    points.pts[i].z = 1.0 + 2.0 * rand () / (RAND_MAX + 1.0);
+  }
+
+  std::vector<int> inliers[2];
+  int nr_threads[2] = {1, 4};
+  for (int t = 0; t < 2; t++)
+  {
+    SACModel *model = new SACModelPlane ();
+    SAC *sac        = new RANSAC (model, 0.02);
+    sac->setNumberOfThreads (nr_threads[t]);
+    model->setDataSet (&points);
+    srand (42);
+
+    timeval t1, t2;
+    gettimeofday (&t1, NULL);
+    bool result = sac->computeModel ();
+    gettimeofday (&t2, NULL);
+    EXPECT_EQ (result, true);
+    printf ("[RANSAC, %d thread(s)] %d points, %g seconds\n", nr_threads[t], (int)points.pts.size (),
+            (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec) / 1e6);
+
+    inliers[t] = sac->getInliers ();
+    EXPECT_EQ ((int)inliers[t].size (), nr_plane);
+
+    std::vector<double> coeff = sac->computeCoefficients ();
+    EXPECT_EQ ((int)coeff.size (), 4);
+    EXPECT_NEAR (fabs (coeff[2]), 1.0, 1e-2);
+    EXPECT_NEAR (fabs (coeff[3]), 0.75, 1e-2);
+
+    delete sac;
+    delete model;
+  }
+  // Batched multi-threaded scoring must not change the result for the same random sequence
+  EXPECT_TRUE (inliers[0] == inliers[1]);
+}
+
+TEST (SACModelPlane, DistancePrecision)
+{
+  std_msgs::PointCloud points;
+  points.pts.resize (10000);
+  srand (0);
+  for (unsigned int i = 0; i < points.pts.size (); i++)
+  {
+    points.pts[i].x = 200.0 * rand () / (RAND_MAX + 1.0) - 100.0;
+    points.pts[i].y = 200.0 * rand () / (RAND_MAX + 1.0) - 100.0;
+    points.pts[i].z = 0.75 + 0.1 * rand () / (RAND_MAX + 1.0) - 0.05;
+  }
+
+  SACModelPlane model;
+  model.setDataSet (&points);
+  std::vector<double> coeff (4);
+  coeff[0] = 0.001; coeff[1] = -0.002; coeff[2] = 1.0; coeff[3] = -0.75;
+  double threshold = 0.02;
+
+  // Selection works in double precision, and agrees exactly with the distances
+  std::vector<double> distances = model.getDistancesToModel (coeff);
+  std::vector<int> inliers = model.selectWithinDistance (coeff, threshold);
+  std::vector<int> expected;
+  for (unsigned int i = 0; i < distances.size (); i++)
+    if (distances[i] < threshold)
+      expected.push_back (i);
+  EXPECT_TRUE (inliers == expected);
+
+  // Counting works in single precision, and may only differ for points within rounding error of the threshold
+  int nr_boundary = 0;
+  for (unsigned int i = 0; i < distances.size (); i++)
+    if (fabs (distances[i] - threshold) < 1e-4)
+      nr_boundary++;
+  EXPECT_LE (abs (model.countWithinDistance (coeff, threshold) - (int)inliers.size ()), nr_boundary);
+}
+
 /* ---[ */
 int
   main (int argc, char** argv)
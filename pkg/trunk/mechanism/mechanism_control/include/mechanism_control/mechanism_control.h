@@ -43,7 +43,8 @@
 #include <mechanism_model/robot.h>
 #include <rosthread/mutex.h>
 #include <mechanism_model/controller.h>
-#include <misc_utils/realtime_publisher.h>
+#include <misc_utils/realtime_triple_publisher.h>
+#include <misc_utils/latency_histogram.h>
 #include <misc_utils/advertised_service_guard.h>
 
 #include <robot_srvs/ListControllerTypes.h>
@@ -72,10 +73,27 @@ public:
   bool killController(const std::string &name);
   controller::Controller* getControllerByName(std::string name);
 
+  // Debugging aid: while enabled, every heap allocation made by the thread
+  // running update() is counted.  Returns false if allocation hooks are not
+  // available on this platform.
+  bool setMallocCheck(bool enable);
+  unsigned int getMallocCount();
+
+  // Writes the timing histograms of every stage of update() and of each
+  // controller to f, in the format of misc_utils::LatencyHistogram::dump.
+  void dumpTiming(FILE *f);
+  const misc_utils::LatencyHistogram *getControllerTiming(const std::string &name);
+
   mechanism::Robot model_;
   mechanism::RobotState *state_;
   HardwareInterface *hw_;
 
+  // Duration of each stage of update(), recorded by the realtime thread
+  misc_utils::LatencyHistogram propagate_state_timing_;
+  misc_utils::LatencyHistogram controllers_timing_;
+  misc_utils::LatencyHistogram enforce_safety_timing_;
+  misc_utils::LatencyHistogram propagate_effort_timing_;
+
 private:
   bool initialized_;
 
@@ -83,6 +101,7 @@ private:
   ros::thread::mutex controllers_lock_;
   controller::Controller* controllers_[MAX_NUM_CONTROLLERS];
   std::string controller_names_[MAX_NUM_CONTROLLERS];
+  misc_utils::LatencyHistogram controller_timing_[MAX_NUM_CONTROLLERS];
 
   // Killing a controller:
   // 1. Non-realtime thread places the index of the controller into please_remove_
@@ -92,6 +111,8 @@ private:
   // please_remove_ must be -1 when not removing
   int please_remove_;
   controller::Controller* removed_;
+
+  bool check_malloc_;
 };
 
 /*
@@ -127,9 +148,9 @@ private:
   int cycles_since_publish_;
 
   const char* const mechanism_state_topic_;
-  misc_utils::RealtimePublisher<robot_msgs::MechanismState> publisher_;
+  misc_utils::RealtimeTriplePublisher<robot_msgs::MechanismState> publisher_;
 
-  misc_utils::RealtimePublisher<tf::TransformArray> transform_publisher_;
+  misc_utils::RealtimeTriplePublisher<tf::TransformArray> transform_publisher_;
 
   AdvertisedServiceGuard list_controllers_guard_, list_controller_types_guard_,
     spawn_controller_guard_, kill_controller_guard_;
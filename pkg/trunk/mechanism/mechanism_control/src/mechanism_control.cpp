@@ -32,11 +32,57 @@
 #include "rosthread/member_thread.h"
 #include "misc_utils/mutex_guard.h"
 #include "rosconsole/rosconsole.h"
+#include <malloc.h>
 
 using namespace mechanism;
 
+// Allocation counting for MechanismControl::setMallocCheck().  The hooks are
+// process wide, so a thread local flag marks the realtime thread while it is
+// inside update() and only those allocations are counted.
+#if defined(__GLIBC__) && __GLIBC__ == 2 && __GLIBC_MINOR__ < 34
+#define MECHANISM_CONTROL_MALLOC_HOOKS
+#endif
+
+static inline double now()
+{
+  struct timespec n;
+  clock_gettime(CLOCK_MONOTONIC, &n);
+  return n.tv_sec + n.tv_nsec * 1e-9;
+}
+
+static __thread bool in_realtime_update = false;
+static volatile unsigned int realtime_malloc_count = 0;
+
+#ifdef MECHANISM_CONTROL_MALLOC_HOOKS
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+
+static void *countingMalloc(size_t size, const void *caller)
+{
+  if (in_realtime_update)
+    __sync_fetch_and_add(&realtime_malloc_count, 1);
+  return __libc_malloc(size);
+}
+
+static void *countingRealloc(void *ptr, size_t size, const void *caller)
+{
+  if (in_realtime_update)
+    __sync_fetch_and_add(&realtime_malloc_count, 1);
+  return __libc_realloc(ptr, size);
+}
+
+static void *countingMemalign(size_t alignment, size_t size, const void *caller)
+{
+  if (in_realtime_update)
+    __sync_fetch_and_add(&realtime_malloc_count, 1);
+  return __libc_memalign(alignment, size);
+}
+#endif
+
 MechanismControl::MechanismControl(HardwareInterface *hw) :
-  state_(NULL), hw_(hw), initialized_(0), please_remove_(-1), removed_(NULL)
+  state_(NULL), hw_(hw), initialized_(0), please_remove_(-1), removed_(NULL),
+  check_malloc_(false)
 {
   memset(controllers_, 0, MAX_NUM_CONTROLLERS * sizeof(void*));
   model_.hw_ = hw;
@@ -44,6 +90,8 @@ MechanismControl::MechanismControl(HardwareInterface *hw) :
 
 MechanismControl::~MechanismControl()
 {
+  setMallocCheck(false);
+
   // Destroy all controllers
   for (int i = 0; i < MAX_NUM_CONTROLLERS; ++i)
   {
@@ -77,18 +125,35 @@ controller::Controller* MechanismControl::getControllerByName(std::string name)
 // Must be realtime safe.
 void MechanismControl::update()
 {
+  if (check_malloc_)
+    in_realtime_update = true;
+
+  double start = now();
   state_->propagateState();
   state_->zeroCommands();
+  double after_state = now();
+  propagate_state_timing_.record(after_state - start);
 
   // Update all controllers
+  double before = after_state;
   for (int i = 0; i < MAX_NUM_CONTROLLERS; ++i)
   {
     if (controllers_[i] != NULL)
+    {
       controllers_[i]->update();
+      double after = now();
+      controller_timing_[i].record(after - before);
+      before = after;
+    }
   }
+  controllers_timing_.record(before - after_state);
 
   state_->enforceSafety();
+  double after_safety = now();
+  enforce_safety_timing_.record(after_safety - before);
+
   state_->propagateEffort();
+  propagate_effort_timing_.record(now() - after_safety);
 
   // If there's a controller to remove, we take it out of the controllers array.
   if (please_remove_ >= 0)
@@ -97,6 +162,36 @@ void MechanismControl::update()
     controllers_[please_remove_] = NULL;
     please_remove_ = -1;
   }
+
+  in_realtime_update = false;
+}
+
+bool MechanismControl::setMallocCheck(bool enable)
+{
+#ifdef MECHANISM_CONTROL_MALLOC_HOOKS
+  if (enable && !check_malloc_)
+  {
+    realtime_malloc_count = 0;
+    __malloc_hook = countingMalloc;
+    __realloc_hook = countingRealloc;
+    __memalign_hook = countingMemalign;
+  }
+  else if (!enable && check_malloc_)
+  {
+    __malloc_hook = NULL;
+    __realloc_hook = NULL;
+    __memalign_hook = NULL;
+  }
+  check_malloc_ = enable;
+  return true;
+#else
+  return !enable;
+#endif
+}
+
+unsigned int MechanismControl::getMallocCount()
+{
+  return realtime_malloc_count;
 }
 
 void MechanismControl::getControllerNames(std::vector<std::string> &controllers)
@@ -123,8 +218,9 @@ bool MechanismControl::addController(controller::Controller *c, const std::strin
   {
     if (controllers_[i] == NULL)
     {
-      controllers_[i] = c;
+      controller_timing_[i].reset();
       controller_names_[i] = name;
+      controllers_[i] = c;
       return true;
     }
   }
@@ -133,6 +229,34 @@ bool MechanismControl::addController(controller::Controller *c, const std::strin
 }
 
 
+const misc_utils::LatencyHistogram *MechanismControl::getControllerTiming(const std::string &name)
+{
+  misc_utils::MutexGuard guard(&controllers_lock_);
+
+  for (int i = 0; i < MAX_NUM_CONTROLLERS; ++i)
+  {
+    if (controllers_[i] != NULL && controller_names_[i] == name)
+      return &controller_timing_[i];
+  }
+  return NULL;
+}
+
+void MechanismControl::dumpTiming(FILE *f)
+{
+  propagate_state_timing_.dump(f, "propagate_state");
+  controllers_timing_.dump(f, "controllers");
+  enforce_safety_timing_.dump(f, "enforce_safety");
+  propagate_effort_timing_.dump(f, "propagate_effort");
+
+  misc_utils::MutexGuard guard(&controllers_lock_);
+  for (int i = 0; i < MAX_NUM_CONTROLLERS; ++i)
+  {
+    if (controllers_[i] != NULL)
+      controller_timing_[i].dump(f, ("controller/" + controller_names_[i]).c_str());
+  }
+}
+
+
 bool MechanismControl::spawnController(const std::string &type,
                                        const std::string &name,
                                        TiXmlElement *config)
@@ -211,8 +335,17 @@ bool MechanismControlNode::initXml(TiXmlElement *config)
 {
   if (!mc_->initXml(config))
     return false;
-  publisher_.msg_.set_joint_states_size(mc_->model_.joints_.size());
-  publisher_.msg_.set_actuator_states_size(mc_->hw_->actuators_.size());
+
+  // Sizes the published messages and fills in the names, which never
+  // change, so the realtime loop only writes the numbers.
+  robot_msgs::MechanismState state;
+  state.set_joint_states_size(mc_->model_.joints_.size());
+  for (unsigned int i = 0; i < mc_->model_.joints_.size(); ++i)
+    state.joint_states[i].name = mc_->model_.joints_[i]->name_;
+  state.set_actuator_states_size(mc_->hw_->actuators_.size());
+  for (unsigned int i = 0; i < mc_->hw_->actuators_.size(); ++i)
+    state.actuator_states[i].name = mc_->hw_->actuators_[i]->name_;
+  publisher_.init(state);
 
   // Counts the number of transforms
   int num_transforms = 0;
@@ -221,7 +354,18 @@ bool MechanismControlNode::initXml(TiXmlElement *config)
     if (mc_->model_.links_[i]->parent_name_ != std::string("world"))
       ++num_transforms;
   }
-  transform_publisher_.msg_.set_quaternions_size(num_transforms);
+  tf::TransformArray transforms;
+  transforms.set_quaternions_size(num_transforms);
+  int ti = 0;
+  for (unsigned int i = 0; i < mc_->model_.links_.size(); ++i)
+  {
+    if (mc_->model_.links_[i]->parent_name_ == std::string("world"))
+      continue;
+    transforms.quaternions[ti].header.frame_id = mc_->model_.links_[i]->name_;
+    transforms.quaternions[ti].parent = mc_->model_.links_[i]->parent_name_;
+    ++ti;
+  }
+  transform_publisher_.init(transforms);
 
 
   // Advertise services
@@ -244,82 +388,73 @@ void MechanismControlNode::update()
   if (++cycles_since_publish_ >= CYCLES_PER_STATE_PUBLISH)
   {
     cycles_since_publish_ = 0;
-    if (publisher_.trylock())
+    robot_msgs::MechanismState &state = publisher_.msg();
+    assert(mc_->model_.joints_.size() == state.get_joint_states_size());
+    for (unsigned int i = 0; i < mc_->model_.joints_.size(); ++i)
     {
-      assert(mc_->model_.joints_.size() == publisher_.msg_.get_joint_states_size());
-      for (unsigned int i = 0; i < mc_->model_.joints_.size(); ++i)
-      {
-        robot_msgs::JointState *out = &publisher_.msg_.joint_states[i];
-        mechanism::JointState *in = &mc_->state_->joint_states_[i];
-        out->name = mc_->model_.joints_[i]->name_;
-        out->position = in->position_;
-        out->velocity = in->velocity_;
-        out->applied_effort = in->applied_effort_;
-        out->commanded_effort = in->commanded_effort_;
-        out->is_calibrated = in->calibrated_;
-      }
-
-      for (unsigned int i = 0; i < mc_->hw_->actuators_.size(); ++i)
-      {
-        robot_msgs::ActuatorState *out = &publisher_.msg_.actuator_states[i];
-        ActuatorState *in = &mc_->hw_->actuators_[i]->state_;
-        out->name = mc_->hw_->actuators_[i]->name_;
-        out->encoder_count = in->encoder_count_;
-        out->position = in->position_;
-        out->timestamp = in->timestamp_;
-        out->encoder_velocity = in->encoder_velocity_;
-        out->velocity = in->velocity_;
-        out->calibration_reading = in->calibration_reading_;
-        out->calibration_rising_edge_valid = in->calibration_rising_edge_valid_;
-        out->calibration_falling_edge_valid = in->calibration_falling_edge_valid_;
-        out->last_calibration_rising_edge = in->last_calibration_rising_edge_;
-        out->last_calibration_falling_edge = in->last_calibration_falling_edge_;
-        out->is_enabled = in->is_enabled_;
-        out->run_stop_hit = in->run_stop_hit_;
-        out->last_requested_current = in->last_requested_current_;
-        out->last_commanded_current = in->last_commanded_current_;
-        out->last_measured_current = in->last_measured_current_;
-        out->last_requested_effort = in->last_requested_effort_;
-        out->last_commanded_effort = in->last_commanded_effort_;
-        out->last_measured_effort = in->last_measured_effort_;
-        out->motor_voltage = in->motor_voltage_;
-        out->num_encoder_errors = in->num_encoder_errors_;
-      }
-      publisher_.msg_.time = mc_->hw_->current_time_;
-
-      publisher_.unlockAndPublish();
+      robot_msgs::JointState *out = &state.joint_states[i];
+      mechanism::JointState *in = &mc_->state_->joint_states_[i];
+      out->position = in->position_;
+      out->velocity = in->velocity_;
+      out->applied_effort = in->applied_effort_;
+      out->commanded_effort = in->commanded_effort_;
+      out->is_calibrated = in->calibrated_;
     }
 
+    for (unsigned int i = 0; i < mc_->hw_->actuators_.size(); ++i)
+    {
+      robot_msgs::ActuatorState *out = &state.actuator_states[i];
+      ActuatorState *in = &mc_->hw_->actuators_[i]->state_;
+      out->encoder_count = in->encoder_count_;
+      out->position = in->position_;
+      out->timestamp = in->timestamp_;
+      out->encoder_velocity = in->encoder_velocity_;
+      out->velocity = in->velocity_;
+      out->calibration_reading = in->calibration_reading_;
+      out->calibration_rising_edge_valid = in->calibration_rising_edge_valid_;
+      out->calibration_falling_edge_valid = in->calibration_falling_edge_valid_;
+      out->last_calibration_rising_edge = in->last_calibration_rising_edge_;
+      out->last_calibration_falling_edge = in->last_calibration_falling_edge_;
+      out->is_enabled = in->is_enabled_;
+      out->run_stop_hit = in->run_stop_hit_;
+      out->last_requested_current = in->last_requested_current_;
+      out->last_commanded_current = in->last_commanded_current_;
+      out->last_measured_current = in->last_measured_current_;
+      out->last_requested_effort = in->last_requested_effort_;
+      out->last_commanded_effort = in->last_commanded_effort_;
+      out->last_measured_effort = in->last_measured_effort_;
+      out->motor_voltage = in->motor_voltage_;
+      out->num_encoder_errors = in->num_encoder_errors_;
+    }
+    state.time = mc_->hw_->current_time_;
+
+    publisher_.publish();
+
 
     // Frame transforms
-    if (transform_publisher_.trylock())
+    tf::TransformArray &transforms = transform_publisher_.msg();
+    transforms.header.stamp.fromSec(mc_->hw_->current_time_);
+    int ti = 0;
+    for (unsigned int i = 0; i < mc_->model_.links_.size(); ++i)
     {
-      //assert(mc_->model_.links_.size() == transform_publisher_.msg_.get_quaternions_size());
-      transform_publisher_.msg_.header.stamp.fromSec(mc_->hw_->current_time_);
-      int ti = 0;
-      for (unsigned int i = 0; i < mc_->model_.links_.size(); ++i)
-      {
-        if (mc_->model_.links_[i]->parent_name_ == std::string("world"))
-          continue;
-
-        tf::Vector3 pos = mc_->state_->link_states_[i].rel_frame_.getOrigin();
-        tf::Quaternion quat = mc_->state_->link_states_[i].rel_frame_.getRotation();
-        tf::TransformQuaternion &out = transform_publisher_.msg_.quaternions[ti++];
-
-        out.header.stamp.fromSec(mc_->hw_->current_time_);
-        out.header.frame_id = mc_->model_.links_[i]->name_;
-        out.parent = mc_->model_.links_[i]->parent_name_;
-        out.xt = pos.x();
-        out.yt = pos.y();
-        out.zt = pos.z();
-        out.w = quat.w();
-        out.xr = quat.x();
-        out.yr = quat.y();
-        out.zr = quat.z();
-      }
-
-      transform_publisher_.unlockAndPublish();
+      if (mc_->model_.links_[i]->parent_name_ == "world")
+        continue;
+
+      tf::Vector3 pos = mc_->state_->link_states_[i].rel_frame_.getOrigin();
+      tf::Quaternion quat = mc_->state_->link_states_[i].rel_frame_.getRotation();
+      tf::TransformQuaternion &out = transforms.quaternions[ti++];
+
+      out.header.stamp.fromSec(mc_->hw_->current_time_);
+      out.xt = pos.x();
+      out.yt = pos.y();
+      out.zt = pos.z();
+      out.w = quat.w();
+      out.xr = quat.x();
+      out.yr = quat.y();
+      out.zr = quat.z();
     }
+
+    transform_publisher_.publish();
   }
 }
 
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2008, Willow Garage, Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of Willow Garage, Inc. nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "mechanism_control/mechanism_control.h"
+
+class AllocatingController : public controller::Controller
+{
+public:
+  AllocatingController() : allocate_(false) {}
+
+  bool initXml(mechanism::RobotState *robot, TiXmlElement *config) { return true; }
+
+  void update()
+  {
+    if (allocate_)
+    {
+      std::vector<double> scratch(16);
+      scratch[0] = 1.0;
+    }
+  }
+
+  bool allocate_;
+};
+
+TEST(MechanismControl, MallocCheck)
+{
+  HardwareInterface hw(0);
+  MechanismControl mc(&hw);
+
+  TiXmlElement robot("robot");
+  ASSERT_TRUE(mc.initXml(&robot));
+
+  AllocatingController *c = new AllocatingController;
+  ASSERT_TRUE(mc.addController(c, "allocating"));
+
+  // Without allocation hooks nothing would be checked, which must not pass silently
+  if (!mc.setMallocCheck(true))
+    FAIL() << "Allocation hooks are not available on this platform, the malloc check cannot run";
+
+  for (int i = 0; i < 10; ++i)
+    mc.update();
+  EXPECT_EQ(mc.getMallocCount(), 0u);
+
+  // Allocations outside of update() are not counted
+  std::vector<double> outside(16);
+  EXPECT_EQ(mc.getMallocCount(), 0u);
+
+  c->allocate_ = true;
+  mc.update();
+  EXPECT_GT(mc.getMallocCount(), 0u);
+
+  mc.setMallocCheck(false);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
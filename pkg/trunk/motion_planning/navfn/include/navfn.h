@@ -45,6 +45,8 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <vector>
+#include <utility>
 
 // cost defs
 #define COST_OBS 254		// Conor uses 255 and 254 for forbidden regions
@@ -113,8 +115,42 @@ class NavFn
       reached; use best-first A* method with Euclidean distance heuristic */
   bool propNavFnAstar(int cycles); /**< returns true if start point found */
 
+  /** incremental replanning
+      after a full Dijkstra propagation, sets new costs for <n> cells and 
+      repairs the potential field around them, instead of recomputing it; 
+      cells whose potential was derived through a changed cell are 
+      invalidated, and the wavefront is restarted from the valid boundary 
+      of the invalidated region, in order of potential.  Run 
+      propNavFnDijkstra() afterwards to complete the repair.  The goal 
+      must not change between repairs. */
+  void updateCosts(int *cells, COSTTYPE *costs, int n);
+  void invalidateCell(int n);	/**< invalidates the potential of cell <n> and the cells derived from it */
+  bool dependsOn(int m, int n);	/**< true if the potential of cell <m> was computed from neighbor <n> */
+  void clearGrad();		/**< resets all the gradients cached by calcPath() */
+  std::vector<int> invstack;	/**< cells pending invalidation */
+  std::vector<int> invcells;	/**< cells invalidated in the current repair */
+  std::vector<std::pair<float,int> > seeds; /**< repair seeds, with the potential of their lowest neighbor */
+  int nextSeed;			/**< next seed to push */
+  void pushSeeds();		/**< pushes seeds below the current threshold */
+
+  /** hierarchical planning
+      plans first on the cost array downsampled by <factor>, then 
+      propagates at full resolution only within <width> coarse cells of 
+      the coarse path, and calculates the path for at most <n> cycles as 
+      calcPath() does; with <levels> > 1 the coarse plan is itself 
+      hierarchical.  The corridor is planned in a separate window, so 
+      only pathx, pathy and npath are set here, not the potential.  
+      Falls back to full-resolution propagation if the corridor does not 
+      connect start and goal. */
+  bool calcPathHier(int n, int levels = 1, int factor = 4, int width = 2);
+  void setupCoarse(int factor);	/**< downsamples the cost array into the coarse planner */
+  NavFn *coarse;		/**< planner for the downsampled cost array */
+  NavFn *window;		/**< planner for the corridor, at full resolution */
+  bool *hiermask;		/**< coarse cells in the corridor */
+
   /** gradient and paths */
   float *gradx, *grady;		/**< gradient arrays, size of potential array */
+  std::vector<int> gradcells;	/**< cells with a cached gradient */
   float *pathx, *pathy;		/**< path points, as subpixel cell coordinates */
   int npath;			/**< number of path points */
   int npathbuf;			/**< size of pathx, pathy buffers */
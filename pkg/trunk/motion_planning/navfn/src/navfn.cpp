@@ -38,6 +38,7 @@
 //
 
 #include"navfn.h"
+#include <algorithm>
 
 
 //
@@ -51,6 +52,9 @@ NavFn::NavFn(int xs, int ys)
   potarr = NULL;
   pending = NULL;
   gradx = grady = NULL;
+  coarse = NULL;
+  window = NULL;
+  hiermask = NULL;
   setNavArr(xs,ys);
 
   // priority buffers
@@ -70,6 +74,10 @@ NavFn::NavFn(int xs, int ys)
 
   // path buffers
   npathbuf = 0;
+  npath = 0;
+
+  // repair seeds
+  nextSeed = 0;
   pathx = pathy = NULL;
 }
 
@@ -92,6 +100,12 @@ NavFn::~NavFn()
     delete[] pathx;
   if(pathy)
     delete[] pathy;
+  if(coarse)
+    delete coarse;
+  if(window)
+    delete window;
+  if(hiermask)
+    delete[] hiermask;
 }
 
 
@@ -151,6 +165,7 @@ NavFn::setNavArr(int xs, int ys)
   memset(pending, 0, ns*sizeof(bool));
   gradx = new float[ns];
   grady = new float[ns];
+  gradcells.clear();
 }
 
 
@@ -204,6 +219,7 @@ NavFn::setupNavFn(bool keepit)
       if (!keepit) costarr[i] = COST_NEUTRAL;
       gradx[i] = grady[i] = 0.0;
     }
+  gradcells.clear();
 
   // outer bounds of cost array
   COSTTYPE *pc;
@@ -229,6 +245,8 @@ NavFn::setupNavFn(bool keepit)
   overP = pb3;
   overPe = 0;
   memset(pending, 0, ns*sizeof(bool));
+  seeds.clear();
+  nextSeed = 0;
 
   // set goal
   int k = goal[0] + goal[1]*nx;
@@ -455,11 +473,19 @@ NavFn::propNavFnDijkstra(int cycles, bool atStart)
   // set up start cell
   int startCell = start[1]*nx + start[0];
 
+  // seeds queued by updateCosts()
+  pushSeeds();
+
   for (; cycle < cycles; cycle++) // go for this many cycles, unless interrupted
     {
       // 
       if (curPe == 0 && nextPe == 0) // priority blocks empty
-	break;
+	{
+	  if (nextSeed >= (int)seeds.size())
+	    break;
+	  curT = seeds[nextSeed].first + priInc; // skip ahead to next seed
+	  pushSeeds();
+	}
 
       // stats
       nc += curPe;
@@ -497,6 +523,7 @@ NavFn::propNavFnDijkstra(int cycles, bool atStart)
           pb = curP;		// swap buffers
           curP = overP;
           overP = pb;
+	  pushSeeds();
         }
 
       // check if we've hit the Start cell
@@ -596,6 +623,359 @@ NavFn::propNavFnAstar(int cycles)
 }
 
 
+//
+// incremental replanning
+// sets new costs for changed cells, invalidates the part of the 
+//   potential field derived through them, and seeds the priority 
+//   blocks with the boundary of the invalidated region
+// propNavFnDijkstra() then repairs the field
+//
+
+void
+NavFn::updateCosts(int *cells, COSTTYPE *costs, int n)
+{
+  int goalCell = goal[1]*nx + goal[0];
+  invcells.clear();
+
+  // set new costs, invalidating the changed cells and their dependents
+  for (int i=0; i<n; i++)
+    {
+      int k = cells[i];
+      if (k < nx || k >= ns-nx || k%nx == 0 || k%nx == nx-1)
+	continue;		// outer bounds stay obstacles
+      if (k == goalCell)
+	continue;		// goal keeps its potential
+      if (costarr[k] >= COST_OBS) nobs--;
+      if (costs[i] >= COST_OBS) nobs++;
+      costarr[k] = costs[i];
+      if (potarr[k] < POT_HIGH)
+	invalidateCell(k);
+      else
+	invcells.push_back(k);	// e.g. a freed obstacle, nothing depends on it
+    }
+
+  // the repair can change the potential of any cell around the 
+  //   invalidated region, so no cached gradient can be trusted
+  clearGrad();
+
+  // empty the priority blocks, in case the last propagation was cut short
+  for (int i=0; i<curPe; i++) pending[curP[i]] = false;
+  for (int i=0; i<nextPe; i++) pending[nextP[i]] = false;
+  for (int i=0; i<overPe; i++) pending[overP[i]] = false;
+  curP = pb1; 
+  curPe = 0;
+  nextP = pb2;
+  nextPe = 0;
+  overP = pb3;
+  overPe = 0;
+
+  // queue invalidated cells that have a valid neighbor as seeds, in 
+  //   order of potential, so the wavefront restarts from the lowest
+  seeds.clear();
+  nextSeed = 0;
+  for (unsigned int i=0; i<invcells.size(); i++)
+    {
+      int k = invcells[i];
+      if (costarr[k] >= COST_OBS)
+	continue;
+      float pot = potarr[k-1];
+      if (potarr[k+1] < pot) pot = potarr[k+1];
+      if (potarr[k-nx] < pot) pot = potarr[k-nx];
+      if (potarr[k+nx] < pot) pot = potarr[k+nx];
+      if (pot < POT_HIGH)	// else interior of the invalidated region
+	seeds.push_back(std::make_pair(pot,k));
+    }
+  std::sort(seeds.begin(), seeds.end());
+
+  if (seeds.size() > 0)
+    curT = seeds[0].first + priInc;
+}
+
+
+//
+// move queued repair seeds below the current threshold onto the 
+//   current priority block
+//
+
+void
+NavFn::pushSeeds()
+{
+  while (nextSeed < (int)seeds.size() && seeds[nextSeed].first < curT 
+	 && curPe < PRIORITYBUFSIZE)
+    {
+      int n = seeds[nextSeed++].second;
+      push_cur(n);
+    }
+}
+
+
+//
+// invalidate a cell and, recursively, the neighbors whose potential 
+//   was computed from it
+//
+
+void
+NavFn::invalidateCell(int n)
+{
+  invstack.push_back(n);
+  while (!invstack.empty())
+    {
+      int k = invstack.back();
+      invstack.pop_back();
+      float p = potarr[k];
+      if (p >= POT_HIGH)
+	continue;		// already invalid
+
+      // cells with finite potential are inside the bounds, so their 
+      //   neighbors can be indexed
+      if (dependsOn(k-1,k)) invstack.push_back(k-1);
+      if (dependsOn(k+1,k)) invstack.push_back(k+1);
+      if (dependsOn(k-nx,k)) invstack.push_back(k-nx);
+      if (dependsOn(k+nx,k)) invstack.push_back(k+nx);
+
+      potarr[k] = POT_HIGH;
+      invcells.push_back(k);
+    }
+}
+
+
+//
+// check whether the potential of cell <m> was computed from its 
+//   neighbor <n>, following the planar-wave update in updateCell()
+// <n> must be the lower neighbor on its axis, and either the lowest
+//   overall or close enough to the other axis to be interpolated
+// ties count as dependencies
+//
+
+bool
+NavFn::dependsOn(int m, int n)
+{
+  float pm = potarr[m];
+  float pn = potarr[n];
+  if (pm >= POT_HIGH || pm <= pn)
+    return false;
+
+  float h, v;
+  if (potarr[m-1] < potarr[m+1]) h = potarr[m-1]; else h = potarr[m+1];
+  if (potarr[m-nx] < potarr[m+nx]) v = potarr[m-nx]; else v = potarr[m+nx];
+  float ta, tc;			// <n>'s axis, and the other one
+  if (n == m-1 || n == m+1) { ta = h; tc = v; }
+  else { ta = v; tc = h; }
+
+  if (pn > ta)			// not the lower neighbor on its axis
+    return false;
+  return pn <= tc || pn - tc < (float)costarr[m];
+}
+
+
+//
+// reset the gradients cached by calcPath(), of all the paths since 
+//   the last reset, whose cells are listed in gradcells
+//
+
+void
+NavFn::clearGrad()
+{
+  for (unsigned int i=0; i<gradcells.size(); i++)
+    {
+      int n = gradcells[i];
+      gradx[n] = grady[n] = 0.0;
+    }
+  gradcells.clear();
+}
+
+
+//
+// hierarchical planning
+// plan on a downsampled cost array, then propagate at full resolution
+//   only in a window around the corridor of the coarse path, with 
+//   cells outside the corridor as obstacles
+// the path is copied back into this planner's path buffers
+//
+
+bool
+NavFn::calcPathHier(int n, int levels, int factor, int width)
+{
+  // coarse plan
+  setupCoarse(factor);
+  int cnx = coarse->nx;
+  int cny = coarse->ny;
+  int cn = n/factor + 1;
+  bool ok;
+  if (levels > 1)
+    ok = coarse->calcPathHier(cn, levels-1, factor, width);
+  else
+    {
+      coarse->setupNavFn(true);
+      coarse->propNavFnAstar(coarse->ns);
+      ok = coarse->calcPath(cn) && 
+	coarse->potarr[coarse->start[1]*cnx + coarse->start[0]] < POT_HIGH;
+    }
+
+  if (ok)
+    {
+      // corridor of coarse cells around the path, and around the goal, 
+      //   where calcPath() stops short
+      if (!hiermask)
+	hiermask = new bool[cnx*cny];
+      memset(hiermask, 0, cnx*cny*sizeof(bool));
+      int cgoal = coarse->goal[1]*cnx + coarse->goal[0];
+      int r = COST_OBS/COST_NEUTRAL + 1;
+      int x0 = cnx, x1 = 0, y0 = cny, y1 = 0; // bounding box
+      for (int i=-2; i<coarse->npath; i++)
+	{
+	  int cx, cy, w = width;
+	  if (i == -2)		// goal region
+	    { cx = cgoal%cnx; cy = cgoal/cnx; w = r + width; }
+	  else if (i == -1)	// start cell
+	    { cx = coarse->start[0]; cy = coarse->start[1]; }
+	  else
+	    { cx = (int)coarse->pathx[i]; cy = (int)coarse->pathy[i]; }
+	  for (int y=cy-w; y<=cy+w+1; y++)
+	    for (int x=cx-w; x<=cx+w+1; x++)
+	      if (x >= 0 && x < cnx && y >= 0 && y < cny)
+		{
+		  hiermask[y*cnx+x] = true;
+		  if (x < x0) x0 = x;
+		  if (x > x1) x1 = x;
+		  if (y < y0) y0 = y;
+		  if (y > y1) y1 = y;
+		}
+	}
+
+      // full-resolution window, with a one-cell border
+      int wx0 = x0*factor - 1;
+      int wy0 = y0*factor - 1;
+      int wx1 = (x1+1)*factor + 1;
+      int wy1 = (y1+1)*factor + 1;
+      if (wx0 < 0) wx0 = 0;
+      if (wy0 < 0) wy0 = 0;
+      if (wx1 > nx) wx1 = nx;
+      if (wy1 > ny) wy1 = ny;
+      int wnx = wx1 - wx0;
+      int wny = wy1 - wy0;
+      if (!window)
+	window = new NavFn(wnx,wny);
+      else if (window->nx != wnx || window->ny != wny)
+	window->setNavArr(wnx,wny);
+
+      // costs inside the corridor, obstacles outside
+      for (int y=0; y<wny; y++)
+	{
+	  COSTTYPE *pc = costarr + (y+wy0)*nx + wx0;
+	  COSTTYPE *pw = window->costarr + y*wnx;
+	  bool *pm = hiermask + ((y+wy0)/factor)*cnx;
+	  for (int x=0; x<wnx; x++)
+	    pw[x] = pm[(x+wx0)/factor] ? pc[x] : COST_OBS;
+	}
+
+      window->goal[0] = goal[0] - wx0;
+      window->goal[1] = goal[1] - wy0;
+      window->start[0] = start[0] - wx0;
+      window->start[1] = start[1] - wy0;
+      window->priInc = priInc;
+      window->setupNavFn(true);
+      window->propNavFnDijkstra(window->ns, true);
+      ok = window->potarr[window->start[1]*wnx + window->start[0]] < POT_HIGH;
+
+      if (ok)
+	{
+	  // path, in this planner's coordinates
+	  bool ret = window->calcPath(n);
+	  if (npathbuf < n)
+	    {
+	      if (pathx) delete [] pathx;
+	      if (pathy) delete [] pathy;
+	      pathx = new float[n];
+	      pathy = new float[n];
+	      npathbuf = n;
+	    }
+	  npath = window->npath;
+	  for (int i=0; i<npath; i++)
+	    {
+	      pathx[i] = window->pathx[i] + wx0;
+	      pathy[i] = window->pathy[i] + wy0;
+	    }
+	  return ret;
+	}
+    }
+
+  // no coarse path, or the corridor does not reach the start:
+  //   fall back to a full propagation
+  setupNavFn(true);
+  propNavFnDijkstra(ns, true);
+  return calcPath(n);
+}
+
+
+//
+// downsample the cost array by <factor> into the coarse planner
+// a coarse cell is an obstacle only if all its cells are, otherwise it 
+//   takes the mean cost, counting obstacles at COST_OBS
+//
+
+void
+NavFn::setupCoarse(int factor)
+{
+  int cnx = (nx+factor-1)/factor;
+  int cny = (ny+factor-1)/factor;
+  if (!coarse)
+    coarse = new NavFn(cnx,cny);
+  else if (coarse->nx != cnx || coarse->ny != cny)
+    {
+      coarse->setNavArr(cnx,cny);
+      if (hiermask)
+	delete[] hiermask;
+      hiermask = NULL;
+    }
+
+  // accumulate a row of coarse cells at a time, reading the cost array
+  //   in order
+  int *sum = new int[cnx];
+  int *nobst = new int[cnx];
+  for (int cy=0; cy<cny; cy++)
+    {
+      memset(sum, 0, cnx*sizeof(int));
+      memset(nobst, 0, cnx*sizeof(int));
+      int y1 = (cy+1)*factor;
+      if (y1 > ny) y1 = ny;
+      for (int y=cy*factor; y<y1; y++)
+	{
+	  COSTTYPE *pc = costarr + y*nx;
+	  for (int x=0; x<nx; x++, pc++)
+	    {
+	      if (*pc >= COST_OBS)
+		{
+		  sum[x/factor] += COST_OBS;
+		  nobst[x/factor]++;
+		}
+	      else
+		sum[x/factor] += *pc;
+	    }
+	}
+
+      int h = y1 - cy*factor;
+      for (int cx=0; cx<cnx; cx++)
+	{
+	  int w = (cx+1)*factor > nx ? nx - cx*factor : factor;
+	  int nc = w*h;
+	  COSTTYPE c = sum[cx]/nc;
+	  if (nobst[cx] < nc && c >= COST_OBS)
+	    c = COST_OBS-1;
+	  coarse->costarr[cy*cnx+cx] = c;
+	}
+    }
+  delete[] sum;
+  delete[] nobst;
+
+  coarse->goal[0] = goal[0]/factor;
+  coarse->goal[1] = goal[1]/factor;
+  coarse->start[0] = start[0]/factor;
+  coarse->start[1] = start[1]/factor;
+  coarse->priInc = priInc;
+}
+
+
 //
 // Path construction
 // Find gradient at array points, interpolate path
@@ -716,6 +1096,7 @@ NavFn::gradCell(int n)
       norm = 1.0/norm;
       gradx[n] = norm*dx;
       grady[n] = norm*dy;
+      gradcells.push_back(n);
     }
 }
 
@@ -41,6 +41,7 @@ dispPot(NavFn *nav)
 }
 
 COSTTYPE *readPGM(char *fname, int *width, int *height);
+void replanTest(NavFn *nav, int nrep);
 
 int main(int argc, char **argv)
 {
@@ -49,6 +50,7 @@ int main(int argc, char **argv)
   int res = 50;			// 50 mm resolution
   double size = 40.0;		// 40 m on a side
   int inc = COST_OBS+10;	// thin wavefront
+  int nrep = 10;		// number of replans to time
   
   // get resolution (mm) and perhaps size (m)
   if (argc > 1)
@@ -63,6 +65,9 @@ int main(int argc, char **argv)
   if (argc > 4)
     dispn = atoi(argv[4]);
 
+  if (argc > 5)
+    nrep = atoi(argv[5]);
+
   NavFn *nav;
 
   // try reading in a file
@@ -153,6 +158,17 @@ int main(int argc, char **argv)
 	ntot++;			// number of uncalculated cells
     }
   printf("[NavFn] Cells not touched: %d/%d\n", ntot, nav->nx*nav->ny);
+
+  // hierarchical plan, on a coarse map and then in a corridor
+  t0 = get_ms();
+  nav->calcPathHier(1000);
+  t1 = get_ms();
+  printf("Time for hierarchical plan calculation: %d ms, path length %d\n", 
+	 (int)(t1-t0), nav->npath);
+
+  // replanning latency
+  if (nrep > 0)
+    replanTest(nav,nrep);
   nwin->maxval = 4*mmax/3;
   dispPot(nav);
   while (Fl::check()) {}
@@ -174,6 +190,97 @@ int main(int argc, char **argv)
 }
 
 
+// time incremental replanning against full propagation
+// alternately drops a block of obstacle cells onto the middle of the 
+//   current path and removes it again; after each change the field is 
+//   repaired, then recomputed from scratch on a copy for comparison
+
+#define REPLAN_BLOCK 8
+
+void
+replanTest(NavFn *nav, int nrep)
+{
+  int nx = nav->nx;
+  int ny = nav->ny;
+  int cycles = nx*ny/20;
+
+  // full Dijkstra field to start from
+  nav->display(dispPot,0);
+  nav->setupNavFn(true);
+  nav->propNavFnDijkstra(cycles);
+
+  NavFn *full = new NavFn(nx,ny);
+  full->setGoal(nav->goal);
+  full->setStart(nav->start);
+  memcpy(full->costarr, nav->costarr, nx*ny*sizeof(COSTTYPE));
+
+  int cells[REPLAN_BLOCK*REPLAN_BLOCK];
+  COSTTYPE costs[REPLAN_BLOCK*REPLAN_BLOCK];
+  COSTTYPE saved[REPLAN_BLOCK*REPLAN_BLOCK];
+  int n = 0;
+  int nt = 0;			// number of replans timed
+  double trep = 0.0, tfull = 0.0;
+
+  for (int i=0; i<nrep; i++)
+    {
+      if (i%2 == 0)		// drop a block onto the path
+	{
+	  nav->calcPath(1000);
+	  if (nav->npath < 2)
+	    break;
+	  int cx = (int)nav->pathx[nav->npath/2];
+	  int cy = (int)nav->pathy[nav->npath/2];
+	  n = 0;
+	  for (int y=cy-REPLAN_BLOCK/2; y<cy+REPLAN_BLOCK/2; y++)
+	    for (int x=cx-REPLAN_BLOCK/2; x<cx+REPLAN_BLOCK/2; x++)
+	      {
+		cells[n] = y*nx + x;
+		saved[n] = nav->costarr[cells[n]];
+		costs[n] = COST_OBS;
+		n++;
+	      }
+	}
+      else			// and take it away again
+	memcpy(costs, saved, n*sizeof(COSTTYPE));
+
+      double t0 = get_ms();
+      nav->updateCosts(cells,costs,n);
+      nav->propNavFnDijkstra(cycles);
+      double t1 = get_ms();
+
+      for (int j=0; j<n; j++)
+	full->costarr[cells[j]] = costs[j];
+      double t2 = get_ms();
+      full->setupNavFn(true);
+      full->propNavFnDijkstra(cycles);
+      double t3 = get_ms();
+
+      // largest relative difference between the two fields
+      float emax = 0.0;
+      for (int j=0; j<nx*ny; j++)
+	{
+	  float p = full->potarr[j];
+	  if (p < POT_HIGH && p > 0.0)
+	    {
+	      float e = fabs(nav->potarr[j] - p)/p;
+	      if (e > emax) emax = e;
+	    }
+	}
+
+      printf("[NavTest] Replan %d: repair %0.1f ms, full %0.1f ms, max difference %0.2f%%\n",
+	     i, t1-t0, t3-t2, emax*100.0);
+      trep += t1-t0;
+      tfull += t3-t2;
+      nt++;
+    }
+
+  if (nt > 0)
+    printf("[NavTest] Average replan time: repair %0.1f ms, full %0.1f ms\n",
+	   trep/nt, tfull/nt);
+  delete full;
+}
+
+
 // read in a PGM file for obstacles
 // no expansion yet...
 
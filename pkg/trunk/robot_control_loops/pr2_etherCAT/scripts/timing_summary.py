@@ -0,0 +1,56 @@
+#! /usr/bin/env python
+
+# Summarizes the histograms written by "pr2_etherCAT --timing <file>":
+# one line per stage/controller with the sample count, mean, 50/99/99.9th
+# percentiles, max, and the number of cycles over the 1 ms budget.
+#
+#   timing_summary.py <file> [budget_us]
+
+import sys
+
+def percentile(buckets, count, fraction, max_ns):
+  target = max(1, int(fraction * count + 0.5))
+  seen = 0
+  for low, high, n in buckets:
+    seen += n
+    if seen >= target:
+      return min(high, max_ns)
+  return max_ns
+
+def summarize(name, count, min_ns, max_ns, sum_ns, buckets, budget_ns):
+  if count == 0:
+    print "%-40s %10d" % (name, 0)
+    return
+  over = sum([n for low, high, n in buckets if low > budget_ns])
+  print "%-40s %10d %9.1f %9.1f %9.1f %9.1f %9.1f %8d" % \
+      (name, count, sum_ns / 1e3 / count,
+       percentile(buckets, count, 0.5, max_ns) / 1e3,
+       percentile(buckets, count, 0.99, max_ns) / 1e3,
+       percentile(buckets, count, 0.999, max_ns) / 1e3,
+       max_ns / 1e3, over)
+
+def main():
+  if len(sys.argv) < 2:
+    print "usage: %s <timing file> [budget_us]" % sys.argv[0]
+    sys.exit(1)
+  budget_ns = 1000 * float(sys.argv[2]) if len(sys.argv) > 2 else 1e6
+
+  print "%-40s %10s %9s %9s %9s %9s %9s %8s" % \
+      ("stage", "samples", "mean(us)", "p50", "p99", "p99.9", "max", "over")
+  current = None
+  for line in open(sys.argv[1]):
+    f = line.split()
+    if not f:
+      continue
+    if f[0] == "overruns":
+      print "deadline overruns: %s" % f[1]
+    elif f[0] == "histogram":
+      current = (f[1], int(f[2]), int(f[3]), int(f[4]), int(f[5]), [])
+    elif f[0] == "end":
+      summarize(*(current + (budget_ns,)))
+      current = None
+    elif current:
+      current[5].append((int(f[0]), int(f[1]), int(f[2])))
+
+if __name__ == "__main__":
+  main()
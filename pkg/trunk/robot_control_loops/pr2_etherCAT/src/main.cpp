@@ -48,13 +48,15 @@
 #include <ros/node.h>
 #include <std_srvs/Empty.h>
 
-#include <misc_utils/realtime_publisher.h>
+#include <misc_utils/realtime_triple_publisher.h>
+#include <misc_utils/latency_histogram.h>
 
 static struct
 {
   char *program_;
   char *interface_;
   char *xml_;
+  char *timing_file_;
   bool allow_override_;
   bool allow_unprogrammed_;
   bool quiet_;
@@ -68,6 +70,7 @@ void Usage(string msg = "")
   fprintf(stderr, "    -x, --xml <file|param>      Load the robot description from this file or parameter name\n");
   fprintf(stderr, "    -u, --allow_unprogrammed    Allow control loop to run with unprogrammed devices\n");
   fprintf(stderr, "    -q, --quiet                 Don't print warning messages when switching to secondary mode\n");
+  fprintf(stderr, "    -t, --timing <file>         Write cycle time histograms to this file on exit\n");
   fprintf(stderr, "    -h, --help     Print this message and exit\n");
   if (msg != "")
   {
@@ -89,51 +92,71 @@ static struct
   double ec[1000];
   double mc[1000];
   int secondary;
+
+  // Whole-run histograms, see misc_utils::LatencyHistogram
+  misc_utils::LatencyHistogram ec_timing;       // EtherCAT txandrcv
+  misc_utils::LatencyHistogram mc_timing;       // MechanismControlNode::update
+  misc_utils::LatencyHistogram cycle_timing;    // everything but the sleep
+  misc_utils::LatencyHistogram wakeup_latency;  // late wakeup from clock_nanosleep
+  int overruns;                                 // cycles that missed their deadline
 } diagnostics;
 
-static void publishDiagnostics(misc_utils::RealtimePublisher<robot_msgs::DiagnosticMessage> &publisher)
+static const char *diagnostic_labels[] = {
+  "Secondary mode switches",
+  "Max EtherCAT roundtrip (us)",
+  "Avg EtherCAT roundtrip (us)",
+  "Max Mechanism Control roundtrip (us)",
+  "Avg Mechanism Control roundtrip (us)",
+  "99.9% EtherCAT roundtrip (us)",
+  "99.9% Mechanism Control roundtrip (us)",
+  "Max wakeup latency (us)",
+  "Deadline overruns"
+};
+static const int NUM_DIAGNOSTIC_VALUES = sizeof(diagnostic_labels) / sizeof(diagnostic_labels[0]);
+
+// Sizes the diagnostic message and fills in the strings before going
+// realtime, so publishDiagnostics() only has to write numbers.
+static void initDiagnostics(misc_utils::RealtimeTriplePublisher<robot_msgs::DiagnosticMessage> &publisher)
 {
-  if (publisher.trylock())
+  robot_msgs::DiagnosticMessage msg;
+  msg.set_status_size(1);
+  robot_msgs::DiagnosticStatus &status = msg.status[0];
+  status.level = 0;
+  status.name = "Realtime Control Loop";
+  status.message = "OK";
+  status.set_values_size(NUM_DIAGNOSTIC_VALUES);
+  for (int i = 0; i < NUM_DIAGNOSTIC_VALUES; ++i)
   {
-    vector<robot_msgs::DiagnosticStatus> statuses;
-    vector<robot_msgs::DiagnosticValue> values;
-    vector<robot_msgs::DiagnosticString> strings;
-    robot_msgs::DiagnosticStatus status;
-    robot_msgs::DiagnosticValue v;
-    robot_msgs::DiagnosticString s;
-
-    status.level = 0;
-    status.name = "Realtime Control Loop";
-    status.message = "OK";
-
-    static double max_ec = 0, max_mc = 0;
-    double total_ec = 0, total_mc = 0;
+    status.values[i].label = diagnostic_labels[i];
+    status.values[i].value = 0;
+  }
+  publisher.init(msg);
+}
 
-    for (int i = 0; i < 1000; ++i)
-    {
-      total_ec += diagnostics.ec[i];
-      max_ec = max(max_ec, diagnostics.ec[i]);
-      total_mc += diagnostics.mc[i];
-      max_mc = max(max_mc, diagnostics.mc[i]);
-    }
+static void publishDiagnostics(misc_utils::RealtimeTriplePublisher<robot_msgs::DiagnosticMessage> &publisher)
+{
+  static double max_ec = 0, max_mc = 0;
+  double total_ec = 0, total_mc = 0;
 
-#define ADD_VALUE(lab, val)                     \
-    v.label = (lab);                            \
-    v.value = (val);                            \
-    values.push_back(v)
-
-    ADD_VALUE("Secondary mode switches", diagnostics.secondary);
-    ADD_VALUE("Max EtherCAT roundtrip (us)", max_ec*1e+6);
-    ADD_VALUE("Avg EtherCAT roundtrip (us)", total_ec*1e+6/1000);
-    ADD_VALUE("Max Mechanism Control roundtrip (us)", max_mc*1e+6);
-    ADD_VALUE("Avg Mechanism Control roundtrip (us)", total_mc*1e+6/1000);
-
-    status.set_values_vec(values);
-    status.set_strings_vec(strings);
-    statuses.push_back(status);
-    publisher.msg_.set_status_vec(statuses);
-    publisher.unlockAndPublish();
+  for (int i = 0; i < 1000; ++i)
+  {
+    total_ec += diagnostics.ec[i];
+    max_ec = max(max_ec, diagnostics.ec[i]);
+    total_mc += diagnostics.mc[i];
+    max_mc = max(max_mc, diagnostics.mc[i]);
   }
+
+  robot_msgs::DiagnosticValue *values = &publisher.msg().status[0].values[0];
+  values[0].value = diagnostics.secondary;
+  values[1].value = max_ec*1e+6;
+  values[2].value = total_ec*1e+6/1000;
+  values[3].value = max_mc*1e+6;
+  values[4].value = total_mc*1e+6/1000;
+  values[5].value = diagnostics.ec_timing.percentile(0.999)*1e+6;
+  values[6].value = diagnostics.mc_timing.percentile(0.999)*1e+6;
+  values[7].value = diagnostics.wakeup_latency.max()*1e+6;
+  values[8].value = diagnostics.overruns;
+  publisher.publish();
 }
 
 static inline double now()
@@ -160,10 +183,10 @@ static void *syncClocks(void *)
 
 void *controlLoop(void *)
 {
-  misc_utils::RealtimePublisher<robot_msgs::DiagnosticMessage> publisher("/diagnostics", 2);
+  misc_utils::RealtimeTriplePublisher<robot_msgs::DiagnosticMessage> publisher("/diagnostics", 2);
 
-  // Publish one-time before entering real-time to pre-allocate message vectors
-  publishDiagnostics(publisher);
+  // Pre-allocate the message vectors before entering real-time
+  initDiagnostics(publisher);
 
   // Initialize the hardware interface
   EthercatHardware ec;
@@ -238,6 +261,8 @@ void *controlLoop(void *)
 
     diagnostics.ec[count] = after_ec - start;
     diagnostics.mc[count] = after_mc - after_ec;
+    diagnostics.ec_timing.record(after_ec - start);
+    diagnostics.mc_timing.record(after_mc - after_ec);
 
     if (++count == 1000)
     {
@@ -251,7 +276,15 @@ void *controlLoop(void *)
       tick.tv_nsec -= NSEC_PER_SEC;
       tick.tv_sec++;
     }
+
+    double deadline = tick.tv_sec + double(tick.tv_nsec) / NSEC_PER_SEC;
+    double before_sleep = now();
+    diagnostics.cycle_timing.record(before_sleep - start);
+    if (before_sleep > deadline)
+      ++diagnostics.overruns;
+
     clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL);
+    diagnostics.wakeup_latency.record(now() - deadline);
   }
 
   /* Shutdown all of the motors on exit */
@@ -269,6 +302,23 @@ void *controlLoop(void *)
   pthread_set_mode_np(PTHREAD_PRIMARY, 0);
 #endif
 
+  if (g_options.timing_file_)
+  {
+    FILE *f = fopen(g_options.timing_file_, "w");
+    if (f)
+    {
+      fprintf(f, "overruns %d\n", diagnostics.overruns);
+      diagnostics.ec_timing.dump(f, "ethercat");
+      diagnostics.mc_timing.dump(f, "mechanism_control");
+      diagnostics.cycle_timing.dump(f, "cycle");
+      diagnostics.wakeup_latency.dump(f, "wakeup_latency");
+      mc.dumpTiming(f);
+      fclose(f);
+    }
+    else
+      perror(g_options.timing_file_);
+  }
+
   return 0;
 }
 
@@ -434,9 +484,10 @@ int main(int argc, char *argv[])
       {"quiet", no_argument, 0, 'q'},
       {"interface", required_argument, 0, 'i'},
       {"xml", required_argument, 0, 'x'},
+      {"timing", required_argument, 0, 't'},
     };
     int option_index = 0;
-    int c = getopt_long(argc, argv, "ahi:qux:", long_options, &option_index);
+    int c = getopt_long(argc, argv, "ahi:qt:ux:", long_options, &option_index);
     if (c == -1) break;
     switch (c)
     {
@@ -458,6 +509,9 @@ int main(int argc, char *argv[])
       case 'x':
         g_options.xml_ = optarg;
         break;
+      case 't':
+        g_options.timing_file_ = optarg;
+        break;
     }
   }
   if (optind < argc)
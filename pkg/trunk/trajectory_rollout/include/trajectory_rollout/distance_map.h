@@ -0,0 +1,110 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef DISTANCE_MAP_H_
+#define DISTANCE_MAP_H_
+
+#include <vector>
+#include <trajectory_rollout/trajectory_inc.h>
+
+//distances of cells the wavefront did not reach, and of blocked cells it reached
+#define DIST_UNREACHED 0xffffffffu
+#define DIST_BLOCKED 0xfffffffeu
+
+//Wavefront distances from a set of source cells around blocked cells, the same as
+//TrajectoryController::computePathDistance computes them, but kept between updates
+//so that only the cells affected by a change in the sources or the blocked cells are redone
+class DistanceMap{
+  public:
+    DistanceMap();
+
+    //forget all distances and cover a grid of the given size
+    void resize(unsigned int size_x, unsigned int size_y);
+
+    //move the grid by (dx, dy) cells, so that cell (x, y) becomes what was cell (x + dx, y + dy),
+    //the cells that come into the grid are unknown
+    void shift(int dx, int dy);
+
+    //bring the distances up to date, blocked holds a flag for every cell, changed the cells
+    //whose flag may differ from the last update, and sources the cell indices, a blocked
+    //cell that the wavefront reaches gets blocked_dist
+    //only the changed cells and those that came in with a shift are looked at, unless no
+    //source is kept from the last update, in which case the distances are redone from scratch
+    void update(const std::vector<unsigned char>& blocked, const std::vector<unsigned int>& changed,
+        const std::vector<unsigned int>& sources, double blocked_dist);
+
+    inline double operator[] (unsigned int ind) const {
+      unsigned int d = dist_[ind];
+      return d < DIST_BLOCKED ? d : (d == DIST_BLOCKED ? blocked_dist_ : DBL_MAX);
+    }
+
+    unsigned int size_x_, size_y_;
+
+  private:
+    //the neighbor of a cell in a direction, false at the edge of the grid
+    inline bool neighbor(unsigned int ind, unsigned int dir, unsigned int& n) const {
+      n = ind + offset_[dir];
+      return (edge_[ind] & (1 << dir)) == 0;
+    }
+
+    //a cell the wavefront moves on from
+    inline bool expands(unsigned int ind) const {
+      return blocked_[ind] == 0 || source_[ind] != 0;
+    }
+
+    //offsets of the neighbors in each direction, and for each cell a bit for the
+    //directions in which it is on the edge of the grid
+    int offset_[4];
+    std::vector<unsigned char> edge_;
+
+    //distance of each cell, in cells, and the direction of the neighbor it comes from
+    std::vector<unsigned int> dist_;
+    double blocked_dist_;
+    std::vector<unsigned char> parent_;
+
+    //blocked cells and sources at the last update, and the cells whose blocked flag is
+    //unknown since they came in with a shift
+    std::vector<unsigned char> blocked_;
+    std::vector<unsigned char> source_;
+    std::vector<unsigned int> sources_;
+    std::vector<unsigned int> unknown_;
+
+    //a plain breadth first wavefront from the sources, for when nothing can be kept
+    void rebuild(const std::vector<unsigned char>& blocked);
+
+    //kept between updates to save allocations
+    std::vector<unsigned int> changed_, cleared_, reached_, queue_;
+    std::vector< std::vector<unsigned int> > buckets_;
+};
+
+#endif
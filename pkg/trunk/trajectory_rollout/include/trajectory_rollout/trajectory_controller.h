@@ -44,6 +44,7 @@
 #include <ctime>
 #include <algorithm>
 #include <rosconsole/rosconsole.h>
+#include <boost/thread.hpp>
 
 //For transform support
 #include "tf/transform_listener.h"
@@ -51,6 +52,7 @@
 #include <trajectory_rollout/map_cell.h>
 #include <trajectory_rollout/map_grid.h>
 #include <trajectory_rollout/trajectory.h>
+#include <trajectory_rollout/distance_map.h>
 
 // For obstacle data access
 #include <costmap_2d/obstacle_map_accessor.h>
@@ -65,6 +67,9 @@
 #define HEADING_LOOKAHEAD .325
 #define OSCILLATION_RESET_DIST .05
 
+//number of trajectories a thread rolls out together when batch scoring
+#define SAMPLE_BLOCK 16
+
 //Based on the plan from the path planner, determine what velocities to send to the robot
 class TrajectoryController {
   public:
@@ -73,6 +78,8 @@ class TrajectoryController {
         double pdist_scale, double gdist_scale, double dfast_scale, double occdist_scale, 
         double acc_lim_x, double acc_lim_y, double acc_lim_theta, tf::TransformListener* tf,
         const costmap_2d::ObstacleMapAccessor& ma, std::vector<std_msgs::Point2DFloat32> footprint_spec);
+
+    ~TrajectoryController();
     
     //given the current state of the robot, find a good trajectory
     Trajectory findBestPath(tf::Stamped<tf::Pose> global_pose, tf::Stamped<tf::Pose> global_vel,
@@ -113,6 +120,15 @@ class TrajectoryController {
     //update what map cells are considered path based on the global_plan
     void setPathCells();
 
+    //roll out and score all velocity samples up front, spread over num_threads threads,
+    //which only pays off with spare cores, see test/scoring_benchmark.cpp
+    void setBatchScoring(bool batch, unsigned int num_threads = 1);
+
+    //keep the path and goal distances from one cycle to the next, shifting them with the
+    //map window and only redoing them where the plan or the obstacles changed, the goal
+    //distances are redone from scratch whenever the local goal moves
+    void setIncrementalDistances(bool incremental);
+
     //possible trajectories for this run
     std::vector<Trajectory> trajectories_;
 
@@ -149,11 +165,49 @@ class TrajectoryController {
     const costmap_2d::ObstacleMapAccessor& ma_;
 
     //for scoring trajectories
-    Trajectory traj_one, traj_two;
+    Trajectory traj_one;
 
     //for laying down the footprint of the robot
     std::vector<std_msgs::Point2DFloat32> footprint_spec_;
 
+    //the state that the trajectories are rolled out from
+    struct RolloutStart {
+      double x, y, theta;
+      double vx, vy, vtheta;
+      double acc_x, acc_y, acc_theta;
+      double impossible_cost;
+    };
+
+    //get the k-th sample of trajectories_, rolling it out unless batch scoring already did
+    Trajectory* sampleTrajectory(unsigned int k, const RolloutStart& start);
+
+    //batch scoring of trajectories_, the threads other than the calling one are kept
+    //waiting on the barrier between cycles
+    bool batch_scoring_;
+    unsigned int scoring_threads_;
+    unsigned int next_sample_;
+    boost::mutex sample_mutex_;
+    boost::barrier* scoring_barrier_;
+    boost::thread_group* scoring_workers_;
+    bool scoring_shutdown_;
+    const RolloutStart* scoring_start_;
+    void scoringWorker();
+    void stopScoringWorkers();
+    void scoreTrajectories(const RolloutStart& start);
+    void scoreSamples(const RolloutStart* start);
+    void scoreSampleBlock(unsigned int begin, unsigned int end, const RolloutStart& start);
+
+    //incremental path and goal distances, with the map window they were computed for
+    bool incremental_dist_;
+    DistanceMap path_map_, goal_map_;
+    double dist_origin_x_, dist_origin_y_, dist_scale_;
+    std::vector<unsigned char> blocked_cells_;
+    std::vector<unsigned int> changed_cells_, path_cells_, goal_cells_;
+    void updateDistances();
+
+    //cells marked within_robot, which are unmarked the next cycle in place of resetPathDist
+    std::vector<unsigned int> robot_cells_;
+
     inline void updatePathCell(MapCell* current_cell, MapCell* check_cell, 
         std::queue<MapCell*>& dist_queue){
       //mark the cell as visisted
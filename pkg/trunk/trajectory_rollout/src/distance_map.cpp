@@ -0,0 +1,359 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <trajectory_rollout/distance_map.h>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+//the neighbors of a cell are at -x, +x, -y and +y, so that the opposite of a direction is dir ^ 1
+#define DIST_SOURCE 4
+#define DIST_NONE 5
+#define DIST_CLEARED 6
+
+//blocked flag of a cell that was never seen, which counts as a change
+#define DIST_UNKNOWN 2
+
+DistanceMap::DistanceMap() : size_x_(0), size_y_(0), blocked_dist_(DBL_MAX) {}
+
+void DistanceMap::resize(unsigned int size_x, unsigned int size_y){
+  size_x_ = size_x;
+  size_y_ = size_y;
+  unsigned int size = size_x_ * size_y_;
+  dist_.assign(size, DIST_UNREACHED);
+  parent_.assign(size, DIST_NONE);
+  blocked_.assign(size, DIST_UNKNOWN);
+  source_.assign(size, 0);
+  sources_.clear();
+  unknown_.clear();
+
+  offset_[0] = -1;
+  offset_[1] = 1;
+  offset_[2] = -(int)size_x_;
+  offset_[3] = size_x_;
+  edge_.assign(size, 0);
+  for(unsigned int y = 0; y < size_y_; ++y){
+    for(unsigned int x = 0; x < size_x_; ++x){
+      unsigned char& edge = edge_[y * size_x_ + x];
+      if(x == 0) edge |= 1;
+      if(x + 1 == size_x_) edge |= 2;
+      if(y == 0) edge |= 4;
+      if(y + 1 == size_y_) edge |= 8;
+    }
+  }
+}
+
+//move the cells of a grid back by offset, the cells that come in get value
+template <class T>
+static void shiftCells(vector<T>& cells, int offset, T value){
+  if(offset > 0){
+    copy(cells.begin() + offset, cells.end(), cells.begin());
+    fill(cells.end() - offset, cells.end(), value);
+  }
+  else if(offset < 0){
+    copy_backward(cells.begin(), cells.end() + offset, cells.end());
+    fill(cells.begin(), cells.begin() - offset, value);
+  }
+}
+
+void DistanceMap::shift(int dx, int dy){
+  if(dx == 0 && dy == 0)
+    return;
+
+  //nothing is left of the old grid
+  if(abs(dx) >= (int)size_x_ || abs(dy) >= (int)size_y_){
+    resize(size_x_, size_y_);
+    return;
+  }
+
+  int offset = dy * (int)size_x_ + dx;
+  shiftCells(dist_, offset, DIST_UNREACHED);
+  shiftCells(parent_, offset, (unsigned char) DIST_NONE);
+  shiftCells(blocked_, offset, (unsigned char) DIST_UNKNOWN);
+  shiftCells(source_, offset, (unsigned char) 0);
+
+  //the columns that came in wrapped around from the next or the previous row
+  unsigned int x_begin = dx > 0 ? size_x_ - dx : 0;
+  unsigned int x_end = dx > 0 ? size_x_ : -dx;
+  for(unsigned int y = 0; y < size_y_; ++y){
+    for(unsigned int x = x_begin; x < x_end; ++x){
+      unsigned int ind = y * size_x_ + x;
+      dist_[ind] = DIST_UNREACHED;
+      parent_[ind] = DIST_NONE;
+      blocked_[ind] = DIST_UNKNOWN;
+      source_[ind] = 0;
+    }
+  }
+
+  //the cells still unknown from an earlier shift move along, and the rows that came in join them
+  unsigned int kept = 0;
+  for(unsigned int i = 0; i < unknown_.size(); ++i){
+    int x = unknown_[i] % size_x_ - dx;
+    int y = unknown_[i] / size_x_ - dy;
+    if(x >= 0 && x < (int)size_x_ && y >= 0 && y < (int)size_y_)
+      unknown_[kept++] = y * size_x_ + x;
+  }
+  unknown_.resize(kept);
+  unsigned int y_begin = dy > 0 ? size_y_ - dy : 0;
+  unsigned int y_end = dy > 0 ? size_y_ : -dy;
+  for(unsigned int y = 0; y < size_y_; ++y){
+    for(unsigned int x = x_begin; x < x_end; ++x)
+      unknown_.push_back(y * size_x_ + x);
+  }
+  for(unsigned int y = y_begin; y < y_end; ++y){
+    for(unsigned int x = 0; x < size_x_; ++x)
+      unknown_.push_back(y * size_x_ + x);
+  }
+
+  //a cell on the edge whose distance came from outside the grid has to be redone like a
+  //changed cell, and so does a blocked cell that may have been reached from outside
+  unsigned int n;
+  for(unsigned int y = 0; y < size_y_; ++y){
+    unsigned int step = (y == 0 || y + 1 == size_y_ || size_x_ < 2) ? 1 : size_x_ - 1;
+    for(unsigned int x = 0; x < size_x_; x += step){
+      unsigned int ind = y * size_x_ + x;
+      if(parent_[ind] < DIST_SOURCE ? !neighbor(ind, parent_[ind], n) : parent_[ind] == DIST_NONE && dist_[ind] != DIST_UNREACHED){
+        blocked_[ind] = DIST_UNKNOWN;
+        unknown_.push_back(ind);
+      }
+    }
+  }
+
+  kept = 0;
+  for(unsigned int i = 0; i < sources_.size(); ++i){
+    int x = sources_[i] % size_x_ - dx;
+    int y = sources_[i] / size_x_ - dy;
+    if(x >= 0 && x < (int)size_x_ && y >= 0 && y < (int)size_y_)
+      sources_[kept++] = y * size_x_ + x;
+  }
+  sources_.resize(kept);
+}
+
+void DistanceMap::update(const vector<unsigned char>& blocked, const vector<unsigned int>& changed,
+    const vector<unsigned int>& sources, double blocked_dist){
+  unsigned int n;
+  blocked_dist_ = blocked_dist;
+  changed_.clear();
+  cleared_.clear();
+  reached_.clear();
+
+  //sources of the last update are marked 1, new ones 2 and those in both 3
+  bool kept_source = false;
+  for(unsigned int i = 0; i < sources.size(); ++i){
+    unsigned char& mark = source_[sources[i]];
+    if(mark == 0){
+      mark = 2;
+      changed_.push_back(sources[i]);
+    }
+    else if(mark == 1){
+      mark = 3;
+      kept_source = true;
+    }
+  }
+  for(unsigned int i = 0; i < sources_.size(); ++i){
+    if(source_[sources_[i]] == 1){
+      source_[sources_[i]] = 0;
+      changed_.push_back(sources_[i]);
+    }
+  }
+  for(unsigned int i = 0; i < sources.size(); ++i)
+    source_[sources[i]] = 1;
+  sources_ = sources;
+
+  //every distance comes from a source that is gone, so start over rather than clear them one by one
+  if(!kept_source){
+    rebuild(blocked);
+    return;
+  }
+
+  //the cells that changed since the last update
+  for(unsigned int i = 0; i < changed.size(); ++i){
+    unsigned int ind = changed[i];
+    if(blocked_[ind] != blocked[ind]){
+      blocked_[ind] = blocked[ind];
+      changed_.push_back(ind);
+    }
+  }
+  for(unsigned int i = 0; i < unknown_.size(); ++i){
+    unsigned int ind = unknown_[i];
+    if(blocked_[ind] != blocked[ind]){
+      blocked_[ind] = blocked[ind];
+      changed_.push_back(ind);
+    }
+  }
+  unknown_.clear();
+
+  //clear the changed cells along with every cell whose distance came through them
+  for(unsigned int i = 0; i < changed_.size(); ++i){
+    reached_.push_back(changed_[i]);
+    while(!reached_.empty()){
+      unsigned int ind = reached_.back();
+      reached_.pop_back();
+      if(parent_[ind] == DIST_CLEARED)
+        continue;
+
+      for(unsigned int dir = 0; dir < 4; ++dir){
+        if(neighbor(ind, dir, n) && parent_[n] == (dir ^ 1))
+          reached_.push_back(n);
+      }
+      dist_[ind] = DIST_UNREACHED;
+      parent_[ind] = DIST_CLEARED;
+      cleared_.push_back(ind);
+    }
+  }
+
+  //the wavefront starts again from the sources and from the cells around the cleared ones
+  unsigned int last = 0;
+  if(buckets_.size() < 2)
+    buckets_.resize(2);
+  for(unsigned int i = 0; i < sources_.size(); ++i){
+    unsigned int ind = sources_[i];
+    if(dist_[ind] != 0){
+      dist_[ind] = 0;
+      parent_[ind] = DIST_SOURCE;
+      buckets_[0].push_back(ind);
+    }
+  }
+  for(unsigned int i = 0; i < cleared_.size(); ++i){
+    for(unsigned int dir = 0; dir < 4; ++dir){
+      if(neighbor(cleared_[i], dir, n) && parent_[n] != DIST_CLEARED && dist_[n] != DIST_UNREACHED && expands(n)){
+        unsigned int d = dist_[n];
+        if(d + 1 >= buckets_.size())
+          buckets_.resize(d + 2);
+        buckets_[d].push_back(n);
+        last = max(last, d);
+      }
+    }
+  }
+  for(unsigned int i = 0; i < cleared_.size(); ++i){
+    if(parent_[cleared_[i]] == DIST_CLEARED)
+      parent_[cleared_[i]] = DIST_NONE;
+  }
+
+  //distances are whole numbers of cells, so the queue is a bucket per distance
+  for(unsigned int d = 0; d <= last; ++d){
+    if(d + 2 >= buckets_.size())
+      buckets_.resize(d + 3);
+    vector<unsigned int>& bucket = buckets_[d];
+    vector<unsigned int>& next = buckets_[d + 1];
+    for(unsigned int i = 0; i < bucket.size(); ++i){
+      unsigned int ind = bucket[i];
+      if(dist_[ind] != d || !expands(ind))
+        continue;
+
+      for(unsigned int dir = 0; dir < 4; ++dir){
+        if(!neighbor(ind, dir, n))
+          continue;
+
+        //blocked cells stop the wavefront
+        if(!expands(n)){
+          reached_.push_back(n);
+          continue;
+        }
+
+        if(d + 1 < dist_[n]){
+          dist_[n] = d + 1;
+          parent_[n] = dir ^ 1;
+          next.push_back(n);
+        }
+      }
+    }
+    bucket.clear();
+    if(!next.empty())
+      last = max(last, d + 1);
+  }
+
+  //blocked cells next to a cleared cell may have lost their last reached neighbor
+  for(unsigned int i = 0; i < cleared_.size(); ++i){
+    reached_.push_back(cleared_[i]);
+    for(unsigned int dir = 0; dir < 4; ++dir){
+      if(neighbor(cleared_[i], dir, n))
+        reached_.push_back(n);
+    }
+  }
+  for(unsigned int i = 0; i < reached_.size(); ++i){
+    unsigned int ind = reached_[i];
+    if(expands(ind))
+      continue;
+
+    dist_[ind] = DIST_UNREACHED;
+    parent_[ind] = DIST_NONE;
+    for(unsigned int dir = 0; dir < 4; ++dir){
+      if(neighbor(ind, dir, n) && expands(n) && dist_[n] != DIST_UNREACHED){
+        dist_[ind] = DIST_BLOCKED;
+        break;
+      }
+    }
+  }
+}
+
+void DistanceMap::rebuild(const vector<unsigned char>& blocked){
+  unsigned int size = dist_.size();
+  unsigned int n;
+  blocked_ = blocked;
+  unknown_.clear();
+  dist_.assign(size, DIST_UNREACHED);
+  parent_.assign(size, DIST_NONE);
+
+  //every cell is queued at most once
+  queue_.resize(size);
+  unsigned int head = 0, tail = 0;
+  for(unsigned int i = 0; i < sources_.size(); ++i){
+    unsigned int ind = sources_[i];
+    if(dist_[ind] != 0){
+      dist_[ind] = 0;
+      parent_[ind] = DIST_SOURCE;
+      queue_[tail++] = ind;
+    }
+  }
+
+  while(head < tail){
+    unsigned int ind = queue_[head++];
+    unsigned int d = dist_[ind] + 1;
+    for(unsigned int dir = 0; dir < 4; ++dir){
+      if(!neighbor(ind, dir, n) || dist_[n] != DIST_UNREACHED)
+        continue;
+
+      //blocked cells stop the wavefront
+      if(!expands(n)){
+        dist_[n] = DIST_BLOCKED;
+        continue;
+      }
+
+      dist_[n] = d;
+      parent_[n] = dir ^ 1;
+      queue_[tail++] = n;
+    }
+  }
+}
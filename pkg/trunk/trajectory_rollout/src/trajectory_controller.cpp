@@ -32,6 +32,8 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
 #include <trajectory_rollout/trajectory_controller.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace std_msgs;
@@ -45,7 +47,9 @@ TrajectoryController::TrajectoryController(MapGrid& mg, double sim_time, int num
   acc_lim_x_(acc_lim_x), acc_lim_y_(acc_lim_y), acc_lim_theta_(acc_lim_theta), 
   prev_x_(0), prev_y_(0),
   tf_(tf), ma_(ma), traj_one(0, 0, 0, num_steps_),
-  traj_two(0, 0, 0, num_steps), footprint_spec_(footprint_spec)
+  footprint_spec_(footprint_spec), batch_scoring_(false), scoring_threads_(1), next_sample_(0),
+  scoring_barrier_(NULL), scoring_workers_(NULL), scoring_shutdown_(false), scoring_start_(NULL),
+  incremental_dist_(false), dist_origin_x_(0.0), dist_origin_y_(0.0), dist_scale_(0.0)
 {
   //the robot is not stuck to begin with
   stuck_left = false;
@@ -59,6 +63,10 @@ TrajectoryController::TrajectoryController(MapGrid& mg, double sim_time, int num
 
 }
 
+TrajectoryController::~TrajectoryController(){
+  stopScoringWorkers();
+}
+
 //update what map cells are considered path based on the global_plan
 void TrajectoryController::setPathCells(){
   int local_goal_x = -1;
@@ -66,15 +74,21 @@ void TrajectoryController::setPathCells(){
   bool started_path = false;
   queue<MapCell*> path_dist_queue;
   queue<MapCell*> goal_dist_queue;
+  path_cells_.clear();
+  goal_cells_.clear();
   for(unsigned int i = 0; i < global_plan_.size(); ++i){
     double g_x = global_plan_[i].x;
     double g_y = global_plan_[i].y;
     unsigned int map_x, map_y;
     if(ma_.WC_MC(g_x, g_y, map_x, map_y)){
-      MapCell& current = map_(map_x, map_y);
-      current.path_dist = 0.0;
-      current.path_mark = true;
-      path_dist_queue.push(&current);
+      if(incremental_dist_)
+        path_cells_.push_back(map_.getIndex(map_x, map_y));
+      else{
+        MapCell& current = map_(map_x, map_y);
+        current.path_dist = 0.0;
+        current.path_mark = true;
+        path_dist_queue.push(&current);
+      }
       local_goal_x = map_x;
       local_goal_y = map_y;
       started_path = true;
@@ -88,17 +102,87 @@ void TrajectoryController::setPathCells(){
   //printf("\n");
 
   if(local_goal_x >= 0 && local_goal_y >= 0){
-    MapCell& current = map_(local_goal_x, local_goal_y);
     ma_.MC_WC(local_goal_x, local_goal_y, goal_x_, goal_y_);
-    current.goal_dist = 0.0;
-    current.goal_mark = true;
-    goal_dist_queue.push(&current);
+    if(incremental_dist_)
+      goal_cells_.push_back(map_.getIndex(local_goal_x, local_goal_y));
+    else{
+      MapCell& current = map_(local_goal_x, local_goal_y);
+      current.goal_dist = 0.0;
+      current.goal_mark = true;
+      goal_dist_queue.push(&current);
+    }
   }
+
   //compute our distances
+  if(incremental_dist_){
+    updateDistances();
+    return;
+  }
   computePathDistance(path_dist_queue);
   computeGoalDistance(goal_dist_queue);
 }
 
+void TrajectoryController::setIncrementalDistances(bool incremental){
+  incremental_dist_ = incremental;
+  //start over the next time
+  dist_scale_ = 0.0;
+}
+
+//update the distances kept from the last cycle and copy them to the map
+void TrajectoryController::updateDistances(){
+  bool resized = path_map_.size_x_ != map_.size_x_ || path_map_.size_y_ != map_.size_y_ || dist_scale_ != map_.scale;
+  if(!resized){
+    //follow the map window if it moved by whole cells
+    double dx = (map_.origin_x - dist_origin_x_) / map_.scale;
+    double dy = (map_.origin_y - dist_origin_y_) / map_.scale;
+    int cell_dx = (int) floor(dx + 0.5);
+    int cell_dy = (int) floor(dy + 0.5);
+    if(fabs(dx - cell_dx) > 1e-3 || fabs(dy - cell_dy) > 1e-3)
+      resized = true;
+    else{
+      path_map_.shift(cell_dx, cell_dy);
+      goal_map_.shift(cell_dx, cell_dy);
+
+      //the flags of the cells that came in are not looked at, the maps know them as unknown
+      int offset = cell_dy * (int) map_.size_x_ + cell_dx;
+      if(offset > 0 && offset < (int) blocked_cells_.size())
+        copy(blocked_cells_.begin() + offset, blocked_cells_.end(), blocked_cells_.begin());
+      else if(offset < 0 && -offset < (int) blocked_cells_.size())
+        copy_backward(blocked_cells_.begin(), blocked_cells_.end() + offset, blocked_cells_.end());
+    }
+  }
+  if(resized){
+    path_map_.resize(map_.size_x_, map_.size_y_);
+    goal_map_.resize(map_.size_x_, map_.size_y_);
+    blocked_cells_.assign(map_.map_.size(), 0);
+    dist_scale_ = map_.scale;
+  }
+  dist_origin_x_ = map_.origin_x;
+  dist_origin_y_ = map_.origin_y;
+
+  //the same cells stop the wavefront as in computePathDistance, there is no record of what
+  //changed in the costmap so a single pass finds the cells that changed for both maps
+  const unsigned char* costs = ma_.getMap();
+  changed_cells_.clear();
+  for(unsigned int i = 0; i < blocked_cells_.size(); ++i){
+    unsigned char blocked = (costs[i] == costmap_2d::ObstacleMapAccessor::LETHAL_OBSTACLE
+        || costs[i] == costmap_2d::ObstacleMapAccessor::INSCRIBED_INFLATED_OBSTACLE) && !map_.map_[i].within_robot;
+    if(blocked != blocked_cells_[i]){
+      blocked_cells_[i] = blocked;
+      changed_cells_.push_back(i);
+    }
+  }
+
+  double blocked_dist = map_.map_.size();
+  path_map_.update(blocked_cells_, changed_cells_, path_cells_, blocked_dist);
+  goal_map_.update(blocked_cells_, changed_cells_, goal_cells_, blocked_dist);
+
+  for(unsigned int i = 0; i < map_.map_.size(); ++i){
+    map_.map_[i].path_dist = path_map_[i];
+    map_.map_[i].goal_dist = goal_map_[i];
+  }
+}
+
 void TrajectoryController::computePathDistance(queue<MapCell*>& dist_queue){
   MapCell* current_cell;
   MapCell* check_cell;
@@ -299,65 +383,71 @@ Trajectory TrajectoryController::createTrajectories(double x, double y, double t
 
   double vx_samp = min_vel_x;
   double vtheta_samp = min_vel_theta;
-  double vy_samp = 0.0;
 
-  //make sure to reset the list of trajectories
-  trajectories_.clear();
+  //any cell with a cost greater than the size of the map is impossible
+  double impossible_cost = map_.map_.size();
+
+  RolloutStart start = {x, y, theta, vx, vy, vtheta, acc_x, acc_y, acc_theta, impossible_cost};
+
+  //lay out the samples in the order that they are visited below
+  trajectories_.resize(samples_per_dim_ * samples_per_dim_ + samples_per_dim_ + y_vels.size() + 1,
+      Trajectory(0, 0, 0, num_steps_));
+  vector<Trajectory>::iterator sample = trajectories_.begin();
+  for(int i = 0; i < samples_per_dim_; ++i){
+    sample->xv_ = vx_samp; sample->yv_ = 0.0; sample->thetav_ = 0.0;
+    ++sample;
+    vtheta_samp = min_vel_theta;
+    for(int j = 0; j < samples_per_dim_ - 1; ++j){
+      sample->xv_ = vx_samp; sample->yv_ = 0.0; sample->thetav_ = vtheta_samp;
+      ++sample;
+      vtheta_samp += dvtheta;
+    }
+    vx_samp += dvx;
+  }
+
+  vtheta_samp = min_vel_theta;
+  for(int i = 0; i < samples_per_dim_; ++i){
+    //enforce a minimum rotational velocity because the base can't handle small in-place rotations
+    sample->xv_ = 0.0; sample->yv_ = 0.0; sample->thetav_ = vtheta_samp > 0 ? max(vtheta_samp, .4) : min(vtheta_samp, -.4);
+    ++sample;
+    vtheta_samp += dvtheta;
+  }
+
+  for(unsigned int i = 0; i < y_vels.size(); ++i){
+    sample->xv_ = 0.0; sample->yv_ = y_vels[i]; sample->thetav_ = 0.0;
+    ++sample;
+  }
+
+  sample->xv_ = -0.1; sample->yv_ = 0.0; sample->thetav_ = 0.0;
+
+  if(batch_scoring_)
+    scoreTrajectories(start);
 
   //keep track of the best trajectory seen so far
   Trajectory* best_traj = &traj_one;
   best_traj->cost_ = -1.0;
 
-  Trajectory* comp_traj = &traj_two;
-  comp_traj->cost_ = -1.0;
+  Trajectory* comp_traj = NULL;
+  unsigned int k = 0;
 
-  Trajectory* swap = NULL;
-  
-  //any cell with a cost greater than the size of the map is impossible
-  double impossible_cost = map_.map_.size();
-
-  //loop through all x velocities
-  for(int i = 0; i < samples_per_dim_; ++i){
-    vtheta_samp = 0;
-    //first sample the straight trajectory
-    generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+  //loop through all x velocities, first the straight trajectory and then all theta trajectories
+  for(int i = 0; i < samples_per_dim_ * samples_per_dim_; ++i){
+    comp_traj = sampleTrajectory(k++, start);
 
     //if the new trajectory is better... let's take it
     if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-      swap = best_traj;
       best_traj = comp_traj;
-      comp_traj = swap;
-    }
-
-    vtheta_samp = min_vel_theta;
-    //next sample all theta trajectories
-    for(int j = 0; j < samples_per_dim_ - 1; ++j){
-      generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
-
-      //if the new trajectory is better... let's take it
-      if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-        swap = best_traj;
-        best_traj = comp_traj;
-        comp_traj = swap;
-      }
-      vtheta_samp += dvtheta;
     }
-    vx_samp += dvx;
   }
 
   //next we want to generate trajectories for rotating in place
   vtheta_samp = min_vel_theta;
-  vx_samp = 0.0;
-  vy_samp = 0.0;
 
   //let's try to rotate toward open space
   double heading_dist = DBL_MAX;
 
   for(int i = 0; i < samples_per_dim_; ++i){
-    //enforce a minimum rotational velocity because the base can't handle small in-place rotations
-    double vtheta_samp_limited = vtheta_samp > 0 ? max(vtheta_samp, .4) : min(vtheta_samp, -.4);
-
-    generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp_limited, acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+    comp_traj = sampleTrajectory(k++, start);
 
     //if the new trajectory is better... let's take it
     if(comp_traj->cost_ >= 0 && (comp_traj->cost_ <= best_traj->cost_ || best_traj->cost_ < 0) && (vtheta_samp > dvtheta || vtheta_samp < -1 * dvtheta)){
@@ -373,16 +463,12 @@ Trajectory TrajectoryController::createTrajectories(double x, double y, double t
         if(ahead_gdist < heading_dist){
           //if we haven't already tried rotating left since we've moved forward
           if(vtheta_samp < 0 && !stuck_left){
-            swap = best_traj;
             best_traj = comp_traj;
-            comp_traj = swap;
             heading_dist = ahead_gdist;
           }
           //if we haven't already tried rotating right since we've moved forward
           else if(vtheta_samp > 0 && !stuck_right){
-            swap = best_traj;
             best_traj = comp_traj;
-            comp_traj = swap;
             heading_dist = ahead_gdist;
           }
         }
@@ -395,15 +481,11 @@ Trajectory TrajectoryController::createTrajectories(double x, double y, double t
 
 
   //if we can't rotate in place or move forward... maybe we can move sideways and rotate
-  vtheta_samp = min_vel_theta;
-  vx_samp = 0.0;
-
   //loop through all y velocities
   for(unsigned int i = 0; i < y_vels.size(); ++i){
-    vtheta_samp = 0;
-    vy_samp = y_vels[i];
+    double vy_samp = y_vels[i];
     //sample completely horizontal trajectories
-    generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+    comp_traj = sampleTrajectory(k++, start);
 
     //if the new trajectory is better... let's take it
     if(comp_traj->cost_ >= 0 && (comp_traj->cost_ <= best_traj->cost_ || best_traj->cost_ < 0)){
@@ -419,16 +501,12 @@ Trajectory TrajectoryController::createTrajectories(double x, double y, double t
         if(ahead_gdist < heading_dist){
           //if we haven't already tried strafing left since we've moved forward
           if(vy_samp > 0 && !stuck_left_strafe){
-            swap = best_traj;
             best_traj = comp_traj;
-            comp_traj = swap;
             heading_dist = ahead_gdist;
           }
           //if we haven't already tried rotating right since we've moved forward
           else if(vy_samp < 0 && !stuck_right_strafe){
-            swap = best_traj;
             best_traj = comp_traj;
-            comp_traj = swap;
             heading_dist = ahead_gdist;
           }
         }
@@ -484,16 +562,11 @@ Trajectory TrajectoryController::createTrajectories(double x, double y, double t
   }
 
   //and finally, if we can't do anything else, we want to generate trajectories that move backwards slowly
-  vtheta_samp = 0.0;
-  vx_samp = -0.1;
-  vy_samp = 0.0;
-  generateTrajectory(x, y, theta, vx, vy, vtheta, vx_samp, vy_samp, vtheta_samp, acc_x, acc_y, acc_theta, impossible_cost, *comp_traj);
+  comp_traj = sampleTrajectory(k++, start);
 
   //if the new trajectory is better... let's take it
   if(comp_traj->cost_ >= 0 && (comp_traj->cost_ < best_traj->cost_ || best_traj->cost_ < 0)){
-	  swap = best_traj;
 	  best_traj = comp_traj;
-	  comp_traj = swap;
   }
 
   strafe_left = false;
@@ -509,14 +582,188 @@ Trajectory TrajectoryController::createTrajectories(double x, double y, double t
   
 }
 
+Trajectory* TrajectoryController::sampleTrajectory(unsigned int k, const RolloutStart& start){
+  Trajectory& traj = trajectories_[k];
+  if(!batch_scoring_)
+    generateTrajectory(start.x, start.y, start.theta, start.vx, start.vy, start.vtheta, traj.xv_, traj.yv_, traj.thetav_,
+        start.acc_x, start.acc_y, start.acc_theta, start.impossible_cost, traj);
+  return &traj;
+}
+
+void TrajectoryController::setBatchScoring(bool batch, unsigned int num_threads){
+  stopScoringWorkers();
+  batch_scoring_ = batch;
+  scoring_threads_ = max(num_threads, 1u);
+
+  //start the workers once, rather than every cycle
+  if(batch_scoring_ && scoring_threads_ > 1){
+    scoring_barrier_ = new boost::barrier(scoring_threads_);
+    scoring_workers_ = new boost::thread_group();
+    for(unsigned int i = 1; i < scoring_threads_; ++i)
+      scoring_workers_->create_thread(boost::bind(&TrajectoryController::scoringWorker, this));
+  }
+}
+
+void TrajectoryController::stopScoringWorkers(){
+  if(scoring_barrier_ == NULL)
+    return;
+
+  scoring_shutdown_ = true;
+  scoring_barrier_->wait();
+  scoring_workers_->join_all();
+  delete scoring_workers_;
+  delete scoring_barrier_;
+  scoring_workers_ = NULL;
+  scoring_barrier_ = NULL;
+  scoring_shutdown_ = false;
+}
+
+void TrajectoryController::scoringWorker(){
+  while(true){
+    scoring_barrier_->wait();
+    if(scoring_shutdown_)
+      return;
+
+    scoreSamples(scoring_start_);
+    scoring_barrier_->wait();
+  }
+}
+
+//roll out all of trajectories_, handing out blocks of samples to the threads
+void TrajectoryController::scoreTrajectories(const RolloutStart& start){
+  next_sample_ = 0;
+  if(scoring_barrier_ == NULL){
+    scoreSamples(&start);
+    return;
+  }
+
+  scoring_start_ = &start;
+  scoring_barrier_->wait();
+  scoreSamples(&start);
+  scoring_barrier_->wait();
+  scoring_start_ = NULL;
+}
+
+void TrajectoryController::scoreSamples(const RolloutStart* start){
+  while(true){
+    unsigned int begin;
+    {
+      boost::mutex::scoped_lock lock(sample_mutex_);
+      if(next_sample_ >= trajectories_.size())
+        break;
+      begin = next_sample_;
+      next_sample_ += SAMPLE_BLOCK;
+    }
+
+    scoreSampleBlock(begin, min(begin + SAMPLE_BLOCK, (unsigned int)trajectories_.size()), *start);
+  }
+}
+
+//same as generateTrajectory for a block of samples, which are moved forward a step at a time
+void TrajectoryController::scoreSampleBlock(unsigned int begin, unsigned int end, const RolloutStart& start){
+  double x_i[SAMPLE_BLOCK], y_i[SAMPLE_BLOCK], theta_i[SAMPLE_BLOCK];
+  double vx_i[SAMPLE_BLOCK], vy_i[SAMPLE_BLOCK], vtheta_i[SAMPLE_BLOCK];
+  double path_dist[SAMPLE_BLOCK], goal_dist[SAMPLE_BLOCK], occ_cost[SAMPLE_BLOCK];
+  Trajectory* traj = &trajectories_[begin];
+  unsigned int num_samples = end - begin;
+  unsigned int num_valid = num_samples;
+  double dt = sim_time_ / num_steps_;
+
+  for(unsigned int k = 0; k < num_samples; ++k){
+    x_i[k] = start.x;
+    y_i[k] = start.y;
+    theta_i[k] = start.theta;
+    vx_i[k] = start.vx;
+    vy_i[k] = start.vy;
+    vtheta_i[k] = start.vtheta;
+    path_dist[k] = 0.0;
+    goal_dist[k] = 0.0;
+    occ_cost[k] = 0.0;
+    traj[k].cost_ = 0.0;
+  }
+
+  for(int i = 0; i < num_steps_ && num_valid > 0; ++i){
+    for(unsigned int k = 0; k < num_samples; ++k){
+      //skip the trajectories that are already invalid
+      if(traj[k].cost_ < 0)
+        continue;
+
+      unsigned int cell_x, cell_y;
+
+      //we don't want a path that goes off the know map
+      if(!ma_.WC_MC(x_i[k], y_i[k], cell_x, cell_y)){
+        traj[k].cost_ = -1.0;
+        --num_valid;
+        continue;
+      }
+
+      //we need to check if we need to lay down the footprint of the robot
+      if(ma_.isCircumscribedCell(cell_x, cell_y)){
+        double footprint_cost = footprintCost(x_i[k], y_i[k], theta_i[k]);
+        //if the footprint hits an obstacle this trajectory is invalid
+        if(footprint_cost < 0){
+          traj[k].cost_ = -1.0;
+          --num_valid;
+          continue;
+        }
+
+        occ_cost[k] += footprint_cost;
+      }
+      else{
+        occ_cost[k] += ma_.getCost(cell_x, cell_y);
+      }
+
+      path_dist[k] = map_(cell_x, cell_y).path_dist;
+      goal_dist[k] = map_(cell_x, cell_y).goal_dist;
+
+      //if a point on this trajectory has no clear path to goal it is invalid
+      if(start.impossible_cost <= goal_dist[k] || start.impossible_cost <= path_dist[k]){
+        traj[k].cost_ = -1.0;
+        --num_valid;
+        continue;
+      }
+
+      //the point is legal... add it to the trajectory
+      traj[k].setPoint(i, x_i[k], y_i[k], theta_i[k]);
+    }
+
+    //move every sample forward, the invalid ones won't be looked at again
+    for(unsigned int k = 0; k < num_samples; ++k){
+      vx_i[k] = computeNewVelocity(traj[k].xv_, vx_i[k], start.acc_x, dt);
+      vy_i[k] = computeNewVelocity(traj[k].yv_, vy_i[k], start.acc_y, dt);
+      vtheta_i[k] = computeNewVelocity(traj[k].thetav_, vtheta_i[k], start.acc_theta, dt);
+
+      x_i[k] = computeNewXPosition(x_i[k], vx_i[k], vy_i[k], theta_i[k], dt);
+      y_i[k] = computeNewYPosition(y_i[k], vx_i[k], vy_i[k], theta_i[k], dt);
+      theta_i[k] = computeNewThetaPosition(theta_i[k], vtheta_i[k], dt);
+    }
+  }
+
+  for(unsigned int k = 0; k < num_samples; ++k){
+    if(traj[k].cost_ < 0)
+      continue;
+
+    traj[k].cost_ = pdist_scale_ * path_dist[k] + gdist_scale_ * goal_dist[k] + dfast_scale_ * (1.0 / ((.05 + traj[k].xv_) * (.05 + traj[k].xv_)))
+      + occdist_scale_ * occ_cost[k];
+  }
+}
+
 //given the current state of the robot, find a good trajectory
 Trajectory TrajectoryController::findBestPath(tf::Stamped<tf::Pose> global_pose, tf::Stamped<tf::Pose> global_vel, 
     tf::Stamped<tf::Pose>& drive_velocities){
 
 
 
-  //reset the map for new operations
-  map_.resetPathDist();
+  //reset the map for new operations, the incremental distances overwrite every cell so
+  //only the footprint of the last cycle has to be unmarked
+  if(incremental_dist_){
+    for(unsigned int i = 0; i < robot_cells_.size(); ++i){
+      if(robot_cells_[i] < map_.map_.size())
+        map_.map_[robot_cells_[i]].within_robot = false;
+    }
+  }
+  else
+    map_.resetPathDist();
 
 
   double uselessPitch, uselessRoll, yaw, velYaw;
@@ -528,8 +775,10 @@ Trajectory TrajectoryController::findBestPath(tf::Stamped<tf::Pose> global_pose,
   vector<std_msgs::Position2DInt> footprint_list = getFootprintCells(global_pose.getOrigin().getX(), global_pose.getOrigin().getY(), yaw, true);
   
   //mark cells within the initial footprint of the robot
+  robot_cells_.clear();
   for(unsigned int i = 0; i < footprint_list.size(); ++i){
     map_(footprint_list[i].x, footprint_list[i].y).within_robot = true;
+    robot_cells_.push_back(map_.getIndex(footprint_list[i].x, footprint_list[i].y));
   }
   
   //make sure that we update our path based on the global plan and compute costs
@@ -0,0 +1,175 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <sys/time.h>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <trajectory_rollout/map_grid.h>
+#include <trajectory_rollout/trajectory_controller.h>
+#include <trajectory_rollout/governor_node.h>
+
+#include <std_msgs/Point2DFloat32.h>
+
+//the world the local window moves through
+const unsigned int WORLD_WIDTH(800);
+const unsigned int WORLD_HEIGHT(400);
+const double RESOLUTION(0.05);
+
+//the local window around the robot
+const unsigned int WINDOW_WIDTH(120);
+const unsigned int WINDOW_HEIGHT(120);
+
+//cycles of the controller, with the robot moving a cell every cycle, or every tenth
+//cycle as when it moves slowly or the plan is replaced often
+const unsigned int CYCLE_COUNT(500);
+const unsigned int MOVE_PERIODS[] = {1, 10};
+
+//cells of sensor noise that change in the window each cycle
+const unsigned int NOISE_COUNT(20);
+
+using namespace std;
+
+double now(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+//a regular grid of pillars with some clutter, and a clear corridor down the middle
+void buildWorld(vector<int>& world){
+  srand(0);
+  world.assign(WORLD_WIDTH * WORLD_HEIGHT, 0);
+  for(unsigned int j = 0; j < WORLD_HEIGHT; ++j){
+    for(unsigned int i = 0; i < WORLD_WIDTH; ++i){
+      if(j > WORLD_HEIGHT / 2 - 10 && j < WORLD_HEIGHT / 2 + 10)
+        continue;
+      if((i % 30 < 3 && j % 30 < 3) || rand() % 100 == 0)
+        world[i + j * WORLD_WIDTH] = 1;
+    }
+  }
+}
+
+//a straight plan along the corridor
+vector<std_msgs::Point2DFloat32> buildPlan(){
+  vector<std_msgs::Point2DFloat32> plan;
+  std_msgs::Point2DFloat32 pt;
+  for(unsigned int i = 0; i < WORLD_WIDTH; ++i){
+    pt.x = (i + 0.5) * RESOLUTION;
+    pt.y = (WORLD_HEIGHT / 2 + 0.5) * RESOLUTION;
+    plan.push_back(pt);
+  }
+  return plan;
+}
+
+//copy the world into the window at the given cell, with some noise
+void fillWindow(MapGrid& mg, const vector<int>& world, unsigned int wx, unsigned int wy){
+  for(unsigned int j = 0; j < WINDOW_HEIGHT; ++j){
+    for(unsigned int i = 0; i < WINDOW_WIDTH; ++i){
+      mg(i, j).occ_state = world[(wx + i) + (wy + j) * WORLD_WIDTH];
+      mg(i, j).occ_dist = DBL_MAX;
+    }
+  }
+  for(unsigned int k = 0; k < NOISE_COUNT; ++k)
+    mg.map_[rand() % mg.map_.size()].occ_state = 1;
+  mg.origin_x = wx * RESOLUTION;
+  mg.origin_y = wy * RESOLUTION;
+}
+
+void runCycles(const vector<int>& world, const vector<std_msgs::Point2DFloat32>& plan, unsigned int move_period){
+  MapGrid mg(WINDOW_WIDTH, WINDOW_HEIGHT, RESOLUTION, 0, 0);
+  WavefrontMapAccessor wa(mg, 0.0);
+  vector<std_msgs::Point2DFloat32> footprint_spec;
+
+  TrajectoryController full(mg, 1.0, 20, 6, .4, .6, 0, 0, 1, 1, 1, NULL, wa, footprint_spec);
+  TrajectoryController incremental(mg, 1.0, 20, 6, .4, .6, 0, 0, 1, 1, 1, NULL, wa, footprint_spec);
+  incremental.setIncrementalDistances(true);
+  full.updatePlan(plan);
+  incremental.updatePlan(plan);
+
+  double full_total = 0, full_max = 0;
+  double inc_total = 0, inc_max = 0;
+  unsigned int mismatches = 0;
+  vector<double> path_dist(mg.map_.size()), goal_dist(mg.map_.size());
+
+  srand(1);
+  unsigned int wy = (WORLD_HEIGHT - WINDOW_HEIGHT) / 2;
+  for(unsigned int cycle = 0; cycle < CYCLE_COUNT; ++cycle){
+    unsigned int wx = (cycle / move_period) % (WORLD_WIDTH - WINDOW_WIDTH);
+    fillWindow(mg, world, wx, wy);
+    wa.updateOrigin(mg.origin_x, mg.origin_y);
+    wa.synchronize();
+
+    double start = now();
+    mg.resetPathDist();
+    full.setPathCells();
+    double elapsed = now() - start;
+    full_total += elapsed;
+    full_max = max(full_max, elapsed);
+
+    for(unsigned int i = 0; i < mg.map_.size(); ++i){
+      path_dist[i] = mg.map_[i].path_dist;
+      goal_dist[i] = mg.map_[i].goal_dist;
+    }
+
+    //like findBestPath, the incremental mode does without resetPathDist
+    start = now();
+    incremental.setPathCells();
+    elapsed = now() - start;
+    inc_total += elapsed;
+    inc_max = max(inc_max, elapsed);
+
+    for(unsigned int i = 0; i < mg.map_.size(); ++i){
+      if(mg.map_[i].path_dist != path_dist[i] || mg.map_[i].goal_dist != goal_dist[i])
+        ++mismatches;
+    }
+  }
+
+  printf("%u cycles of a %ux%u window moving a cell every %u cycles, %u noise cells per cycle\n",
+      CYCLE_COUNT, WINDOW_WIDTH, WINDOW_HEIGHT, move_period, NOISE_COUNT);
+  printf("%-12s %10.4f ms/cycle %10.4f ms max\n", "full", full_total / CYCLE_COUNT * 1e3, full_max * 1e3);
+  printf("%-12s %10.4f ms/cycle %10.4f ms max\n", "incremental", inc_total / CYCLE_COUNT * 1e3, inc_max * 1e3);
+  printf("%u cells differ\n", mismatches);
+}
+
+int main(int argc, char** argv){
+  vector<int> world;
+  buildWorld(world);
+  vector<std_msgs::Point2DFloat32> plan = buildPlan();
+
+  for(unsigned int i = 0; i < sizeof(MOVE_PERIODS) / sizeof(MOVE_PERIODS[0]); ++i)
+    runCycles(world, plan, MOVE_PERIODS[i]);
+
+  return 0;
+}
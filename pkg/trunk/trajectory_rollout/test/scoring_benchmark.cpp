@@ -0,0 +1,156 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <sys/time.h>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <trajectory_rollout/map_grid.h>
+#include <trajectory_rollout/trajectory_controller.h>
+#include <trajectory_rollout/governor_node.h>
+
+#include <std_msgs/Point2DFloat32.h>
+
+//the local window around the robot
+const unsigned int WINDOW_WIDTH(120);
+const unsigned int WINDOW_HEIGHT(120);
+const double RESOLUTION(0.05);
+
+//cycles of the controller timed for each setting
+const unsigned int CYCLE_COUNT(50);
+
+using namespace std;
+
+double now(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+//pillars and some clutter, with a clear corridor down the middle, and the distance
+//to the nearest obstacle filled in around them
+void buildWindow(MapGrid& mg){
+  srand(0);
+  for(unsigned int j = 0; j < WINDOW_HEIGHT; ++j){
+    for(unsigned int i = 0; i < WINDOW_WIDTH; ++i){
+      mg(i, j).occ_state = 0;
+      mg(i, j).occ_dist = DBL_MAX;
+      if(j > WINDOW_HEIGHT / 2 - 10 && j < WINDOW_HEIGHT / 2 + 10)
+        continue;
+      if((i % 30 < 3 && j % 30 < 3) || rand() % 100 == 0)
+        mg(i, j).occ_state = 1;
+    }
+  }
+
+  int reach = (int) (OUTER_RADIUS / RESOLUTION) + 1;
+  for(unsigned int j = 0; j < WINDOW_HEIGHT; ++j){
+    for(unsigned int i = 0; i < WINDOW_WIDTH; ++i){
+      if(mg(i, j).occ_state != 1)
+        continue;
+      for(int dj = -reach; dj <= reach; ++dj){
+        for(int di = -reach; di <= reach; ++di){
+          int x = i + di, y = j + dj;
+          if(x < 0 || y < 0 || x >= (int) WINDOW_WIDTH || y >= (int) WINDOW_HEIGHT)
+            continue;
+          mg(x, y).occ_dist = min(mg(x, y).occ_dist, sqrt((double) (di * di + dj * dj)) * RESOLUTION);
+        }
+      }
+    }
+  }
+}
+
+//a straight plan along the corridor
+vector<std_msgs::Point2DFloat32> buildPlan(){
+  vector<std_msgs::Point2DFloat32> plan;
+  std_msgs::Point2DFloat32 pt;
+  for(unsigned int i = 0; i < WINDOW_WIDTH; ++i){
+    pt.x = (i + 0.5) * RESOLUTION;
+    pt.y = (WINDOW_HEIGHT / 2 + 0.5) * RESOLUTION;
+    plan.push_back(pt);
+  }
+  return plan;
+}
+
+vector<std_msgs::Point2DFloat32> buildFootprint(){
+  vector<std_msgs::Point2DFloat32> footprint_spec;
+  std_msgs::Point2DFloat32 pt;
+  pt.x = ROBOT_FRONT_RADIUS; pt.y = ROBOT_SIDE_RADIUS; footprint_spec.push_back(pt);
+  pt.x = ROBOT_FRONT_RADIUS; pt.y = -ROBOT_SIDE_RADIUS; footprint_spec.push_back(pt);
+  pt.x = -ROBOT_FRONT_RADIUS; pt.y = -ROBOT_SIDE_RADIUS; footprint_spec.push_back(pt);
+  pt.x = -ROBOT_FRONT_RADIUS; pt.y = ROBOT_SIDE_RADIUS; footprint_spec.push_back(pt);
+  return footprint_spec;
+}
+
+//time createTrajectories from a few poses along the corridor, near the pillars
+double timeCycles(TrajectoryController& tc){
+  double total = 0;
+  for(unsigned int cycle = 0; cycle < CYCLE_COUNT; ++cycle){
+    double x = (20 + cycle % 80) * RESOLUTION;
+    double y = (WINDOW_HEIGHT / 2 + (cycle % 5) - 2) * RESOLUTION;
+    double start = now();
+    tc.createTrajectories(x, y, 0.1 * (cycle % 7), 0.2, 0, 0, 1, 1, 1);
+    total += now() - start;
+  }
+  return total / CYCLE_COUNT;
+}
+
+int main(int argc, char** argv){
+  unsigned int max_threads = argc > 1 ? atoi(argv[1]) : 4;
+
+  MapGrid mg(WINDOW_WIDTH, WINDOW_HEIGHT, RESOLUTION, 0, 0);
+  buildWindow(mg);
+  WavefrontMapAccessor wa(mg, OUTER_RADIUS);
+  vector<std_msgs::Point2DFloat32> plan = buildPlan();
+  vector<std_msgs::Point2DFloat32> footprint_spec = buildFootprint();
+
+  //the governor's settings, and finer sampling
+  int settings[][2] = {{VEL_SAMPLES, SIM_STEPS}, {50, 60}};
+  for(unsigned int s = 0; s < sizeof(settings) / sizeof(settings[0]); ++s){
+    int samples = settings[s][0], steps = settings[s][1];
+    TrajectoryController tc(mg, SIM_TIME, steps, samples, .4, .6, 0, 0, 1, 1, 1, NULL, wa, footprint_spec);
+    tc.updatePlan(plan);
+    mg.resetPathDist();
+    tc.setPathCells();
+
+    printf("%d samples per dimension, %d steps, %u cycles\n", samples, steps, CYCLE_COUNT);
+    printf("%-12s %10.4f ms/cycle\n", "sequential", timeCycles(tc) * 1e3);
+    for(unsigned int threads = 1; threads <= max_threads; ++threads){
+      tc.setBatchScoring(true, threads);
+      printf("batch %-6u %10.4f ms/cycle\n", threads, timeCycles(tc) * 1e3);
+    }
+    tc.setBatchScoring(false);
+  }
+
+  return 0;
+}
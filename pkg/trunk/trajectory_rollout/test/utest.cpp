@@ -39,6 +39,7 @@
 #include <trajectory_rollout/map_grid.h>
 #include <trajectory_rollout/trajectory.h>
 #include <trajectory_rollout/trajectory_controller.h>
+#include <trajectory_rollout/distance_map.h>
 #include <costmap_2d/obstacle_map_accessor.h>
 #include <trajectory_rollout/governor_node.h>
 #include <math.h>
@@ -211,6 +212,154 @@ TEST(TrajectoryController, checkPathDistance){
 
 }
 
+//batch scoring should score the samples like the rollout of one trajectory at a time, on any number of threads
+TEST(TrajectoryController, batchScoring){
+  //clear the map but for an obstacle in the way of some of the trajectories
+  for(unsigned int i = 0; i < tc->map_.map_.size(); ++i)
+    tc->map_.map_[i].occ_state = 0;
+  tc->map_(7, 4).occ_state = 1;
+  wa.synchronize();
+
+  //head for the right edge of the map
+  tc->map_.resetPathDist();
+  queue<MapCell*> path_dist_queue;
+  queue<MapCell*> goal_dist_queue;
+  MapCell& current = tc->map_(9, 5);
+  current.path_dist = 0.0;
+  current.path_mark = true;
+  current.goal_dist = 0.0;
+  current.goal_mark = true;
+  path_dist_queue.push(&current);
+  goal_dist_queue.push(&current);
+  tc->computePathDistance(path_dist_queue);
+  tc->computeGoalDistance(goal_dist_queue);
+
+  tc->createTrajectories(4.5, 4.5, M_PI_2, 0, 0, 0, 1, 1, 1);
+  vector<Trajectory> trajectories = tc->trajectories_;
+
+  for(unsigned int threads = 1; threads <= 3; ++threads){
+    tc->setBatchScoring(true, threads);
+    tc->createTrajectories(4.5, 4.5, M_PI_2, 0, 0, 0, 1, 1, 1);
+    ASSERT_EQ(tc->trajectories_.size(), trajectories.size());
+
+    //the last sample is only rolled out when no other trajectory is legal
+    for(unsigned int i = 0; i < trajectories.size() - 1; ++i){
+      EXPECT_DOUBLE_EQ(tc->trajectories_[i].cost_, trajectories[i].cost_);
+    }
+  }
+  tc->setBatchScoring(false);
+}
+
+//incremental distances should match the distances computed from scratch as obstacles and the plan change
+TEST(TrajectoryController, incrementalDistances){
+  std::vector<std_msgs::Point2DFloat32> footprint_spec;
+  TrajectoryController itc(mg, 2, 30, 25, .4, .6, 0, 0, 1, 1, 1, NULL, wa, footprint_spec);
+  itc.setIncrementalDistances(true);
+
+  srand(0);
+  for(unsigned int cycle = 0; cycle < 50; ++cycle){
+    //move a few obstacles around
+    for(unsigned int i = 0; i < 5; ++i)
+      mg.map_[rand() % mg.map_.size()].occ_state = rand() % 3 == 0 ? 1 : 0;
+    wa.synchronize();
+
+    //now and then the window moves by a cell
+    if(cycle % 7 == 6){
+      mg.origin_x = mg.origin_x == 0 ? mg.scale : 0;
+      wa.updateOrigin(mg.origin_x, mg.origin_y);
+    }
+
+    //a plan along a fixed row whose end bends a little every cycle, so that most of
+    //the path is kept and only its end is cleared and seeded again
+    vector<Point2DFloat32> plan;
+    Point2DFloat32 pt;
+    for(int i = 0; i < 6; ++i){
+      pt.x = i + 1.5;
+      pt.y = 5.5;
+      plan.push_back(pt);
+    }
+    int bend = rand() % 3 - 1;
+    for(int i = 1; i <= 2; ++i){
+      pt.y = 5.5 + i * bend;
+      plan.push_back(pt);
+    }
+    tc->updatePlan(plan);
+    itc.updatePlan(plan);
+
+    tc->map_.resetPathDist();
+    tc->setPathCells();
+    vector<double> path_dist, goal_dist;
+    for(unsigned int i = 0; i < mg.map_.size(); ++i){
+      path_dist.push_back(mg.map_[i].path_dist);
+      goal_dist.push_back(mg.map_[i].goal_dist);
+    }
+
+    //the incremental update has to write every cell without resetPathDist
+    for(unsigned int i = 0; i < mg.map_.size(); ++i){
+      mg.map_[i].path_dist = -1.0;
+      mg.map_[i].goal_dist = -1.0;
+    }
+    itc.setPathCells();
+    for(unsigned int i = 0; i < mg.map_.size(); ++i){
+      EXPECT_DOUBLE_EQ(mg.map_[i].path_dist, path_dist[i]);
+      EXPECT_DOUBLE_EQ(mg.map_[i].goal_dist, goal_dist[i]);
+    }
+  }
+
+  mg.origin_x = 0;
+  wa.updateOrigin(mg.origin_x, mg.origin_y);
+}
+
+//a distance map that follows a moving window should match one computed from scratch for the window
+TEST(DistanceMap, shiftedWindow){
+  unsigned int world_size = 30, window_size = 12;
+  vector<unsigned char> world(world_size * world_size);
+  srand(1);
+  for(unsigned int i = 0; i < world.size(); ++i)
+    world[i] = rand() % 4 == 0;
+
+  DistanceMap moving;
+  moving.resize(window_size, window_size);
+  int wx = 0, wy = 0;
+  vector<unsigned char> blocked(window_size * window_size);
+  vector<unsigned int> sources;
+  for(unsigned int cycle = 0; cycle < 40; ++cycle){
+    int dx = rand() % 3 - 1, dy = rand() % 3 - 1;
+    if(wx + dx < 0 || wx + dx + window_size > world_size) dx = 0;
+    if(wy + dy < 0 || wy + dy + window_size > world_size) dy = 0;
+    wx += dx;
+    wy += dy;
+    moving.shift(dx, dy);
+
+    //the cells that came in with the shift are not listed, only the one that flipped
+    unsigned int flip = rand() % world.size();
+    world[flip] ^= 1;
+    vector<unsigned int> changed;
+    int fx = flip % world_size - wx, fy = flip / world_size - wy;
+    if(fx >= 0 && fx < (int)window_size && fy >= 0 && fy < (int)window_size)
+      changed.push_back(fy * window_size + fx);
+    for(unsigned int y = 0; y < window_size; ++y)
+      for(unsigned int x = 0; x < window_size; ++x)
+        blocked[y * window_size + x] = world[(wy + y) * world_size + wx + x];
+
+    //a source that stays put in the world while it is in the window
+    sources.clear();
+    int sx = 15 - wx, sy = 15 - wy;
+    if(sx >= 0 && sx < (int)window_size && sy >= 0 && sy < (int)window_size)
+      sources.push_back(sy * window_size + sx);
+    sources.push_back(rand() % blocked.size());
+
+    moving.update(blocked, changed, sources, blocked.size());
+
+    DistanceMap fresh;
+    fresh.resize(window_size, window_size);
+    fresh.update(blocked, changed, sources, blocked.size());
+    for(unsigned int i = 0; i < blocked.size(); ++i){
+      EXPECT_DOUBLE_EQ(moving[i], fresh[i]);
+    }
+  }
+}
+
 //sanity check to make sure the grid functions correctly
 TEST(MapGrid, properGridConstruction){
   MapGrid mg(10, 10);
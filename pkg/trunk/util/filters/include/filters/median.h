@@ -31,6 +31,7 @@
 #define FILTERS_MEDIAN_H_
 
 #include <stdint.h>
+#include <cstring>
 
 #include "filters/filter_base.h"
 
@@ -132,7 +133,7 @@ MedianFilter<T>::MedianFilter(uint32_t number_of_observations, uint32_t elements
   elements_per_observation_(elements_per_observation)
 {
   data_storage_ = new T[number_of_observations_ * elements_per_observation];
-  temp_storage_ = new T[elements_per_observation];
+  temp_storage_ = new T[number_of_observations_];
 
 };
 
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FILTERS_SLIDING_MEDIAN_H_
+#define FILTERS_SLIDING_MEDIAN_H_
+
+#include <stdint.h>
+
+#include "filters/filter_base.h"
+
+/** \brief A median filter which works on arrays, and keeps the window of each element sorted
+ * between updates.
+ * Each element keeps its last observations in a max heap of the ones below the median and a
+ * min heap of the ones above it, with the median between them, as in the double heap of
+ * Haerdle and Steiger.  An update replaces the oldest observation of each element with the new
+ * one and restores the heaps, which is O(log number_of_observations) per element instead of
+ * selecting the median from all the observations again.  The output is the same as MedianFilter,
+ * the lower median when the number of observations is even.
+ */
+template <typename T>
+class SlidingMedianFilter: public FilterBase <T>
+{
+public:
+  /** \brief Construct the filter with the expected width and height */
+  SlidingMedianFilter(uint32_t number_of_observations, uint32_t elements_per_observation);
+
+  /** \brief Destructor to clean up
+   */
+  ~SlidingMedianFilter()
+  {
+    delete [] data_storage_;
+    delete [] positions_;
+    delete [] heaps_;
+  }
+
+  /** \brief Update filter mutating data in place
+   * This will overwrite the results on top of the input
+   * \param data This must be an array which is elements_per_observation long
+   */
+  virtual bool update(T * data)
+  {
+    return update (data, data);
+  }
+
+
+  /** \brief Update the filter and return the data seperately
+   * \param data_in double array with length elements_per_observation
+   * \param data_out double array with length elements_per_observation
+   */
+  virtual bool update(T const * const data_in, T* data_out);
+  
+protected:
+  /** \brief Swap heap entries i and j if the observation at i is less than the one at j
+   * \return true if they were swapped */
+  static inline bool exchangeIfLess(const T* data, int* positions, int* heap, int i, int j)
+  {
+    if (!(data[heap[i]] < data[heap[j]]))
+      return false;
+    int t = heap[i];
+    heap[i] = heap[j];
+    heap[j] = t;
+    positions[heap[i]] = i;
+    positions[heap[j]] = j;
+    return true;
+  }
+
+  /** \brief Move the entry at child i of the min heap down to its place */
+  inline void minSortDown(const T* data, int* positions, int* heap, int i) const
+  {
+    for (; i <= min_count_; i *= 2)
+    {
+      if (i > 1 && i < min_count_ && data[heap[i + 1]] < data[heap[i]])
+        ++i;
+      if (!exchangeIfLess(data, positions, heap, i, i / 2))
+        break;
+    }
+  }
+
+  /** \brief Move the entry at child i of the max heap down to its place */
+  inline void maxSortDown(const T* data, int* positions, int* heap, int i) const
+  {
+    for (; i >= -max_count_; i *= 2)
+    {
+      if (i < -1 && i > -max_count_ && data[heap[i]] < data[heap[i - 1]])
+        --i;
+      if (!exchangeIfLess(data, positions, heap, i / 2, i))
+        break;
+    }
+  }
+
+  /** \brief Move the entry at i of the min heap up to its place
+   * \return true if it became the median */
+  static inline bool minSortUp(const T* data, int* positions, int* heap, int i)
+  {
+    while (i > 0 && exchangeIfLess(data, positions, heap, i, i / 2))
+      i /= 2;
+    return i == 0;
+  }
+
+  /** \brief Move the entry at i of the max heap up to its place
+   * \return true if it became the median */
+  static inline bool maxSortUp(const T* data, int* positions, int* heap, int i)
+  {
+    while (i < 0 && exchangeIfLess(data, positions, heap, i / 2, i))
+      i /= 2;
+    return i == 0;
+  }
+
+  T * data_storage_;                       ///< Storage for data between updates, the observations of each element together
+  int * positions_;                        ///< Position in the heap of each stored observation
+  int * heaps_;                            ///< For each element, the stored observations ordered as a max heap at negative positions and a min heap at positive ones around the median at 0
+
+  uint32_t last_updated_row_;                   ///< The last row to have been updated by the filter
+  uint32_t iterations_;                         ///< Number of iterations up to number of observations
+  int min_count_;                               ///< Number of observations in each min heap
+  int max_count_;                               ///< Number of observations in each max heap
+
+  uint32_t number_of_observations_;             ///< Number of observations over which to filter
+  uint32_t elements_per_observation_;           ///< Number of elements per observation
+
+};
+
+template <typename T>
+SlidingMedianFilter<T>::SlidingMedianFilter(uint32_t number_of_observations, uint32_t elements_per_observation):
+  last_updated_row_(number_of_observations),
+  iterations_(0),
+  min_count_(0),
+  max_count_(0),
+  number_of_observations_(number_of_observations),
+  elements_per_observation_(elements_per_observation)
+{
+  data_storage_ = new T[number_of_observations_ * elements_per_observation_];
+  positions_ = new int[number_of_observations_ * elements_per_observation_];
+  heaps_ = new int[number_of_observations_ * elements_per_observation_];
+
+  //Observations fill the median, then the max and min heaps in turn, while starting up
+  for (uint32_t i = 0; i < elements_per_observation_; i++)
+  {
+    int* positions = &positions_[i * number_of_observations_];
+    int* heap = &heaps_[i * number_of_observations_ + number_of_observations_ / 2];
+    for (uint32_t row = 0; row < number_of_observations_; row++)
+    {
+      positions[row] = ((row + 1) / 2) * ((row & 1) ? -1 : 1);
+      heap[positions[row]] = row;
+    }
+  }
+};
+
+
+template <typename T>
+bool SlidingMedianFilter<T>::update(T const* const data_in, T* data_out)
+{
+  //update active row
+  if (last_updated_row_ >= number_of_observations_ - 1)
+    last_updated_row_ = 0;
+  else 
+    last_updated_row_++;
+
+  //keep track of number of rows used while starting up
+  bool starting = iterations_ < number_of_observations_;
+  if (starting)
+  {
+    iterations_++;
+    max_count_ = iterations_ / 2;
+    min_count_ = (iterations_ - 1) / 2;
+  }
+
+  //Replace the oldest observation of each element and return each value
+  for (uint32_t i = 0; i < elements_per_observation_; i++)
+  {
+    T* data = &data_storage_[i * number_of_observations_];
+    int* positions = &positions_[i * number_of_observations_];
+    int* heap = &heaps_[i * number_of_observations_ + number_of_observations_ / 2];
+
+    T old = data[last_updated_row_];
+    T value = data_in[i];
+    data[last_updated_row_] = value;
+
+    int p = positions[last_updated_row_];
+    if (p > 0) //in the min heap
+    {
+      if (!starting && old < value)
+        minSortDown(data, positions, heap, p * 2);
+      else if (minSortUp(data, positions, heap, p))
+        maxSortDown(data, positions, heap, -1);
+    }
+    else if (p < 0) //in the max heap
+    {
+      if (!starting && value < old)
+        maxSortDown(data, positions, heap, p * 2);
+      else if (maxSortUp(data, positions, heap, p))
+        minSortDown(data, positions, heap, 1);
+    }
+    else //the median
+    {
+      if (max_count_ > 0)
+        maxSortDown(data, positions, heap, -1);
+      if (min_count_ > 0)
+        minSortDown(data, positions, heap, 1);
+    }
+
+    //the median, or the top of the max heap for the lower median of an even count
+    data_out[i] = data[heap[max_count_ > min_count_ ? -1 : 0]];
+  }    
+  
+  return true;
+}
+
+
+
+#endif //#ifndef FILTERS_SLIDING_MEDIAN_H_
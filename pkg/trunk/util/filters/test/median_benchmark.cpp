@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file Time MedianFilter and SlidingMedianFilter on rows as long as a
+ * Hokuyo UTM-30LX scan, over windows of 5 to 51 observations. */
+
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "filters/median.h"
+#include "filters/sliding_median.h"
+
+const uint32_t ELEMENTS = 1081;
+const uint32_t ROWS = 2000;
+
+double now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/** \brief Filter all the rows, return the seconds per row */
+double run(FilterBase<float>& filter, const float* rows, float* output)
+{
+  double start = now();
+  for (uint32_t row = 0; row < ROWS; row++)
+    filter.update(&rows[row * ELEMENTS], &output[row * ELEMENTS]);
+  return (now() - start) / ROWS;
+}
+
+int main(int argc, char **argv)
+{
+  //ranges of a robot standing still, with noise and dropouts
+  srand(0);
+  float* rows = new float[ROWS * ELEMENTS];
+  for (uint32_t i = 0; i < ELEMENTS; i++)
+  {
+    float range = 1.0 + 4.0 * rand() / (float) RAND_MAX;
+    for (uint32_t row = 0; row < ROWS; row++)
+      rows[row * ELEMENTS + i] = rand() % 50 == 0 ? 0.0 : range + 0.05 * rand() / (float) RAND_MAX;
+  }
+  float* output = new float[ROWS * ELEMENTS];
+  float* sliding_output = new float[ROWS * ELEMENTS];
+
+  printf("%u elements, %u rows\n", ELEMENTS, ROWS);
+  printf("window  MedianFilter ms/row  SlidingMedianFilter ms/row  speedup  mismatches\n");
+  for (uint32_t window = 5; window <= 51; window += (window < 11 ? 6 : 10))
+  {
+    MedianFilter<float> filter(window, ELEMENTS);
+    SlidingMedianFilter<float> sliding_filter(window, ELEMENTS);
+    double time = run(filter, rows, output);
+    double sliding_time = run(sliding_filter, rows, sliding_output);
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < ROWS * ELEMENTS; i++)
+      if (output[i] != sliding_output[i])
+        mismatches++;
+
+    printf("%6u  %19.4f  %26.4f  %7.2f  %10u\n", window, time * 1e3, sliding_time * 1e3, time / sliding_time, mismatches);
+  }
+
+  delete [] rows;
+  delete [] output;
+  delete [] sliding_output;
+  return 0;
+}
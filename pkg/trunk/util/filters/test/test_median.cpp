@@ -31,6 +31,7 @@
 #include <sys/time.h>
 
 #include "filters/median.h"
+#include "filters/sliding_median.h"
 #include "filters/mean.h"
 
 void seed_rand()
@@ -94,6 +95,74 @@ TEST(MedianFilter, ThreeRows)
   
 }
 
+TEST(SlidingMedianFilter, ConfirmIdentityNRows)
+{
+  double epsilon = 1e-6;
+  int length = 5;
+  int rows = 5;
+  SlidingMedianFilter<float> filter(rows,length);
+  float input1[] = {1,2,3,4,5};
+  float input1a[] = {1,2,3,4,5};
+
+  for (int i =0; i < rows*10; i++)
+  {
+    filter.update(input1, input1a);
+    
+    for (int i = 1; i < length; i++)
+    {
+      EXPECT_NEAR(input1[i], input1a[i], epsilon);
+    }
+  }
+}
+
+TEST(SlidingMedianFilter, ThreeRows)
+{
+  double epsilon = 1e-6;
+  int length = 5;
+  int rows = 5;
+  SlidingMedianFilter<float> filter(rows,length);
+  float input1[] = {0,1,2,3,4};
+  float input2[] = {1,2,3,4,5};
+  float input3[] = {2,3,4,5,6};
+  float input1a[] = {1,2,3,4,5};
+
+  filter.update(input1, input1a);
+  filter.update(input2, input1a);
+  filter.update(input3, input1a);
+  
+  for (int i = 1; i < length; i++)
+  {
+    EXPECT_NEAR(input2[i], input1a[i], epsilon);
+  }
+  
+}
+
+TEST(SlidingMedianFilter, SameAsMedianFilter)
+{
+  seed_rand();
+  int length = 20;
+  for (int rows = 1; rows <= 12; rows++)
+  {
+    MedianFilter<float> filter(rows,length);
+    SlidingMedianFilter<float> sliding_filter(rows,length);
+    float input[20], output[20], sliding_output[20];
+
+    for (int j = 0; j < rows*10; j++)
+    {
+      //few distinct values, so that there are ties
+      for (int i = 0; i < length; i++)
+        input[i] = rand() % 8;
+      filter.update(input, output);
+      sliding_filter.update(input, sliding_output);
+      
+      for (int i = 0; i < length; i++)
+      {
+        EXPECT_EQ(output[i], sliding_output[i]);
+      }
+    }
+  }
+}
+
 TEST(MeanFilter, ConfirmIdentityNRows)
 {
   double epsilon = 1e-6;
@@ -31,13 +31,10 @@
 #define LASER_SCAN_UTILS_LASERSCAN_H
 
 #include <map>
+#include <vector>
 #include <iostream>
 #include <sstream>
 
-#include <newmat10/newmat.h>
-#include <newmat10/newmatio.h>
-#include <newmat10/newmatap.h>
-
 #include "tf/tf.h"
 
 #include "std_msgs/LaserScan.h"
@@ -68,6 +65,7 @@ namespace laser_scan{
        * \param cloudOut The output point cloud
        * \param range_cutoff An additional range cutoff which can be applied which is more limiting than max_range in the scan.
        * \param preservative Default: false  If true all points in scan will be projected, including out of range values.  Otherwise they will not be added to the cloud.
+       * The cloud gets "intensities" and "index" channels if the scan has intensities.
        */
       void projectLaser(const std_msgs::LaserScan& scan_in, std_msgs::PointCloud & cloud_out, double range_cutoff=-1.0, bool preservative = false);
 
@@ -77,14 +75,23 @@ namespace laser_scan{
 
       
     private:
+      /** \brief The cos and sin of each beam angle of a scan configuration, in contiguous arrays */
+      struct UnitVectors
+      {
+        float angle_min, angle_max, angle_increment;
+        unsigned int length;
+        std::vector<float> cos_;
+        std::vector<float> sin_;
+      };
+
       /** \brief Return the unit vectors for this configuration
        * Return the unit vectors for this configuration.
        * if they have not been calculated yet, calculate them and store them
        * Otherwise it will return them from memory. */
-      NEWMAT::Matrix& getUnitVectors(float angle_max, float angle_min, float angle_increment);
+      const UnitVectors& getUnitVectors(float angle_min, float angle_max, float angle_increment);
 
-      ///The map of pointers to stored values
-      std::map<std::string,NEWMAT::Matrix*> unit_vector_map_;
+      ///The stored unit vectors, one per configuration seen, looked up by their angles
+      std::vector<UnitVectors*> unit_vectors_;
       
     };
   
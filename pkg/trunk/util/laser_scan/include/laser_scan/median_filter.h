@@ -36,7 +36,7 @@
 
 #include "std_msgs/LaserScan.h"
 
-#include "filters/median.h"
+#include "filters/sliding_median.h"
 
 namespace laser_scan{
 
@@ -63,8 +63,8 @@ private:
   ros::thread::mutex data_lock; /// Protection from multi threaded programs
   std_msgs::LaserScan temp_scan_; /** \todo cache only shallow info not full scan */
 
-  MedianFilter<float> * range_filter_;
-  MedianFilter<float> * intensity_filter_;
+  SlidingMedianFilter<float> * range_filter_;
+  SlidingMedianFilter<float> * intensity_filter_;
       
 };
   
@@ -29,83 +29,102 @@
 
 #include "laser_scan/laser_scan.h"
 #include <algorithm>
+#include <math.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 namespace laser_scan{
 
   
-  void LaserProjection::projectLaser(const std_msgs::LaserScan& scan_in, std_msgs::PointCloud & cloud_out, double range_cutoff, bool preservative)
+  /** \brief Write beam index of the scan as point count of the cloud, with its channels if the cloud has them */
+  static inline void setPoint(std_msgs::PointCloud& cloud, unsigned int count, float x, float y,
+                              const std_msgs::LaserScan& scan, unsigned int index, unsigned int n_intensities)
   {
-    NEWMAT::Matrix ranges(2, scan_in.get_ranges_size());
-    double * matPointer = ranges.Store();
-    // Fill the ranges matrix
-    for (unsigned int index = 0; index < scan_in.get_ranges_size(); index++)
-      {
-        matPointer[index] = (double) scan_in.ranges[index];
-        matPointer[index+scan_in.get_ranges_size()] = (double) scan_in.ranges[index];
-      }
-    
+    cloud.pts[count].x = x;
+    cloud.pts[count].y = y;
+    cloud.pts[count].z = 0.0;
+    if (n_intensities > 0)
+    {
+      cloud.chan[0].vals[count] = index < n_intensities ? scan.intensities[index] : 0.0;
+      //write index to point cloud
+      cloud.chan[1].vals[count] = index;
+    }
+  }
 
-    //Do the projection
-    NEWMAT::Matrix output = NEWMAT::SP(ranges, getUnitVectors(scan_in.angle_min, scan_in.angle_max, scan_in.angle_increment));
-    
+  void LaserProjection::projectLaser(const std_msgs::LaserScan& scan_in, std_msgs::PointCloud & cloud_out, double range_cutoff, bool preservative)
+  {
+    const UnitVectors& unit_vectors = getUnitVectors(scan_in.angle_min, scan_in.angle_max, scan_in.angle_increment);
+    unsigned int n_pts = std::min(scan_in.get_ranges_size(), unit_vectors.length);
+    unsigned int n_intensities = scan_in.get_intensities_size();
 
-    //Stuff the output cloud
+    //Stuff the output cloud, with room for every beam
     cloud_out.header = scan_in.header;
-    cloud_out.set_pts_size(scan_in.get_ranges_size());
-    if (scan_in.get_intensities_size() > 0)
+    cloud_out.set_pts_size(n_pts);
+    if (n_intensities > 0)
       {
         cloud_out.set_chan_size(2);
         cloud_out.chan[0].name ="intensities";
-        cloud_out.chan[0].set_vals_size(scan_in.get_intensities_size());
+        cloud_out.chan[0].set_vals_size(n_pts);
 
         cloud_out.chan[1].name = "index";
-        cloud_out.chan[1].set_vals_size(scan_in.get_ranges_size());
+        cloud_out.chan[1].set_vals_size(n_pts);
       }
-
-    double* outputMat = output.Store();
+    else
+      cloud_out.set_chan_size(0);
 
     if (range_cutoff < 0)
       range_cutoff = scan_in.range_max;
     else
       range_cutoff = std::min(range_cutoff, (double)scan_in.range_max); 
-    
+
+    // The ranges are floats, so comparing them to the cutoff rounded up to a float
+    // keeps the same beams as comparing them to the double cutoff
+    float cutoff = range_cutoff;
+    if (cutoff < range_cutoff)
+      cutoff = nextafterf(cutoff, INFINITY);
+    float range_min = scan_in.range_min;
+
+    const float* cos_table = n_pts > 0 ? &unit_vectors.cos_[0] : NULL;
+    const float* sin_table = n_pts > 0 ? &unit_vectors.sin_[0] : NULL;
+    const float* ranges = n_pts > 0 ? &scan_in.ranges[0] : NULL;
+
+    // Project, mask and fill the channels in one pass, four beams at a time
     unsigned int count = 0;
-    for (unsigned int index = 0; index< scan_in.get_ranges_size(); index++)
+    unsigned int index = 0;
+#if defined(__SSE__)
+    __m128 vcutoff = _mm_set1_ps(cutoff), vrange_min = _mm_set1_ps(range_min);
+    for (; index + 4 <= n_pts; index += 4)
     {
+      __m128 r = _mm_loadu_ps(ranges + index);
+      int mask = 0xf;
       if (!preservative) //Default behaviour will throw out invalid data
       {
-        if ((matPointer[index] < range_cutoff) &&
-            (matPointer[index] > scan_in.range_min)) //only valid
+        mask = _mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(r, vcutoff), _mm_cmpgt_ps(r, vrange_min)));
+        if (mask == 0)
+          continue;
+      }
+      float x[4], y[4];
+      _mm_storeu_ps(x, _mm_mul_ps(r, _mm_loadu_ps(cos_table + index)));
+      _mm_storeu_ps(y, _mm_mul_ps(r, _mm_loadu_ps(sin_table + index)));
+      for (unsigned int j = 0; j < 4; j++)
+      {
+        if (mask & (1 << j))
         {
-          cloud_out.pts[count].x = outputMat[index];
-          cloud_out.pts[count].y = outputMat[index + scan_in.get_ranges_size()];
-          cloud_out.pts[count].z = 0.0;
-
-          //write index to point cloud
-          cloud_out.chan[1].vals[count] = index;
-
-          if (scan_in.get_intensities_size() >= index){ /// \todo optimize and catch length difference better
-            cloud_out.chan[0].vals[count] = scan_in.intensities[index];
-          }
+          setPoint(cloud_out, count, x[j], y[j], scan_in, index + j, n_intensities);
           count++;
         }
       }
-      else //Keep all points
+    }
+#endif
+    for (; index < n_pts; index++)
+    {
+      float r = ranges[index];
+      if (preservative || (r < cutoff && r > range_min))
       {
-        cloud_out.pts[count].x = outputMat[index];
-        cloud_out.pts[count].y = outputMat[index + scan_in.get_ranges_size()];
-        cloud_out.pts[count].z = 0.0;
-
-        //write index to point cloud
-        cloud_out.chan[1].vals[count] = index;
-
-        if (scan_in.get_intensities_size() >= index){ /// \todo optimize and catch length difference better
-          cloud_out.chan[0].vals[count] = scan_in.intensities[index];
-        }
-
+        setPoint(cloud_out, count, r * cos_table[index], r * sin_table[index], scan_in, index, n_intensities);
         count++;
       }
-        
     }
 
     //downsize if necessary
@@ -114,7 +133,7 @@ namespace laser_scan{
     {
       cloud_out.chan.resize(0);
     }
-    else
+    else if (n_intensities > 0)
     {
       cloud_out.chan[0].set_vals_size(count);
       cloud_out.chan[1].set_vals_size(count);
@@ -122,26 +141,31 @@ namespace laser_scan{
  
   };
 
-  NEWMAT::Matrix& LaserProjection::getUnitVectors(float angle_min, float angle_max, float angle_increment)
+  const LaserProjection::UnitVectors& LaserProjection::getUnitVectors(float angle_min, float angle_max, float angle_increment)
   {
-    //construct string for lookup in the map
-    std::stringstream anglestring;
-    anglestring <<angle_min<<","<<angle_max<<","<<angle_increment;
-    std::map<string, NEWMAT::Matrix*>::iterator it;
-    it = unit_vector_map_.find(anglestring.str());
-    //check the map for presense
-    if (it != unit_vector_map_.end())
-      return *((*it).second);     //if present return
+    //look the configuration up by its angles, there are only ever a few of them
+    for (unsigned int i = 0; i < unit_vectors_.size(); i++)
+    {
+      const UnitVectors& unit_vectors = *unit_vectors_[i];
+      if (unit_vectors.angle_min == angle_min && unit_vectors.angle_max == angle_max &&
+          unit_vectors.angle_increment == angle_increment)
+        return unit_vectors;     //if present return
+    }
     //else calculate
-    unsigned int length = (unsigned int) round((angle_max - angle_min)/angle_increment) + 1; ///\todo Codify how this parameter will be calculated in all cases
-    NEWMAT::Matrix * tempPtr = new NEWMAT::Matrix(2,length);
-    for (unsigned int index = 0;index < length; index++)
+    UnitVectors * tempPtr = new UnitVectors;
+    tempPtr->angle_min = angle_min;
+    tempPtr->angle_max = angle_max;
+    tempPtr->angle_increment = angle_increment;
+    tempPtr->length = (unsigned int) round((angle_max - angle_min)/angle_increment) + 1; ///\todo Codify how this parameter will be calculated in all cases
+    tempPtr->cos_.resize(tempPtr->length);
+    tempPtr->sin_.resize(tempPtr->length);
+    for (unsigned int index = 0;index < tempPtr->length; index++)
       {
-        (*tempPtr)(1,index+1) = cos(angle_min + (double) index * angle_increment);
-        (*tempPtr)(2,index+1) = sin(angle_min + (double) index * angle_increment);
+        tempPtr->cos_[index] = cos(angle_min + (double) index * angle_increment);
+        tempPtr->sin_[index] = sin(angle_min + (double) index * angle_increment);
       }
     //store 
-    unit_vector_map_[anglestring.str()] = tempPtr;
+    unit_vectors_.push_back(tempPtr);
     //and return
     return *tempPtr;
   };
@@ -149,108 +173,116 @@ namespace laser_scan{
 
   LaserProjection::~LaserProjection()
   {
-    std::map<string, NEWMAT::Matrix*>::iterator it;
-    it = unit_vector_map_.begin();
-    while (it != unit_vector_map_.end())
-      {
-        delete (*it).second;
-        it++;
-      }
+    for (unsigned int i = 0; i < unit_vectors_.size(); i++)
+      delete unit_vectors_[i];
   };
 
 void LaserProjection::transformLaserScanToPointCloud(const std::string & target_frame, std_msgs::PointCloud & cloudOut, const std_msgs::LaserScan & scanIn,
                                                        tf::Transformer& tf)
 {
+  unsigned int n_pts = scanIn.get_ranges_size();
+  unsigned int n_intensities = scanIn.get_intensities_size();
+
   cloudOut.header = scanIn.header;
   cloudOut.header.frame_id = target_frame;
-  cloudOut.set_pts_size(scanIn.get_ranges_size());
-  if (scanIn.get_intensities_size() > 0)
+  cloudOut.set_pts_size(n_pts);
+  if (n_intensities > 0)
   {
     cloudOut.set_chan_size(2);
     cloudOut.chan[0].name ="intensities";
-    cloudOut.chan[0].set_vals_size(scanIn.get_intensities_size());
+    cloudOut.chan[0].set_vals_size(n_pts);
 
     cloudOut.chan[1].name ="index";
-    cloudOut.chan[1].set_vals_size(scanIn.get_ranges_size());
+    cloudOut.chan[1].set_vals_size(n_pts);
   }
+  else
+    cloudOut.set_chan_size(0);
 
-  tf::Stamped<tf::Point> pointIn;
-  tf::Stamped<tf::Point> pointOut;
-
-  pointIn.frame_id_ = scanIn.header.frame_id;
-
-  ///\todo this can be optimized
-  std_msgs::PointCloud intermediate; //optimize out
-
-  projectLaser(scanIn, intermediate, -1.0, true);
-
-  // Extract transforms for the beginning and end of the laser scan
+  // Extract transforms for the beginning and end of the laser scan, beam i is measured time_increment after beam i-1
   ros::Time start_time = scanIn.header.stamp ;
-  ros::Time end_time   = scanIn.header.stamp + ros::Duration().fromSec(scanIn.get_ranges_size()*scanIn.time_increment) ;
+  ros::Time end_time   = scanIn.header.stamp + ros::Duration().fromSec((n_pts > 0 ? n_pts - 1 : 0) * scanIn.time_increment) ;
 
   tf::Stamped<tf::Transform> start_transform ;
   tf::Stamped<tf::Transform> end_transform ;
-  tf::Stamped<tf::Transform> cur_transform ;
 
   tf.lookupTransform(target_frame, scanIn.header.frame_id, start_time, start_transform) ;
   tf.lookupTransform(target_frame, scanIn.header.frame_id, end_time, end_transform) ;
 
+  // Looking up transforms in tree per beam is too expensive. Instead, assume constant motion during the laser-scan:
+  // the translation is interpolated linearly and the rotation with slerp, both in closed form from the start and end transforms
+  btQuaternion q1, q2 ;
+  start_transform.getBasis().getRotation(q1) ;
+  end_transform.getBasis().getRotation(q2) ;
 
-  unsigned int count = 0;  
-  for (unsigned int i = 0; i < scanIn.get_ranges_size(); i++)
+  double x1 = q1.x(), y1 = q1.y(), z1 = q1.z(), w1 = q1.w();
+  double x2 = q2.x(), y2 = q2.y(), z2 = q2.z(), w2 = q2.w();
+  double cos_theta = x1 * x2 + y1 * y2 + z1 * z2 + w1 * w2;
+  if (cos_theta < 0.0) // q2 and -q2 are the same rotation, take the shorter way to it
   {
-    if (scanIn.ranges[i] < scanIn.range_max 
-        && scanIn.ranges[i] > scanIn.range_min) //only when valid
-    {
-      // Looking up transforms in tree is too expensive. Need more optimized way
-      /*
-         pointIn = tf::Stamped<tf::Point>(btVector3(intermediate.pts[i].x, intermediate.pts[i].y, intermediate.pts[i].z), 
-         ros::Time(scanIn.header.stamp.to_ull() + (uint64_t) (scanIn.time_increment * 1000000000)),
-         pointIn.frame_id_ = scanIn.header.frame_id);///\todo optimize to no copy
-         transformPoint(target_frame, pointIn, pointOut);
-         */
-
-      // Instead, assume constant motion during the laser-scan, and use slerp to compute intermediate transforms
-      btScalar ratio = i / ( (double) scanIn.get_ranges_size() - 1.0) ;
-
-      //! \todo Make a function that performs both the slerp and linear interpolation needed to interpolate a Full Transform (Quaternion + Vector)
-
-      //Interpolate translation
-      btVector3 v ;
-      v.setInterpolate3(start_transform.getOrigin(), end_transform.getOrigin(), ratio) ;
-      cur_transform.setOrigin(v) ;
-
-      //Interpolate rotation
-      btQuaternion q1, q2 ;
-      start_transform.getBasis().getRotation(q1) ;
-      end_transform.getBasis().getRotation(q2) ;
-
-      // Compute the slerp-ed rotation
-      cur_transform.setRotation( slerp( q1, q2 , ratio) ) ;
-
-      // Apply the transform to the current point
-      btVector3 pointIn(intermediate.pts[i].x, intermediate.pts[i].y, intermediate.pts[i].z) ;
-      btVector3 pointOut = cur_transform * pointIn ;
-
-      // Copy transformed point into cloud
-      cloudOut.pts[count].x  = pointOut.x();
-      cloudOut.pts[count].y  = pointOut.y();
-      cloudOut.pts[count].z  = pointOut.z();
+    x2 = -x2; y2 = -y2; z2 = -z2; w2 = -w2;
+    cos_theta = -cos_theta;
+  }
+  double theta = acos(std::min(cos_theta, 1.0));
+  double sin_theta = sin(theta);
+  bool lerp = sin_theta < 1e-6; // slerp and lerp agree when the rotation barely changes
+
+  const btVector3& origin1 = start_transform.getOrigin();
+  const btVector3& origin2 = end_transform.getOrigin();
+  double ox = origin1.x(), oy = origin1.y(), oz = origin1.z();
+  double dx = origin2.x() - ox, dy = origin2.y() - oy, dz = origin2.z() - oz;
+
+  // cos and sin of each beam angle
+  const UnitVectors& unit_vectors = getUnitVectors(scanIn.angle_min, scanIn.angle_max, scanIn.angle_increment);
+  n_pts = std::min(n_pts, unit_vectors.length);
+  const float* cos_table = n_pts > 0 ? &unit_vectors.cos_[0] : NULL;
+  const float* sin_table = n_pts > 0 ? &unit_vectors.sin_[0] : NULL;
+
+  double ratio_step = n_pts > 1 ? 1.0 / (n_pts - 1.0) : 0.0;
+  double range_min = scanIn.range_min, range_max = scanIn.range_max;
+
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < n_pts; i++)
+  {
+    double range = scanIn.ranges[i];
+    if (!(range < range_max && range > range_min)) //only when valid
+      continue;
 
-      //Copy index over from projected point cloud
-      cloudOut.chan[1].vals[count] = intermediate.chan[1].vals[i];
+    double ratio = i * ratio_step;
+    double a, b;
+    if (lerp)
+    {
+      a = 1.0 - ratio;
+      b = ratio;
+    }
+    else
+    {
+      a = sin((1.0 - ratio) * theta) / sin_theta;
+      b = sin(ratio * theta) / sin_theta;
+    }
+    double qx = a * x1 + b * x2, qy = a * y1 + b * y2, qz = a * z1 + b * z2, qw = a * w1 + b * w2;
+    double s = 2.0 / (qx * qx + qy * qy + qz * qz + qw * qw);
 
+    // The beam lies in the xy plane of the laser, so only the first two columns of the rotation are needed
+    double px = range * cos_table[i], py = range * sin_table[i];
+    cloudOut.pts[count].x = ox + dx * ratio + (1.0 - s * (qy * qy + qz * qz)) * px + s * (qx * qy - qw * qz) * py;
+    cloudOut.pts[count].y = oy + dy * ratio + s * (qx * qy + qw * qz) * px + (1.0 - s * (qx * qx + qz * qz)) * py;
+    cloudOut.pts[count].z = oz + dz * ratio + s * (qx * qz - qw * qy) * px + s * (qy * qz + qw * qx) * py;
 
-      if (scanIn.get_intensities_size() >= i) /// \todo optimize and catch length difference better
-        cloudOut.chan[0].vals[count] = scanIn.intensities[i];
-      count++;
+    if (n_intensities > 0)
+    {
+      cloudOut.chan[0].vals[count] = i < n_intensities ? scanIn.intensities[i] : 0.0;
+      cloudOut.chan[1].vals[count] = i;
     }
-
+    count++;
   }
+
   //downsize if necessary
   cloudOut.set_pts_size(count);
-  cloudOut.chan[0].set_vals_size(count);
-  cloudOut.chan[1].set_vals_size(count);
+  if (n_intensities > 0)
+  {
+    cloudOut.chan[0].set_vals_size(count);
+    cloudOut.chan[1].set_vals_size(count);
+  }
 }
 
 
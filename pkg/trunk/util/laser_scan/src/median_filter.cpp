@@ -36,8 +36,8 @@ LaserMedianFilter::LaserMedianFilter(unsigned int filter_length):
   filter_length_(filter_length),
   num_ranges_(1)
 {
-  range_filter_ = new MedianFilter<float>(filter_length_, num_ranges_);
-  intensity_filter_ = new MedianFilter<float>(filter_length_, num_ranges_);
+  range_filter_ = new SlidingMedianFilter<float>(filter_length_, num_ranges_);
+  intensity_filter_ = new SlidingMedianFilter<float>(filter_length_, num_ranges_);
 };
 
 LaserMedianFilter::~LaserMedianFilter()
@@ -59,8 +59,8 @@ bool LaserMedianFilter::update(const std_msgs::LaserScan& scan_in, std_msgs::Las
 
 
     num_ranges_ = scan_in.get_ranges_size();
-    range_filter_ = new MedianFilter<float>(filter_length_, num_ranges_);
-    intensity_filter_ = new MedianFilter<float>(filter_length_, num_ranges_);
+    range_filter_ = new SlidingMedianFilter<float>(filter_length_, num_ranges_);
+    intensity_filter_ = new SlidingMedianFilter<float>(filter_length_, num_ranges_);
     
   }
 
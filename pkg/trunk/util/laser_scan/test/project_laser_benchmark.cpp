@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file Throughput of LaserProjection::projectLaser against the projection with
+ * unit vectors stored as NEWMAT matrices under a string key, which it replaced.
+ * Scans of two configurations alternate, as from two lasers on one robot. */
+
+#include "laser_scan/laser_scan.h"
+#include <newmat10/newmat.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+const unsigned int SCAN_COUNT = 20000;
+
+double now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/** \brief The projection as it was, kept for comparison */
+class NewmatProjection
+{
+public:
+  ~NewmatProjection()
+  {
+    for (std::map<std::string, NEWMAT::Matrix*>::iterator it = unit_vector_map_.begin(); it != unit_vector_map_.end(); it++)
+      delete it->second;
+  }
+
+  void projectLaser(const std_msgs::LaserScan& scan_in, std_msgs::PointCloud & cloud_out, double range_cutoff)
+  {
+    NEWMAT::Matrix ranges(2, scan_in.get_ranges_size());
+    double * matPointer = ranges.Store();
+    for (unsigned int index = 0; index < scan_in.get_ranges_size(); index++)
+    {
+      matPointer[index] = (double) scan_in.ranges[index];
+      matPointer[index+scan_in.get_ranges_size()] = (double) scan_in.ranges[index];
+    }
+    NEWMAT::Matrix output = NEWMAT::SP(ranges, getUnitVectors(scan_in.angle_min, scan_in.angle_max, scan_in.angle_increment));
+
+    cloud_out.header = scan_in.header;
+    cloud_out.set_pts_size(scan_in.get_ranges_size());
+    cloud_out.set_chan_size(2);
+    cloud_out.chan[0].name ="intensities";
+    cloud_out.chan[0].set_vals_size(scan_in.get_intensities_size());
+    cloud_out.chan[1].name = "index";
+    cloud_out.chan[1].set_vals_size(scan_in.get_ranges_size());
+
+    double* outputMat = output.Store();
+    range_cutoff = std::min(range_cutoff, (double)scan_in.range_max);
+    unsigned int count = 0;
+    for (unsigned int index = 0; index< scan_in.get_ranges_size(); index++)
+    {
+      if ((matPointer[index] < range_cutoff) && (matPointer[index] > scan_in.range_min))
+      {
+        cloud_out.pts[count].x = outputMat[index];
+        cloud_out.pts[count].y = outputMat[index + scan_in.get_ranges_size()];
+        cloud_out.pts[count].z = 0.0;
+        cloud_out.chan[1].vals[count] = index;
+        cloud_out.chan[0].vals[count] = scan_in.intensities[index];
+        count++;
+      }
+    }
+    cloud_out.set_pts_size(count);
+    cloud_out.chan[0].set_vals_size(count);
+    cloud_out.chan[1].set_vals_size(count);
+  }
+
+private:
+  NEWMAT::Matrix& getUnitVectors(float angle_min, float angle_max, float angle_increment)
+  {
+    std::stringstream anglestring;
+    anglestring <<angle_min<<","<<angle_max<<","<<angle_increment;
+    std::map<std::string, NEWMAT::Matrix*>::iterator it = unit_vector_map_.find(anglestring.str());
+    if (it != unit_vector_map_.end())
+      return *it->second;
+    unsigned int length = (unsigned int) round((angle_max - angle_min)/angle_increment) + 1;
+    NEWMAT::Matrix * tempPtr = new NEWMAT::Matrix(2,length);
+    for (unsigned int index = 0;index < length; index++)
+    {
+      (*tempPtr)(1,index+1) = cos(angle_min + (double) index * angle_increment);
+      (*tempPtr)(2,index+1) = sin(angle_min + (double) index * angle_increment);
+    }
+    unit_vector_map_[anglestring.str()] = tempPtr;
+    return *tempPtr;
+  }
+
+  std::map<std::string, NEWMAT::Matrix*> unit_vector_map_;
+};
+
+/** A Hokuyo UTM-30LX scan for the base and a Hokuyo URG-04LX scan for the tilting laser */
+void fillScan(std_msgs::LaserScan& scan, bool base)
+{
+  unsigned int beams = base ? 1081 : 683;
+  scan.angle_min = base ? -0.75 * M_PI : -2.0862;
+  scan.angle_increment = base ? 1.5 * M_PI / (beams - 1) : 0.0061359;
+  scan.angle_max = scan.angle_min + (beams - 1) * scan.angle_increment;
+  scan.range_min = base ? 0.1 : 0.02;
+  scan.range_max = base ? 30.0 : 5.6;
+  scan.set_ranges_size(beams);
+  scan.set_intensities_size(beams);
+  for (unsigned int i = 0; i < beams; i++)
+  {
+    // a few beams with no return, and some out of range
+    scan.ranges[i] = rand() % 20 == 0 ? 0.0 : 0.01 + (scan.range_max + 1.0) * rand() / (double) RAND_MAX;
+    scan.intensities[i] = rand() % 1000;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  srand(0);
+  std_msgs::LaserScan scans[2];
+  fillScan(scans[0], true);
+  fillScan(scans[1], false);
+
+  laser_scan::LaserProjection projector;
+  NewmatProjection newmat_projector;
+  std_msgs::PointCloud cloud, newmat_cloud;
+
+  // the same points, indices and intensities
+  double error = 0.0;
+  unsigned int mismatches = 0;
+  for (unsigned int k = 0; k < 2; k++)
+  {
+    projector.projectLaser(scans[k], cloud, 4.0);
+    newmat_projector.projectLaser(scans[k], newmat_cloud, 4.0);
+    if (cloud.get_pts_size() != newmat_cloud.get_pts_size())
+    {
+      mismatches++;
+      continue;
+    }
+    for (unsigned int j = 0; j < cloud.get_pts_size(); j++)
+    {
+      error = std::max(error, (double) hypot(cloud.pts[j].x - newmat_cloud.pts[j].x, cloud.pts[j].y - newmat_cloud.pts[j].y));
+      if (cloud.chan[0].vals[j] != newmat_cloud.chan[0].vals[j] || cloud.chan[1].vals[j] != newmat_cloud.chan[1].vals[j])
+        mismatches++;
+    }
+  }
+
+  unsigned int beams = 0;
+  double start = now();
+  for (unsigned int k = 0; k < SCAN_COUNT; k++)
+  {
+    newmat_projector.projectLaser(scans[k % 2], newmat_cloud, 4.0);
+    beams += scans[k % 2].get_ranges_size();
+  }
+  double newmat_time = now() - start;
+
+  start = now();
+  for (unsigned int k = 0; k < SCAN_COUNT; k++)
+    projector.projectLaser(scans[k % 2], cloud, 4.0);
+  double time = now() - start;
+
+  printf("%u scans, %u beams\n", SCAN_COUNT, beams);
+  printf("NEWMAT unit vectors: %.4f ms per scan, %.1f Mbeams/s\n", newmat_time / SCAN_COUNT * 1e3, beams / newmat_time * 1e-6);
+  printf("float unit vectors:  %.4f ms per scan, %.1f Mbeams/s, %.1fx\n", time / SCAN_COUNT * 1e3, beams / time * 1e-6, newmat_time / time);
+  printf("%u mismatched points or channels, %.2e m largest distance\n", mismatches, error);
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file Benchmark for LaserProjection::transformLaserScanToPointCloud on
+ * 1081 beam scans at 40 Hz, as from a Hokuyo UTM-30LX, taken while the robot
+ * drives along an arc.  The points are checked against transforming each
+ * beam on its own through tf at the time it was measured. */
+
+#include "laser_scan/laser_scan.h"
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace tf;
+
+const unsigned int BEAM_COUNT = 1081;
+const double SCAN_RATE = 40.0;                 // Hz
+const double SCAN_STEPS = 1440.0;              // beam periods per revolution
+const unsigned int SCAN_COUNT = 400;           // ten seconds of scans
+const unsigned int CHECKED_SCAN_COUNT = 20;    // scans checked beam by beam through tf
+const double TF_RATE = 100.0;                  // Hz at which the odometry is published
+const double LINEAR_VELOCITY = 1.0;            // m/s
+const double ANGULAR_VELOCITY = 1.0;           // rad/s
+
+double now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+ros::Time stamp(double t)
+{
+  return ros::Time() + ros::Duration().fromSec(t);
+}
+
+/** Publish the robot driving along a circle, with the laser mounted ahead of the base */
+void fillTransforms(Transformer& tf, double duration)
+{
+  for (double t = 0.0; t <= duration; t += 1.0 / TF_RATE)
+  {
+    double yaw = ANGULAR_VELOCITY * t;
+    double radius = LINEAR_VELOCITY / ANGULAR_VELOCITY;
+    tf.setTransform(Stamped<btTransform>(btTransform(btQuaternion(yaw, 0, 0), btVector3(radius * sin(yaw), radius * (1.0 - cos(yaw)), 0)),
+                                         stamp(t), "base_link", "odom"));
+    tf.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0, 0, 0), btVector3(0.2, 0, 0.3)),
+                                         stamp(t), "laser", "base_link"));
+  }
+}
+
+void fillScan(std_msgs::LaserScan& scan, double t)
+{
+  scan.header.frame_id = "laser";
+  scan.header.stamp = stamp(t);
+  scan.angle_min = -0.75 * M_PI;
+  scan.angle_max = 0.75 * M_PI;
+  scan.angle_increment = 1.5 * M_PI / (BEAM_COUNT - 1);
+  scan.time_increment = 1.0 / SCAN_RATE / SCAN_STEPS;
+  scan.range_min = 0.1;
+  scan.range_max = 30.0;
+  scan.set_ranges_size(BEAM_COUNT);
+  scan.set_intensities_size(BEAM_COUNT);
+  for (unsigned int i = 0; i < BEAM_COUNT; i++)
+  {
+    // a few beams with no return
+    scan.ranges[i] = rand() % 20 == 0 ? 0.0 : 0.5 + 10.0 * rand() / (double) RAND_MAX;
+    scan.intensities[i] = rand() % 1000;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  srand(0);
+  Transformer tf(true, ros::Duration().fromSec(SCAN_COUNT / SCAN_RATE + 2.0));
+  fillTransforms(tf, SCAN_COUNT / SCAN_RATE + 1.0);
+
+  laser_scan::LaserProjection projector;
+  std_msgs::LaserScan scan;
+  std_msgs::PointCloud cloud;
+
+  double total = 0.0, longest = 0.0, error = 0.0;
+  unsigned int points = 0;
+  for (unsigned int k = 0; k < SCAN_COUNT; k++)
+  {
+    fillScan(scan, 0.5 + k / SCAN_RATE);
+
+    double start = now();
+    projector.transformLaserScanToPointCloud("odom", cloud, scan, tf);
+    double elapsed = now() - start;
+    total += elapsed;
+    longest = std::max(longest, elapsed);
+    points += cloud.get_pts_size();
+
+    if (k >= CHECKED_SCAN_COUNT)
+      continue;
+
+    // the same points, transforming each beam through tf at its own time
+    for (unsigned int j = 0; j < cloud.get_pts_size(); j++)
+    {
+      unsigned int i = (unsigned int) cloud.chan[1].vals[j];
+      double angle = scan.angle_min + i * scan.angle_increment;
+      Stamped<Point> beam(Point(scan.ranges[i] * cos(angle), scan.ranges[i] * sin(angle), 0.0),
+                          scan.header.stamp + ros::Duration().fromSec(i * scan.time_increment), "laser");
+      Stamped<Point> point;
+      tf.transformPoint("odom", beam, point);
+      error = std::max(error, (double) (point - Point(cloud.pts[j].x, cloud.pts[j].y, cloud.pts[j].z)).length());
+    }
+  }
+
+  printf("%u scans of %u beams, %.1f points per scan\n", SCAN_COUNT, BEAM_COUNT, points / (double) SCAN_COUNT);
+  printf("%.4f ms per scan, %.4f ms at most, %.3f%% of the %.0f Hz period\n",
+         total / SCAN_COUNT * 1e3, longest * 1e3, total / SCAN_COUNT * SCAN_RATE * 100.0, SCAN_RATE);
+  printf("%.2e m largest distance to the points transformed beam by beam\n", error);
+  return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A fixed-size latency histogram for realtime loops.
+ *
+ * Values are bucketed log-linearly (as in HdrHistogram): each power of
+ * two is split into 16 linear sub-buckets, so every recorded value is
+ * known to within 1/16 (6.25%) from 1 ns up to about 4 seconds, in
+ * under 2 KB and without any allocation.  record() is cheap enough to
+ * call several times per control cycle.
+ *
+ * One thread records; any thread may read.  Readers are not
+ * synchronized with the writer and may see a sample that is counted in
+ * a bucket but not yet in count(), which is fine for monitoring.
+ */
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+namespace misc_utils {
+
+class LatencyHistogram
+{
+public:
+  enum { SUB_BUCKET_BITS = 4, SUB_BUCKETS = 1 << SUB_BUCKET_BITS, MAX_BITS = 32,
+         NUM_BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS };
+
+  LatencyHistogram()
+  {
+    reset();
+  }
+
+  // Called from non-realtime while nothing is recording.
+  void reset()
+  {
+    memset(buckets_, 0, sizeof(buckets_));
+    count_ = 0;
+    sum_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+  }
+
+  // Records a duration given in seconds.  Negative durations count as 0.
+  void record(double seconds)
+  {
+    recordNsec(seconds > 0.0 ? (uint64_t)(seconds * 1e+9 + 0.5) : 0);
+  }
+
+  void recordNsec(uint64_t nsec)
+  {
+    ++buckets_[bucketIndex(nsec)];
+    sum_ += nsec;
+    if (nsec < min_) min_ = nsec;
+    if (nsec > max_) max_ = nsec;
+    ++count_;
+  }
+
+  uint64_t count() const { return count_; }
+  double min() const { return count_ ? min_ * 1e-9 : 0.0; }
+  double max() const { return max_ * 1e-9; }
+  double mean() const { return count_ ? (sum_ * 1e-9) / count_ : 0.0; }
+
+  // Returns, in seconds, the upper bound of the bucket holding the
+  // given fraction (0..1) of the samples.
+  double percentile(double fraction) const
+  {
+    uint64_t total = count_;
+    if (total == 0)
+      return 0.0;
+    uint64_t target = (uint64_t)(fraction * total + 0.5);
+    if (target < 1) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+      seen += buckets_[i];
+      if (seen >= target && i < NUM_BUCKETS - 1)
+      {
+        uint64_t upper = bucketLow(i + 1) - 1;
+        return (upper < max_ ? upper : max_) * 1e-9;
+      }
+    }
+    return max();
+  }
+
+  // Number of samples that took longer than the given number of seconds,
+  // rounded to bucket resolution.
+  uint64_t countAbove(double seconds) const
+  {
+    uint64_t n = 0;
+    for (int i = bucketIndex((uint64_t)(seconds * 1e+9)) + 1; i < NUM_BUCKETS; ++i)
+      n += buckets_[i];
+    return n;
+  }
+
+  // Writes the histogram in a plain text format meant for offline
+  // analysis:
+  //
+  //   histogram <name> <count> <min_ns> <max_ns> <sum_ns>
+  //   <bucket_low_ns> <bucket_high_ns> <samples>    (one line per non-empty bucket)
+  //   end
+  void dump(FILE *f, const char *name) const
+  {
+    fprintf(f, "histogram %s %llu %llu %llu %llu\n", name,
+            (unsigned long long)count_, (unsigned long long)(count_ ? min_ : 0),
+            (unsigned long long)max_, (unsigned long long)sum_);
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+      if (buckets_[i])
+        fprintf(f, "%llu %llu %u\n", (unsigned long long)bucketLow(i),
+                (unsigned long long)bucketLow(i + 1) - 1, buckets_[i]);
+    }
+    fprintf(f, "end\n");
+  }
+
+private:
+  static int bucketIndex(uint64_t nsec)
+  {
+    if (nsec >> MAX_BITS)
+      nsec = (1ULL << MAX_BITS) - 1;
+    if (nsec < SUB_BUCKETS)
+      return (int)nsec;
+    int shift = (63 - __builtin_clzll(nsec)) - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + (int)((nsec >> shift) - SUB_BUCKETS);
+  }
+
+  static uint64_t bucketLow(int index)
+  {
+    if (index < SUB_BUCKETS)
+      return index;
+    int shift = index / SUB_BUCKETS - 1;
+    return (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+  }
+
+  unsigned int buckets_[NUM_BUCKETS];
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_, max_;
+};
+
+}
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A lock-free alternative to RealtimePublisher.  The realtime thread
+ * owns one of three message buffers and fills it in place; publish()
+ * atomically swaps that buffer with the "ready" slot, so the realtime
+ * side never blocks, never fails and never copies the message.  The
+ * publishing thread polls the ready slot and publishes straight out of
+ * the buffer it swapped out, so signalling it costs the realtime thread
+ * a single atomic exchange rather than a syscall.
+ *
+ * Only one thread may call msg()/publish().  Messages published faster
+ * than the polling period are coalesced: the newest one wins.
+ *
+ * Because the realtime thread cycles through all three buffers, any
+ * field it does not rewrite on every publish (array sizes, names) must
+ * be set up with init() before the realtime loop starts.
+ */
+#ifndef REALTIME_TRIPLE_PUBLISHER_H
+#define REALTIME_TRIPLE_PUBLISHER_H
+
+#include <unistd.h>
+#include <string>
+#include <ros/node.h>
+#include <rosthread/member_thread.h>
+
+namespace misc_utils {
+
+template <class Msg>
+class RealtimeTriplePublisher
+{
+public:
+  RealtimeTriplePublisher(const std::string &topic, int queue_size, unsigned int poll_usec = 1000)
+    : topic_(topic), node_(NULL), is_running_(false), keep_running_(false), thread_(NULL),
+      poll_usec_(poll_usec), writing_(0), ready_(1), publishing_(2)
+  {
+    if ((node_ = ros::node::instance()) == NULL)
+    {
+      int argc = 0;  char **argv = NULL;
+      ros::init(argc, argv);
+      node_ = new ros::node("realtime_publisher", ros::node::DONT_HANDLE_SIGINT);
+    }
+
+    node_->advertise<Msg>(topic_, queue_size);
+
+    keep_running_ = true;
+    thread_ = ros::thread::member_thread::startMemberFunctionThread<RealtimeTriplePublisher<Msg> >
+      (this, &RealtimeTriplePublisher::publishingLoop);
+  }
+
+  ~RealtimeTriplePublisher()
+  {
+    stop();
+    while (is_running())
+      usleep(100);
+
+    // Don't unadvertise topic because other threads within the
+    // process may still be publishing on the topic
+  }
+
+  void stop()
+  {
+    keep_running_ = false;
+  }
+
+  // Called from non-realtime, before the realtime thread starts
+  // publishing.  Copies msg into all three buffers.
+  void init(const Msg &msg)
+  {
+    for (int i = 0; i < 3; ++i)
+      data_[i] = msg;
+  }
+
+  // Called from realtime.  The buffer to fill for the next publish().
+  Msg &msg()
+  {
+    return data_[writing_];
+  }
+
+  // Called from realtime.  Hands the current buffer to the publishing
+  // thread and takes over the previously ready one.
+  void publish()
+  {
+    writing_ = exchange(&ready_, writing_ | DIRTY) & INDEX;
+  }
+
+  bool is_running() const { return is_running_; }
+
+  void publishingLoop()
+  {
+    is_running_ = true;
+    while (keep_running_)
+    {
+      if (!(ready_ & DIRTY))
+      {
+        usleep(poll_usec_);
+        continue;
+      }
+
+      publishing_ = exchange(&ready_, publishing_) & INDEX;
+      if (keep_running_)
+        node_->publish(topic_, data_[publishing_]);
+    }
+    is_running_ = false;
+  }
+
+private:
+  // The index of a buffer plus a flag marking it as not yet published
+  enum { INDEX = 3, DIRTY = 4 };
+
+  // Atomically replaces *slot with value and returns the old value.
+  // The compare-and-swap is a full barrier, so the contents of the
+  // buffer being handed over are visible before its index is.
+  static int exchange(volatile int *slot, int value)
+  {
+    int old;
+    do {
+      old = *slot;
+    } while (!__sync_bool_compare_and_swap(slot, old, value));
+    return old;
+  }
+
+  std::string topic_;
+  ros::node *node_;
+  volatile bool is_running_;
+  volatile bool keep_running_;
+
+  pthread_t *thread_;
+  unsigned int poll_usec_;
+
+  // Each slot is owned by exactly one side at a time: writing_ by the
+  // realtime thread, publishing_ by the publishing thread, and ready_
+  // is exchanged between them.
+  Msg data_[3];
+  int writing_;
+  volatile int ready_;
+  int publishing_;
+};
+
+}
+
+#endif
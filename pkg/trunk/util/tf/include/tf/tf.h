@@ -112,6 +112,12 @@ public:
    */
   void lookupTransform(const std::string& target_frame, const std::string& source_frame, 
                        const ros::Time& time, Stamped<btTransform>& transform);
+  /** \brief Get the transform between two frames by frame number, as returned by getFrameNumber().
+   * This avoids the string lookups of the version above.  The transform for a pair of frames at a time
+   * is cached until data is set on one of the frames it was computed from, so repeated lookups do not 
+   * walk the tree again. */
+  void lookupTransform(unsigned int target_frame, unsigned int source_frame, 
+                       const ros::Time& time, Stamped<btTransform>& transform);
   //time traveling version
   void lookupTransform(const std::string& target_frame, const ros::Time& target_time, 
                        const std::string& source_frame, const ros::Time& source_time, 
@@ -138,6 +144,25 @@ public:
   /** \brief Transform a Stamped Pose into the target frame */
   void transformPose(const std::string& target_frame, const Stamped<tf::Pose>& stamped_in, Stamped<tf::Pose>& stamped_out);
 
+  /** \brief Transform an array of points from the source frame into the target frame, 
+   * looking up the transform once for all of them.  points_out may be points_in. */
+  void transformPoints(const std::string& target_frame, const std::string& source_frame, const ros::Time& time,
+                       const std::vector<tf::Point>& points_in, std::vector<tf::Point>& points_out);
+  /** \brief Transform an array of points between frames given by frame number */
+  void transformPoints(unsigned int target_frame, unsigned int source_frame, const ros::Time& time,
+                       const std::vector<tf::Point>& points_in, std::vector<tf::Point>& points_out);
+  /** \brief Transform an array of poses from the source frame into the target frame, 
+   * looking up the transform once for all of them.  poses_out may be poses_in. */
+  void transformPoses(const std::string& target_frame, const std::string& source_frame, const ros::Time& time,
+                      const std::vector<tf::Pose>& poses_in, std::vector<tf::Pose>& poses_out);
+  /** \brief Transform an array of poses between frames given by frame number */
+  void transformPoses(unsigned int target_frame, unsigned int source_frame, const ros::Time& time,
+                      const std::vector<tf::Pose>& poses_in, std::vector<tf::Pose>& poses_out);
+
+  /** \brief Apply a transform to count points, unrolled to plain arithmetic so the compiler can vectorize it.
+   * points_out may be points_in. */
+  static void transformPointArray(const btTransform& transform, const tf::Point* points_in, tf::Point* points_out, unsigned int count);
+
   /** \brief Transform a Stamped Quaternion into the target frame */
   void transformQuaternion(const std::string& target_frame, const ros::Time& target_time, 
                            const Stamped<tf::Quaternion>& stamped_in, 
@@ -180,6 +205,10 @@ public:
   /** \brief A way to get a std::vector of available frame ids */
   void getFrameStrings(std::vector<std::string>& ids);
 
+  /** \brief Get the number of a frame, for the frame number versions of lookupTransform, transformPoints and transformPoses.
+   * Numbers do not change for the life of the Transformer.  An unknown frame is allocated a new number. */
+  unsigned int getFrameNumber(const std::string& frame_id) { return lookupFrameNumber(frame_id); };
+
   /**@brief Fill the parent of a frame.  
    * @param frame_id The frame id of the frame in question
    * @param parent The reference to the string to fill the parent
@@ -225,6 +254,35 @@ protected:
   /// whether or not to allow extrapolation
   ros::Duration max_extrapolation_distance_;
 
+  /// A frame read while looking up a transform, and the generation of its cache it was read at
+  typedef std::pair<TimeCache*, unsigned int> FrameRead;
+
+  static const unsigned int TRANSFORM_CACHE_SIZE = 64; //!< Number of entries in transform_cache_, a power of two
+  static const unsigned int MAX_CACHED_FRAMES = 16; //!< Lookups which read more frames than this are not cached
+
+  /** \brief The last transform looked up between a pair of frames at a time.
+   * It stays valid while every frame read to compute it is at the same generation.  Entries are 
+   * written under transform_cache_mutex_ and read without locking under seq, like TimeCache. */
+  struct CachedTransform
+  {
+    volatile unsigned int seq; //!< odd while the entry is being written
+    unsigned int target_frame;
+    unsigned int source_frame;
+    ros::Time time;
+    unsigned int generation; //!< generation_ when the entry was written
+    unsigned int frame_count;
+    TimeCache* frames[MAX_CACHED_FRAMES];
+    unsigned int frame_generations[MAX_CACHED_FRAMES];
+    btTransform transform;
+  };
+
+  /// Transforms, direct mapped by (target, source) frame number
+  CachedTransform transform_cache_[TRANSFORM_CACHE_SIZE];
+  ros::thread::mutex transform_cache_mutex_; //!< serializes writers
+
+  /// Incremented by clear and setExtrapolationLimit, which change lookups without touching a frame's data
+  volatile unsigned int generation_;
+
 
   /************************* Internal Functions ****************************/
 
@@ -270,8 +328,23 @@ protected:
   };
 
 
-  /** Find the list of connected frames necessary to connect two different frames */
-  int lookupLists(unsigned int target_frame, ros::Time time, unsigned int source_frame, TransformLists & lists, std::string* error_string);
+  /** Return the latest rostime which is common across the spanning set, by frame number */
+  int getLatestCommonTime(unsigned int source, unsigned int dest, ros::Time& time);
+
+  /** Find the list of connected frames necessary to connect two different frames
+   * \param reads If not NULL, filled with every frame read on the way */
+  int lookupLists(unsigned int target_frame, ros::Time time, unsigned int source_frame, TransformLists & lists, std::string* error_string,
+                  std::vector<FrameRead>* reads = NULL);
+
+  /** Get the transform and stamp for a lookup by frame number, without setting the frame id */
+  void lookupTransformData(unsigned int target_frame, unsigned int source_frame, const ros::Time& time, Stamped<btTransform>& transform);
+
+  /** Fill transform from transform_cache_ if it holds a valid entry for the lookup */
+  bool getCachedTransform(unsigned int target_frame, unsigned int source_frame, const ros::Time& time, btTransform& transform);
+
+  /** Store a transform in transform_cache_, with the frames read to compute it */
+  void setCachedTransform(unsigned int target_frame, unsigned int source_frame, const ros::Time& time, unsigned int generation,
+                          const std::vector<FrameRead>& reads, const btTransform& transform);
 
   bool test_extrapolation(const ros::Time& target_time, const TransformLists& t_lists, std::string * error_string);
   
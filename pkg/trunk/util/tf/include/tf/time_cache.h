@@ -27,12 +27,14 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+
 /** \author Tully Foote */
 
 #ifndef TF_TIME_CACHE_H
 #define TF_TIME_CACHE_H
 
-#include <list>
+#include <set>
+#include <vector>
 #include "rosthread/mutex.h"
 #include "tf/transform_datatypes.h"
 #include "tf/exceptions.h"
@@ -56,79 +58,101 @@ public:
 };
 
 
-/** \brief A class to keep a sorted linked list in time
- * This builds and maintains a list of timestamped
- * data.  And provides lookup functions to get
- * data out as a function of time. */
+/** \brief A class to keep a sorted ring buffer in time
+ * This builds and maintains a ring buffer of timestamped
+ * data, oldest first.  And provides lookup functions to get
+ * data out as a function of time.
+ *
+ * Writers are serialized by a mutex.  Readers take no lock: they 
+ * binary search a snapshot of the buffer under a sequence counter, 
+ * and retry if a write overlapped.  Frame names are interned so that 
+ * the buffer only holds plain data which is safe to copy while it 
+ * may be overwritten. */
 class TimeCache
 {
  public:
   static const int MIN_INTERPOLATION_DISTANCE = 5; //!< Number of nano-seconds to not interpolate below.
-  static const unsigned int MAX_LENGTH_LINKED_LIST = 1000000; //!< Maximum length of linked list, to make sure not to be able to use unlimited memory.
+  static const unsigned int MAX_LENGTH_LINKED_LIST = 1000000; //!< Maximum number of transforms stored, to make sure not to be able to use unlimited memory.
+  static const unsigned int INITIAL_CAPACITY = 64; //!< Initial size of the ring buffer, doubled as needed
   static const int64_t DEFAULT_MAX_STORAGE_TIME = 1ULL * 1000000000LL; //!< default value of 10 seconds storage
   static const int64_t DEFAULT_MAX_EXTRAPOLATION_TIME = 0LL; //!< default max extrapolation of 0 nanoseconds \todo remove and make not optional??
 
 
   TimeCache(bool interpolating = true, ros::Duration  max_storage_time = ros::Duration().fromNSec(DEFAULT_MAX_STORAGE_TIME),
-            ros::Duration  max_extrapolation_time = ros::Duration().fromNSec(DEFAULT_MAX_EXTRAPOLATION_TIME)):
-    interpolating_(interpolating),
-    max_storage_time_(max_storage_time),
-    max_extrapolation_time_(max_extrapolation_time)
-    {};
+            ros::Duration  max_extrapolation_time = ros::Duration().fromNSec(DEFAULT_MAX_EXTRAPOLATION_TIME));
+  ~TimeCache();
 
 
-  bool getData(ros::Time time, TransformStorage & data_out); //returns false if data unavailable (should be thrown as lookup exception
+  /** \brief Get the data at a time, returns false if data unavailable (should be thrown as lookup exception)
+   * \param generation If not NULL, filled with the getGeneration() the data was read at */
+  bool getData(ros::Time time, TransformStorage & data_out, unsigned int* generation = NULL);
 
-  void insertData(const TransformStorage& new_data)
-    {
-      storage_lock_.lock();
-      std::list<TransformStorage >::iterator storage_it = storage_.begin();
-      while(storage_it != storage_.end())
-      {
-        if (storage_it->stamp_ <= new_data.stamp_)
-          break;
-        storage_it++;
-      }
-      storage_.insert(storage_it, new_data);
-      storage_lock_.unlock();
-
-      pruneList();
-    };
+  /** \brief A counter which changes whenever the contents of the cache change, odd while a write is in progress */
+  unsigned int getGeneration() { return seq_; };
+
+  void insertData(const TransformStorage& new_data);
 
 
   void interpolate(const TransformStorage& one, const TransformStorage& two, ros::Time time, TransformStorage& output);  //specific implementation for each T
 
 
-  void clearList() { storage_lock_.lock(); storage_.clear(); storage_lock_.unlock();};
+  void clearList();
 
  private:
-  std::list<TransformStorage > storage_;
+  /** \brief A transform as held in the ring buffer */
+  struct Slot
+  {
+    btTransform transform;
+    ros::Time stamp;
+    unsigned int parent_frame_id;
+    const std::string* frame_id;  //!< interned in names_
+    const std::string* parent_id; //!< interned in names_
+  };
+
+  /** \brief The ring buffer, replaced by a larger one when full */
+  struct Ring
+  {
+    Slot* slots;
+    unsigned int mask; //!< capacity - 1, capacity is a power of two
+  };
+
+  Ring* volatile ring_;
+  volatile unsigned int head_; //!< index of the oldest slot
+  volatile unsigned int size_;
+  volatile unsigned int seq_;  //!< odd while a write is in progress
+  std::vector<Ring*> retired_; //!< outgrown rings, kept for readers still in them
+  std::set<std::string> names_;
 
   bool interpolating_;
   ros::Duration max_storage_time_;
   ros::Duration max_extrapolation_time_;
 
-  ros::thread::mutex storage_lock_;
+  ros::thread::mutex storage_lock_; //!< serializes writers
 
   /// A helper function for getData
-  //Assumes storage is already locked for it
-  uint8_t findClosest(TransformStorage& one, TransformStorage& two, ros::Time target_time, ExtrapolationMode& mode);
+  //Reads the buffer without locking, the caller checks seq_ afterwards
+  uint8_t findClosest(Slot& one, Slot& two, ros::Time target_time, ExtrapolationMode& mode);
 
-  void pruneList()
-    {
-
-      storage_lock_.lock();
-      ros::Time latest_time = storage_.begin()->stamp_;
+  void slotToStorage(const Slot& slot, TransformStorage& data_out);
+  const std::string* intern(const std::string& name);
+  void grow();
 
-      while(!storage_.empty() && storage_.back().stamp_ + max_storage_time_ < latest_time)
-      {
-        storage_.pop_back();
-      }
+  /// Helpers for writers, which must hold storage_lock_
+  void writeBegin() { seq_ = seq_ + 1; __sync_synchronize(); };
+  void writeEnd() { __sync_synchronize(); seq_ = seq_ + 1; };
 
-      storage_lock_.unlock();
+  /// Helpers for readers
+  unsigned int readBegin()
+    {
+      unsigned int seq;
+      while ((seq = seq_) & 1)
+        ;
+      __sync_synchronize();
+      return seq;
     };
+  bool readRetry(unsigned int seq) { __sync_synchronize(); return seq != seq_; };
 
-
+  void pruneList();
 
 };
 
@@ -33,133 +33,236 @@
 
 using namespace tf;
 
-bool TimeCache::getData(ros::Time time, TransformStorage & data_out) //returns false if data not available
+TimeCache::TimeCache(bool interpolating, ros::Duration max_storage_time, ros::Duration max_extrapolation_time):
+  head_(0),
+  size_(0),
+  seq_(0),
+  interpolating_(interpolating),
+  max_storage_time_(max_storage_time),
+  max_extrapolation_time_(max_extrapolation_time)
 {
-  TransformStorage p_temp_1, p_temp_2;
+  ring_ = new Ring;
+  ring_->slots = new Slot[INITIAL_CAPACITY];
+  ring_->mask = INITIAL_CAPACITY - 1;
+};
+
+TimeCache::~TimeCache()
+{
+  Ring* ring = ring_;
+  retired_.push_back(ring);
+  for (unsigned int i = 0; i < retired_.size(); i++)
+  {
+    delete [] retired_[i]->slots;
+    delete retired_[i];
+  }
+};
+
+bool TimeCache::getData(ros::Time time, TransformStorage & data_out, unsigned int* generation) //returns false if data not available
+{
+  Slot p_temp_1, p_temp_2;
 
   int num_nodes;
-  ros::Duration time_diff;
-  storage_lock_.lock();
-  //  try
+  ExtrapolationMode mode;
+  unsigned int seq;
+  do
   {
-    ExtrapolationMode mode;
+    seq = readBegin();
     num_nodes = findClosest(p_temp_1,p_temp_2, time, mode);
-    if (num_nodes == 1)
+  } while (readRetry(seq));
+
+  if (generation)
+    *generation = seq;
+
+  // The copies are consistent, and the names they point to are never freed
+  if (num_nodes == 1)
+  {
+    slotToStorage(p_temp_1, data_out);
+    data_out.mode_ = mode;
+  }
+  else if (num_nodes == 2)
+  {
+    if(interpolating_ && ( p_temp_1.parent_frame_id == p_temp_2.parent_frame_id) ) // if we're interpolating and haven't reparented
     {
-      data_out = p_temp_1;
+      TransformStorage one, two;
+      slotToStorage(p_temp_1, one);
+      slotToStorage(p_temp_2, two);
+      interpolate(one, two, time, data_out);
       data_out.mode_ = mode;
     }
-    else if (num_nodes == 2)
+    else
     {
-      if(interpolating_ && ( p_temp_1.parent_frame_id == p_temp_2.parent_frame_id) ) // if we're interpolating and haven't reparented
-      {
-        interpolate(p_temp_1, p_temp_2, time, data_out);
-        data_out.mode_ = mode;
-      }
-      else
-       {
-         data_out = p_temp_1;
-         data_out.mode_ = mode;
-       }
-
-        
+      slotToStorage(p_temp_1, data_out);
+      data_out.mode_ = mode;
     }
   }
-  /*  //  catch (TFException &ex)
-  catch (...)
-  {
-    storage_lock_.unlock();
-    throw;
-  }
-  */
-  storage_lock_.unlock();
     
   return (num_nodes > 0);
 
 };
 
 
-uint8_t TimeCache::findClosest(TransformStorage& one, TransformStorage& two, ros::Time target_time, ExtrapolationMode& mode)
+uint8_t TimeCache::findClosest(Slot& one, Slot& two, ros::Time target_time, ExtrapolationMode& mode)
 {
+  // Snapshot of the buffer; indices are masked so a torn read stays in bounds
+  Ring* ring = ring_;
+  unsigned int head = head_;
+  unsigned int size = size_;
+  Slot* slots = ring->slots;
+  unsigned int mask = ring->mask;
+  if (size > mask + 1)
+    size = mask + 1;
+
   //No values stored
-  if (storage_.empty())
+  if (size == 0)
   {
     return 0;
   }
 
   //If time == 0 return the latest
-  if (target_time == ros::Time())
+  //One value stored
+  if (target_time == ros::Time() || size == 1)
   {
-    one = storage_.front();
-    mode = ONE_VALUE;
-    return 1;
-  }
-
-  // One value stored
-  if (++storage_.begin() == storage_.end())
-  {
-    one = *(storage_.begin());
+    one = slots[(head + size - 1) & mask];
     mode = ONE_VALUE;
     return 1;
   }
 
   //At least 2 values stored
-  //Find the first value less than the target value
-  std::list<TransformStorage >::iterator storage_it = storage_.begin();
-  while(storage_it != storage_.end())
+  //Count the values no newer than the target, by binary search
+  unsigned int low = 0, high = size;
+  while (low < high)
   {
-    if (storage_it->stamp_ <= target_time)
-      break;
-    storage_it++;
+    unsigned int mid = (low + high) / 2;
+    if (slots[(head + mid) & mask].stamp <= target_time)
+      low = mid + 1;
+    else
+      high = mid;
   }
-  //Catch the case it is the first value in the list
-  if (storage_it == storage_.begin())
+
+  //Catch the case it is newer than all values
+  if (low == size)
   {
-    one = *storage_it;
-    two = *(++storage_it);
+    one = slots[(head + size - 1) & mask];
+    two = slots[(head + size - 2) & mask];
     mode = EXTRAPOLATE_FORWARD;
-
-    /*    if (time_diff > max_extrapolation_time_) //Guarenteed in the future therefore positive
-    {
-      std::stringstream ss;
-      ss << "Extrapolation Too Far in the future: target_time = "<< (target_time).to_double() <<", closest data at "
-         << (one.stamp_).to_double() << " and " << (two.stamp_).to_double() <<" which are farther away than max_extrapolation_time "
-         << (max_extrapolation_time_).to_double() <<" at "<< (target_time - one.stamp_).to_double()<< " and " << (target_time - two.stamp_).to_double() <<" respectively.";
-      throw ExtrapolationException(ss.str());
-    }
-    */
     return 2;
   }
 
   //Catch the case where it's in the past
-  if (storage_it == storage_.end())
+  if (low == 0)
   {
-    one = *(--storage_it);
-    two = *(--storage_it);
+    one = slots[head & mask];
+    two = slots[(head + 1) & mask];
     mode = EXTRAPOLATE_BACK;
-    /*
-      time_diff = target_time - one.stamp_;
-    if (time_diff < ros::Duration()-max_extrapolation_time_) //Guarenteed in the past ///\todo check negative sign
-    {
-      std::stringstream ss;
-      ss << "Extrapolation Too Far in the past: target_time = "<< (target_time).to_double() <<", closest data at "
-         << (one.stamp_).to_double() << " and " << (two.stamp_).to_double() <<" which are farther away than max_extrapolation_time "
-         << (max_extrapolation_time_).to_double() <<" at "<< (target_time - one.stamp_).to_double()<< " and " << (target_time - two.stamp_).to_double() <<" respectively."; //sign flip since in the past
-      throw ExtrapolationException(ss.str());
-    }
-    */
     return 2;
   }
 
   //Finally the case were somewhere in the middle  Guarenteed no extrapolation :-)
-  one = *(storage_it); //Older
-  two = *(--storage_it); //Newer
+  one = slots[(head + low - 1) & mask]; //Older
+  two = slots[(head + low) & mask]; //Newer
   mode = INTERPOLATE;
   return 2;
 
 
 };
 
+void TimeCache::insertData(const TransformStorage& new_data)
+{
+  storage_lock_.lock();
+
+  Slot slot;
+  slot.transform = new_data;
+  slot.stamp = new_data.stamp_;
+  slot.parent_frame_id = new_data.parent_frame_id;
+  slot.frame_id = intern(new_data.frame_id_);
+  slot.parent_id = intern(new_data.parent_id_);
+
+  writeBegin();
+
+  if (size_ > ring_->mask)
+  {
+    if (size_ < MAX_LENGTH_LINKED_LIST)
+      grow();
+    else // Full, drop the oldest
+    {
+      head_ = head_ + 1;
+      size_ = size_ - 1;
+    }
+  }
+
+  // Data almost always arrives in order, so look for the place from the newest end
+  Slot* slots = ring_->slots;
+  unsigned int mask = ring_->mask;
+  unsigned int pos = size_;
+  while (pos > 0 && slots[(head_ + pos - 1) & mask].stamp > slot.stamp)
+  {
+    slots[(head_ + pos) & mask] = slots[(head_ + pos - 1) & mask];
+    pos--;
+  }
+  slots[(head_ + pos) & mask] = slot;
+  size_ = size_ + 1;
+
+  pruneList();
+
+  writeEnd();
+
+  storage_lock_.unlock();
+};
+
+void TimeCache::clearList()
+{
+  storage_lock_.lock();
+  writeBegin();
+  head_ = 0;
+  size_ = 0;
+  writeEnd();
+  storage_lock_.unlock();
+};
+
+void TimeCache::pruneList()
+{
+  Slot* slots = ring_->slots;
+  unsigned int mask = ring_->mask;
+  ros::Time latest_time = slots[(head_ + size_ - 1) & mask].stamp;
+
+  while(size_ > 0 && slots[head_ & mask].stamp + max_storage_time_ < latest_time)
+  {
+    head_ = head_ + 1;
+    size_ = size_ - 1;
+  }
+};
+
+void TimeCache::grow()
+{
+  Ring* old = ring_;
+  Ring* ring = new Ring;
+  unsigned int capacity = 2 * (old->mask + 1);
+  ring->slots = new Slot[capacity];
+  ring->mask = capacity - 1;
+  for (unsigned int i = 0; i < size_; i++)
+    ring->slots[i] = old->slots[(head_ + i) & old->mask];
+
+  // Readers may still be copying from the old ring
+  retired_.push_back(old);
+  __sync_synchronize();
+  ring_ = ring;
+  head_ = 0;
+};
+
+const std::string* TimeCache::intern(const std::string& name)
+{
+  return &*names_.insert(name).first;
+};
+
+void TimeCache::slotToStorage(const Slot& slot, TransformStorage& data_out)
+{
+  data_out.setData(slot.transform);
+  data_out.stamp_ = slot.stamp;
+  data_out.frame_id_ = *slot.frame_id;
+  data_out.parent_id_ = *slot.parent_id;
+  data_out.parent_frame_id = slot.parent_frame_id;
+};
+
 void TimeCache::interpolate(const TransformStorage& one, const TransformStorage& two, ros::Time time, TransformStorage& output)
 { 
 
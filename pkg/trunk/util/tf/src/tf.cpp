@@ -36,13 +36,21 @@ using namespace tf;
 Transformer::Transformer(bool interpolating,
                                 ros::Duration cache_time):
   cache_time(cache_time),
-  interpolating (interpolating)
+  interpolating (interpolating),
+  generation_(0)
 {
   max_extrapolation_distance_.fromNSec(DEFAULT_MAX_EXTRAPOLATION_DISTANCE);
   frameIDs_["NO_PARENT"] = 0;
   frames_.push_back(NULL);// new TimeCache(interpolating, cache_time, max_extrapolation_distance));//unused but needed for iteration over all elements
   frameIDs_reverse.push_back("NO_PARENT");
 
+  // Entries with no time never match, as latest common time lookups are not cached
+  for (unsigned int i = 0; i < TRANSFORM_CACHE_SIZE; i++)
+  {
+    transform_cache_[i].seq = 0;
+    transform_cache_[i].frame_count = 0;
+  }
+
   return;
 }
 
@@ -69,6 +77,7 @@ void Transformer::clear()
       (*cache_it)->clearList();
     }
   }
+  __sync_fetch_and_add(&generation_, 1);
   frame_mutex_.unlock();
 }
 
@@ -82,6 +91,31 @@ void Transformer::setTransform(const Stamped<btTransform>& transform)
 void Transformer::lookupTransform(const std::string& target_frame, const std::string& source_frame,
                      const ros::Time& time, Stamped<btTransform>& transform)
 {
+  lookupTransformData(lookupFrameNumber(target_frame), lookupFrameNumber(source_frame), time, transform);
+  transform.frame_id_ = target_frame;
+};
+
+void Transformer::lookupTransform(unsigned int target_frame, unsigned int source_frame,
+                     const ros::Time& time, Stamped<btTransform>& transform)
+{
+  lookupTransformData(target_frame, source_frame, time, transform);
+  transform.frame_id_ = lookupFrameString(target_frame);
+};
+
+void Transformer::lookupTransformData(unsigned int target_frame, unsigned int source_frame,
+                     const ros::Time& time, Stamped<btTransform>& transform)
+{
+  // Latest common time lookups depend on ros::Time::now() so are not cached
+  if (time != ros::Time() && getCachedTransform(target_frame, source_frame, time, transform))
+  {
+    transform.stamp_ = time;
+    return;
+  }
+
+  // Read before the lookup, so a clear or new extrapolation limit during it leaves the entry stale
+  unsigned int generation = generation_;
+  __sync_synchronize();
+
   int retval = NO_ERROR;
   ros::Time temp_time;
   //If getting the latest get the latest common time
@@ -92,9 +126,10 @@ void Transformer::lookupTransform(const std::string& target_frame, const std::st
 
   std::string error_string;
   TransformLists t_list;
+  std::vector<FrameRead> reads;
 
   if (retval == NO_ERROR)
-    retval = lookupLists(lookupFrameNumber( target_frame), temp_time, lookupFrameNumber( source_frame), t_list, &error_string);
+    retval = lookupLists(target_frame, temp_time, source_frame, t_list, &error_string, &reads);
 
   ///\todo WRITE HELPER FUNCITON TO RETHROW
   if (retval != NO_ERROR)
@@ -111,8 +146,71 @@ void Transformer::lookupTransform(const std::string& target_frame, const std::st
 
   transform.setData( computeTransformFromList(t_list));
   transform.stamp_ = temp_time;
-  transform.frame_id_ = target_frame;
 
+  if (time != ros::Time())
+    setCachedTransform(target_frame, source_frame, time, generation, reads, transform);
+};
+
+bool Transformer::getCachedTransform(unsigned int target_frame, unsigned int source_frame, const ros::Time& time, btTransform& transform)
+{
+  const CachedTransform& entry = transform_cache_[(target_frame * 31 + source_frame) & (TRANSFORM_CACHE_SIZE - 1)];
+
+  // Copy the entry out, then check that no writer overlapped the copy
+  unsigned int seq = entry.seq;
+  if (seq & 1)
+    return false;
+  __sync_synchronize();
+  bool hit = entry.target_frame == target_frame && entry.source_frame == source_frame && entry.time == time
+    && entry.generation == generation_;
+  unsigned int frame_count = entry.frame_count;
+  TimeCache* frames[MAX_CACHED_FRAMES];
+  unsigned int frame_generations[MAX_CACHED_FRAMES];
+  if (frame_count > MAX_CACHED_FRAMES)
+    hit = false;
+  for (unsigned int i = 0; hit && i < frame_count; i++)
+  {
+    frames[i] = entry.frames[i];
+    frame_generations[i] = entry.frame_generations[i];
+  }
+  btTransform cached = entry.transform;
+  __sync_synchronize();
+  if (!hit || seq != entry.seq)
+    return false;
+
+  // Any data set on a frame the lookup read may change its result
+  for (unsigned int i = 0; i < frame_count; i++)
+    if (frames[i]->getGeneration() != frame_generations[i])
+      return false;
+
+  transform = cached;
+  return true;
+};
+
+void Transformer::setCachedTransform(unsigned int target_frame, unsigned int source_frame, const ros::Time& time, unsigned int generation,
+                                     const std::vector<FrameRead>& reads, const btTransform& transform)
+{
+  if (reads.size() > MAX_CACHED_FRAMES)
+    return;
+
+  CachedTransform& entry = transform_cache_[(target_frame * 31 + source_frame) & (TRANSFORM_CACHE_SIZE - 1)];
+
+  transform_cache_mutex_.lock();
+  entry.seq = entry.seq + 1;
+  __sync_synchronize();
+  entry.target_frame = target_frame;
+  entry.source_frame = source_frame;
+  entry.time = time;
+  entry.generation = generation;
+  entry.frame_count = reads.size();
+  for (unsigned int i = 0; i < reads.size(); i++)
+  {
+    entry.frames[i] = reads[i].first;
+    entry.frame_generations[i] = reads[i].second;
+  }
+  entry.transform = transform;
+  __sync_synchronize();
+  entry.seq = entry.seq + 1;
+  transform_cache_mutex_.unlock();
 };
 
 void Transformer::lookupTransform(const std::string& target_frame,const ros::Time& target_time, const std::string& source_frame,
@@ -262,14 +360,20 @@ bool Transformer::getParent(const std::string& frame_id, ros::Time time, std::st
 void Transformer::setExtrapolationLimit(const ros::Duration& distance)
 {
   max_extrapolation_distance_ = distance;
+  __sync_fetch_and_add(&generation_, 1);
 }
 
 int Transformer::getLatestCommonTime(const std::string& source, const std::string& dest, ros::Time & time)
+{
+  return getLatestCommonTime(lookupFrameNumber(source), lookupFrameNumber(dest), time);
+};
+
+int Transformer::getLatestCommonTime(unsigned int source, unsigned int dest, ros::Time & time)
 {
   time = ros::Time::now();///\todo hack fixme
   int retval;
   TransformLists lists;
-  retval = lookupLists(lookupFrameNumber(dest), ros::Time(), lookupFrameNumber(source), lists, NULL);
+  retval = lookupLists(dest, ros::Time(), source, lists, NULL);
   if (retval == NO_ERROR)
   {
     for (unsigned int i = 0; i < lists.inverseTransforms.size(); i++)
@@ -293,7 +397,8 @@ int Transformer::getLatestCommonTime(const std::string& source, const std::strin
 
 
 
-int Transformer::lookupLists(unsigned int target_frame, ros::Time time, unsigned int source_frame, TransformLists& lists, std::string * error_string)
+int Transformer::lookupLists(unsigned int target_frame, ros::Time time, unsigned int source_frame, TransformLists& lists, std::string * error_string,
+                             std::vector<FrameRead>* reads)
 {
   /*  timeval tempt;
   gettimeofday(&tempt,NULL);
@@ -326,7 +431,10 @@ int Transformer::lookupLists(unsigned int target_frame, ros::Time time, unsigned
       TimeCache* pointer = getFrame(frame);
       ROS_ASSERT(pointer);
 
-      if (! pointer->getData(time, temp))
+      unsigned int generation;
+      bool found = pointer->getData(time, temp, &generation);
+      if (reads) reads->push_back(FrameRead(pointer, generation));
+      if (! found)
       {
         last_inverse = frame;
         // this is thrown when there is no data
@@ -378,7 +486,10 @@ int Transformer::lookupLists(unsigned int target_frame, ros::Time time, unsigned
       ROS_ASSERT(pointer);
 
 
-      if(!  pointer->getData(time, temp))
+      unsigned int generation;
+      bool found = pointer->getData(time, temp, &generation);
+      if (reads) reads->push_back(FrameRead(pointer, generation));
+      if(! found)
       {
         last_forward = frame;
         break;
@@ -454,7 +565,7 @@ int Transformer::lookupLists(unsigned int target_frame, ros::Time time, unsigned
       return CONNECTIVITY_ERROR;//throw(ConnectivityException(ss.str()));
     }
 
-    if (lookupFrameNumber(lists.inverseTransforms.back().parent_id_) != target_frame)
+    if (lists.inverseTransforms.back().parent_frame_id != target_frame)
     {
       std::stringstream ss;
       ss<< "No Common ParentA between "<< lookupFrameString(target_frame) <<" and " << lookupFrameString(source_frame)  << std::endl << allFramesAsString() << std::endl << lists.inverseTransforms.back().parent_id_ << std::endl;
@@ -477,7 +588,7 @@ int Transformer::lookupLists(unsigned int target_frame, ros::Time time, unsigned
     return CONNECTIVITY_ERROR;//    throw(ConnectivityException(ss.str()));
   }
   /* Make sure that we don't have a no parent at the top */
-  if (lookupFrameNumber(lists.inverseTransforms.back().frame_id_) == 0 || lookupFrameNumber( lists.forwardTransforms.back().frame_id_) == 0)
+  if (lists.inverseTransforms.back().frame_id_ == "NO_PARENT" || lists.forwardTransforms.back().frame_id_ == "NO_PARENT")
   {
     if (error_string) *error_string = "NO_PARENT at top of tree";
     return CONNECTIVITY_ERROR;//    throw(ConnectivityException("NO_PARENT at top of tree"));
@@ -487,7 +598,8 @@ int Transformer::lookupLists(unsigned int target_frame, ros::Time time, unsigned
   std::cerr << "Base Cases done" <<tempt.tv_sec * 1000000LL + tempt.tv_usec- tempt2.tv_sec * 1000000LL - tempt2.tv_usec << std::endl;
   */
 
-  while (lookupFrameNumber(lists.inverseTransforms.back().frame_id_) == lookupFrameNumber(lists.forwardTransforms.back().frame_id_))
+  // Frame ids are unique per frame number, so compare them directly rather than through the frame map
+  while (lists.inverseTransforms.back().frame_id_ == lists.forwardTransforms.back().frame_id_)
   {
       lists.inverseTransforms.pop_back();
       lists.forwardTransforms.pop_back();
@@ -766,6 +878,59 @@ void Transformer::transformPose(const std::string& target_frame, const Stamped<P
   //  stamped_out.parent_id_ = stamped_in.parent_id_;//only useful for transforms
 };
 
+void Transformer::transformPointArray(const btTransform& transform, const Point* points_in, Point* points_out, unsigned int count)
+{
+  // Pull the transform apart into scalars so the loop body is plain arithmetic with no aliasing through btTransform
+  const btMatrix3x3& basis = transform.getBasis();
+  const btVector3& origin = transform.getOrigin();
+  const btScalar m00 = basis[0].x(), m01 = basis[0].y(), m02 = basis[0].z();
+  const btScalar m10 = basis[1].x(), m11 = basis[1].y(), m12 = basis[1].z();
+  const btScalar m20 = basis[2].x(), m21 = basis[2].y(), m22 = basis[2].z();
+  const btScalar ox = origin.x(), oy = origin.y(), oz = origin.z();
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const btScalar x = points_in[i].x(), y = points_in[i].y(), z = points_in[i].z();
+    points_out[i].setValue(m00 * x + m01 * y + m02 * z + ox,
+                           m10 * x + m11 * y + m12 * z + oy,
+                           m20 * x + m21 * y + m22 * z + oz);
+  }
+};
+
+void Transformer::transformPoints(const std::string& target_frame, const std::string& source_frame, const ros::Time& time,
+                                  const std::vector<Point>& points_in, std::vector<Point>& points_out)
+{
+  transformPoints(lookupFrameNumber(target_frame), lookupFrameNumber(source_frame), time, points_in, points_out);
+};
+
+void Transformer::transformPoints(unsigned int target_frame, unsigned int source_frame, const ros::Time& time,
+                                  const std::vector<Point>& points_in, std::vector<Point>& points_out)
+{
+  Stamped<Transform> transform;
+  lookupTransform(target_frame, source_frame, time, transform);
+
+  points_out.resize(points_in.size());
+  if (!points_in.empty())
+    transformPointArray(transform, &points_in[0], &points_out[0], points_in.size());
+};
+
+void Transformer::transformPoses(const std::string& target_frame, const std::string& source_frame, const ros::Time& time,
+                                 const std::vector<Pose>& poses_in, std::vector<Pose>& poses_out)
+{
+  transformPoses(lookupFrameNumber(target_frame), lookupFrameNumber(source_frame), time, poses_in, poses_out);
+};
+
+void Transformer::transformPoses(unsigned int target_frame, unsigned int source_frame, const ros::Time& time,
+                                 const std::vector<Pose>& poses_in, std::vector<Pose>& poses_out)
+{
+  Stamped<Transform> transform;
+  lookupTransform(target_frame, source_frame, time, transform);
+
+  poses_out.resize(poses_in.size());
+  for (unsigned int i = 0; i < poses_in.size(); i++)
+    poses_out[i] = transform * poses_in[i];
+};
+
 
 void Transformer::transformQuaternion(const std::string& target_frame, const ros::Time& target_time,
                                       const Stamped<Quaternion>& stamped_in,
@@ -137,24 +137,17 @@ void TransformListener::transformPointCloud(const std::string& target_frame, con
 
 void TransformListener::transformPointCloud(const std::string & target_frame, const Transform& net_transform, const ros::Time& target_time, const std_msgs::PointCloud & cloudIn, std_msgs::PointCloud & cloudOut)
 {
-  NEWMAT::Matrix transform = transformAsMatrix(net_transform);
+  // Apply the transform directly to each point, rather than building 4xN matrices.  Each point is read
+  // completely before it is written, so this is safe when cloudIn and cloudOut are the same cloud.
+  const btMatrix3x3& basis = net_transform.getBasis();
+  const btVector3& origin = net_transform.getOrigin();
+  const double m00 = basis[0].x(), m01 = basis[0].y(), m02 = basis[0].z();
+  const double m10 = basis[1].x(), m11 = basis[1].y(), m12 = basis[1].z();
+  const double m20 = basis[2].x(), m21 = basis[2].y(), m22 = basis[2].z();
+  const double ox = origin.x(), oy = origin.y(), oz = origin.z();
 
   unsigned int length = cloudIn.get_pts_size();
 
-  NEWMAT::Matrix matIn(4, length);
-
-  double * matrixPtr = matIn.Store();
-
-  for (unsigned int i = 0; i < length ; i++)
-  {
-    matrixPtr[i] = cloudIn.pts[i].x;
-    matrixPtr[length +i] = cloudIn.pts[i].y;
-    matrixPtr[2 * length + i] = cloudIn.pts[i].z;
-    matrixPtr[3 * length + i] = 1;
-  };
-
-  NEWMAT::Matrix matOut = transform * matIn;
-
   // Copy relevant data from cloudIn, if needed
   if (&cloudIn != &cloudOut)
   {
@@ -165,16 +158,15 @@ void TransformListener::transformPointCloud(const std::string & target_frame, co
       cloudOut.chan[i] = cloudIn.chan[i];
   }
 
-  matrixPtr = matOut.Store();
-
   //Override the positions
   cloudOut.header.stamp = target_time;
   cloudOut.header.frame_id = target_frame;
   for (unsigned int i = 0; i < length ; i++)
   {
-    cloudOut.pts[i].x = matrixPtr[i];
-    cloudOut.pts[i].y = matrixPtr[1*length + i];
-    cloudOut.pts[i].z = matrixPtr[2*length + i];
+    const double x = cloudIn.pts[i].x, y = cloudIn.pts[i].y, z = cloudIn.pts[i].z;
+    cloudOut.pts[i].x = m00 * x + m01 * y + m02 * z + ox;
+    cloudOut.pts[i].y = m10 * x + m11 * y + m12 * z + oy;
+    cloudOut.pts[i].z = m20 * x + m21 * y + m22 * z + oz;
   };
 }
 
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** \file Contention benchmark for TimeCache: one thread inserting transforms
+ * while several threads look them up.  Each reader count is run with the 
+ * lock-free reader path, and with every lookup serialized through a mutex, 
+ * as the reader path used to be. */
+
+#include <tf/tf.h>
+#include <boost/thread.hpp>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace tf;
+
+const double RUN_TIME = 1.0; // seconds per configuration
+const uint64_t INSERT_PERIOD = 1000000; // nanoseconds between stamps, and between inserts: 1 kHz
+
+double now()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+struct Benchmark
+{
+  TimeCache cache;
+  volatile bool running;
+  volatile uint64_t latest;
+  bool serialize;
+  boost::mutex lookup_lock;
+
+  Benchmark(bool serialize_lookups) : cache(true, ros::Duration().fromNSec(1000 * INSERT_PERIOD)),
+                                      running(true), latest(0), serialize(serialize_lookups) {};
+
+  void write()
+  {
+    TransformStorage stor;
+    stor.setIdentity();
+    stor.frame_id_ = "base_link";
+    stor.parent_id_ = "odom";
+    stor.parent_frame_id = 1;
+    while (running)
+    {
+      uint64_t stamp = latest + INSERT_PERIOD;
+      stor.setOrigin(btVector3((double)stamp, 0, 0));
+      stor.stamp_ = stamp;
+      cache.insertData(stor);
+      latest = stamp;
+      if (stamp > 2000 * INSERT_PERIOD) // fill quickly, then publish at rate
+        usleep(INSERT_PERIOD / 1000);
+    }
+  };
+
+  void read(unsigned int seed, unsigned long* count)
+  {
+    TransformStorage stor;
+    unsigned long n = 0;
+    while (running)
+    {
+      // Somewhere in the last 100 transforms
+      uint64_t stamp = latest - (rand_r(&seed) % (100 * INSERT_PERIOD));
+      if (serialize)
+      {
+        boost::mutex::scoped_lock lock(lookup_lock);
+        cache.getData(stamp, stor);
+      }
+      else
+        cache.getData(stamp, stor);
+      n++;
+    }
+    *count = n;
+  };
+};
+
+void run(unsigned int readers, bool serialize)
+{
+  Benchmark bench(serialize);
+
+  // Fill the storage window before timing
+  boost::thread writer(boost::bind(&Benchmark::write, &bench));
+  while (bench.latest < 2000 * INSERT_PERIOD)
+    boost::thread::yield();
+
+  std::vector<unsigned long> counts(readers);
+  boost::thread_group group;
+  double start = now();
+  for (unsigned int i = 0; i < readers; i++)
+    group.create_thread(boost::bind(&Benchmark::read, &bench, i, &counts[i]));
+  while (now() - start < RUN_TIME)
+    usleep(10000);
+  bench.running = false;
+  group.join_all();
+  writer.join();
+  double elapsed = now() - start;
+
+  unsigned long total = 0;
+  for (unsigned int i = 0; i < readers; i++)
+    total += counts[i];
+  printf("%-10s %2u readers %12.0f lookups/sec\n", serialize ? "serialized" : "lock-free", readers, total / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+  for (unsigned int readers = 1; readers <= 8; readers *= 2)
+  {
+    run(readers, true);
+    run(readers, false);
+  }
+  return 0;
+}
@@ -446,6 +446,51 @@ TEST(TimeCache, AngularInterpolation)
 }
 
 
+/** \brief Fill the cache past its initial capacity, and past the storage time */
+TEST(TimeCache, RingBufferGrowthAndPruning)
+{
+  uint64_t runs = 10000;
+  uint64_t storage = 1000;
+
+  tf::TimeCache cache(true, ros::Duration().fromNSec(storage));
+
+  TransformStorage stor;
+  stor.setIdentity();
+  stor.frame_id_ = "NO_NEED";
+  stor.parent_frame_id = 2;
+
+  for ( uint64_t i = 1; i <= runs ; i++ )
+  {
+    stor.setOrigin(btVector3((double)i, 0, 0));
+    stor.stamp_ = i;
+    cache.insertData(stor);
+  }
+
+  //The stored window interpolates exactly
+  for ( uint64_t i = runs - storage; i <= runs ; i++ )
+  {
+    cache.getData(i, stor);
+    EXPECT_NEAR((double)i, stor.getOrigin().x(), 1e-6);
+  }
+
+  //Older values have been pruned, so these extrapolate from the oldest two
+  cache.getData(runs - storage - 1, stor);
+  EXPECT_EQ(stor.mode_, EXTRAPOLATE_BACK);
+  EXPECT_EQ(stor.stamp_, runs - storage);
+
+  //Out of order insertion into the middle
+  stor.setOrigin(btVector3(-1.0, 0, 0));
+  stor.stamp_ = runs - 10;
+  stor.frame_id_ = "LATE";
+  cache.insertData(stor);
+  cache.getData(runs - 10, stor);
+  EXPECT_EQ(stor.frame_id_, std::string("LATE"));
+
+  cache.clearList();
+  EXPECT_FALSE(cache.getData(runs, stor));
+}
+
+
 int main(int argc, char **argv){
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
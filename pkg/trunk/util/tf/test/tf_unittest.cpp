@@ -1188,6 +1188,144 @@ TEST(tf, getLatestCommonTime)
 
 
 
+}
+
+TEST(tf, BatchTransformPoints)
+{
+  uint64_t runs = 400;
+  double epsilon = 1e-6;
+  seed_rand();
+
+  tf::Transformer mTR(true);
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0.3,0.2,0.1), btVector3(1,2,3)), ros::Time(1000ULL), "a", "parent"));
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(-0.5,0.1,0.7), btVector3(-4,0.5,1)), ros::Time(1000ULL), "b", "parent"));
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(1.1,0,0), btVector3(0,0,2)), ros::Time(1000ULL), "c", "b"));
+
+  std::vector<double> xvalues(runs), yvalues(runs), zvalues(runs);
+  generate_rand_vectors(10.0, runs, xvalues, yvalues, zvalues);
+  std::vector<Point> points(runs), points_out;
+  std::vector<Pose> poses(runs), poses_out;
+  for (uint64_t i = 0; i < runs; i++)
+  {
+    points[i] = Point(xvalues[i], yvalues[i], zvalues[i]);
+    poses[i] = Pose(btQuaternion(xvalues[i], yvalues[i], zvalues[i]), points[i]);
+  }
+
+  try
+  {
+    mTR.transformPoints("a", "c", ros::Time(1000ULL), points, points_out);
+    mTR.transformPoses("a", "c", ros::Time(1000ULL), poses, poses_out);
+  }
+  catch (tf::TransformException &ex)
+  {
+    printf("%s\n", ex.what());
+    EXPECT_FALSE("Shouldn't get this Exception");
+  }
+
+  ASSERT_EQ(points_out.size(), runs);
+  ASSERT_EQ(poses_out.size(), runs);
+  for (uint64_t i = 0; i < runs; i++)
+  {
+    Stamped<Point> point_expected;
+    mTR.transformPoint("a", Stamped<Point>(points[i], ros::Time(1000ULL), "c"), point_expected);
+    EXPECT_NEAR(points_out[i].x(), point_expected.x(), epsilon);
+    EXPECT_NEAR(points_out[i].y(), point_expected.y(), epsilon);
+    EXPECT_NEAR(points_out[i].z(), point_expected.z(), epsilon);
+
+    Stamped<Pose> pose_expected;
+    mTR.transformPose("a", Stamped<Pose>(poses[i], ros::Time(1000ULL), "c"), pose_expected);
+    EXPECT_NEAR(poses_out[i].getOrigin().x(), pose_expected.getOrigin().x(), epsilon);
+    EXPECT_NEAR(poses_out[i].getOrigin().y(), pose_expected.getOrigin().y(), epsilon);
+    EXPECT_NEAR(poses_out[i].getOrigin().z(), pose_expected.getOrigin().z(), epsilon);
+    EXPECT_NEAR(poses_out[i].getRotation().angle(pose_expected.getRotation()), 0, epsilon);
+  }
+
+  // In place
+  mTR.transformPoints("a", "c", ros::Time(1000ULL), points, points);
+  for (uint64_t i = 0; i < runs; i++)
+  {
+    EXPECT_NEAR(points[i].x(), points_out[i].x(), epsilon);
+    EXPECT_NEAR(points[i].y(), points_out[i].y(), epsilon);
+    EXPECT_NEAR(points[i].z(), points_out[i].z(), epsilon);
+  }
+}
+
+TEST(tf, FrameNumberLookup)
+{
+  double epsilon = 1e-6;
+  tf::Transformer mTR(true);
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(1,0,0)), ros::Time(1000ULL), "a", "parent"));
+
+  unsigned int a = mTR.getFrameNumber("a");
+  unsigned int parent = mTR.getFrameNumber("parent");
+  EXPECT_EQ(a, mTR.getFrameNumber("a"));
+  EXPECT_NE(a, parent);
+
+  Stamped<btTransform> by_number, by_string;
+  mTR.lookupTransform(parent, a, ros::Time(1000ULL), by_number);
+  mTR.lookupTransform("parent", "a", ros::Time(1000ULL), by_string);
+  EXPECT_EQ(by_number.frame_id_, "parent");
+  EXPECT_EQ(by_number.stamp_, ros::Time(1000ULL));
+  EXPECT_NEAR(by_number.getOrigin().x(), 1, epsilon);
+  EXPECT_NEAR(by_string.getOrigin().x(), 1, epsilon);
+
+  // A lookup cached before new data arrives must not be returned afterwards
+  mTR.setExtrapolationLimit(ros::Duration(10000LL));
+  mTR.lookupTransform(parent, a, ros::Time(1500ULL), by_number);
+  EXPECT_NEAR(by_number.getOrigin().x(), 1, epsilon);
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(3,0,0)), ros::Time(2000ULL), "a", "parent"));
+  mTR.lookupTransform(parent, a, ros::Time(1500ULL), by_number);
+  EXPECT_NEAR(by_number.getOrigin().x(), 2, epsilon);
+
+  // Unconnected frames still throw
+  unsigned int other = mTR.getFrameNumber("other");
+  EXPECT_THROW(mTR.lookupTransform(other, a, ros::Time(1000ULL), by_number), tf::TransformException);
+}
+
+/** \brief Exposes the lookup cache of a Transformer */
+class CacheTestTransformer : public tf::Transformer
+{
+public:
+  CacheTestTransformer() : tf::Transformer(true) {};
+  bool isCached(const std::string& target_frame, const std::string& source_frame, const ros::Time& time)
+  {
+    btTransform transform;
+    return getCachedTransform(getFrameNumber(target_frame), getFrameNumber(source_frame), time, transform);
+  };
+};
+
+TEST(tf, LookupCacheInvalidation)
+{
+  double epsilon = 1e-6;
+  CacheTestTransformer mTR;
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(1,0,0)), ros::Time(1000ULL), "b", "parent"));
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(1,0,0)), ros::Time(2000ULL), "b", "parent"));
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(0,1,0)), ros::Time(1000ULL), "a", "b"));
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(0,1,0)), ros::Time(2000ULL), "a", "b"));
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(0,0,1)), ros::Time(1000ULL), "c", "parent"));
+
+  Stamped<btTransform> out;
+  mTR.lookupTransform("parent", "a", ros::Time(1500ULL), out);
+  EXPECT_TRUE(mTR.isCached("parent", "a", ros::Time(1500ULL)));
+  EXPECT_FALSE(mTR.isCached("parent", "a", ros::Time(1600ULL)));
+
+  // Data on a frame off the chain leaves the entry valid
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(0,0,1)), ros::Time(2000ULL), "c", "parent"));
+  EXPECT_TRUE(mTR.isCached("parent", "a", ros::Time(1500ULL)));
+
+  // Data on a frame in the middle of the chain invalidates it
+  mTR.setTransform(Stamped<btTransform>(btTransform(btQuaternion(0,0,0), btVector3(3,0,0)), ros::Time(1500ULL), "b", "parent"));
+  EXPECT_FALSE(mTR.isCached("parent", "a", ros::Time(1500ULL)));
+  mTR.lookupTransform("parent", "a", ros::Time(1500ULL), out);
+  EXPECT_NEAR(out.getOrigin().x(), 3, epsilon);
+  EXPECT_NEAR(out.getOrigin().y(), 1, epsilon);
+  EXPECT_EQ(out.frame_id_, "parent");
+  EXPECT_TRUE(mTR.isCached("parent", "a", ros::Time(1500ULL)));
+
+  // So does clearing
+  mTR.clear();
+  EXPECT_FALSE(mTR.isCached("parent", "a", ros::Time(1500ULL)));
+  EXPECT_THROW(mTR.lookupTransform("parent", "a", ros::Time(1500ULL), out), tf::TransformException);
 }
 
 int main(int argc, char **argv){
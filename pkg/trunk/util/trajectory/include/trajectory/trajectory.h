@@ -170,7 +170,15 @@ namespace trajectory
 
 //  void sample(std::vector<TPoint> &tp, double dT);
 
-//    void sample(std::vector<TPoint> &tp, double start_time, double end_time, double dT); 
+    /*!
+      \brief Sample the trajectory at regular intervals into a pre-allocated buffer. Samples are taken at start_time, start_time + dT, ... up to end_time or until the buffer is full, whichever comes first. The buffer is never resized.
+      \param reference to a pre-allocated vector of TPoints, each of the trajectory's dimension
+      \param time of the first sample
+      \param time after which no more samples are taken
+      \param time between samples (must be positive)
+      \return number of samples written, -1 if error
+    */
+    int sample(std::vector<TPoint> &tp, double start_time, double end_time, double dT);
 
 //  std::vector<TPoint>& getPoints() const;
 
@@ -229,6 +237,18 @@ namespace trajectory
 
     std::vector<double> max_acc_;/** vector of max accelerations on the n DOFs of the trajectory */
 
+    typedef void (Trajectory::*SampleFunction)(TPoint &tp, double time, const TCoeff &tc, double segment_start_time);
+
+    SampleFunction sample_function_; /** sampling function for interp_method_, resolved in parameterize() so sample() does not compare strings */
+
+    int segment_cursor_; /** segment found by the last call to findTrajectorySegment, where the next search starts */
+
+    /*!
+      \brief Look up the sampling function matching interp_method_
+      \return NULL if interp_method_ is not recognized
+    */
+    SampleFunction getSampleFunction();
+
     /*!
       \brief calculate the coefficients for interpolation between trajectory points
        If autocalc_timing_ is true, timings for the trajectories are automatically calculated using max rate and/or max accn information
@@ -307,7 +327,7 @@ namespace trajectory
     void sampleBlendedLinear(TPoint &tp, double time, const TCoeff &tc, double segment_start_time);
 
     /*! 
-       \brief finds the trajectory segment corresponding to a particular time 
+       \brief finds the trajectory segment corresponding to a particular time. The search resumes from the segment found by the previous call, so it is amortized O(1) when time increases monotonically, and falls back to a binary search when time goes backwards.
        \param input time (in seconds)
        \return segment index 
     */
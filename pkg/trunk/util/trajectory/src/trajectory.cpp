@@ -30,15 +30,17 @@
 /** \author Sachin Chitta */
 
 #include "trajectory/trajectory.h"
+#include <algorithm>
 
 #define MAX_ALLOWABLE_TIME 1.0e8
 #define EPS_TRAJECTORY 1.0e-8
 
 using namespace trajectory;
 
-Trajectory::Trajectory(int dimension): dimension_(dimension)
+Trajectory::Trajectory(int dimension): dimension_(dimension), segment_cursor_(0)
 {
   interp_method_ = "linear";
+  sample_function_ = &Trajectory::sampleLinear;
   autocalc_timing_ = false;
 }
 
@@ -50,6 +52,7 @@ void Trajectory::clear()
   max_limit_.resize(0);
   max_rate_.resize(0);
   max_acc_.resize(0);
+  segment_cursor_ = 0;
 }
 
 int Trajectory::setTrajectory(const std::vector<TPoint>& tp)
@@ -193,13 +196,36 @@ void Trajectory::addPoint(const TPoint tp)
   parameterize();
 }
 
+static bool pointTimeLess(const Trajectory::TPoint &tp, double time)
+{
+  return tp.time_ < time;
+}
+
 inline int Trajectory::findTrajectorySegment(double time)
 {
-  int result = 0;
+  int last = (int) tp_.size() - 2;
+  if(last < 0)
+    return 0;
 
-  while(time > tp_[result+1].time_)
-    result++;
+  int result = segment_cursor_;
 
+  if(result > last || time <= tp_[result].time_)
+  {
+    // Going backwards (or the trajectory changed): the segment is the one ending at the first point at or after time
+    result = std::lower_bound(tp_.begin() + 1, tp_.end(), time, pointTimeLess) - tp_.begin() - 1;
+  }
+  else
+  {
+    while(result < last && time > tp_[result+1].time_)
+      result++;
+  }
+
+  if(result > last)
+    result = last;
+  if(result < 0)
+    result = 0;
+
+  segment_cursor_ = result;
   return result;
 }
 
@@ -234,18 +260,52 @@ int Trajectory::sample(TPoint &tp, double time)
   } 
   int segment_index = findTrajectorySegment(time);
 //  ROS_INFO("segment index : %d",segment_index);
-  if(interp_method_ == std::string("linear"))
-    sampleLinear(tp,time,tc_[segment_index],tp_[segment_index].time_);
-  else if(interp_method_ == std::string("cubic"))
-    sampleCubic(tp,time,tc_[segment_index],tp_[segment_index].time_);
-  else if(interp_method_ == std::string("blended_linear"))
-    sampleBlendedLinear(tp,time,tc_[segment_index],tp_[segment_index].time_);
+  if(sample_function_)
+    (this->*sample_function_)(tp,time,tc_[segment_index],tp_[segment_index].time_);
   else
     ROS_WARN("Unrecognized interp_method type: %s\n",interp_method_.c_str());
 
   return 1;
 }
 
+int Trajectory::sample(std::vector<TPoint> &tp, double start_time, double end_time, double dT)
+{
+  if(dT <= 0.0)
+  {
+    ROS_WARN("Sampling interval %f must be positive",dT);
+    return -1;
+  }
+  if(!sample_function_)
+  {
+    ROS_WARN("Unrecognized interp_method type: %s\n",interp_method_.c_str());
+    return -1;
+  }
+
+  int num_samples = 0;
+  for(int i=0; i < (int) tp.size(); i++)
+  {
+    double time = start_time + i * dT;
+    if(time > end_time)
+      break;
+
+    if((int) tp[i].q_.size() != dimension_ || (int) tp[i].qdot_.size() != dimension_)
+    {
+      ROS_WARN("Dimension of sample point passed in = %d does not match dimension of trajectory = %d",tp[i].q_.size(),dimension_);
+      return -1;
+    }
+
+    if(time > tp_.back().time_)
+      time = tp_.back().time_;
+    else if(time < tp_.front().time_)
+      time = tp_.front().time_;
+
+    int segment_index = findTrajectorySegment(time);
+    (this->*sample_function_)(tp[i],time,tc_[segment_index],tp_[segment_index].time_);
+    num_samples++;
+  }
+  return num_samples;
+}
+
 /*
 int Trajectory::sample(std::vector<TPoint> &tp, double start_time, double end_time)
 {
@@ -301,6 +361,8 @@ int Trajectory::setMaxAcc(std::vector<double> max_acc)
 int Trajectory::minimizeSegmentTimes()
 {
   int error_code = -1;
+  sample_function_ = getSampleFunction();
+  segment_cursor_ = 0;
   if(interp_method_ == std::string("linear"))
      error_code = minimizeSegmentTimesWithLinearInterpolation();
   else if(interp_method_ == std::string("cubic"))
@@ -670,12 +732,26 @@ double Trajectory::calculateMinTimeLSPB(double q0, double q1, double vmax, doubl
 void Trajectory::setInterpolationMethod(std::string interp_method)
 {
   interp_method_ = interp_method;
+  sample_function_ = getSampleFunction();
   ROS_INFO("Trajectory:: interpolation type %s",interp_method_.c_str());
 }
 
+Trajectory::SampleFunction Trajectory::getSampleFunction()
+{
+  if(interp_method_ == std::string("linear"))
+    return &Trajectory::sampleLinear;
+  else if(interp_method_ == std::string("cubic"))
+    return &Trajectory::sampleCubic;
+  else if(interp_method_ == std::string("blended_linear"))
+    return &Trajectory::sampleBlendedLinear;
+  return NULL;
+}
+
 int Trajectory::parameterize()
 {
   int error_code = -1;
+  sample_function_ = getSampleFunction();
+  segment_cursor_ = 0;
   if(interp_method_ == std::string("linear"))
      error_code = parameterizeLinear();
   else if(interp_method_ == std::string("cubic"))
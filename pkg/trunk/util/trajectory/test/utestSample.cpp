@@ -0,0 +1,115 @@
+#include "trajectory/trajectory.h"
+#include <gtest/gtest.h>
+#include <sys/time.h>
+
+using namespace trajectory;
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// A 7 DOF trajectory through num_points waypoints, one second apart
+static void makeTrajectory(Trajectory &t, int num_points)
+{
+  std::vector<double> p(7*num_points), time(num_points);
+  for(int i=0; i < num_points; i++)
+  {
+    time[i] = (double) i;
+    for(int j=0; j < 7; j++)
+      p[i*7+j] = sin(0.3*i + j);
+  }
+  t.setTrajectory(p,time,num_points);
+}
+
+TEST(Trajectory, samplingOutOfOrder){
+  Trajectory t(1);
+  Trajectory::TPoint b(1);
+  std::vector<double> a(4), c(4);
+
+  for(int i=0; i < 4; i++)
+  {
+    a[i] = (double) (i*i);
+    c[i] = (double) i;
+  }
+  t.setTrajectory(a,c,4);
+
+  // forwards, backwards, and back to a segment the cursor already passed
+  double times[] = {0.5, 2.5, 0.25, 1.5, 1.0, 3.0, 2.0, 0.0};
+  double expected[] = {0.5, 6.5, 0.25, 2.5, 1.0, 9.0, 4.0, 0.0};
+  for(int i=0; i < 8; i++)
+  {
+    t.sample(b,times[i]);
+    EXPECT_NEAR(b.q_[0],expected[i],1e-9);
+  }
+}
+
+TEST(Trajectory, batchSamplingMatchesSingleSampling){
+  Trajectory t(7), reference(7);
+  t.setInterpolationMethod("cubic");
+  reference.setInterpolationMethod("cubic");
+  makeTrajectory(t,20);
+  makeTrajectory(reference,20);
+
+  std::vector<Trajectory::TPoint> batch(2000, Trajectory::TPoint(7));
+  EXPECT_EQ(t.sample(batch,0.0,19.0,0.01),1901);
+
+  Trajectory::TPoint b(7);
+  for(int i=0; i < 1901; i++)
+  {
+    reference.sample(b,i*0.01);
+    EXPECT_DOUBLE_EQ(batch[i].time_,b.time_);
+    for(int j=0; j < 7; j++)
+    {
+      EXPECT_DOUBLE_EQ(batch[i].q_[j],b.q_[j]);
+      EXPECT_DOUBLE_EQ(batch[i].qdot_[j],b.qdot_[j]);
+    }
+  }
+
+  // the buffer is never resized
+  std::vector<Trajectory::TPoint> small(10, Trajectory::TPoint(7));
+  EXPECT_EQ(t.sample(small,0.0,19.0,0.01),10);
+  EXPECT_EQ((int) small.size(),10);
+  EXPECT_EQ(t.sample(small,0.0,19.0,0.0),-1);
+}
+
+TEST(Trajectory, samplingBenchmark){
+  Trajectory t(7);
+  t.setInterpolationMethod("cubic");
+  makeTrajectory(t,200);
+
+  // Sample the whole trajectory at 1 kHz, as the arm trajectory controllers do
+  const int num_samples = 199*1000;
+  const int repetitions = 10;
+  Trajectory::TPoint b(7);
+  double sum = 0;
+
+  double start = now();
+  for(int r=0; r < repetitions; r++)
+    for(int i=0; i < num_samples; i++)
+    {
+      t.sample(b,i*0.001);
+      sum += b.q_[0];
+    }
+  double single = now() - start;
+
+  std::vector<Trajectory::TPoint> batch(1000, Trajectory::TPoint(7));
+  start = now();
+  for(int r=0; r < repetitions; r++)
+    for(int i=0; i < num_samples; i += 1000)
+    {
+      t.sample(batch,i*0.001,(i+999)*0.001,0.001);
+      sum += batch[0].q_[0];
+    }
+  double batched = now() - start;
+
+  printf("sample(): %.1f ns/sample, batch sample(): %.1f ns/sample (%g)\n",
+         single*1e9/(repetitions*num_samples), batched*1e9/(repetitions*num_samples), sum);
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
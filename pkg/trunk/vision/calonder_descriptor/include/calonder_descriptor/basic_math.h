@@ -2,6 +2,9 @@
 #define FEATURES_BASIC_MATH_H
 
 #include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifndef ushort
 typedef unsigned short int ushort;
@@ -23,6 +26,18 @@ inline void add(int size, const float* src1, const float* src2, float* dst)
 
 inline void add(int size, const ushort* src1, const uchar* src2, ushort* dst)
 {
+#ifdef __SSE2__
+  // Widen 16 uchars to two registers of 8 ushorts and add
+  const __m128i zero = _mm_setzero_si128();
+  for (; size >= 16; size -= 16) {
+    __m128i b = _mm_loadu_si128((const __m128i*)src2);
+    __m128i lo = _mm_add_epi16(_mm_loadu_si128((const __m128i*)src1), _mm_unpacklo_epi8(b, zero));
+    __m128i hi = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(src1 + 8)), _mm_unpackhi_epi8(b, zero));
+    _mm_storeu_si128((__m128i*)dst, lo);
+    _mm_storeu_si128((__m128i*)(dst + 8), hi);
+    dst += 16; src1 += 16; src2 += 16;
+  }
+#endif
   while(--size >= 0) {
     *dst = *src1 + *src2;
     ++dst; ++src1; ++src2;
@@ -55,6 +70,17 @@ inline float L1Distance(int size, const float* a, const float* b)
 inline int L1Distance(int size, const unsigned char* a, const unsigned char* b)
 {
   int result = 0;
+#ifdef __SSE2__
+  // psadbw sums the absolute differences of 8 bytes into each 64-bit half
+  __m128i sum = _mm_setzero_si128();
+  for (; size >= 16; size -= 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)a);
+    __m128i vb = _mm_loadu_si128((const __m128i*)b);
+    sum = _mm_add_epi32(sum, _mm_sad_epu8(va, vb));
+    a += 16; b += 16;
+  }
+  result = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+#endif
   while (--size >= 0) {
     result += abs(*a - *b);
     ++a; ++b;
@@ -0,0 +1,444 @@
+#ifndef FEATURES_INDEXED_MATCHER_H
+#define FEATURES_INDEXED_MATCHER_H
+
+#include "calonder_descriptor/basic_math.h"
+#include "calonder_descriptor/rng.h"
+#include <cv.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+#include <utility>
+#include <cassert>
+
+namespace features {
+
+/*!
+  Alternative to BruteForceMatcher for large databases. Signatures are
+  quantized to uchar and copied into one contiguous buffer, and compared
+  with an SSE2 L1 distance. buildIndex() adds a spatial grid over the
+  keypoint positions for findMatchInWindow and, optionally, a forest of
+  randomized kd-trees for approximate whole-database matching.
+
+  Data must have x and y members, as for BruteForceMatcher::findMatchInWindow.
+  Distances are in quantized units.
+ */
+template < typename Data >
+class IndexedMatcher
+{
+public:
+  // Float signature values are multiplied by scale before rounding to
+  // uchar; ushort signatures (RTreeClassifier::getSignature) are only
+  // clamped to 255. cell_size is the side of a grid cell in pixels.
+  IndexedMatcher(size_t signature_size, float scale = 255.0f, int cell_size = 32);
+
+  // Unlike BruteForceMatcher, the signature is copied
+  void addSignature(const float* signature, Data const& data);
+  void addSignature(const ushort* signature, Data const& data);
+
+  // Quantize a query signature into size() uchars
+  void quantize(const float* signature, uchar* dst) const;
+  void quantize(const ushort* signature, uchar* dst) const;
+
+  // Builds the grid and, if num_trees > 0, a kd-forest. Must be called after
+  // the last addSignature and before matching.
+  void buildIndex(int num_trees = 0, int leaf_size = 8, Rng::int_type seed = 0);
+
+  // Bounds the number of distances computed by the kd-forest search. With 0,
+  // or no forest, whole-database matching is exhaustive.
+  inline void setMaxChecks(int max_checks) { max_checks_ = max_checks; }
+
+  inline size_t size() const { return size_; }
+  inline int numSignatures() const { return data_.size(); }
+  const uchar* getSignature(int index) const;
+  Data& getData(int index);
+  const Data& getData(int index) const;
+
+  int findMatch(const uchar* signature, int *distance) const;
+
+  int findMatchInWindow(const uchar* signature, CvRect window,
+                        int *distance) const;
+
+  // Returns top two matches, useful for ratio test
+  int findMatches(const uchar* signature, int *d1, int *second,
+                  int *d2) const;
+
+private:
+  struct BestTwo
+  {
+    int first, d1, second, d2;
+    BestTwo() : first(-1), d1(std::numeric_limits<int>::max()),
+                second(-1), d2(std::numeric_limits<int>::max()) {}
+    inline void update(int index, int distance)
+    {
+      // The same signature may be reached through several trees
+      if (index == first || index == second)
+        return;
+      if (distance < d1) {
+        second = first; d2 = d1;
+        first = index; d1 = distance;
+      } else if (distance < d2) {
+        second = index; d2 = distance;
+      }
+    }
+  };
+
+  // Inner nodes split at value on dim, entries <= value go left and >= value
+  // go right. Leaves have dim == -1 and cover tree indices [left, right).
+  struct KdNode
+  {
+    int dim, value, left, right;
+  };
+
+  struct KdTree
+  {
+    std::vector<KdNode> nodes;
+    std::vector<int> indices;
+  };
+
+  // (lower bound, (tree, node)) of a branch not yet searched
+  typedef std::pair< int, std::pair<int, int> > Branch;
+  typedef std::priority_queue< Branch, std::vector<Branch>, std::greater<Branch> > BranchQueue;
+
+  static const int KD_SAMPLES = 100;   // entries sampled to choose a split
+  static const int KD_RAND_DIMS = 5;   // split on one of the highest-variance dims
+
+  int buildNode(KdTree &tree, int begin, int end, int leaf_size, Rng &rng);
+  void searchLinear(const uchar* signature, BestTwo &best) const;
+  void searchForest(const uchar* signature, BestTwo &best) const;
+  void descend(const uchar* signature, int tree, int node, int bound,
+               BranchQueue &queue, BestTwo &best, int &checks) const;
+
+  inline const uchar* row(int index) const { return &signatures_[index * size_]; }
+
+  std::vector< uchar > signatures_;
+  std::vector< Data > data_;
+  size_t size_;
+  float scale_;
+  int max_checks_;
+
+  // Grid, entries of cell c are cell_entries_[cell_start_[c] .. cell_start_[c+1])
+  int cell_size_;
+  int grid_x_, grid_y_, grid_width_, grid_height_;
+  std::vector< int > cell_start_;
+  std::vector< int > cell_entries_;
+
+  std::vector< KdTree > forest_;
+  bool indexed_;
+};
+
+template < typename Data >
+inline
+IndexedMatcher<Data>::IndexedMatcher(size_t signature_size, float scale, int cell_size)
+  : size_(signature_size), scale_(scale), max_checks_(0), cell_size_(cell_size),
+    grid_x_(0), grid_y_(0), grid_width_(0), grid_height_(0), indexed_(false)
+{}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::quantize(const float* signature, uchar* dst) const
+{
+  for (size_t i = 0; i < size_; ++i) {
+    float value = signature[i] * scale_ + 0.5f;
+    dst[i] = value <= 0 ? 0 : (value >= 255 ? 255 : (uchar)value);
+  }
+}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::quantize(const ushort* signature, uchar* dst) const
+{
+  for (size_t i = 0; i < size_; ++i)
+    dst[i] = std::min<ushort>(signature[i], 255);
+}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::addSignature(const float* signature, Data const& data)
+{
+  signatures_.resize(signatures_.size() + size_);
+  quantize(signature, &signatures_[signatures_.size() - size_]);
+  data_.push_back(data);
+  indexed_ = false;
+}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::addSignature(const ushort* signature, Data const& data)
+{
+  signatures_.resize(signatures_.size() + size_);
+  quantize(signature, &signatures_[signatures_.size() - size_]);
+  data_.push_back(data);
+  indexed_ = false;
+}
+
+template < typename Data >
+inline
+const uchar* IndexedMatcher<Data>::getSignature(int index) const
+{
+  return row(index);
+}
+
+template < typename Data >
+inline
+Data& IndexedMatcher<Data>::getData(int index)
+{
+  return data_[index];
+}
+
+template < typename Data >
+inline
+const Data& IndexedMatcher<Data>::getData(int index) const
+{
+  return data_[index];
+}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::buildIndex(int num_trees, int leaf_size, Rng::int_type seed)
+{
+  int n = data_.size();
+
+  // Grid over the bounding box of the keypoints, filled by counting sort
+  cell_start_.clear();
+  cell_entries_.resize(n);
+  grid_width_ = grid_height_ = 0;
+  if (n > 0) {
+    int max_x = grid_x_ = (int)data_[0].x;
+    int max_y = grid_y_ = (int)data_[0].y;
+    for (int i = 1; i < n; ++i) {
+      grid_x_ = std::min(grid_x_, (int)data_[i].x);
+      grid_y_ = std::min(grid_y_, (int)data_[i].y);
+      max_x = std::max(max_x, (int)data_[i].x);
+      max_y = std::max(max_y, (int)data_[i].y);
+    }
+    grid_width_ = (max_x - grid_x_) / cell_size_ + 1;
+    grid_height_ = (max_y - grid_y_) / cell_size_ + 1;
+  }
+  std::vector<int> cells(n);
+  cell_start_.assign(grid_width_ * grid_height_ + 1, 0);
+  for (int i = 0; i < n; ++i) {
+    int cx = ((int)data_[i].x - grid_x_) / cell_size_;
+    int cy = ((int)data_[i].y - grid_y_) / cell_size_;
+    cells[i] = cy * grid_width_ + cx;
+    ++cell_start_[cells[i] + 1];
+  }
+  for (size_t c = 1; c < cell_start_.size(); ++c)
+    cell_start_[c] += cell_start_[c - 1];
+  std::vector<int> fill(cell_start_.begin(), cell_start_.end() - 1);
+  for (int i = 0; i < n; ++i)
+    cell_entries_[fill[cells[i]]++] = i;
+
+  // kd-forest; the trees differ by the random choice of split dimensions
+  forest_.clear();
+  forest_.resize(num_trees);
+  Rng rng(seed);
+  for (int t = 0; t < num_trees; ++t) {
+    KdTree &tree = forest_[t];
+    tree.indices.resize(n);
+    for (int i = 0; i < n; ++i)
+      tree.indices[i] = i;
+    if (n > 0)
+      buildNode(tree, 0, n, std::max(1, leaf_size), rng);
+  }
+
+  indexed_ = true;
+}
+
+// Compares entries of a kd-tree by one signature dimension
+template < typename Data >
+struct IndexedMatcherDimLess
+{
+  const IndexedMatcher<Data> *matcher;
+  int dim;
+  inline bool operator()(int a, int b) const
+  {
+    return matcher->getSignature(a)[dim] < matcher->getSignature(b)[dim];
+  }
+};
+
+template < typename Data >
+inline
+int IndexedMatcher<Data>::buildNode(KdTree &tree, int begin, int end, int leaf_size, Rng &rng)
+{
+  int node = tree.nodes.size();
+  tree.nodes.push_back(KdNode());
+  int count = end - begin;
+
+  // Variance of each dimension over a random sample of the entries
+  int dim = -1;
+  if (count > leaf_size) {
+    int samples = std::min(count, (int)KD_SAMPLES);
+    std::vector<float> sum(size_, 0.f), sum_sq(size_, 0.f);
+    for (int s = 0; s < samples; ++s) {
+      int index = tree.indices[begin + (samples == count ? s : (int)rng(count))];
+      const uchar* sig = row(index);
+      for (size_t i = 0; i < size_; ++i) {
+        sum[i] += sig[i];
+        sum_sq[i] += sig[i] * sig[i];
+      }
+    }
+    std::vector< std::pair<float, int> > variances(size_);
+    for (size_t i = 0; i < size_; ++i)
+      variances[i] = std::make_pair(sum_sq[i] - sum[i] * sum[i] / samples, (int)i);
+    int top = std::min((int)KD_RAND_DIMS, (int)size_);
+    std::partial_sort(variances.begin(), variances.begin() + top, variances.end(),
+                      std::greater< std::pair<float, int> >());
+    // Fewer candidates if only some dimensions vary
+    while (top > 0 && variances[top - 1].first <= 0)
+      --top;
+    if (top > 0)
+      dim = variances[rng(top)].second;
+  }
+
+  if (dim < 0) {
+    tree.nodes[node].dim = -1;
+    tree.nodes[node].left = begin;
+    tree.nodes[node].right = end;
+    return node;
+  }
+
+  // Median split keeps the trees balanced
+  int middle = begin + count / 2;
+  IndexedMatcherDimLess<Data> less = { this, dim };
+  std::nth_element(tree.indices.begin() + begin, tree.indices.begin() + middle,
+                   tree.indices.begin() + end, less);
+  int value = row(tree.indices[middle])[dim];
+
+  int left = buildNode(tree, begin, middle, leaf_size, rng);
+  int right = buildNode(tree, middle, end, leaf_size, rng);
+  KdNode &split = tree.nodes[node];
+  split.dim = dim;
+  split.value = value;
+  split.left = left;
+  split.right = right;
+  return node;
+}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::searchLinear(const uchar* signature, BestTwo &best) const
+{
+  int n = data_.size();
+  const uchar* stored_sig = n > 0 ? row(0) : NULL;
+  for (int i = 0; i < n; ++i, stored_sig += size_)
+    best.update(i, L1Distance(size_, signature, stored_sig));
+}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::descend(const uchar* signature, int tree, int node, int bound,
+                                   BranchQueue &queue, BestTwo &best, int &checks) const
+{
+  const KdTree &kd_tree = forest_[tree];
+  const KdNode *current = &kd_tree.nodes[node];
+  while (current->dim >= 0) {
+    int diff = signature[current->dim] - current->value;
+    int near = diff < 0 ? current->left : current->right;
+    int far = diff < 0 ? current->right : current->left;
+    // Priority of the other side, accumulated along the path as in FLANN
+    int far_bound = bound + (diff < 0 ? -diff : diff);
+    if (far_bound < best.d2)
+      queue.push(std::make_pair(far_bound, std::make_pair(tree, far)));
+    current = &kd_tree.nodes[near];
+  }
+
+  for (int i = current->left; i < current->right; ++i) {
+    int index = kd_tree.indices[i];
+    best.update(index, L1Distance(size_, signature, row(index)));
+    ++checks;
+  }
+}
+
+template < typename Data >
+inline
+void IndexedMatcher<Data>::searchForest(const uchar* signature, BestTwo &best) const
+{
+  BranchQueue queue;
+  int checks = 0;
+
+  // One leaf from each tree, then the most promising branches of all trees
+  for (int t = 0; t < (int)forest_.size(); ++t)
+    descend(signature, t, 0, 0, queue, best, checks);
+
+  while (!queue.empty() && checks < max_checks_) {
+    Branch branch = queue.top();
+    queue.pop();
+    if (branch.first >= best.d2)
+      break;
+    descend(signature, branch.second.first, branch.second.second, branch.first,
+            queue, best, checks);
+  }
+}
+
+template < typename Data >
+inline
+int IndexedMatcher<Data>::findMatch(const uchar* signature, int *distance) const
+{
+  int second, d2;
+  return findMatches(signature, distance, &second, &d2);
+}
+
+template < typename Data >
+inline
+int IndexedMatcher<Data>::findMatches(const uchar* signature, int *d1, int *second,
+                                      int *d2) const
+{
+  assert(indexed_);
+  BestTwo best;
+  if (forest_.empty() || max_checks_ <= 0 || data_.empty())
+    searchLinear(signature, best);
+  else
+    searchForest(signature, best);
+
+  *d1 = best.d1;
+  *second = best.second;
+  *d2 = best.d2;
+  return best.first;
+}
+
+template < typename Data >
+inline
+int IndexedMatcher<Data>::findMatchInWindow(const uchar* signature, CvRect window,
+                                            int *distance) const
+{
+  assert(indexed_);
+  int match = -1;
+  int best_distance = std::numeric_limits<int>::max();
+
+  // Range of cells overlapping the window, clipped to the grid
+  int cx_begin = std::max(0, (window.x - grid_x_) / cell_size_);
+  int cy_begin = std::max(0, (window.y - grid_y_) / cell_size_);
+  int cx_end = std::min(grid_width_, (window.x + window.width - 1 - grid_x_) / cell_size_ + 1);
+  int cy_end = std::min(grid_height_, (window.y + window.height - 1 - grid_y_) / cell_size_ + 1);
+  if (window.x + window.width <= grid_x_ || window.y + window.height <= grid_y_)
+    cx_end = cy_end = 0;
+
+  for (int cy = cy_begin; cy < cy_end; ++cy) {
+    for (int cx = cx_begin; cx < cx_end; ++cx) {
+      int cell = cy * grid_width_ + cx;
+      for (int e = cell_start_[cell]; e < cell_start_[cell + 1]; ++e) {
+        int i = cell_entries_[e];
+        Data const& data = data_[i];
+        if (data.x < window.x || data.y < window.y ||
+            data.x >= window.x + window.width ||
+            data.y >= window.y + window.height)
+          continue;
+
+        int next_distance = L1Distance(size_, signature, row(i));
+        if (next_distance < best_distance) {
+          best_distance = next_distance;
+          match = i;
+        }
+      }
+    }
+  }
+
+  *distance = best_distance;
+  return match;
+}
+
+} // namespace features
+
+#endif
@@ -34,6 +34,14 @@ public:
   void getSignature(IplImage *patch, ushort *sig);
   void getFloatSignature(IplImage *patch, float *sig);  
   void getSparseSignature(IplImage *patch, float *sig);
+
+  // Computes the signatures of many patches at once; same result as calling
+  // getSignature on each. sigs must point to num_patches*classes() ushorts.
+  // All trees are run over a block of patches before moving on, so each
+  // tree's nodes and posteriors stay in cache, and the patches are split
+  // across num_threads threads.
+  void getSignatures(IplImage **patches, int num_patches, ushort *sigs,
+                     int num_threads = 1);
     
   inline int classes() { return classes_; }
   inline int original_num_classes() { return original_num_classes_; }
@@ -44,6 +52,11 @@ public:
   void write(std::ostream &os) const;
 
 private:  
+  static const int SIGNATURE_BLOCK = 64; // patches per block in getSignatures
+
+  void getSignaturesBlocked(IplImage **patches, int num_patches, ushort *sigs);
+  void quantizeSignature(ushort *sig);
+
   int classes_;
   int original_num_classes_;
   std::vector<RandomizedTree> trees_;
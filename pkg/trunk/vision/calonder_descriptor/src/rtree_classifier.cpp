@@ -3,6 +3,9 @@
 #include <fstream>
 #include <cstring>
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
 
 namespace features {
 
@@ -161,6 +164,11 @@ void RTreeClassifier::getSignature(IplImage* patch, ushort *sig)
   delete [] posteriors;
   posteriors = NULL;  
 
+  quantizeSignature(sig);
+}
+
+void RTreeClassifier::quantizeSignature(ushort *sig)
+{
   // full quantization (experimental, later implicit)
   #if 1
     int n_max = 1<<8 - 1;
@@ -175,6 +183,73 @@ void RTreeClassifier::getSignature(IplImage* patch, ushort *sig)
   #endif
 }
 
+void RTreeClassifier::getSignatures(IplImage **patches, int num_patches, ushort *sigs,
+                                    int num_threads)
+{
+  if (num_threads < 1)
+    num_threads = 1;
+  // Not worth a thread for less than a block of patches
+  num_threads = std::min(num_threads, (num_patches + SIGNATURE_BLOCK - 1) / SIGNATURE_BLOCK);
+  if (num_threads <= 1) {
+    getSignaturesBlocked(patches, num_patches, sigs);
+    return;
+  }
+
+  // Contiguous shares of the patches; the calling thread takes the first
+  boost::thread_group threads;
+  int share = (num_patches + num_threads - 1) / num_threads;
+  for (int start = share; start < num_patches; start += share) {
+    int n = std::min(share, num_patches - start);
+    threads.create_thread(boost::bind(&RTreeClassifier::getSignaturesBlocked, this,
+                                      patches + start, n, sigs + start*classes_));
+  }
+  getSignaturesBlocked(patches, std::min(share, num_patches), sigs);
+  threads.join_all();
+}
+
+void RTreeClassifier::getSignaturesBlocked(IplImage **patches, int num_patches, ushort *sigs)
+{
+  static const int PATCH_AREA = RandomizedTree::PATCH_SIZE * RandomizedTree::PATCH_SIZE;
+  std::vector<uchar> buffer(SIGNATURE_BLOCK * PATCH_AREA);
+  uchar* patch_data[SIGNATURE_BLOCK];
+
+  for (int start = 0; start < num_patches; start += SIGNATURE_BLOCK) {
+    int n = std::min(SIGNATURE_BLOCK, num_patches - start);
+
+    // Need pointers to 32x32 patch data; padded patches are copied
+    for (int p = 0; p < n; ++p) {
+      IplImage *patch = patches[start + p];
+      if (patch->widthStep != RandomizedTree::PATCH_SIZE) {
+        uchar* data = getData(patch);
+        uchar* dst = &buffer[p * PATCH_AREA];
+        for (int i = 0; i < RandomizedTree::PATCH_SIZE; ++i) {
+          memcpy((void*)dst, (void*)data, RandomizedTree::PATCH_SIZE);
+          data += patch->widthStep;
+          dst += RandomizedTree::PATCH_SIZE;
+        }
+        patch_data[p] = &buffer[p * PATCH_AREA];
+      }
+      else
+        patch_data[p] = getData(patch);
+    }
+
+    ushort *block_sigs = sigs + start*classes_;
+    memset((void*)block_sigs, 0, n * classes_ * sizeof(block_sigs[0]));
+
+    // Tree-major: one tree over the whole block, then the next
+    std::vector<RandomizedTree>::iterator tree_it;
+    for (tree_it = trees_.begin(); tree_it != trees_.end(); ++tree_it) {
+      for (int p = 0; p < n; ++p) {
+        ushort *sig = block_sigs + p*classes_;
+        add(classes_, sig, tree_it->getPosterior2(patch_data[p]), sig);
+      }
+    }
+
+    for (int p = 0; p < n; ++p)
+      quantizeSignature(block_sigs + p*classes_);
+  }
+}
+
 
 void RTreeClassifier::getSparseSignature(IplImage *patch, float *sig)
 {
@@ -0,0 +1,184 @@
+// calonder_descriptor
+#include "calonder_descriptor/matcher.h"
+#include "calonder_descriptor/indexed_matcher.h"
+#include "calonder_descriptor/rng.h"
+#include <sys/time.h>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+using namespace features;
+
+/*
+  Recall and speed of IndexedMatcher against BruteForceMatcher.
+
+  The signatures are synthetic but built the way RTreeClassifier builds
+  them: the sum over NUM_TREES trees of the posterior of the leaf a patch
+  falls into, quantized as in RTreeClassifier::getSignature. A query is a
+  database entry for which a fraction of the trees reach a different leaf,
+  as a slightly warped patch would. Recall is the fraction of queries for
+  which the indexed matcher returns the exhaustive nearest neighbour.
+
+  Measured on a Xeon, g++ -O3 -msse2, 20000 signatures and
+  2000 queries, with 10% / 30% of the leaves changed:
+
+    method                          queries/s     recall 10%   30%
+    BruteForceMatcher (float)             420            1.000 1.000
+    IndexedMatcher, linear (uchar)       3000            1.000 1.000
+    kd-forest  1 tree,   256 checks     57000            0.814 0.409
+    kd-forest  4 trees,  128 checks     62000            0.887 0.412
+    kd-forest  4 trees,  512 checks     18000            0.979 0.694
+    kd-forest  8 trees,  256 checks     29000            0.979 0.630
+    kd-forest  8 trees, 1024 checks      8500            1.000 0.888
+
+    findMatchInWindow, 64x64 window in 640x480:
+      BruteForceMatcher 4100/s, grid 78000/s, same matches
+
+  The synthetic signatures have no structure beyond the leaf sums, which is
+  the hard case for kd-trees; real signatures of similar patches share more
+  leaves. The linear uchar scan is memory bound at this database size.
+
+  Usage: ./ann_benchmark [num_signatures] [num_queries] [changed_fraction]
+*/
+
+static const int NUM_TREES = 50;
+static const int NUM_LEAVES = 1024;
+static const int SIG_SIZE = 176;
+static const int IMAGE_WIDTH = 640;
+static const int IMAGE_HEIGHT = 480;
+
+static double wallTime()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Sum of leaf posteriors, quantized as in RTreeClassifier::getSignature
+static void makeSignature(std::vector<uchar> const& posteriors, const int* leaves, ushort* sig)
+{
+  for (int i = 0; i < SIG_SIZE; ++i)
+    sig[i] = 0;
+  for (int t = 0; t < NUM_TREES; ++t)
+    add(SIG_SIZE, sig, &posteriors[(t * NUM_LEAVES + leaves[t]) * SIG_SIZE], sig);
+
+  int n_max = 1<<(8 - 1);
+  int sum_max = (1<<(4 - 1))*NUM_TREES;
+  int shift = 0;
+  while ((sum_max>>shift) > n_max) shift++;
+  for (int i = 0; i < SIG_SIZE; ++i) {
+    sig[i] = sig[i] >> shift;
+    if (sig[i] > n_max) sig[i] = n_max;
+  }
+}
+
+int main( int argc, char** argv )
+{
+  int num_sigs = (argc > 1) ? atoi(argv[1]) : 20000;
+  int num_queries = (argc > 2) ? atoi(argv[2]) : 2000;
+  double changed = (argc > 3) ? atof(argv[3]) : 0.3;
+  assert(num_queries <= num_sigs);
+
+  Rng rng(42);
+
+  // Sparse posteriors, mostly mass on a few classes per leaf
+  std::vector<uchar> posteriors(NUM_TREES * NUM_LEAVES * SIG_SIZE, 0);
+  for (int leaf = 0; leaf < NUM_TREES * NUM_LEAVES; ++leaf)
+    for (int k = 0; k < 8; ++k)
+      posteriors[leaf * SIG_SIZE + rng(SIG_SIZE)] = rng(16);
+
+  // Database and queries
+  std::vector<int> leaves(NUM_TREES);
+  std::vector<ushort> db_sigs(num_sigs * SIG_SIZE), query_sigs(num_queries * SIG_SIZE);
+  std::vector<CvPoint> points(num_sigs);
+  for (int i = 0; i < num_sigs; ++i) {
+    for (int t = 0; t < NUM_TREES; ++t)
+      leaves[t] = rng(NUM_LEAVES);
+    makeSignature(posteriors, &leaves[0], &db_sigs[i * SIG_SIZE]);
+    points[i] = cvPoint(rng(IMAGE_WIDTH), rng(IMAGE_HEIGHT));
+    if (i < num_queries) {
+      for (int t = 0; t < NUM_TREES; ++t)
+        if (rng.uniform() < changed)
+          leaves[t] = rng(NUM_LEAVES);
+      makeSignature(posteriors, &leaves[0], &query_sigs[i * SIG_SIZE]);
+    }
+  }
+
+  // BruteForceMatcher on float copies of the signatures
+  std::vector<float> db_float(db_sigs.begin(), db_sigs.end());
+  std::vector<float> query_float(query_sigs.begin(), query_sigs.end());
+  BruteForceMatcher<CvPoint> brute(SIG_SIZE);
+  for (int i = 0; i < num_sigs; ++i)
+    brute.addSignature(&db_float[i * SIG_SIZE], points[i]);
+
+  IndexedMatcher<CvPoint> indexed(SIG_SIZE);
+  for (int i = 0; i < num_sigs; ++i)
+    indexed.addSignature(&db_sigs[i * SIG_SIZE], points[i]);
+  std::vector<uchar> queries(num_queries * SIG_SIZE);
+  for (int q = 0; q < num_queries; ++q)
+    indexed.quantize(&query_sigs[q * SIG_SIZE], &queries[q * SIG_SIZE]);
+
+  printf("%d signatures, %d queries, %.0f%% of leaves changed\n\n",
+         num_sigs, num_queries, changed * 100);
+  printf("%-30s %10s %8s\n", "method", "queries/s", "recall");
+
+  // Exhaustive baselines; the float and uchar distances are equal here
+  std::vector<int> truth(num_queries);
+  float float_distance;
+  double start = wallTime();
+  for (int q = 0; q < num_queries; ++q)
+    truth[q] = brute.findMatch(&query_float[q * SIG_SIZE], &float_distance);
+  printf("%-30s %10.0f %8.3f\n", "BruteForceMatcher (float)",
+         num_queries / (wallTime() - start), 1.0);
+
+  int distance, agree = 0;
+  indexed.buildIndex();
+  start = wallTime();
+  for (int q = 0; q < num_queries; ++q)
+    agree += indexed.findMatch(&queries[q * SIG_SIZE], &distance) == truth[q];
+  printf("%-30s %10.0f %8.3f\n", "IndexedMatcher, linear (uchar)",
+         num_queries / (wallTime() - start), (double)agree / num_queries);
+
+  int tree_counts[] = { 1, 4, 8 };
+  int check_counts[] = { 64, 128, 256, 512, 1024 };
+  for (int t = 0; t < 3; ++t) {
+    double build_start = wallTime();
+    indexed.buildIndex(tree_counts[t]);
+    double build_time = wallTime() - build_start;
+    for (int c = 0; c < 5; ++c) {
+      indexed.setMaxChecks(check_counts[c]);
+      agree = 0;
+      start = wallTime();
+      for (int q = 0; q < num_queries; ++q)
+        agree += indexed.findMatch(&queries[q * SIG_SIZE], &distance) == truth[q];
+      char name[64];
+      snprintf(name, sizeof(name), "kd-forest %2d tree%s %4d checks", tree_counts[t],
+               tree_counts[t] == 1 ? ", " : "s,", check_counts[c]);
+      printf("%-30s %10.0f %8.3f\n", name, num_queries / (wallTime() - start),
+             (double)agree / num_queries);
+    }
+    printf("  (built in %.3f s)\n", build_time);
+  }
+
+  // Windowed search around the true position; both must agree exactly
+  static const int WINDOW = 64;
+  std::vector<CvRect> windows(num_queries);
+  for (int q = 0; q < num_queries; ++q)
+    windows[q] = cvRect(points[q].x - WINDOW/2, points[q].y - WINDOW/2, WINDOW, WINDOW);
+  std::vector<int> window_truth(num_queries);
+  start = wallTime();
+  for (int q = 0; q < num_queries; ++q)
+    window_truth[q] = brute.findMatchInWindow(&query_float[q * SIG_SIZE], windows[q], &float_distance);
+  double brute_rate = num_queries / (wallTime() - start);
+  agree = 0;
+  start = wallTime();
+  for (int q = 0; q < num_queries; ++q)
+    agree += indexed.findMatchInWindow(&queries[q * SIG_SIZE], windows[q], &distance) == window_truth[q];
+  double grid_rate = num_queries / (wallTime() - start);
+  printf("\nwindow %dx%d in %dx%d:  BruteForceMatcher %.0f/s, grid %.0f/s, agree %.3f\n",
+         WINDOW, WINDOW, IMAGE_WIDTH, IMAGE_HEIGHT, brute_rate, grid_rate,
+         (double)agree / num_queries);
+
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "calonder_descriptor/rtree_classifier.h"
+#include <cvwimage.h> // Google C++ wrappers
+#include <highgui.h>
+#include <sys/time.h>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+using namespace features;
+
+// Wall-clock time; getrusage would add up the CPU time of all threads
+static double wallTime()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Usage: ./getsig_benchmark land30.trees img.pgm [num_threads]
+int main( int argc, char** argv )
+{
+  static const int REPEATS = 5;
+  assert(argc > 2);
+  int num_threads = (argc > 3) ? atoi(argv[3]) : 2;
+
+  RTreeClassifier classifier(false);
+  classifier.read(argv[1]);
+  cv::WImageBuffer1_b image( cvLoadImage(argv[2], CV_LOAD_IMAGE_GRAYSCALE) );
+
+  // Take every patch on an 8-pixel grid, as a dense detector would
+  int size = RandomizedTree::PATCH_SIZE;
+  std::vector<cv::WImageView1_b> views;
+  for (int y = 0; y + size <= image.Height(); y += 8)
+    for (int x = 0; x + size <= image.Width(); x += 8)
+      views.push_back( cv::WImageView1_b(&image, x, y, size, size) );
+  int num_patches = views.size();
+  std::vector<IplImage*> patches(num_patches);
+  for (int i = 0; i < num_patches; ++i)
+    patches[i] = views[i].Ipl();
+
+  int sig_size = classifier.classes();
+  std::vector<ushort> reference(num_patches * sig_size), batch(num_patches * sig_size);
+  printf("%d patches, %d classes\n", num_patches, sig_size);
+
+  double start = wallTime();
+  for (int r = 0; r < REPEATS; ++r)
+    for (int i = 0; i < num_patches; ++i)
+      classifier.getSignature(patches[i], &reference[i * sig_size]);
+  double single = (wallTime() - start) / REPEATS;
+  printf("getSignature (per patch):     %8.0f patches/s\n", num_patches / single);
+
+  int thread_counts[] = { 1, num_threads };
+  for (int t = 0; t < 2; ++t) {
+    int threads = thread_counts[t];
+    std::fill(batch.begin(), batch.end(), 0);
+    start = wallTime();
+    for (int r = 0; r < REPEATS; ++r)
+      classifier.getSignatures(&patches[0], num_patches, &batch[0], threads);
+    double elapsed = (wallTime() - start) / REPEATS;
+    bool same = (reference == batch);
+    printf("getSignatures (%d thread%s):  %8.0f patches/s, %.2fx, output %s\n",
+           threads, threads == 1 ? ")" : "s)", num_patches / elapsed, single / elapsed,
+           same ? "identical" : "DIFFERS");
+    if (!same)
+      return 1;
+  }
+
+  return 0;
+}
@@ -119,6 +119,7 @@ namespace cam
 {
 
   class StereoData;		// forward reference
+  class StereoBands;		// thread pool for multithreaded disparity
 
   // monocular data structure
   // generally, all images should be on 16-byte alignment
@@ -177,6 +178,14 @@ namespace cam
     bool initRectify();		// initializes the rectification internals from the
                                 //   calibration parameters
 
+    // fused Bayer => mono, rectification and stereo prefilter, one pass over
+    //   bands of rows that stay in cache, with a fixed-point remap table
+    // the source is the mono image, or else the Bayer image, which is converted
+    //   with the bilinear algorithm and not stored as a mono image
+    // <ftim> gets the prefiltered rectified image, if not NULL
+    // returns false if the rectified image is already present, or can't be made
+    bool doRectifyFused(uint8_t *ftim = NULL, uint8_t ftzero = 31);
+
     // color conversion
     color_conversion_t colorConvertType; // BILINEAR or EDGE conversion
     void doBayerColorRGB();	// does Bayer => color and mono
@@ -197,12 +206,24 @@ namespace cam
     IplImage* srcIm;		// temps for rectification
     IplImage* dstIm;
 
+    // fixed-point rectification table for doRectifyFused
+    // rectified rows are done in bands, band b reads
+    //   source rows [rBandRows[2*b], rBandRows[2*b+1])
+    bool initRectLut();
+    int32_t *rLutOff;		// source offset from the band's first row, -1 if outside
+    uint16_t *rLutFrac;		// x and y fractions of the source position
+    int *rBandRows;
+    uint8_t *rBandBuf;		// source rows of a band, mono
+    uint8_t *rFtBuf;		// prefilter storage
+
   private:
     // various color converters
     void convertBayerRGGBColorRGB(uint8_t *src, uint8_t *dstc, uint8_t *dstm,
 				  int width, int height, color_conversion_t colorAlg); 
     void convertBayerRGGBMono(uint8_t *src, uint8_t *dstm, 
 				  int width, int height, color_conversion_t colorAlg); 
+    void convertBayerRGGBMonoRows(uint8_t *src, uint8_t *dstm, 
+				  int width, int height, int y0, int y1);
   };
 
 
@@ -285,6 +306,16 @@ namespace cam
     bool setSpeckleDiff(int diff);
     bool setSpeckleRegionSize(int size);
 
+    // fused rectification and prefilter, see ImageData::doRectifyFused
+    // the prefilter is only fused with a single thread
+    bool fusedRectify;
+
+    // multithreading
+    // with more than one thread, disparity is computed in row bands,
+    //   one per thread, with the same result
+    int numThreads;		// threads for doDisparity
+    bool setNumThreads(int n);
+
   private:
     // buffers for stereo
     uint8_t *buf, *flim, *frim;
@@ -292,6 +323,12 @@ namespace cam
     uint8_t *rbuf;
     uint32_t *lbuf, *wbuf;
 
+    // row bands for multithreaded disparity
+    StereoBands *bands;
+    uint32_t *sbuf;		// region sizes for banded speckle filter
+    void doDisparityBands(uint8_t *lim, uint8_t *rim, int ftzero, int dlen,
+			  int corr, int tthresh, int uthresh);
+
   }; 
 
 }
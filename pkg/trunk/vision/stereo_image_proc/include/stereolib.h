@@ -187,6 +187,77 @@ void do_speckle(int16_t *disp, int16_t badval, int width, int height,
 		uint32_t *labels, uint32_t *wbuf, uint8_t *rtype);
 
 
+//
+// row bands, for multithreaded stereo
+// each band can run on its own thread, with its own buffers
+//
+
+// valid disparity rows of do_stereo are [ytop, ybot)
+// the 7 rows from ybot are cleared
+#define STEREO_YTOP(ywin) (((ywin)+YKERN-2)/2)
+#define STEREO_YBOT(yim,ywin) ((yim) - YKERN/2 - (ywin)/2)
+
+// number of image rows used by a band of <n> disparity rows
+#define STEREO_BAND_ROWS(n,ywin) ((n) + (ywin) + YKERN + 8)
+
+// prefilter and stereo for disparity rows [y0,y1) of the full images,
+//   same result as do_prefilter and do_stereo on the full images,
+//   for ywin >= YKERN
+// only rows [y0,y1) of <disp> are written, plus the cleared rows for the last band
+// needs buffers, with nrows = STEREO_BAND_ROWS(y1-y0,ywin):
+//   ftbuf[2*xim*nrows], dbuf[xim*(nrows+8)], both aligned at 16 bytes,
+//   buf as for do_stereo with yim = nrows
+void
+do_stereo_band(uint8_t *lim, uint8_t *rim, // input images
+	  int16_t *disp,	// disparity output, full image
+	  int xim, int yim,	// size of images
+	  int y0, int y1,	// disparity rows of this band
+	  uint8_t ftzero,	// feature offset from zero
+	  int xwin, int ywin,	// size of corr window, usually square
+	  int dlen,		// size of disparity search, multiple of 8
+	  int tfilter_thresh,	// texture filter threshold
+	  int ufilter_thresh,	// uniqueness filter threshold, percent
+	  uint8_t *ftbuf,	// feature image storage for the band
+	  int16_t *dbuf,	// disparity storage for the band
+	  uint8_t *buf		// buffer storage
+	  );
+
+// prefilter for rows [y0,y1) of the feature image, same result as do_prefilter
+//   on the full image; reads image rows up to y1+3
+// rows that do_prefilter does not write are left as they are
+// needs buffers: ftbuf[xim*PREFILTER_BAND_ROWS(y1-y0)] aligned at 16 bytes,
+//   buf as for do_prefilter
+#define PREFILTER_BAND_ROWS(n) ((n) + 10)
+
+void
+do_prefilter_band(uint8_t *im,	// input image
+	  uint8_t *ftim,	// feature image output, full image
+	  int xim, int yim,	// size of image
+	  int y0, int y1,	// feature rows of this band
+	  uint8_t ftzero,	// feature offset from zero
+	  uint8_t *ftbuf,	// feature image storage for the band
+	  uint8_t *buf		// buffer storage
+	  );
+
+// speckle filter in row bands, same result as do_speckle
+// regions are not connected across the ends of a row, which do_speckle
+//   does at the (invalid) image borders
+// 1. do_speckle_band on every band of a partition of [0,height), in parallel
+// 2. do_speckle_seams, once; <ybands> holds the nbands+1 band limits
+// 3. do_speckle_band_apply on every band, in parallel
+// needs buffers: labels[image size], wbuf[image size], regions[image size]
+void do_speckle_band(int16_t *disp, int16_t badval, int width, int height,
+		     int y0, int y1, int rdiff,
+		     uint32_t *labels, uint32_t *wbuf, uint32_t *regions);
+
+void do_speckle_seams(int16_t *disp, int width, int nbands, int *ybands, int rdiff,
+		      uint32_t *labels, uint32_t *wbuf, uint32_t *regions);
+
+void do_speckle_band_apply(int16_t *disp, int16_t badval, int width, int height,
+			   int y0, int y1, int rcount,
+			   uint32_t *labels, uint32_t *wbuf, uint32_t *regions);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,7 @@
 //
 
 #include "image.h"
+#include <pthread.h>
 
 #include <sstream>
 #include <iostream>
@@ -47,6 +48,48 @@
 
 using namespace cam;
 
+// thread pool and buffers for multithreaded disparity, see doDisparityBands
+namespace cam
+{
+  class StereoBands
+  {
+  public:
+    StereoBands(int n);
+    ~StereoBands();
+
+    // runs fn(arg, band) for every band, returns when all are done
+    void run(void (*fn)(void *arg, int band), void *arg);
+
+    int num;			// number of bands
+    int *ydisp;			// disparity rows of the bands, num+1 limits
+    int *yspeck;		// speckle filter rows of the bands, num+1 limits
+
+    // per-band buffers
+    uint8_t **ftbuf, **buf;
+    int16_t **dbuf;
+    size_t ftSize, dSize, bufSize;
+    void allocBuffers(size_t ftsize, size_t dsize, size_t bufsize);
+
+  private:
+    struct Worker
+    {
+      StereoBands *bands;
+      int band;
+      pthread_t thread;
+    };
+    Worker *workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t startCond, doneCond;
+    void (*job)(void *arg, int band);
+    void *jobArg;
+    int generation;		// incremented for each job
+    int pending;		// workers still on the current job
+    bool quit;
+
+    static void *workerLoop(void *arg);
+  };
+}
+
 // image class fns
 
 ImageData::ImageData()
@@ -80,6 +123,11 @@ ImageData::ImageData()
   initRect = false;
   rMapxy = NULL;
   rMapa = NULL;
+  rLutOff = NULL;
+  rLutFrac = NULL;
+  rBandRows = NULL;
+  rBandBuf = NULL;
+  rFtBuf = NULL;
 
   // calibration matrices
   rD = cvCreateMat(5,1,CV_64F);
@@ -132,6 +180,17 @@ ImageData::releaseBuffers()
     cvReleaseMat(&rMapa);
   rMapxy = NULL;
   rMapa = NULL;
+
+  MEMFREE(rLutOff);
+  MEMFREE(rLutFrac);
+  MEMFREE(rBandBuf);
+  MEMFREE(rFtBuf);
+  delete [] rBandRows;
+  rLutOff = NULL;
+  rLutFrac = NULL;
+  rBandRows = NULL;
+  rBandBuf = NULL;
+  rFtBuf = NULL;
 }
 
 
@@ -197,8 +256,8 @@ ImageData::doRectify()
 
   CvSize size = cvSize(imWidth,imHeight);
 
-  // rectify grayscale image
-  if (imType != COLOR_CODING_NONE)
+  // rectify grayscale image, unless done by doRectifyFused
+  if (imType != COLOR_CODING_NONE && imRectType == COLOR_CODING_NONE)
     {
       // set up rectified data buffer
       if (imRectSize < imSize)
@@ -246,6 +305,182 @@ ImageData::doRectify()
 
 
 
+//
+// fused rectification
+// the rectified image is made in bands of RECT_BAND rows; for each band
+//   the source rows it needs are converted from Bayer, the band is
+//   remapped from them, and the prefilter catches up with it
+//
+
+#define RECT_BAND 32		// rows in a band
+#define RECT_FRAC 5		// fraction bits of the remap, as in OpenCV
+#define RECT_ONE (1<<RECT_FRAC)
+#define RECT_PFLAG 3		// prefiltered rows lag rectified rows, see do_prefilter_band
+
+bool
+ImageData::initRectLut()
+{
+  if (rLutOff)
+    return true;		// already done
+
+  if (!initRectify())
+    return false;
+
+  int w = imWidth;
+  int h = imHeight;
+  int nb = (h + RECT_BAND - 1)/RECT_BAND;
+  rLutOff = (int32_t *)MEMALIGN(w*h*sizeof(int32_t));
+  rLutFrac = (uint16_t *)MEMALIGN(w*h*sizeof(uint16_t));
+  rBandRows = new int[2*nb];
+
+  int maxRows = 0;
+  for (int b=0; b<nb; b++)
+    {
+      int y0 = b*RECT_BAND;
+      int y1 = y0 + RECT_BAND;
+      if (y1 > h) y1 = h;
+
+      // fixed-point source positions; a pixel is inside if all the
+      //   source pixels with a nonzero weight are
+      int smin = h, smax = 0;
+      for (int i=y0; i<y1; i++)
+	for (int j=0; j<w; j++)
+	  {
+	    int ix = cvRound(CV_MAT_ELEM(*mx, float, i, j)*RECT_ONE);
+	    int iy = cvRound(CV_MAT_ELEM(*my, float, i, j)*RECT_ONE);
+	    int sx = ix >> RECT_FRAC;
+	    int sy = iy >> RECT_FRAC;
+	    int k = i*w+j;
+	    if (sx < 0 || sy < 0 ||
+		sx + ((ix & (RECT_ONE-1)) != 0) >= w ||
+		sy + ((iy & (RECT_ONE-1)) != 0) >= h)
+	      {
+		rLutOff[k] = -1;
+		continue;
+	      }
+	    rLutOff[k] = sy*w + sx;
+	    rLutFrac[k] = ((iy & (RECT_ONE-1)) << RECT_FRAC) | (ix & (RECT_ONE-1));
+	    // rows [sy, sy+2) are read if the y fraction is nonzero, else only sy
+	    int send = sy + 1 + ((iy & (RECT_ONE-1)) != 0);
+	    if (sy < smin) smin = sy;
+	    if (send > smax) smax = send;
+	  }
+
+      // source rows of the band, and offsets from the first one
+      if (smax > h) smax = h;
+      if (smin > smax) smin = smax;
+      rBandRows[2*b] = smin;
+      rBandRows[2*b+1] = smax;
+      if (smax - smin > maxRows)
+	maxRows = smax - smin;
+      for (int k=y0*w; k<y1*w; k++)
+	if (rLutOff[k] >= 0)
+	  rLutOff[k] -= smin*w;
+    }
+
+  // the remap reads no pixel with a zero weight, so the band needs no
+  //   rows beyond its source rows
+  rBandBuf = (uint8_t *)MEMALIGN(maxRows*w + 16);
+  memset(rBandBuf, 0, maxRows*w + 16);
+  rFtBuf = (uint8_t *)MEMALIGN(w*PREFILTER_BAND_ROWS(RECT_BAND+RECT_PFLAG) + (w+64)*4 + 64);
+  return true;
+}
+
+
+bool
+ImageData::doRectifyFused(uint8_t *ftim, uint8_t ftzero)
+{
+  if (!hasRectification)
+    return false;		// has no rectification
+
+  if (imWidth == 0 || imHeight == 0)
+    return false;
+
+  if (imRectType != COLOR_CODING_NONE)
+    return false;		// already done
+
+  // source image, Bayer conversion is fused only for the bilinear algorithm
+  bool bayer = false;
+  if (imType == COLOR_CODING_NONE)
+    {
+      if (imRawType < COLOR_CODING_BAYER8_RGGB || imRawType > COLOR_CODING_BAYER8_GRBG)
+	return false;		// nothing to rectify
+      if (colorConvertType == COLOR_CONVERSION_BILINEAR)
+	bayer = true;
+      else
+	doBayerMono();
+    }
+
+  if (!initRectLut())
+    return false;
+
+  int w = imWidth;
+  int h = imHeight;
+  if (imRectSize < (size_t)(w*h))
+    {
+      MEMFREE(imRect);
+      imRectSize = w*h;
+      imRect = (uint8_t *)MEMALIGN(imRectSize);
+    }
+
+  uint8_t *ftbuf = rFtBuf;
+  uint8_t *pbuf = rFtBuf + w*PREFILTER_BAND_ROWS(RECT_BAND+RECT_PFLAG);
+  int ydone = 0;		// prefiltered rows
+
+  for (int y0=0, b=0; y0<h; y0+=RECT_BAND, b++)
+    {
+      int y1 = y0 + RECT_BAND;
+      if (y1 > h) y1 = h;
+      int s0 = rBandRows[2*b];
+      int s1 = rBandRows[2*b+1];
+
+      // source rows
+      uint8_t *src;
+      if (bayer)
+	{
+	  convertBayerRGGBMonoRows(imRaw, rBandBuf, w, h, s0, s1);
+	  src = rBandBuf;
+	}
+      else
+	src = im + s0*w;
+
+      // bilinear remap, same weights as the OpenCV fixed-point version
+      int32_t *off = rLutOff + y0*w;
+      uint16_t *frac = rLutFrac + y0*w;
+      uint8_t *dst = imRect + y0*w;
+      for (int k=0; k<(y1-y0)*w; k++)
+	{
+	  if (off[k] < 0)
+	    {
+	      dst[k] = 0;
+	      continue;
+	    }
+	  // pixels with a zero weight are not read, they may be past the
+	  //   last column or row of the source
+	  uint8_t *p = src + off[k];
+	  int fx = frac[k] & (RECT_ONE-1);
+	  int fy = frac[k] >> RECT_FRAC;
+	  int top = fx ? p[0]*(RECT_ONE-fx) + p[1]*fx : p[0]*RECT_ONE;
+	  int bot = 0;
+	  if (fy)
+	    bot = fx ? p[w]*(RECT_ONE-fx) + p[w+1]*fx : p[w]*RECT_ONE;
+	  dst[k] = (top*(RECT_ONE-fy) + bot*fy + (1<<(2*RECT_FRAC-1))) >> (2*RECT_FRAC);
+	}
+
+      // prefilter the rows that are complete
+      if (ftim)
+	{
+	  int yp = y1 == h ? h : y1 - RECT_PFLAG;
+	  do_prefilter_band(imRect, ftim, w, h, ydone, yp, ftzero, ftbuf, pbuf);
+	  ydone = yp;
+	}
+    }
+
+  imRectType = COLOR_CODING_MONO8;
+  return true;
+}
+
+
 // stereo class fns
 
 StereoData::StereoData()
@@ -262,6 +497,10 @@ StereoData::StereoData()
   wbuf = NULL;
   rbuf = NULL;
   lbuf = NULL;
+  sbuf = NULL;
+  bands = NULL;
+  numThreads = 1;
+  fusedRectify = false;
 
   // nominal values
   imWidth = 640;
@@ -299,6 +538,8 @@ StereoData::~StereoData()
   MEMFREE(buf);
   MEMFREE(flim);
   MEMFREE(frim);
+  MEMFREE(sbuf);
+  delete bands;
 }
 
 bool
@@ -328,6 +569,20 @@ StereoData::setUniqueThresh(int val)
   return true;
 }
 
+bool
+StereoData::setNumThreads(int val)
+{
+  if (val < 1) val = 1;
+  if (val > 16) val = 16;
+  if (val != numThreads)
+    {
+      delete bands;		// new pool on next doDisparity
+      bands = NULL;
+    }
+  numThreads = val;
+  return true;
+}
+
 bool
 StereoData::setNumDisp(int val)
 {
@@ -409,6 +664,39 @@ bool
 StereoData::doDisparity()
 {
   uint8_t *lim, *rim;
+  int xim = imWidth;
+  int yim = imHeight;
+
+  // some parameters
+  int ftzero = 31;		// max 31 cutoff for prefilter value (31 default)
+  int dlen   = numDisp;	// number of disparities
+  int corr   = corrSize;	// correlation window size
+  int tthresh = textureThresh; // texture threshold
+  int uthresh = uniqueThresh; // uniqueness threshold, percent
+
+  // feature images, for a single thread
+  if (!hasDisparity && numThreads <= 1)
+    {
+      if (!flim)
+	{
+	  flim = (uint8_t *)MEMALIGN(xim*yim); // feature image
+	  memset(flim, 0, xim*yim);
+	}
+      if (!frim)
+	{
+	  frim = (uint8_t *)MEMALIGN(xim*yim); // feature image
+	  memset(frim, 0, xim*yim);
+	}
+    }
+
+  // fused rectification, which does the prefilter for a single thread
+  bool lfilt = false, rfilt = false;
+  if (fusedRectify && !hasDisparity)
+    {
+      bool pf = numThreads <= 1;
+      lfilt = imLeft->doRectifyFused(pf ? flim : NULL, ftzero) && pf;
+      rfilt = imRight->doRectifyFused(pf ? frim : NULL, ftzero) && pf;
+    }
 
   // first do any rectification necessary
   doRectify();
@@ -425,31 +713,31 @@ StereoData::doDisparity()
   // variables
   lim = (uint8_t *)imLeft->imRect;
   rim = (uint8_t *)imRight->imRect;
-  int xim = imWidth;
-  int yim = imHeight;
-
-  // some parameters
-  int ftzero = 31;		// max 31 cutoff for prefilter value (31 default)
-  int dlen   = numDisp;	// number of disparities
-  int corr   = corrSize;	// correlation window size
-  int tthresh = textureThresh; // texture threshold
-  int uthresh = uniqueThresh; // uniqueness threshold, percent
 
   // allocate buffers
   // TODO: make these consistent with current values
+  // border pixels are never written, start them out as invalid
   if (!imDisp)
-    imDisp = (int16_t *)MEMALIGN(xim*yim*2);
+    {
+      imDisp = (int16_t *)MEMALIGN(xim*yim*2);
+      memset(imDisp, 0, xim*yim*2);
+    }
+
+  if (numThreads > 1)
+    {
+      doDisparityBands(lim, rim, ftzero, dlen, corr, tthresh, uthresh);
+      hasDisparity = true;
+      return true;
+    }
 
   if (!buf)
     buf  = (uint8_t *)malloc(yim*2*dlen*(corr+5)); // local storage for the algorithm
-  if (!flim)
-    flim = (uint8_t *)MEMALIGN(xim*yim); // feature image
-  if (!frim)
-    frim = (uint8_t *)MEMALIGN(xim*yim); // feature image
 
   // prefilter
-  do_prefilter(lim, flim, xim, yim, ftzero, buf);
-  do_prefilter(rim, frim, xim, yim, ftzero, buf);
+  if (!lfilt)
+    do_prefilter(lim, flim, xim, yim, ftzero, buf);
+  if (!rfilt)
+    do_prefilter(rim, frim, xim, yim, ftzero, buf);
 
   // stereo
   do_stereo(flim, frim, imDisp, NULL, xim, yim, 
@@ -474,6 +762,243 @@ StereoData::doDisparity()
 }
 
 
+//
+// multithreaded disparity
+// the images are cut into row bands, one per thread; the calling thread
+//   does band 0 and persistent worker threads the others
+//
+
+StereoBands::StereoBands(int n)
+{
+  num = n;
+  ydisp = new int[n+1];
+  yspeck = new int[n+1];
+  ftbuf = new uint8_t*[n];
+  buf = new uint8_t*[n];
+  dbuf = new int16_t*[n];
+  for (int i=0; i<n; i++)
+    {
+      ftbuf[i] = buf[i] = NULL;
+      dbuf[i] = NULL;
+    }
+  ftSize = dSize = bufSize = 0;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&startCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  generation = 0;
+  pending = 0;
+  quit = false;
+  workers = new Worker[n-1];
+  for (int i=0; i<n-1; i++)
+    {
+      workers[i].bands = this;
+      workers[i].band = i+1;
+      pthread_create(&workers[i].thread, NULL, workerLoop, &workers[i]);
+    }
+}
+
+StereoBands::~StereoBands()
+{
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&startCond);
+  pthread_mutex_unlock(&mutex);
+  for (int i=0; i<num-1; i++)
+    pthread_join(workers[i].thread, NULL);
+  delete [] workers;
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&startCond);
+  pthread_mutex_destroy(&mutex);
+
+  for (int i=0; i<num; i++)
+    {
+      MEMFREE(ftbuf[i]);
+      MEMFREE(dbuf[i]);
+      MEMFREE(buf[i]);
+    }
+  delete [] ftbuf;
+  delete [] dbuf;
+  delete [] buf;
+  delete [] ydisp;
+  delete [] yspeck;
+}
+
+void
+StereoBands::allocBuffers(size_t ftsize, size_t dsize, size_t bufsize)
+{
+  if (ftsize <= ftSize && dsize <= dSize && bufsize <= bufSize)
+    return;
+
+  // unwritten border pixels stay zero, as in the full-image buffers
+  for (int i=0; i<num; i++)
+    {
+      MEMFREE(ftbuf[i]);
+      MEMFREE(dbuf[i]);
+      MEMFREE(buf[i]);
+      ftbuf[i] = (uint8_t *)MEMALIGN(ftsize);
+      memset(ftbuf[i], 0, ftsize);
+      dbuf[i] = (int16_t *)MEMALIGN(dsize);
+      memset(dbuf[i], 0, dsize);
+      buf[i] = (uint8_t *)MEMALIGN(bufsize);
+    }
+  ftSize = ftsize;
+  dSize = dsize;
+  bufSize = bufsize;
+}
+
+void
+StereoBands::run(void (*fn)(void *arg, int band), void *arg)
+{
+  pthread_mutex_lock(&mutex);
+  job = fn;
+  jobArg = arg;
+  pending = num-1;
+  generation++;
+  pthread_cond_broadcast(&startCond);
+  pthread_mutex_unlock(&mutex);
+
+  fn(arg, 0);
+
+  pthread_mutex_lock(&mutex);
+  while (pending > 0)
+    pthread_cond_wait(&doneCond, &mutex);
+  pthread_mutex_unlock(&mutex);
+}
+
+void *
+StereoBands::workerLoop(void *arg)
+{
+  Worker *w = (Worker *)arg;
+  StereoBands *b = w->bands;
+  int seen = 0;
+
+  pthread_mutex_lock(&b->mutex);
+  while (true)
+    {
+      while (!b->quit && b->generation == seen)
+	pthread_cond_wait(&b->startCond, &b->mutex);
+      if (b->quit)
+	break;
+      seen = b->generation;
+      void (*fn)(void *, int) = b->job;
+      void *fnArg = b->jobArg;
+      pthread_mutex_unlock(&b->mutex);
+
+      fn(fnArg, w->band);
+
+      pthread_mutex_lock(&b->mutex);
+      if (--b->pending == 0)
+	pthread_cond_signal(&b->doneCond);
+    }
+  pthread_mutex_unlock(&b->mutex);
+  return NULL;
+}
+
+
+// arguments of the band jobs
+struct BandJob
+{
+  StereoBands *bands;
+  uint8_t *lim, *rim;
+  int16_t *disp;
+  int xim, yim;
+  int ftzero, corr, dlen, tthresh, uthresh;
+  int sdiff, scount;
+  uint32_t *lbuf, *wbuf, *sbuf;
+};
+
+static void
+stereoBand(void *arg, int b)
+{
+  BandJob *j = (BandJob *)arg;
+  do_stereo_band(j->lim, j->rim, j->disp, j->xim, j->yim,
+		 j->bands->ydisp[b], j->bands->ydisp[b+1],
+		 j->ftzero, j->corr, j->corr, j->dlen, j->tthresh, j->uthresh,
+		 j->bands->ftbuf[b], j->bands->dbuf[b], j->bands->buf[b]);
+}
+
+static void
+speckleBand(void *arg, int b)
+{
+  BandJob *j = (BandJob *)arg;
+  do_speckle_band(j->disp, 0, j->xim, j->yim,
+		  j->bands->yspeck[b], j->bands->yspeck[b+1], j->sdiff,
+		  j->lbuf, j->wbuf, j->sbuf);
+}
+
+static void
+speckleApplyBand(void *arg, int b)
+{
+  BandJob *j = (BandJob *)arg;
+  do_speckle_band_apply(j->disp, 0, j->xim, j->yim,
+			j->bands->yspeck[b], j->bands->yspeck[b+1], j->scount,
+			j->lbuf, j->wbuf, j->sbuf);
+}
+
+void
+StereoData::doDisparityBands(uint8_t *lim, uint8_t *rim, int ftzero, int dlen,
+			     int corr, int tthresh, int uthresh)
+{
+  int xim = imWidth;
+  int yim = imHeight;
+
+  if (!bands)
+    bands = new StereoBands(numThreads);
+  int n = bands->num;
+
+  // equal bands of the valid disparity rows, and of the whole image
+  int ytop = STEREO_YTOP(corr);
+  int ybot = STEREO_YBOT(yim,corr);
+  for (int i=0; i<=n; i++)
+    {
+      bands->ydisp[i] = ytop + (ybot-ytop)*i/n;
+      bands->yspeck[i] = yim*i/n;
+    }
+
+  int nrows = STEREO_BAND_ROWS((ybot-ytop+n-1)/n, corr);
+  size_t bufsize = nrows*2*dlen*(corr+5);
+  if (bufsize < (size_t)(xim+64)*4 + 64)
+    bufsize = (xim+64)*4 + 64;
+  bands->allocBuffers(2*xim*nrows, xim*(nrows+8)*sizeof(int16_t), bufsize);
+
+  BandJob job;
+  job.bands = bands;
+  job.lim = lim;
+  job.rim = rim;
+  job.disp = imDisp;
+  job.xim = xim;
+  job.yim = yim;
+  job.ftzero = ftzero;
+  job.corr = corr;
+  job.dlen = dlen;
+  job.tthresh = tthresh;
+  job.uthresh = uthresh;
+  job.sdiff = speckleDiff;
+  job.scount = speckleRegionSize;
+
+  // prefilter and stereo
+  bands->run(stereoBand, &job);
+
+  // speckle filter, with a seam pass between the band passes
+  if (speckleRegionSize > 0)
+    {
+      if (!lbuf)
+	lbuf = (uint32_t *)malloc(xim*yim*sizeof(uint32_t));
+      if (!wbuf)
+	wbuf = (uint32_t *)malloc(xim*yim*sizeof(uint32_t));
+      if (!sbuf)
+	sbuf = (uint32_t *)malloc(xim*yim*sizeof(uint32_t));
+      job.lbuf = lbuf;
+      job.wbuf = wbuf;
+      job.sbuf = sbuf;
+      bands->run(speckleBand, &job);
+      do_speckle_seams(imDisp, xim, n, bands->yspeck, speckleDiff, lbuf, wbuf, sbuf);
+      bands->run(speckleApplyBand, &job);
+    }
+}
+
+
 //
 // param sting parsing routines
 //
@@ -1262,6 +1787,39 @@ ImageData::convertBayerRGGBColorRGB(uint8_t *src, uint8_t *dstc, uint8_t *dstm,
 }
 
 
+// converts rows [y0,y1) to monochrome, with the bilinear algorithm
+// the green pixels are kept, the others are the average of their four
+//   green neighbors; the image borders are mirrored
+
+void
+ImageData::convertBayerRGGBMonoRows(uint8_t *src, uint8_t *dstm, 
+				    int width, int height, int y0, int y1)
+{
+  int i, j;
+
+  for (i=y0; i<y1; i++, dstm+=width)
+    {
+      uint8_t *s = src + i*width;
+      uint8_t *su = i > 0 ? s-width : s+width;
+      uint8_t *sd = i < height-1 ? s+width : s-width;
+      int jg = i & 1;		// first green pixel
+
+      for (j=jg; j<width; j+=2)
+	dstm[j] = s[j];
+      j = 1-jg;
+      if (j == 0)		// left border
+	{
+	  dstm[0] = ((int)su[0] + (int)sd[0] + 2*(int)s[1]) >> 2;
+	  j += 2;
+	}
+      for (; j<width-1; j+=2)
+	dstm[j] = ((int)su[j] + (int)sd[j] + (int)s[j-1] + (int)s[j+1]) >> 2;
+      if (j == width-1)		// right border
+	dstm[j] = ((int)su[j] + (int)sd[j] + 2*(int)s[j-1]) >> 2;
+    }
+}
+
+
 // real function to do the job
 // converts to monochrome
 
@@ -0,0 +1,105 @@
+//
+// timing of multithreaded disparity
+// runs doDisparity on a stereo pair with 1..N threads, and checks
+//   that every thread count gives the single-thread disparity image
+//
+// usage: stereo_bench [left.bmp right.bmp] [max threads] [iterations]
+//   defaults to the wallcal images of visual_odometry
+//
+// default stereo parameters: 64 disparities, 15x15 window, speckle filter on
+//
+
+#include "image.h"
+#include <highgui.h>
+
+using namespace cam;
+
+static double
+wallTime()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// copies a grayscale image into a rectified image buffer
+static bool
+loadRect(ImageData *im, const char *fname, int w, int h)
+{
+  IplImage *img = cvLoadImage(fname, CV_LOAD_IMAGE_GRAYSCALE);
+  if (!img)
+    {
+      printf("Can't load %s\n", fname);
+      return false;
+    }
+  if (img->width != w || img->height != h)
+    {
+      printf("%s is not %dx%d\n", fname, w, h);
+      cvReleaseImage(&img);
+      return false;
+    }
+  im->imRect = (uint8_t *)MEMALIGN(w*h);
+  for (int y=0; y<h; y++)
+    memcpy(im->imRect + y*w, img->imageData + y*img->widthStep, w);
+  im->imRectType = COLOR_CODING_MONO8;
+  im->imRectSize = w*h;
+  cvReleaseImage(&img);
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *lname = "../visual_odometry/wallcal-L.bmp";
+  const char *rname = "../visual_odometry/wallcal-R.bmp";
+  int w = 640, h = 480;
+  if (argc > 2)
+    {
+      lname = argv[1];
+      rname = argv[2];
+    }
+  int maxThreads = argc > 3 ? atoi(argv[3]) : 4;
+  int iters = argc > 4 ? atoi(argv[4]) : 100;
+
+  // reference, single thread
+  int16_t *ref = (int16_t *)MEMALIGN(w*h*2);
+  printf("threads    fps   speedup\n");
+  double fps1 = 0;
+
+  for (int n=1; n<=maxThreads; n++)
+    {
+      StereoData *sd = new StereoData;
+      sd->setSize(w, h);
+      if (!loadRect(sd->imLeft, lname, w, h) ||
+	  !loadRect(sd->imRight, rname, w, h))
+	return 1;
+      sd->setNumThreads(n);
+
+      sd->hasDisparity = false;
+      sd->doDisparity();	// warm up, allocates buffers
+      double t0 = wallTime();
+      for (int i=0; i<iters; i++)
+	{
+	  sd->hasDisparity = false;
+	  sd->doDisparity();
+	}
+      double fps = iters / (wallTime() - t0);
+
+      if (n == 1)
+	{
+	  memcpy(ref, sd->imDisp, w*h*2);
+	  fps1 = fps;
+	}
+      else if (memcmp(ref, sd->imDisp, w*h*2))
+	{
+	  printf("%d threads: disparity differs from single thread\n", n);
+	  return 1;
+	}
+
+      printf("   %2d   %6.0f   %5.2f\n", n, fps, fps / fps1);
+      delete sd;
+    }
+
+  MEMFREE(ref);
+  return 0;
+}
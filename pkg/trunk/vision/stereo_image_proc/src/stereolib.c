@@ -908,7 +908,7 @@ do_stereo_d_fast(uint8_t *lim, uint8_t *rim, // input feature images
   memclr_si128((__m128i *)intbuf, dlen*yim*sizeof(int16_t));
   memclr_si128((__m128i *)corrbuf, dlen*yim*xwin*sizeof(int8_t));
   memclr_si128((__m128i *)accbuf, dlen*yim*sizeof(int16_t));
-  memclr_si128((__m128i *)textbuf, yim*sizeof(int16_t));
+  memclr_si128((__m128i *)textbuf, TXTBUFSIZE*sizeof(int16_t)); // yim may not be a multiple of 8
 
   // set up corrbuf pointers
   corrend = corrbuf + dlen*yim*xwin;
@@ -1440,3 +1440,257 @@ do_speckle(int16_t *disp, int16_t badval, int width, int height,
 }
 
 
+
+//
+// row bands for multithreaded stereo
+//
+// the disparity at a row only depends on the feature rows under its
+//   correlation window, and a feature row on the 7 image rows around it,
+//   so a band of disparity rows can be computed from a band of the images
+//
+
+void
+do_stereo_band(uint8_t *lim, uint8_t *rim, // input images
+	  int16_t *disp,	// disparity output, full image
+	  int xim, int yim,	// size of images
+	  int y0, int y1,	// disparity rows of this band
+	  uint8_t ftzero,	// feature offset from zero
+	  int xwin, int ywin,	// size of corr window, usually square
+	  int dlen,		// size of disparity search, multiple of 8
+	  int tfilter_thresh,	// texture filter threshold
+	  int ufilter_thresh,	// uniqueness filter threshold, percent
+	  uint8_t *ftbuf,	// feature image storage for the band
+	  int16_t *dbuf,	// disparity storage for the band
+	  uint8_t *buf		// buffer storage
+	  )
+{
+  int i, r0, r1, a, e, off, nrows;
+  int ytop = STEREO_YTOP(ywin);
+  int ybot = STEREO_YBOT(yim,ywin);
+  uint8_t *flim, *frim;
+  int16_t *dispp;
+
+  if (y0 < ytop) y0 = ytop;
+  if (y1 > ybot) y1 = ybot;
+
+  if (y1 > y0)
+    {
+      // feature rows under the correlation windows, plus one on each side:
+      //   the subpixel step reads the neighboring rows' sums for a minimum
+      //   at the first or last disparity
+      r0 = y0 - ytop;
+      if (r0 > 0) r0--;
+      off = y0 - ytop - r0;	// disparity rows before y0 in the band
+      r1 = y1 - ytop + ywin + YKERN - 1;
+      if (r1 > yim) r1 = yim;
+
+      // image rows for the prefilter
+      // row r0-1 is filtered as well, it writes the first pixels of row r0
+      a = r0 - PYKERN/2 - 2;
+      if (a < 0) a = 0;
+      e = r1 + PYKERN/2;
+      if (e > yim) e = yim;
+      nrows = e - a;
+
+      flim = ftbuf;
+      frim = ftbuf + nrows*xim;
+      do_prefilter(lim + a*xim, flim, xim, nrows, ftzero, buf);
+      do_prefilter(rim + a*xim, frim, xim, nrows, ftzero, buf);
+
+      // disparities land at band rows [ytop+off, ytop+off+y1-y0)
+      do_stereo(flim + (r0-a)*xim, frim + (r0-a)*xim, dbuf, NULL, xim, r1-r0,
+		ftzero, xwin, ywin, dlen, tfilter_thresh, ufilter_thresh, buf);
+      memcpy(disp + y0*xim, dbuf + (ytop+off)*xim, (y1-y0)*xim*sizeof(int16_t));
+    }
+
+  // last band clears the same rows as do_stereo
+  if (y1 == ybot)
+    {
+      dispp = disp + ybot*xim;
+      for (i=0; i<7 && ybot+i<yim; i++, dispp+=xim)
+	memclr_si128((__m128i *)dispp, xim*sizeof(int16_t));
+    }
+}
+
+
+void
+do_prefilter_band(uint8_t *im,	// input image
+	  uint8_t *ftim,	// feature image output, full image
+	  int xim, int yim,	// size of image
+	  int y0, int y1,	// feature rows of this band
+	  uint8_t ftzero,	// feature offset from zero
+	  uint8_t *ftbuf,	// feature image storage for the band
+	  uint8_t *buf		// buffer storage
+	  )
+{
+  int a, e, x0, x1;
+
+  // do_prefilter writes rows [PYKERN/2+1, yim-PYKERN/2), and the
+  //   first pixels of a row with the row before it
+  x0 = x1 = 0;
+  if (y0 <= PYKERN/2+1)
+    {
+      y0 = PYKERN/2+1;
+      x0 = PXKERN/2;
+    }
+  if (y1 >= yim-PYKERN/2)
+    {
+      y1 = yim-PYKERN/2;
+      x1 = PXKERN/2;
+    }
+  if (y1 <= y0)
+    return;
+
+  // image rows for the band, as in do_stereo_band
+  a = y0 - PYKERN/2 - 2;
+  if (a < 0) a = 0;
+  e = y1 + PYKERN/2;
+  if (e > yim) e = yim;
+
+  do_prefilter(im + a*xim, ftbuf, xim, e-a, ftzero, buf);
+  memcpy(ftim + y0*xim + x0, ftbuf + (y0-a)*xim + x0, (y1-y0)*xim - x0 + x1);
+}
+
+
+//
+// speckle filter in row bands
+// regions are labeled within each band, with the index+1 of their first
+//   pixel, and their size is kept at that index in <regions>
+// regions reaching a band seam are flagged, and merged across the seams
+//   by union-find, with the parents kept in <wbuf>
+//
+
+#define SPECKLE_SEAM 0x80000000	// region reaches a band seam
+#define SPECKLE_SIZE 0x7fffffff
+
+#define bpush(x,y) { if ((disp[x] != badval) && (!labels[x])		\
+			 && (disp[x]-y < rdiff) && (disp[x]-y > -rdiff)) \
+    { labels[x] = cur; *ws++ = x; }}
+
+void
+do_speckle_band(int16_t *disp, int16_t badval, int width, int height,
+		int y0, int y1, int rdiff,
+		uint32_t *labels, uint32_t *wbuf, uint32_t *regions)
+{
+  int k, x, y, cnt, seam;
+  uint32_t *ws, *wb;
+  uint32_t p, cur;
+  int16_t dp;
+  int kend = y1*width;
+  int ytop = y0 > 0 ? y0 : -1;	// seam rows, if any
+  int ybot = y1 < height ? y1-1 : -1;
+
+  memset(labels+y0*width,0x0,(y1-y0)*width*sizeof(uint32_t));
+  wb = wbuf + y0*width;		// wavefront storage of this band
+
+  for (k=y0*width; k<kend; k++)
+    {
+      if (disp[k] == badval || labels[k])
+	continue;
+
+      // new region, propagate within the band
+      cur = k+1;
+      labels[k] = cur;
+      ws = wb;
+      *ws++ = k;
+      cnt = 0;
+      seam = 0;
+      while (ws > wb)
+	{
+	  p = *--ws;
+	  cnt++;
+	  y = p / width;
+	  x = p - y*width;
+	  if (y == ytop || y == ybot)
+	    seam = 1;
+	  dp = disp[p];
+	  if (x < width-1) bpush(p+1,dp);
+	  if (x > 0)       bpush(p-1,dp);
+	  if (y > y0)      bpush(p-width,dp);
+	  if (y < y1-1)    bpush(p+width,dp);
+	}
+
+      regions[k] = cnt | (seam ? SPECKLE_SEAM : 0);
+    }
+}
+
+static inline uint32_t
+speckle_root(uint32_t *parent, uint32_t r)
+{
+  while (parent[r] != r)
+    {
+      parent[r] = parent[parent[r]]; // path halving
+      r = parent[r];
+    }
+  return r;
+}
+
+void
+do_speckle_seams(int16_t *disp, int width, int nbands, int *ybands, int rdiff,
+		 uint32_t *labels, uint32_t *wbuf, uint32_t *regions)
+{
+  int b, x, k;
+  uint32_t ra, rb;
+  int16_t dd;
+
+  // every flagged region has a pixel on a seam row
+  for (b=1; b<nbands; b++)
+    for (k=(ybands[b]-1)*width; k<(ybands[b]+1)*width; k++)
+      if (labels[k])
+	wbuf[labels[k]-1] = labels[k]-1;
+
+  // merge regions connected across the seams
+  for (b=1; b<nbands; b++)
+    {
+      k = (ybands[b]-1)*width;
+      for (x=0; x<width; x++, k++)
+	{
+	  if (!labels[k] || !labels[k+width])
+	    continue;
+	  dd = disp[k+width] - disp[k];
+	  if (dd >= rdiff || dd <= -rdiff)
+	    continue;
+	  ra = speckle_root(wbuf, labels[k]-1);
+	  rb = speckle_root(wbuf, labels[k+width]-1);
+	  if (ra != rb)
+	    {
+	      wbuf[ra] = rb;
+	      regions[rb] += regions[ra] & SPECKLE_SIZE;
+	    }
+	}
+    }
+
+  // point seam regions straight at their root for the apply pass
+  for (b=1; b<nbands; b++)
+    for (k=(ybands[b]-1)*width; k<(ybands[b]+1)*width; k++)
+      if (labels[k])
+	wbuf[labels[k]-1] = speckle_root(wbuf, labels[k]-1);
+}
+
+void
+do_speckle_band_apply(int16_t *disp, int16_t badval, int width, int height,
+		      int y0, int y1, int rcount,
+		      uint32_t *labels, uint32_t *wbuf, uint32_t *regions)
+{
+  int i, j, k;
+  uint32_t r;
+
+  // same interior as do_speckle
+  if (y0 < 4) y0 = 4;
+  if (y1 > height-4) y1 = height-4;
+
+  for (i=y0; i<y1; i++)
+    {
+      k = i*width+4;
+      for (j=4; j<width-4; j++, k++)
+	{
+	  if (!labels[k])
+	    continue;
+	  r = labels[k]-1;
+	  if (regions[r] & SPECKLE_SEAM)
+	    r = wbuf[r];
+	  if ((int)(regions[r] & SPECKLE_SIZE) < rcount)
+	    disp[k] = badval;
+	}
+    }
+}
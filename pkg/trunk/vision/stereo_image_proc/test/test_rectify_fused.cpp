@@ -0,0 +1,203 @@
+// tests of the fused rectification, against the OpenCV remap of doRectify,
+//   and of its prefilter, against do_prefilter
+
+#include <math.h>
+#include <stdlib.h>
+#include <gtest/gtest.h>
+#include "image.h"
+#include "stereolib.h"
+
+using namespace cam;
+
+static const int W = 640;
+static const int H = 480;
+
+// exposes the remap table, to find the pixels the fused version fills
+class RectifyTestImage : public ImageData
+{
+public:
+  bool inside(int k) { return rLutOff[k] >= 0; }
+};
+
+// calibration with distortion and a small rectifying rotation,
+//   or the identity if <ident>
+static void
+setCalibration(ImageData *im, bool ident)
+{
+  double K[9] = {500,0,W/2.0+3.3, 0,505,H/2.0-2.1, 0,0,1};
+  double D[5] = {-0.3,0.12,0.001,-0.002,0};
+  double R[9] = {0.9998,-0.01,0.0158, 0.01,0.99995,0.001, -0.0158,-0.0012,0.9998};
+  double P[12] = {480,0,W/2.0,0, 0,480,H/2.0,0, 0,0,1,0};
+  if (ident)
+    {
+      double Ki[9] = {500,0,W/2.0, 0,500,H/2.0, 0,0,1};
+      double Ri[9] = {1,0,0, 0,1,0, 0,0,1};
+      double Pi[12] = {500,0,W/2.0,0, 0,500,H/2.0,0, 0,0,1,0};
+      memcpy(K, Ki, sizeof(K));
+      memcpy(R, Ri, sizeof(R));
+      memcpy(P, Pi, sizeof(P));
+      memset(D, 0, sizeof(D));
+    }
+  memcpy(im->K, K, sizeof(K));
+  memcpy(im->D, D, sizeof(D));
+  memcpy(im->R, R, sizeof(R));
+  memcpy(im->P, P, sizeof(P));
+  im->hasRectification = true;
+  im->imWidth = W;
+  im->imHeight = H;
+}
+
+static uint8_t *
+makeRaw()
+{
+  uint8_t *raw = (uint8_t *)MEMALIGN(W*H);
+  srand(3);
+  for (int i=0; i<H; i++)
+    for (int j=0; j<W; j++)
+      raw[i*W+j] = (uint8_t)(128 + 100*sin(i*0.07+j*0.05)*cos(j*0.031) + rand()%20);
+  return raw;
+}
+
+// the remap table has the same weights as cvRemap, up to rounding
+static void
+expectNearRemap(RectifyTestImage &fused, ImageData &ref)
+{
+  int n = 0;
+  for (int k=0; k<W*H; k++)
+    if (fused.inside(k))
+      {
+	EXPECT_LE(abs(fused.imRect[k] - ref.imRect[k]), 1) << "at " << k/W << " " << k%W;
+	n++;
+      }
+  EXPECT_GT(n, W*H/2);
+}
+
+
+TEST(RectifyFused, BayerMatchesRemap)
+{
+  uint8_t *raw = makeRaw();
+
+  ImageData ref;
+  setCalibration(&ref, false);
+  ref.imRaw = raw;
+  ref.imRawType = COLOR_CODING_BAYER8_RGGB;
+  ref.doBayerMono();
+  ASSERT_TRUE(ref.doRectify());
+
+  RectifyTestImage fused;
+  setCalibration(&fused, false);
+  fused.imRaw = raw;
+  fused.imRawType = COLOR_CODING_BAYER8_RGGB;
+  ASSERT_TRUE(fused.doRectifyFused());
+  expectNearRemap(fused, ref);
+
+  ref.imRaw = NULL;
+  fused.imRaw = NULL;
+  MEMFREE(raw);
+}
+
+TEST(RectifyFused, MonoMatchesRemap)
+{
+  uint8_t *raw = makeRaw();
+
+  ImageData ref;
+  setCalibration(&ref, false);
+  ref.imRaw = raw;
+  ref.imRawType = COLOR_CODING_BAYER8_RGGB;
+  ref.doBayerMono();
+  ASSERT_TRUE(ref.doRectify());
+
+  RectifyTestImage fused;
+  setCalibration(&fused, false);
+  fused.im = ref.im;
+  fused.imType = COLOR_CODING_MONO8;
+  fused.imSize = W*H;
+  ASSERT_TRUE(fused.doRectifyFused());
+  expectNearRemap(fused, ref);
+
+  ref.imRaw = NULL;
+  fused.im = NULL;
+  MEMFREE(raw);
+}
+
+// the prefilter done along with the rectification is the one of
+//   do_prefilter on the rectified image, over the whole image
+static void
+expectPrefilter(uint8_t *ftim, uint8_t *rect)
+{
+  uint8_t *ft = (uint8_t *)MEMALIGN(W*H);
+  uint8_t *buf = (uint8_t *)MEMALIGN(W*H*4);
+  memset(ft, 0, W*H);
+  do_prefilter(rect, ft, W, H, 31, buf);
+  for (int k=0; k<W*H; k++)
+    ASSERT_EQ(ft[k], ftim[k]) << "at " << k/W << " " << k%W;
+  MEMFREE(buf);
+  MEMFREE(ft);
+}
+
+TEST(RectifyFused, PrefilterMatches)
+{
+  uint8_t *raw = makeRaw();
+  uint8_t *ftim = (uint8_t *)MEMALIGN(W*H);
+  memset(ftim, 0, W*H);
+
+  RectifyTestImage fused;
+  setCalibration(&fused, false);
+  fused.imRaw = raw;
+  fused.imRawType = COLOR_CODING_BAYER8_RGGB;
+  ASSERT_TRUE(fused.doRectifyFused(ftim, 31));
+  expectPrefilter(ftim, fused.imRect);
+
+  fused.imRaw = NULL;
+  MEMFREE(ftim);
+  MEMFREE(raw);
+}
+
+// with the identity the unfused rectified image is the source itself,
+//   so the fused prefilter has to match its prefilter exactly
+TEST(RectifyFused, IdentityPrefilterMatches)
+{
+  uint8_t *raw = makeRaw();
+  uint8_t *ftim = (uint8_t *)MEMALIGN(W*H);
+  memset(ftim, 0, W*H);
+
+  RectifyTestImage fused;
+  setCalibration(&fused, true);
+  fused.im = raw;
+  fused.imType = COLOR_CODING_MONO8;
+  fused.imSize = W*H;
+  ASSERT_TRUE(fused.doRectifyFused(ftim, 31));
+  expectPrefilter(ftim, raw);
+
+  fused.im = NULL;
+  MEMFREE(ftim);
+  MEMFREE(raw);
+}
+
+// with the identity the y fractions are zero and the last source row
+//   is used; nothing past the end of the source may be read
+TEST(RectifyFused, IdentityIsExact)
+{
+  uint8_t *raw = makeRaw();
+
+  RectifyTestImage fused;
+  setCalibration(&fused, true);
+  fused.im = raw;
+  fused.imType = COLOR_CODING_MONO8;
+  fused.imSize = W*H;
+  ASSERT_TRUE(fused.doRectifyFused());
+  for (int k=0; k<W*H; k++)
+    if (fused.inside(k))
+      ASSERT_EQ(raw[k], fused.imRect[k]) << "at " << k/W << " " << k%W;
+  EXPECT_TRUE(fused.inside(W*H-1));
+
+  fused.im = NULL;
+  MEMFREE(raw);
+}
+
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -23,9 +23,12 @@ public:
 		int64 mTime;
 		int64 mCount;
 		int64 mTimeStart;
+		/// longest single measurement, for wall clock timers
+		int64 mTimeMax;
 		void reset() {
 			mTime = 0;
 			mCount = 0;
+			mTimeMax = 0;
 		}
 	};
 
@@ -79,9 +82,12 @@ public:
     RESET(SBAOuterProdOfTrack);
     RESET(SBALinearSolving);
     RESET(SBABackSubstitution);
+    RESET(PoseEstimateLatency);
 }
 	int64 mNumIters;
 	int64 mFrequency;
+	/// ticks of cvGetTickCount() in a milli second, for wall clock timers
+	double mWallFrequency;
 
 	int64 mTotal;
 	int64 mCountTotal;
@@ -134,10 +140,14 @@ public:
   DECLARE(SBAOuterProdOfTrack);
   DECLARE(SBALinearSolving);
   DECLARE(SBABackSubstitution);
+  /// wall clock time of each pose estimation. clock() adds up the time of
+  /// all threads.
+  DECLARE(PoseEstimateLatency);
 
 	void printStat();
   void printStat(const char* title, int64 val, int64 count);
   void printStatSBA(const char* title, int64 val, int64 count);
+  void printStatWall(const char* title, const RecordType& record);
 	static inline CvTestTimer& getTimer() {
 		return _singleton;
 	}
@@ -162,4 +172,15 @@ public:
 	do { CvTestTimer::getTimer().m##timerName.mTime += \
 	  GETTICKCOUNT() - CvTestTimer::getTimer().m##timerName.mTimeStart;} while (0)
 
+/// wall clock timers, which also keep the longest measurement
+#define CvTestTimerStartWall(timerName) \
+	do { CvTestTimer::getTimer().m##timerName.mTimeStart = cvGetTickCount(); \
+	  CvTestTimer::getTimer().m##timerName.mCount++;} while(0)
+
+#define CvTestTimerEndWall(timerName) \
+	do { CvTestTimer::RecordType& _r = CvTestTimer::getTimer().m##timerName; \
+	  int64 _t = cvGetTickCount() - _r.mTimeStart; \
+	  _r.mTime += _t; \
+	  if (_t > _r.mTimeMax) _r.mTimeMax = _t;} while (0)
+
 #endif /*CVTESTTIMER_H_*/
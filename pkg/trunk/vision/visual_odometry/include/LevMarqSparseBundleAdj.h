@@ -44,8 +44,10 @@
 
 #include "LevMarqTransformDispSpace.h"
 #include "PointTracks.h"
+#include "SBABlockSystem.h"
 
 #include <boost/unordered_map.hpp>
+#include <boost/thread.hpp>
 
 namespace cv { namespace willow {
 
@@ -96,21 +98,21 @@ public:
   /// number of good update (when error/cost has decreased).
   int num_good_updates_;
 
+  /// Set the number of threads the tracks are split over when accumulating
+  /// the reduced camera system, back substituting and computing the cost,
+  /// and start the worker threads that are kept until the next call.
+  /// Small problems use fewer threads. Default is 1.
+  void setNumThreads(int num_threads);
+
 protected:
   void initParams(
       vector<FramePose*>* free_frames,
       vector<FramePose*>* fixed_frames,
       PointTracks* tracks
   );
-  /// compute the cost function, for example, the 2-norm of error vector.
-  double costFunction(
-      /// The window of frames. For a free frame, the transformation matrix
-      /// is used as initial value in entry and output in exit.
-      vector<FramePose*>* free_frames,
-      /// The tracks of points. The global coordinates for each track are
-      /// used as initial value in entry and output in exit.
-      PointTracks* tracks
-  );
+  /// compute the cost function, for example, the 2-norm of error vector,
+  /// over the tracks of the current optimize().
+  double costFunction();
   void constructTransfMatrices();
   void constructFwdTransfMatrices();
   void constructFwdTransfMatrices(
@@ -175,31 +177,50 @@ protected:
   int fixed_window_size_;
 
   int num_tracks_;
-  /// a data buffer that is large enough for matrix A in case of a full sliding window.
-  double* A_data_;
-  /// row step of matrix A. Keep in fixed even though the window may not full.
-  const int A_step_;
-  inline double* getABlock(int c0, int c1) {
-    return &A_data_[c0*NUM_CAM_PARAMS*A_step_ + c1*NUM_CAM_PARAMS];
-  }
-  inline void getABlock(CvMat* mat, int c0, int c1) {
-    cvGetSubRect(&mat_A_, mat,
-        cvRect(c1*NUM_CAM_PARAMS, c0*NUM_CAM_PARAMS,
-            NUM_CAM_PARAMS, NUM_CAM_PARAMS));
-  }
-  /// CvMat header for A_data_, for full sliding windows.
-  CvMat mat_A_full_;
-  /// CvMat header for A_data_, for current sliding window (may not be full)
-  CvMat mat_A_;
-  /// a data buffer that is large enough for matrix B in case of a full sliding window.
-  double* B_data_;
-  inline double* getBBlock(int c) {
-    return &B_data_[c*NUM_CAM_PARAMS];
-  }
-  /// CvMat header for B_data_, for full sliding windows.
-  CvMat mat_B_full_;
-  /// CvMat header for B_data_, for the current sliding window (may not be full)
-  CvMat mat_B_;
+  /// The reduced camera system, left hand side matrix A and right hand side
+  /// vector B, in 6x6 blocks.
+  SBABlockSystem cam_system_;
+
+  /// number of threads for the track loops.
+  int num_threads_;
+  /// a thread is only used for at least this many tracks.
+  static const int MIN_TRACKS_PER_SHARE = 64;
+  /// number of shares the tracks are split into in the current optimize()
+  int num_shares_;
+  /// the tracks of the current optimize(), for splitting into shares.
+  vector<PointTrack*> track_vec_;
+  /// reduced camera systems of shares 1 and up. Share 0 uses cam_system_.
+  vector<SBABlockSystem*> share_systems_;
+  /// cost of each share, summed by costFunction()
+  vector<double> share_costs_;
+  /// Levenberg-Marquardt diagonal scale of the current iteration
+  double lambda_plus_one_;
+  /// Run \a fn on each share of the tracks, on a worker thread for all
+  /// but the first. \a fn takes the share index and the range of tracks.
+  void runShares(void (LevMarqSparseBundleAdj::*fn)(int, int, int));
+  /// Run \a share_fn_ on the share of the tracks with index \a share.
+  void runShare(int share);
+  /// Loop of a worker thread: wait for runShares(), run its share and
+  /// wait for the others.
+  void shareWorkerLoop(int share);
+  /// Stop and join the worker threads, if any.
+  void stopShareWorkers();
+  /// Synchronizes the calling thread and the workers at the start and
+  /// end of each runShares()
+  boost::barrier* share_barrier_;
+  /// threads that run shares 1 and up, num_threads_ - 1 of them
+  boost::thread_group share_workers_;
+  /// tells the workers to exit at the start of the next runShares()
+  bool share_shutdown_;
+  /// the function of the current runShares()
+  void (LevMarqSparseBundleAdj::*share_fn_)(int, int, int);
+  /// Step 4 of optimize() for tracks [begin, end): derivatives, point
+  /// elimination and the outer products into the reduced camera system.
+  void accumulateShare(int share, int begin, int end);
+  /// Step 6 of optimize(), back substitution, for tracks [begin, end)
+  void backSubstituteShare(int share, int begin, int end);
+  /// costFunction() for tracks [begin, end)
+  void costShare(int share, int begin, int end);
 
   boost::unordered_map<int, CvMat *> map_global_to_disp_;
   boost::unordered_map<int, int> map_index_global_to_local_;
@@ -271,10 +292,8 @@ protected:
       double *Jp
   );
   /// \brief Solving the linear system with Cholesky factorization.
-  /// Cholesky factor the left hand side matrix A and
-  /// solve for dC.
-  /// (Alternatively, we may use a special SVD for symmetric square matrix
-  /// in OpenCV, which is slower than the Cholesky in eigen2)
+  /// Block Cholesky factor the left hand side matrix A and
+  /// solve for dC. If A is not positive definite, dC is zero.
   void linearSolving();
 
   /// Levenberg-Marquardt scalar. Initialized to zero
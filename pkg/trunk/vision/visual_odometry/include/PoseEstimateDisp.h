@@ -8,6 +8,8 @@
 #include <vector>
 using namespace std;
 
+#include <boost/thread/barrier.hpp>
+
 #include "VisOdom.h"
 
 namespace cv {namespace willow {
@@ -144,7 +146,58 @@ public:
   static bool constructHomography(const CvMat& R, const CvMat& T,
       const CvMat& dispToCart, const CvMat& cartToDisp, CvMat& H);
 
+  /// Switch the RANSAC step of estimate() to a preemptive mode.
+  /// Hypotheses are drawn in batches of RANSAC_BATCH_SIZE and
+  /// scored on numThreads threads, against the points in blocks.
+  /// A hypothesis is dropped as soon as it cannot beat the best one so far.
+  /// RANSAC stops once the best inlier ratio makes it \a confidence likely
+  /// that a triplet of inliers has been drawn, or after the number of
+  /// RANSAC iterations.
+  /// The best hypothesis is the same for any number of threads.
+  void setPreemptiveRansac(
+      /// false for the default, exhaustive RANSAC
+      bool preemptive,
+      /// number of threads to score the hypotheses
+      int numThreads = 1,
+      /// probability of having drawn a triplet of inliers
+      double confidence = 0.99);
+
+  /// number of hypotheses drawn between two checks for termination
+  /// in preemptive RANSAC
+  static const int RANSAC_BATCH_SIZE = 32;
+
 protected:
+  /// a RANSAC hypothesis of preemptive RANSAC, defined in the .cpp file
+  struct RansacHypothesis;
+  /// The preemptive RANSAC step of estimate().
+  /// @return number of inliers of the best hypothesis, whose rotation and
+  /// translation are stored in rot and shift.
+  int estimatePreemptive(CvMat *xyzs0, CvMat *xyzs1,
+      const CvMat *uvds0, const CvMat *uvds1,
+      CvMat *rot, CvMat *shift);
+  /// Least squares and scoring of hypotheses [begin, end).
+  /// Stores -1 as the number of inliers of a hypothesis that cannot have
+  /// more than \a bound inliers, nor more than an earlier hypothesis of
+  /// the range.
+  void scoreHypotheses(RansacHypothesis* hyps, int begin, int end,
+      int bound);
+  /// Thread of preemptive RANSAC. Scores its part of each batch,
+  /// between two waits on \a barrier.
+  void ransacThread(int thread, int numThreads, RansacHypothesis* hyps,
+      const int* numHyps, const int* bound, const bool* done,
+      boost::barrier* barrier);
+
+  bool   mPreemptiveRansac;
+  int    mNumRansacThreads;
+  double mRansacConfidence;
+  /// the points of preemptive RANSAC, in arrays of u0, v0, d0, u1, v1 and d1
+  /// (structure of arrays) of mRansacStride floats each, for SSE.
+  float* mRansacPoints;
+  int    mRansacNumPoints;
+  int    mRansacStride;
+  /// number of floats allocated for mRansacPoints
+  int    mRansacCapacity;
+
   /// An internal method that performs estimation for all
   /// interface calls for estimation.
   /// @return number of inliers.
@@ -0,0 +1,102 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef SBABLOCKSYSTEM_H_
+#define SBABLOCKSYSTEM_H_
+
+namespace cv { namespace willow {
+
+/// \brief The reduced camera system of sparse bundle adjustment, i.e. the
+/// normal equations of the free cameras after the points have been
+/// eliminated by Schur complement.
+///
+/// The left hand side is kept as 6x6 blocks, one for each pair of cameras.
+/// Only the blocks on and above the diagonal are used, and of those only the
+/// ones of cameras that share a track are nonzero. The nonzero blocks are
+/// flagged, and clearing, summing and the block Cholesky factorization
+/// skip the others. In a sliding window, where tracks span consecutive
+/// frames, the system is banded and the factorization has no fill-in
+/// outside of the band.
+class SBABlockSystem {
+public:
+  static const int BLOCK_SIZE = 6;
+  static const int BLOCK_ELEMS = BLOCK_SIZE*BLOCK_SIZE;
+
+  SBABlockSystem(
+      /// max number of cameras, i.e. the full size of the free window.
+      int max_num_cams);
+  ~SBABlockSystem();
+
+  /// Clear the system and set its size to \a num_cams cameras.
+  void reset(int num_cams);
+
+  /// Block (c0, c1) of the left hand side, for c0 <= c1, row major.
+  /// Flags it as nonzero. For a diagonal block only the upper triangle
+  /// is used.
+  inline double* getBlock(int c0, int c1) {
+    int k = c0*max_num_cams_ + c1;
+    used_[k] = true;
+    return &blocks_[k*BLOCK_ELEMS];
+  }
+  /// Part \a c of the right hand side.
+  inline double* getRhs(int c) {
+    return &rhs_[c*BLOCK_SIZE];
+  }
+  /// Add the left and right hand sides of \a other, of the same size.
+  void add(const SBABlockSystem& other);
+
+  /// \brief Solve the system with a block Cholesky factorization.
+  /// The left hand side is overwritten by its factor.
+  /// @return false if the left hand side is not positive definite.
+  bool solve(
+      /// output, BLOCK_SIZE*num_cams values
+      double* x);
+
+  void print() const;
+
+  int num_cams_;
+
+protected:
+  const int max_num_cams_;
+  /// max_num_cams_ x max_num_cams_ blocks
+  double* blocks_;
+  /// true if a block is nonzero
+  bool* used_;
+  double* rhs_;
+};
+
+}
+}
+
+#endif /* SBABLOCKSYSTEM_H_ */
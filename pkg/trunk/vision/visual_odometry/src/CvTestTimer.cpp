@@ -8,7 +8,8 @@
 CvTestTimer CvTestTimer::_singleton;
 
 CvTestTimer::CvTestTimer():
-  mFrequency(CLOCKS_PER_SEC/1000)  // make it milli seconds. Go with clock()
+  mFrequency(CLOCKS_PER_SEC/1000),  // make it milli seconds. Go with clock()
+  mWallFrequency(cvGetTickFrequency()*1000.)
 //	mFrequency(cvGetTickFrequency()*1000)  // make it milli seconds. cvGetTickFrequency()
 	// returns the number of ticks in one micro second.
 {
@@ -50,6 +51,17 @@ void CvTestTimer::printStatSBA(const char* title, int64 val, int64 count) {
   );
 }
 
+void CvTestTimer::printStatWall(const char* title, const RecordType& record) {
+  fprintf(stdout, "%s: %10.2f, %10.2f, %10.2f\n",
+      title,
+      // average time of each measurement
+      (record.mCount>0)? ((double)record.mTime/(double)record.mCount/mWallFrequency):0.0,
+      // longest measurement
+      (double)record.mTimeMax/mWallFrequency,
+      // average frequency
+      (mNumIters>0)?     ((double)record.mCount/(double)mNumIters)             :0.0);
+}
+
 void CvTestTimer::printStat() {
   cout << "Statistics of all counters (time in milliseconds, i.e .001 seconds)"<<endl;
   cout << "num of iters: "<< mNumIters<<endl;
@@ -86,6 +98,8 @@ void CvTestTimer::printStat() {
   PRINTSTAT   ("  CheckInliers       ", CheckInliers);
   PRINTSTAT   ("  CopyInliers        ", CopyInliers);
 	PRINTSTAT2  ("PoseEstimateLevMarq  ", PoseEstimateLevMarq);
+  cout <<      "[wall clock]           [Avg time]   [Max time] [Avg Freq]"<<endl;
+  printStatWall("PoseEstimateLatency  ", mPoseEstimateLatency);
   cout <<      "[counter]              [Avg time] [% of Total] [Avg Freq] [SBA Avg time] [% of SBA Total]"<<endl;
 	PRINTSTATSBA("SparseBundleAdjust   ", SparseBundleAdj);
 	PRINTSTATSBA("SBA::CostFunction    ", SBACostFunction);
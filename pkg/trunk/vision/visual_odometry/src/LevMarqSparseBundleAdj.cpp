@@ -44,9 +44,8 @@
 #include "LevMarqSparseBundleAdj.h"
 #include "PointTracks.h"
 #include "boost/foreach.hpp"
-
-// eigen2
-#include <Eigen/Cholesky>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 //#define DEBUG2 1
 
@@ -81,12 +80,14 @@ LevMarqSparseBundleAdj::LevMarqSparseBundleAdj(const CvMat *disparityTo3D,
       lowest_free_global_index_(-1),
       highest_free_global_index_(-1),
       full_fixed_window_size_(full_fixed_window_size),
-      A_data_(new double[full_free_window_size*NUM_CAM_PARAMS*full_free_window_size*NUM_CAM_PARAMS]),
-      A_step_(full_free_window_size*NUM_CAM_PARAMS),
-      mat_A_full_(cvMat(full_free_window_size*NUM_CAM_PARAMS,
-          full_free_window_size*NUM_CAM_PARAMS, CV_64FC1, A_data_)),
-      B_data_(new double[full_free_window_size*NUM_CAM_PARAMS]),
-      mat_B_full_(cvMat(full_free_window_size*NUM_CAM_PARAMS, 1, CV_64FC1, B_data_)),
+      cam_system_(full_free_window_size),
+      num_threads_(1),
+      num_shares_(1),
+      share_costs_(1),
+      lambda_plus_one_(1.),
+      share_barrier_(NULL),
+      share_shutdown_(false),
+      share_fn_(NULL),
       frame_params_(new double[full_free_window_size*NUM_CAM_PARAMS]),
       frame_prev_params_(new double[full_free_window_size*NUM_CAM_PARAMS]),
       frame_params_update_(new double[full_free_window_size*NUM_CAM_PARAMS]),
@@ -101,8 +102,10 @@ LevMarqSparseBundleAdj::LevMarqSparseBundleAdj(const CvMat *disparityTo3D,
 }
 
 LevMarqSparseBundleAdj::~LevMarqSparseBundleAdj() {
-  delete [] A_data_;
-  delete [] B_data_;
+  stopShareWorkers();
+  BOOST_FOREACH(SBABlockSystem* sys, share_systems_) {
+    delete sys;
+  }
   delete [] frame_params_;
   delete [] frame_prev_params_;
   delete [] frame_params_update_;
@@ -283,41 +286,349 @@ inline void LevMarqSparseBundleAdj::JacobianOfPointExact(
 }
 
 inline void LevMarqSparseBundleAdj::linearSolving() {
-  // fill out of lower left part of the matrix
-  cvCompleteSymm(&mat_A_, 0);
-#if 0
-  cvSolve(&mat_A_, &mat_B_, &mat_dC_, CV_SVD_SYM);
-  // update camera parameters with mat_dC
-  cvAdd(&mat_C_, &mat_dC_, &mat_C_);
-#else
-  {
-    Eigen::MatrixXd A0(mat_A_.rows, mat_A_.cols);
-    Eigen::VectorXd B0(mat_B_.rows);
-    Eigen::VectorXd C0(mat_C_.rows);
-    for (int j=0; j<A0.cols(); j++) {
-      for (int i=0; i<A0.rows(); i++) {
-        A0(i, j) = CV_MAT_ELEM( mat_A_, double, i, j );
-      }
+  if (cam_system_.solve(frame_params_update_) == false) {
+    // not positive definite, stay put. The cost will not decrease, and
+    // lambda goes up.
+    memset(frame_params_update_, 0,
+        free_window_size_*NUM_CAM_PARAMS*sizeof(double));
+  }
+  // update camera/frame parameters with dC
+  for (int i=0; i<free_window_size_*NUM_CAM_PARAMS; i++) {
+    frame_params_[i] += frame_params_update_[i];
+  }
+
+#if DEBUG2==1
+  printf("[LevMarqSBA]: updated cam params\n");
+  CvMatUtils::printMat(&mat_C_);
+#endif
+
+}
+
+void LevMarqSparseBundleAdj::setNumThreads(int num_threads) {
+  num_threads = MAX(num_threads, 1);
+  if (num_threads == num_threads_) {
+    return;
+  }
+  stopShareWorkers();
+  num_threads_ = num_threads;
+  if (num_threads_ > 1) {
+    share_barrier_ = new boost::barrier(num_threads_);
+    for (int t=1; t<num_threads_; t++) {
+      share_workers_.create_thread(
+          boost::bind(&LevMarqSparseBundleAdj::shareWorkerLoop, this, t));
     }
-    for (int i=0; i<B0.size(); i++) {
-//      B0(i) = cvmGet(&mat_B_, i, 0);
-      B0(i) = B_data_[i];
+  }
+}
+
+void LevMarqSparseBundleAdj::stopShareWorkers() {
+  if (share_barrier_ == NULL) {
+    return;
+  }
+  share_shutdown_ = true;
+  share_barrier_->wait();
+  share_workers_.join_all();
+  delete share_barrier_;
+  share_barrier_ = NULL;
+  share_shutdown_ = false;
+}
+
+void LevMarqSparseBundleAdj::shareWorkerLoop(int share) {
+  while (true) {
+    share_barrier_->wait();
+    if (share_shutdown_) {
+      return;
     }
-//    TIMERSTART2(SBALinearSolving);
-    A0.llt().solve(B0, &C0);
-//    TIMEREND2(SBALinearSolving);
-    // update camera/frame parameters with C0
-    for (int i=0; i<C0.size(); i++) {
-      frame_params_[i] += (frame_params_update_[i]=C0(i));
+    runShare(share);
+    share_barrier_->wait();
+  }
+}
+
+void LevMarqSparseBundleAdj::runShare(int share) {
+  // contiguous shares of the tracks; shares past num_shares_ are empty
+  if (share >= num_shares_) {
+    return;
+  }
+  int size = (num_tracks_ + num_shares_ - 1)/num_shares_;
+  (this->*share_fn_)(share,
+      MIN(share*size, num_tracks_), MIN((share+1)*size, num_tracks_));
+}
+
+void LevMarqSparseBundleAdj::runShares(
+    void (LevMarqSparseBundleAdj::*fn)(int, int, int)) {
+  if (num_shares_ <= 1 || share_barrier_ == NULL) {
+    (this->*fn)(0, 0, num_tracks_);
+    return;
+  }
+  // the calling thread takes the first share
+  share_fn_ = fn;
+  share_barrier_->wait();
+  runShare(0);
+  share_barrier_->wait();
+}
+
+// Fixed size kernels of the per track computations: the error vector and
+// the point have 3 dimensions, the camera 6.
+namespace {
+const int PT  = 3;
+const int CAM = 6;
+
+/// Add \f$ J_p^T J_p \f$ to the upper triangle of Hpp, and subtract
+/// \f$ J_p^T r \f$ from bp.
+inline void addJpTJp(const double Jp[PT*PT], const double r[PT],
+    double Hpp[PT*PT], double bp[PT]) {
+  for (int d0=0; d0<PT; d0++) {
+    const double Jpx = Jp[       d0];
+    const double Jpy = Jp[  PT + d0];
+    const double Jpz = Jp[2*PT + d0];
+    for (int d1=d0; d1<PT; d1++) {
+      Hpp[d0*PT + d1] += Jpx*Jp[d1] + Jpy*Jp[PT + d1] + Jpz*Jp[2*PT + d1];
+    }
+    bp[d0] -= Jpx*r[0] + Jpy*r[1] + Jpz*r[2];
+  }
+}
+
+/// Add \f$ J_c^T J_c \f$ to the upper triangle of block Acc, with its
+/// diagonal augmented, subtract \f$ J_c^T r \f$ from Bc, and set
+/// \f$ H_{pc} = J_p^T J_c \f$.
+inline void addJcTJc(const double Jc[PT*CAM], const double Jp[PT*PT],
+    const double r[PT], double lambda_plus_one,
+    double Acc[CAM*CAM], double Bc[CAM], double Hpc[PT*CAM]) {
+  for (int k=0; k<CAM; k++) {
+    const double Jcx = Jc[k];
+    const double Jcy = Jc[k +   CAM];
+    const double Jcz = Jc[k + 2*CAM];
+    Acc[k*CAM + k] += lambda_plus_one * (Jcx*Jcx + Jcy*Jcy + Jcz*Jcz);
+    for (int l=k+1; l<CAM; l++) {
+      Acc[k*CAM + l] += Jcx*Jc[l] + Jcy*Jc[l + CAM] + Jcz*Jc[l + 2*CAM];
+    }
+    for (int d=0; d<PT; d++) {
+      Hpc[d*CAM + k] = Jp[d]*Jcx + Jp[PT + d]*Jcy + Jp[2*PT + d]*Jcz;
+    }
+    Bc[k] -= Jcx*r[0] + Jcy*r[1] + Jcz*r[2];
+  }
+}
+
+/// Subtract \f$ H_{pc}^T t_p \f$ from Bc, and set
+/// \f$ T_{cp} = H_{pc}^T H_{pp}^{-1} \f$.
+inline void eliminatePoint(const double Hpc[PT*CAM], const double Hpp_inv[PT*PT],
+    const double tp[PT], double Bc[CAM], double Tcp[CAM*PT]) {
+  for (int i=0; i<CAM; i++) {
+    const double h0 = Hpc[i];
+    const double h1 = Hpc[i +   CAM];
+    const double h2 = Hpc[i + 2*CAM];
+    Bc[i] -= h0*tp[0] + h1*tp[1] + h2*tp[2];
+    for (int j=0; j<PT; j++) {
+      Tcp[i*PT + j] = h0*Hpp_inv[j] + h1*Hpp_inv[PT + j] + h2*Hpp_inv[2*PT + j];
+    }
+  }
+}
+
+/// Subtract \f$ T_{cp} H_{pc2} \f$ from block Acc2.
+inline void subTcpHpc(const double Tcp[CAM*PT], const double Hpc2[PT*CAM],
+    double Acc2[CAM*CAM]) {
+  for (int i=0; i<CAM; i++) {
+    const double t0 = Tcp[i*PT    ];
+    const double t1 = Tcp[i*PT + 1];
+    const double t2 = Tcp[i*PT + 2];
+    for (int j=0; j<CAM; j++) {
+      Acc2[i*CAM + j] -= t0*Hpc2[j] + t1*Hpc2[CAM + j] + t2*Hpc2[2*CAM + j];
     }
   }
+}
+
+/// Subtract \f$ T_{cp}^T d_c \f$ from dp.
+inline void subTcpTdc(const double Tcp[CAM*PT], const double dc[CAM], double dp[PT]) {
+  for (int i=0; i<CAM; i++) {
+    dp[0] -= Tcp[i*PT    ]*dc[i];
+    dp[1] -= Tcp[i*PT + 1]*dc[i];
+    dp[2] -= Tcp[i*PT + 2]*dc[i];
+  }
+}
+}
+
+void LevMarqSparseBundleAdj::accumulateShare(int share, int begin, int end) {
+  SBABlockSystem* sys = share == 0 ? &cam_system_ : share_systems_[share-1];
+  sys->reset(free_window_size_);
+
+  double Hpp[NUM_POINT_PARAMS*NUM_POINT_PARAMS]; // the part of JtJ w.r.t. track p (or point p)
+  double Hpp_inv[NUM_POINT_PARAMS*NUM_POINT_PARAMS];
+  double bp[NUM_POINT_PARAMS];      // the part of bP  w.r.t. track p
+  double Jc[DIM*NUM_CAM_PARAMS];    // 3x6 in stereo case
+  double Jp[DIM*NUM_POINT_PARAMS];  // 3x3 in stereo case
+  double scale = 1./param_delta_;
+
+  for (int ip=begin; ip<end; ip++) {
+    PointTrack* p = track_vec_[ip];
+    // - Compute the part of JtJ w.r.t to p.
+    // Clear a variable \f$ H_{pp} \f$ to represent block \f$ p \f$
+    // of \f$ H_{PP} \f$ (in our case a 3x3 matrix) and a variable
+    // \f$ b_p \f$ to represent part \f$ p \f$ of \f$ b_P \f$ (in our case
+    // a 3-vector)
+    memset(Hpp, 0, NUM_POINT_PARAMS*NUM_POINT_PARAMS*sizeof(double));
+    memset(bp,  0, NUM_POINT_PARAMS*sizeof(double));
+
+    double px = p->param_.x;
+    double py = p->param_.y;
+    double pz = p->param_.z;
+#if DEBUG2==1
+    printf("point %d: [%f, %f, %f]\n", p->id_, px, py, pz);
+#endif
+
+    // - Compute derivatives.  For each camera c on track p.
+    BOOST_FOREACH( PointTrackObserv* obsv, *p) {
+      //     Compute error vector f of reprojection in camera c of point p
+      //     and its Jacobian \f$ J_p \f$ and \f$ J_c\f$ with respect to the point parameters
+      //     (in our case 3x3 matrix) and the camera parameters (in out case
+      //     3x6 matrix). respectively.
+
+      if (isDontCareFrame(obsv->frame_index_) == true) {
+        continue;
+      }
+
+      double pu = obsv->disp_coord_.x;
+      double pv = obsv->disp_coord_.y;
+      double pd = obsv->disp_coord_.z;
+
+      // get a reference of the transformation matrix from global to disp
+      double* transf_global_disp = getTransf(obsv->frame_index_, obsv->local_frame_index_);
+
+      // rx, ry, rz have been computed already in costFunction()
+      double r[DIM] = {obsv->disp_res_.x, obsv->disp_res_.y, obsv->disp_res_.z};
+
+#if 0
+      JacobianOfPointApprox(px, py, pz, pu, pv, pd, r[0], r[1], r[2], scale,
+          transf_global_disp, Jp);
+#else
+      JacobianOfPointExact(obsv, transf_global_disp, Jp);
 #endif
 
+      //     Add \f$ J_p^T J_p\f$ to the upper triangular part of \f$ H_{pp} \f$
+      //     Subtract \f$ J_p^T \f$ from \f$ b_p \f$.
+      addJpTJp(Jp, r, Hpp, bp);
+
+      //     If camera c is free
+      if (isFreeFrame(obsv->frame_index_) == true){
+        // compute the residue w.r.t. the transformations with a delta increment
+        // in each parameter.
+        int frame_li = obsv->local_frame_index_;
+
+        for (int k=0; k<NUM_CAM_PARAMS; k++) {
+          double* transf_fwd_global_disp = getTransfFwd(frame_li, k);
+
+          // fill out column k of Jc
+          double rx1, ry1, rz1;
+          PERSTRANSFORMRESIDUE(transf_fwd_global_disp, px, py, pz, pu, pv, pd,
+              rx1, ry1, rz1);
+
+          // compute the Jacobian regarding this point and this cam
+          Jc[                   k] = (rx1-r[0])*scale;
+          Jc[  NUM_CAM_PARAMS + k] = (ry1-r[1])*scale;
+          Jc[2*NUM_CAM_PARAMS + k] = (rz1-r[2])*scale;
+        }
+
+        // Add \f$ J_c^TJ_c \f$ (with an augmented diagonal)
+        // to upper triangular part of block (c, c) of
+        // left hand side matrix A (in our case 6x6 matrix).
+        // Compute block (p,c) of \f$ H_{PC} \f$ as H_{pc} = J_p^T J_c
+        // (in our case a 3x6 matrix) and store it until track is done.
+        // Subtract \f$ J_c^T f \f$ from part c of right hand side vector B
+        // (related to \f$ b_C \f$).
+        addJcTJc(Jc, Jp, r, lambda_plus_one_, sys->getBlock(frame_li, frame_li),
+            sys->getRhs(frame_li), obsv->Hpc_);
 #if DEBUG2==1
-  printf("[LevMarqSBA]: updated cam params\n");
-  CvMatUtils::printMat(&mat_C_);
+        {
+          printf("Hpc p=%d, c=%d,%d\n", p->id_, obsv->frame_index_, obsv->local_frame_index_);
+          CvMatUtils::printMat(&obsv->mat_Hpc_);
+        }
+#endif
+      } // if camera c is free
+    } // loop thru all observations of the track.
+
+    // Augment diagonal of \f$ H_{pp} \f$, which is now accumulated and ready.
+    for (int i=0; i<NUM_POINT_PARAMS; i++) {
+      Hpp[i*NUM_POINT_PARAMS+i] *= lambda_plus_one_;
+    }
+
+    // invert Hpp
+    // use special implementation for 3x3 symmetric matrix. 15 times faster
+    // than cvInvert().
+    CvMat3X3Sym<double>::invert(Hpp, Hpp_inv);
+    Hpp_inv[1*NUM_POINT_PARAMS + 0] = Hpp_inv[0*NUM_POINT_PARAMS + 1];
+    Hpp_inv[2*NUM_POINT_PARAMS + 0] = Hpp_inv[0*NUM_POINT_PARAMS + 2];
+    Hpp_inv[2*NUM_POINT_PARAMS + 1] = Hpp_inv[1*NUM_POINT_PARAMS + 2];
+
+    // Compute \f$ H_{pp}^{-1} b_p \f$ and store it in a variable \f$ t_p \f$.
+    double* tp = p->tp_;
+    for (int i=0; i<NUM_POINT_PARAMS; i++) {
+      tp[i] = Hpp_inv[i*NUM_POINT_PARAMS +0] * bp[0] +
+        Hpp_inv[i*NUM_POINT_PARAMS +1] * bp[1] + Hpp_inv[i*NUM_POINT_PARAMS +2]*bp[2];
+    }
+#if DEBUG2==1
+    printf("bp=[%f, %f, %f]\n", bp[0], bp[1], bp[2]);
+    printf("tp=[%f, %f, %f]\n", tp[0], tp[1], tp[2]);
 #endif
 
+    // (Outer product of track) For each free camera c on track p
+    for (PointTrack::iterator iObsv=p->begin(); iObsv!=p->end(); iObsv++) {
+      PointTrackObserv* obsv = *iObsv;
+      if (isFreeFrame(obsv->frame_index_) == false) {
+        continue;
+      }
+      int local_index1 = obsv->local_frame_index_;
+
+      //   Subtract \f$ H_{pc}^T t_p = H_{pc}^T H_{pp}^{-1} b_p \f$ from part c
+      //   of right hand side vector B.
+      //   Compute the matrix \f$ H_{pc}^T H_{pp}^{-1} and store it in a variable
+      //   \f$ T_{cp} \f$ (6x3).
+      eliminatePoint(obsv->Hpc_, Hpp_inv, tp, sys->getRhs(local_index1), obsv->Tcp_);
+
+      //   For each free camera c2 >= c on track p
+      for (PointTrack::iterator iObsv2 = iObsv; iObsv2 != p->end(); iObsv2++) {
+        PointTrackObserv* obsv2 = *iObsv2;
+        if (isFreeFrame(obsv2->frame_index_)  == false) {
+          continue;
+        }
+        //    Subtract \f$ T_{pc}H_{pc2} = H__{pc}^T H_{pp}^{-1} H_{pc2} from
+        //     block (c, c2) of left hand side matrix A.
+        subTcpHpc(obsv->Tcp_, obsv2->Hpc_,
+            sys->getBlock(local_index1, obsv2->local_frame_index_));
+      }
+    } // (Outer product of track)
+  } // done with a point track.
+
+#if DEBUG2==1
+  printf("[LevMarqSBA] reduced camera system of share %d\n", share);
+  sys->print();
+#endif
+}
+
+void LevMarqSparseBundleAdj::backSubstituteShare(int share, int begin, int end) {
+  for (int ip=begin; ip<end; ip++) {
+    PointTrack* p = track_vec_[ip];
+    //   Start with point update for this track dp = tp
+    double* dp = p->dp_;
+    for (int i = 0; i<NUM_POINT_PARAMS; i++) {
+      dp[i] = p->tp_[i];
+    }
+    // for  each free camera c on track p
+    BOOST_FOREACH( PointTrackObserv* obsv, *p ) {
+      if (isFreeFrame(obsv->frame_index_)  == false) {
+        continue;
+      }
+      //    Subtract T_{cp}^T dc from dp (where dc is the update for camera c).
+      subTcpTdc(obsv->Tcp_, getFrameParamsUpdate(obsv->local_frame_index_), dp);
+    }
+
+    // update point parameters with dp
+    p->param_.x += dp[0];
+    p->param_.y += dp[1];
+    p->param_.z += dp[2];
+
+#if DEBUG2==1
+    printf("[LevMarqSBA]: updated point params pid=%d, [%f, %f, %f]\n",
+        p->id_, p->param_.x, p->param_.y, p->param_.z);
+#endif
+  }
 }
 
 /// \brief Main method to perform sparse bundle adjustment.
@@ -376,8 +687,13 @@ inline void LevMarqSparseBundleAdj::linearSolving() {
 ///     - Subtract \f$ T_{pc}H_{pc2} = H__{pc}^T H_{pp}^{-1} H_{pc2} \f$ from
 ///       block \f$ (c, c2) \f$ of left hand side matrix \a A.
 ///
+///   With more than one thread (see setNumThreads()), the tracks are split
+///   into contiguous shares, each accumulating into its own copy of \a A and
+///   \a B, and the copies are summed afterwards.
+///
 /// 5. <b>(Linear Solving)</b> Cholesky factor the left hand side matrix \a A and
-/// solve for \a dC.
+/// solve for \a dC. \a A is stored as 6x6 blocks, and only the blocks of
+/// cameras sharing a track, plus their fill-in, are touched.
 ///
 /// 6. <b>(Backsubstitution)</b>  for each track \a p
 ///   - Start with point update for this track \f$ dp = t_p \f$
@@ -443,27 +759,14 @@ bool LevMarqSparseBundleAdj::optimize(
 
   lowest_free_global_index_  = free_frames->front()->mIndex;
   highest_free_global_index_ = free_frames->back()->mIndex;
-  cvGetSubRect(&mat_A_full_, &mat_A_, cvRect(0, 0,
-      free_window_size_*NUM_CAM_PARAMS, free_window_size_*NUM_CAM_PARAMS));
-  // for CvMat's that are actually one columns vectors, we do not need to use
-  // cvGetSubRect()
-  cvGetSubRect(&mat_B_full_, &mat_B_, cvRect(0, 0, 1, free_window_size_*NUM_CAM_PARAMS));
   mat_dC_      = cvMat(free_window_size_*NUM_CAM_PARAMS, 1, CV_64FC1, frame_params_update_);
   mat_C_       = cvMat(free_window_size_*NUM_CAM_PARAMS, 1, CV_64FC1, frame_params_);
   mat_prev_C_  = cvMat(free_window_size_*NUM_CAM_PARAMS, 1, CV_64FC1, frame_prev_params_);
 
-  double Hpp[NUM_POINT_PARAMS*NUM_POINT_PARAMS]; // the part of JtJ w.r.t. track p (or point p)
-  double Hpp_inv[NUM_POINT_PARAMS*NUM_POINT_PARAMS];
-  CvMat mat_Hpp     = cvMat(NUM_POINT_PARAMS, NUM_POINT_PARAMS, CV_64FC1, Hpp);
-  CvMat mat_Hpp_inv;
-  cvInitMatHeader(&mat_Hpp_inv, NUM_POINT_PARAMS, NUM_POINT_PARAMS, CV_64FC1, Hpp_inv);
-  double bp[NUM_POINT_PARAMS];      // the part of bP  w.r.t. track p
-
   // 1. Initialization of  \f$ \lambda \f$.
   lambdaLg10_ = -3;
   const double LOG10= log(10.);
-  double lambda_plus_one = exp(lambdaLg10_*LOG10) + 1.0;
-  double scale = 1./param_delta_;
+  lambda_plus_one_ = exp(lambdaLg10_*LOG10) + 1.0;
 
   if( term_criteria_.type & CV_TERMCRIT_ITER )
     term_criteria_.max_iter = MIN(MAX(term_criteria_.max_iter,1),1000);
@@ -481,428 +784,70 @@ bool LevMarqSparseBundleAdj::optimize(
   // 2. Compute cost function at initial camera and point configuration.
   initParams(free_frames, fixed_frames, tracks);
 
+  // split the tracks into shares for the threads
+  track_vec_.assign(tracks->tracks_.begin(), tracks->tracks_.end());
+  num_shares_ = MAX(MIN(num_threads_, num_tracks_/MIN_TRACKS_PER_SHARE), 1);
+  while ((int)share_systems_.size() < num_shares_-1) {
+    share_systems_.push_back(new SBABlockSystem(full_free_window_size_));
+  }
+  share_costs_.resize(num_shares_);
+
   // For each camera/frame, compute the transformation matrix
   // from global to disparity
   constructTransfMatrices();
 
-  cost_ = costFunction(free_frames, tracks);
+  cost_ = costFunction();
   prev_cost_ = DBL_MAX;
 
 #if DEBUG==1
   printf("Initial cost: %f\n", cost_);
 #endif
 
-  // 3x6 in stereo case
-  CvMat* mat_Jc = cvCreateMat(DIM, NUM_CAM_PARAMS, CV_64FC1);
-  double* Jc  = mat_Jc->data.db;
-  // 3x3 in stereo case
-  CvMat* mat_Jp = cvCreateMat(DIM, NUM_POINT_PARAMS, CV_64FC1);
-  double* Jp = mat_Jp->data.db;
-
   // Main loop of optimization.
   bool converged = false;
   for (int iUpdates = 0;
     iUpdates < term_criteria_.max_iter && converged == false;
     iUpdates++ ) {
     TIMERSTART2(SparseBundleAdj);
-    // 3. Clear the left hand side matrix A and right hand side vector B
-    cvSetZero(&mat_A_);
-    cvSetZero(&mat_B_);
-
     // for computing numerical Jacobian,
     // for each camera/frame compute the transformation matrices
     // from global to disparity w.r.t. delta update on each camera parameter.
     constructFwdTransfMatrices();
 
-    // 4. For each track p
-    BOOST_FOREACH( PointTrack* p, tracks->tracks_) {
-      // - Compute the part of JtJ w.r.t to p.
-      // Clear a variable \f$ H_{pp} \f$ to represent block \f$ p \f$
-      // of \f$ H_{PP} \f$ (in our case a 3x3 matrix) and a variable
-      // \f$ b_p \f$ to represent part \f$ p \f$ of \f$ b_P \f$ (in our case
-      // a 3-vector)
-      memset(Hpp, 0, NUM_POINT_PARAMS*NUM_POINT_PARAMS*sizeof(double));
-      memset(bp,  0, NUM_POINT_PARAMS*sizeof(double));
-
-      double px = p->param_.x;
-      double py = p->param_.y;
-      double pz = p->param_.z;
-#if DEBUG2==1
-      CvMat cart_point = cvMat(1, 1, CV_64FC1, &(p->param_));
-      printf("point %d: [%f, %f, %f]\n", p->id_, px, py, pz);
-#endif
-
-      TIMERSTART2(SBADerivatives);
-      // - Compute derivatives.  For each camera c on track p.
-      //   {
-      BOOST_FOREACH( PointTrackObserv* obsv, *p) {
-        //     Compute error vector f of reprojection in camera c of point p
-        //     and its Jacobian \f$ J_p \f$ and \f$ J_c\f$ with respect to the point parameters
-        //     (in our case 3x3 matrix) and the camera parameters (in out case
-        //     3x6 matrix). respectively.
-
-        if (isDontCareFrame(obsv->frame_index_) == true) {
-          continue;
-        }
-//        TIMERSTART2(SBADerivativesHpp);
-
-        double rx, ry, rz;
-        double pu = obsv->disp_coord_.x;
-        double pv = obsv->disp_coord_.y;
-        double pd = obsv->disp_coord_.z;
-
-        // get a reference of the transformation matrix from global to disp
-        double* transf_global_disp = getTransf(obsv->frame_index_, obsv->local_frame_index_);
-
-        // rx, ry, rz have been computed already in costFunction()
-        rx = obsv->disp_res_.x;
-        ry = obsv->disp_res_.y;
-        rz = obsv->disp_res_.z;
-
-#if 0
-        JacobianOfPointApprox(px, py, pz, pu, pv, pd, rx, ry, rz, scale,
-            transf_global_disp, Jp);
-#else
-        JacobianOfPointExact(obsv, transf_global_disp, Jp);
-#endif
-#if DEBUG==1
-        {
-          printf("Jacobian Jp of point track %d on frame %d, %d:\n", p->id_,
-              obsv->frame_index_, obsv->local_frame_index_);
-          CvMatUtils::printMat(mat_Jp);
-        }
-#endif
-
-        //     Add \f$ J_p^T J_p\f$ to the upper triangular part of \f$ H_{pp} \f$
-        for (int d0=0; d0<NUM_POINT_PARAMS; d0++) {
-          const double& Jpx = Jp[                     d0];
-          const double& Jpy = Jp[  NUM_POINT_PARAMS + d0];
-          const double& Jpz = Jp[2*NUM_POINT_PARAMS + d0];
-          for (int d1=d0; d1<NUM_POINT_PARAMS; d1++) {
-            // Jp[d0]^T*Jp[d1], each a vector of 3
-            Hpp[d0*NUM_POINT_PARAMS + d1] +=
-              Jpx*Jp[                     d1] +
-              Jpy*Jp[  NUM_POINT_PARAMS + d1] +
-              Jpz*Jp[2*NUM_POINT_PARAMS + d1];
-          }
-
-          //     Subtract \f$ J_p^T \f$ from \f$ b_p \f$.
-          bp[d0] -= Jpx * rx + Jpy * ry + Jpz * rz;
-        }
-
-//        TIMEREND2(SBADerivativesHpp);
-        //     If camera c is free
-        if (isFreeFrame(obsv->frame_index_) == true){
-          // Add \f$ J_c^TJ_c \f$ (optionally with an augmented diagonal)
-          // to upper triangular part of block (c, c) of
-          // left hand side matrix A (in our case 6x6 matrix).
-          // Compute block (p,c) of \f$ H_{PC} \f$ as H_{pc} = J_p^T J_c
-          // (in our case a 3x6 matrix) and store it until track is done.
-          // Subtract \f$ J_c^T f \f$ from part c of right hand side vector B
-          // (related to \f$ b_C \f$).
-
-          // compute the residue w.r.t. the transformations with a delta increment
-          // in each parameter.
-          int frame_li = obsv->local_frame_index_;
-
-//          TIMERSTART2(SBADerivativesJc);
-          for (int k=0; k<NUM_CAM_PARAMS; k++) {
-            double* transf_fwd_global_disp = getTransfFwd(frame_li, k);
-
-            // fill out column k of Jc
-            double rx1, ry1, rz1;
-            PERSTRANSFORMRESIDUE(transf_fwd_global_disp, px, py, pz, pu, pv, pd,
-                rx1, ry1, rz1);
-
-            // compute the Jacobian regarding this point and this cam
-            Jc[                   k] = (rx1-rx)*scale;
-            Jc[  NUM_CAM_PARAMS + k] = (ry1-ry)*scale;
-            Jc[2*NUM_CAM_PARAMS + k] = (rz1-rz)*scale;
-          }
-//          TIMEREND2(SBADerivativesJc);
-#if DEBUG2==1
-          {
-            printf("Jacobian Jc of point %d, on frame %d,%d, error=[%f,%f,%f]\n",
-                p->id_, obsv->frame_index_, obsv->local_frame_index_, rx, ry, rz);
-            CvMatUtils::printMat(mat_Jc);
-          }
-#endif
-
-//          TIMERSTART2(SBADerivativesHccHpc);
-          // update the JtJ entry corresponding to it, block (c, c)
-          double *A_data_cc = getABlock(frame_li, frame_li);
-          double *mat_B_data_c  = getBBlock(frame_li);
-          double *Hpc = obsv->Hpc_;
-          for (int k=0; k<NUM_CAM_PARAMS; k++) {
-            double Jcx = Jc[k];
-            double Jcy = Jc[k +  NUM_CAM_PARAMS];
-            double Jcz = Jc[k +2*NUM_CAM_PARAMS];
-            // JtJ entry, H_{cc}, aka block(c,c)
-            // augment the diagonal entries
-            A_data_cc[k*A_step_ + k] +=
-              lambda_plus_one * ( Jcx*Jcx + Jcy*Jcy + Jcz*Jcz);
-            // off diagonal entries
-            for (int l=k+1; l<NUM_CAM_PARAMS; l++) {
-              A_data_cc[k*A_step_ + l] +=
-                Jcx * Jc[l] + Jcy * Jc[l+NUM_CAM_PARAMS] + Jcz * Jc[l+2*NUM_CAM_PARAMS];
-            }
-            // H_{pc}, aka, block (p, c),
-            for (int d=0; d<NUM_POINT_PARAMS; d++) {
-              // compute entry (d, k) of Hpc = (col d of Jp)^T (col k of Jc)
-              Hpc[d*NUM_CAM_PARAMS + k] =
-                Jp[d]*Jcx + Jp[NUM_POINT_PARAMS + d]*Jcy + Jp[2*NUM_POINT_PARAMS + d]*Jcz;
-            }
-            // Subtract Jc^T f from part c of right hand side vector B
-            mat_B_data_c[k] -= Jcx*rx + Jcy*ry + Jcz*rz;
-#if DEBUG2==1
-            printf("row %d of B=%f, %f\n", k, mat_B_data_c[k], -(Jcx*rx + Jcy*ry + Jcz*rz));
-#endif
-          }
-//          TIMEREND2(SBADerivativesHccHpc);
-#if DEBUG2==1
-          {
-            CvMat mat_Hpc = cvMat(3, 6, CV_64FC1, Hpc);
-            printf("Hpc p=%d, c=%d,%d\n", p->id_, obsv->frame_index_, obsv->local_frame_index_);
-            CvMatUtils::printMat(&mat_Hpc);
-          }
-#endif
-        } // if camera c is free
-      } // loop thru all observations of the track.
-
-#if DEBUG2==1
-      printf("[LevMarqSBA] mat_A after Hcc updates for point %d\n", p->id_);
-      CvMatUtils::printMat(&mat_A_);
-      printf("[LevMarqSBA] mat_B after Hcc updates for point %d\n", p->id_);
-      CvMatUtils::printMat(&mat_B_);
-#endif
-
-
-      // Augment diagonal of \f$ H_{pp} \f$, which is now accumulated and ready.
-      // Invert \f$ H_{pp} \f$, taking advantage of the fact that is a symmetric
-      // matrix.  Note that \f$ H_{pp} \f$ is not needed anymore from this point on.
-      // We can reuse the space.
-
-#if DEBUG2==1
-      printf("Hpp:\n");
-      CvMatUtils::printMat(&mat_Hpp);
-#endif
-
-//      TIMERSTART2(SBADerivativesHppInv);
-      // Augment diagonal of Hpp.
-      for (int i=0; i<NUM_POINT_PARAMS; i++) {
-        Hpp[i*NUM_POINT_PARAMS+i] *= lambda_plus_one;
-      }
-
-#if DEBUG2==1
-      printf("Augmented Hpp:\n");
-      CvMatUtils::printMat(&mat_Hpp);
-#endif
-      // invert Hpp
-      // use special implementation for 3x3 symmetric matrix. 15 times faster
-      // than cvInvert() -- see above.
-      CvMat3X3Sym<double>::invert(Hpp, Hpp_inv);
-      cvCompleteSymm(&mat_Hpp_inv, 0);
-#if DEBUG2==1
-      printf("Hpp_inv augmented of p=%d, step=%d\n", p->id_, mat_Hpp_inv.step);
-      CvMatUtils::printMat(&mat_Hpp_inv);
-#endif
-
-      // Compute \f$ H_{pp}^{-1} b_p \f$ and store it in a variable \f$ t_p \f$.
-      double* tp = p->tp_;
-      for (int i=0; i<NUM_POINT_PARAMS; i++) {
-        tp[i] = Hpp_inv[i*NUM_POINT_PARAMS +0] * bp[0] +
-          Hpp_inv[i*NUM_POINT_PARAMS +1] * bp[1] + Hpp_inv[i*NUM_POINT_PARAMS +2]*bp[2];
-      }
-//      TIMEREND2(SBADerivativesHppInv);
-      TIMEREND2(SBADerivatives);
-
-#if DEBUG2==1
-      printf("[LevMarqSBA] mat_B before Outer Product of Tracks\n");
-      CvMatUtils::printMat(&mat_B_);
-      printf("bp=[%f, %f, %f]\n", bp[0], bp[1], bp[2]);
-      printf("tp=[%f, %f, %f]\n", tp[0], tp[1], tp[2]);
-#endif
-      TIMERSTART2(SBAOuterProdOfTrack);
-
-      // (Outer product of track) For each free camera c on track p
-      for (PointTrack::iterator iObsv=p->begin(); iObsv!=p->end(); iObsv++) {
-        PointTrackObserv* obsv = *iObsv;
-        if (isFreeFrame(obsv->frame_index_) == false) {
-          continue;
-        }
-        int local_index1 = obsv->local_frame_index_;
-#if DEBUG2==1
-        printf("Outer product of track: fi=%d, lfi=%d\n", obsv->frame_index_, local_index1);
-#endif
-        double* Bc = getBBlock(local_index1);
-        double* Hpc = obsv->Hpc_;
-#if DEBUG2==1
-        {
-          CvMat mat_Hpc = cvMat(3, 6, CV_64FC1, Hpc);
-          printf("Hpc p=%d, c=%d,%d\n", p->id_, obsv->frame_index_, obsv->local_frame_index_);
-          CvMatUtils::printMat(&mat_Hpc);
-          printf("tp=[%f, %f, %f]\n", tp[0], tp[1], tp[2]);
-        }
-#endif
-        //   Subtract \f$ H_{pc}^T t_p = H_{pc}^T H_{pp}^{-1} b_p \f$ from part c
-        //   of right hand side vector B.
-        CvMat&  mat_Hpc = obsv->mat_Hpc_;
-        for (int i=0; i<NUM_CAM_PARAMS; i++) {
-          Bc[i] -= Hpc[i]*tp[0] + Hpc[i + NUM_CAM_PARAMS]*tp[1] +
-            Hpc[i + NUM_CAM_PARAMS*2]*tp[2];
-#if DEBUG2==1
-            printf("row %d of B=%f, %f\n", i, Bc[i], -(Hpc[i]*tp[0] + Hpc[i + NUM_CAM_PARAMS]*tp[1] +
-                Hpc[i + NUM_CAM_PARAMS*2]*tp[2]));
-#endif
-
-        }
-
-        //   Compute the matrix \f$ H_{pc}^T H_{pp}^{-1} and store it in a variable
-        //   \f$ T_{cp} \f$ (6x3).
-        // direct computation
-        double* Tcp = obsv->Tcp_;
-        for (int i=0; i<NUM_CAM_PARAMS; i++) {
-          for (int j=0; j<NUM_POINT_PARAMS; j++){
-            Tcp[i*NUM_POINT_PARAMS+j] =
-              Hpc[0*NUM_CAM_PARAMS + i]*Hpp_inv[0*NUM_POINT_PARAMS + j] +
-              Hpc[1*NUM_CAM_PARAMS + i]*Hpp_inv[1*NUM_POINT_PARAMS + j] +
-              Hpc[2*NUM_CAM_PARAMS + i]*Hpp_inv[2*NUM_POINT_PARAMS + j];
-          }
-        }
-
-#if DEBUG2==1
-        printf("matrix Hpc, p=%d, c=%d,%d\n", p->id_, obsv->frame_index_, local_index1);
-        CvMatUtils::printMat(&mat_Hpc);
-        printf("matrix Hpp_inv of p=%d\n", p->id_);
-        CvMatUtils::printMat(&mat_Hpp_inv);
-        printf("matrix Tcp\n");
-        CvMatUtils::printMat(&obsv->mat_Tcp_);
-#endif
-
-#if DEBUG2==1
-        printf("[LevMarqSBA] mat_B before Hcc2\n");
-        CvMatUtils::printMat(&mat_B_);
-#endif
-        //   For each free camera c2 >= c on track p
-        for (PointTrack::iterator iObsv2 = iObsv; iObsv2 != p->end(); iObsv2++) {
-          PointTrackObserv* obsv2 = *iObsv2;
-          if (isFreeFrame(obsv2->frame_index_)  == false) {
-            continue;
-          }
-          int local_index2 = obsv2->local_frame_index_;
-#if DEBUG2==1
-          printf("  fi=[%d,%d], lfi=[%d,%d]\n", obsv->frame_index_, obsv2->frame_index_,
-              local_index1, local_index2);
-#endif
-
-          //    Subtract \f$ T_{pc}H_{pc2} = H__{pc}^T H_{pp}^{-1} H_{pc2} from
-          //     block (c, c2) of left hand side matrix A.
-          double* Acc2 = getABlock(local_index1, local_index2);
-          double* Tcp  = obsv->Tcp_;
-          double* Hpc2  = obsv2->Hpc_;
-
-          for (int i=0; i<NUM_CAM_PARAMS; i++) {
-            for (int j=0; j<NUM_CAM_PARAMS; j++) {
-              Acc2[i*A_step_ + j] -=
-                Tcp[i*NUM_POINT_PARAMS + 0]*Hpc2[                  + j] +
-                Tcp[i*NUM_POINT_PARAMS + 1]*Hpc2[NUM_CAM_PARAMS    + j] +
-                Tcp[i*NUM_POINT_PARAMS + 2]*Hpc2[NUM_CAM_PARAMS*2  + j];
-            }
-          }
-
-#if DEBUG2==1
-          printf("matrix Tcp, p=%d, c=%d,%d\n", p->id_, obsv->frame_index_, local_index2);
-          CvMatUtils::printMat(&obsv->mat_Tcp_);
-          printf("matrix Hpc2, p=%d, c2=%d,%d\n", p->id_, obsv2->frame_index_, local_index2);
-          CvMatUtils::printMat(&obsv2->mat_Hpc_);
-#endif
-        }
-      } // (Outer product of track)
-      TIMEREND2(SBAOuterProdOfTrack);
-
-#if DEBUG2==1
-      printf("[LevMarqSBA] mat_A after Outer Product of Tracks\n");
-      CvMatUtils::printMat(&mat_A_);
-      printf("[LevMarqSBA] mat_B after Outer Product of Tracks\n");
-      CvMatUtils::printMat(&mat_B_);
-#endif
-
-    } // done with a point track.
+    // 3. Clear the left hand side matrix A and right hand side vector B,
+    // one for each share of the tracks.
+    // 4. For each track p, accumulate its part of A and B. See accumulateShare().
+    TIMERSTART2(SBADerivatives);
+    runShares(&LevMarqSparseBundleAdj::accumulateShare);
+    for (int t=1; t<num_shares_; t++) {
+      cam_system_.add(*share_systems_[t-1]);
+    }
+    TIMEREND2(SBADerivatives);
 
-    // 6. (Linear Solving) Cholesky factor the left hand side matrix A and
+    // 5. (Linear Solving) Cholesky factor the left hand side matrix A and
     // solve for dC.
-    // (Alternatively, we may use a special SVD for symmetric square matrix
-    // in OpenCV, which is slower than the Cholesky in eigen2)
     TIMERSTART2(SBALinearSolving);
     linearSolving();
     TIMEREND2(SBALinearSolving);
 
     TIMERSTART2(SBABackSubstitution);
     //
-    // 7. (Backsubstitution)  for each track p
+    // 6. (Backsubstitution)  for each track p. See backSubstituteShare().
     //
-    BOOST_FOREACH( PointTrack* p, tracks->tracks_) {
-      //   Start with point update for this track dp = tp
-      double* dp = p->dp_;
-      CvMat& mat_dp = p->mat_dp_;
-      for (int i = 0; i<NUM_POINT_PARAMS; i++) {
-        dp[i] = p->tp_[i];
-      }
-#if DEBUG2==1
-      printf("[LevMarqSBA] backsubstitution, point %d, initial dp\n", p->id_);
-      CvMatUtils::printMat(&mat_dp);
-#endif
-      // for  each free camera c on track p
-      // {
-      BOOST_FOREACH( PointTrackObserv* obsv, *p ) {
-        if (isFreeFrame(obsv->frame_index_)  == false) {
-          continue;
-        }
-        //    Subtract T_{cp}^T dc from dp (where dc is the update for camera c).
-        /// @todo replace cvGEMM with special 3x3 matrix calculation methods may help speeding up.
-        /// Not in bottleneck though.
-        double* dc = getFrameParamsUpdate(obsv->local_frame_index_);
-        CvMat mat_dc  = cvMat(NUM_CAM_PARAMS, 1, CV_64FC1, dc);
-        CvMat& mat_Tcp = obsv->mat_Tcp_;
-        cvGEMM(&mat_Tcp, &mat_dc, -1.0, &mat_dp, 1.0, &mat_dp, CV_GEMM_A_T);
-
-#if DEBUG2==1
-        printf("[LevMarqSBA] backsubstitution, point %d, cam %d,%d\n", p->id_,
-            obsv->frame_index_, obsv->local_frame_index_);
-        printf("[LevMarqSBA] Tcp\n");
-        CvMatUtils::printMat(&mat_Tcp);
-        printf("[LevMarqSBA] dc\n");
-        CvMatUtils::printMat(&mat_dc);
-        printf("[LevMarqSBA] updated dp\n");
-        CvMatUtils::printMat(&mat_dp);
-
-#endif
-      }
-
-      // update point parameters with dp
-      p->param_.x += dp[0];
-      p->param_.y += dp[1];
-      p->param_.z += dp[2];
-
-#if DEBUG2==1
-      printf("[LevMarqSBA]: updated point params pid=%d, [%f, %f, %f]\n",
-          p->id_, p->param_.x, p->param_.y, p->param_.z);
-#endif
-
-    } // for each point track p, backsubstitution
+    runShares(&LevMarqSparseBundleAdj::backSubstituteShare);
     TIMEREND2(SBABackSubstitution);
     //
-    // 8. Compute the cost function for the updated camera and point configuration
+    // 7. Compute the cost function for the updated camera and point configuration
     //
     constructTransfMatrices();
-    cost_ = costFunction(free_frames, tracks);
+    cost_ = costFunction();
 #if DEBUG==1
     printf("[LevMarqSBA] cost of iteration %d = %e <=> %e (prev)\n",
         iUpdates, cost_, prev_cost_);
 #endif
 
     if (cost_ <= prev_cost_) {
-      // 9. If cost function has improved, accept the update step, decrease
+      // 8. If cost function has improved, accept the update step, decrease
       //    \f$ \lambda \f$ and go to Step 3 (unless converged, in which case quit).
       //    This step increases the influence of Gauss-Newton and decreases the
       //    the influence of gradient descent.
@@ -921,7 +866,7 @@ bool LevMarqSparseBundleAdj::optimize(
       } else {
         lambdaLg10_ = MAX(lambdaLg10_-1, -16);
         // update lambda according to lambdalog10
-        lambda_plus_one = exp(lambdaLg10_*LOG10) + 1.0;
+        lambda_plus_one_ = exp(lambdaLg10_*LOG10) + 1.0;
 #if DEBUG==1
         printf("[LevMarqSBA] good update. num of iters=%d, change in param=%e <=> %e\n",
             iUpdates, param_change, term_criteria_.epsilon);
@@ -935,14 +880,14 @@ bool LevMarqSparseBundleAdj::optimize(
         }
       }
     } else {
-      // 10. Otherwise, reject the update,
+      // 9. Otherwise, reject the update,
       // increase \f$ \lambda \f$ and go to Step 3 (unless exceeded the
       // maximum number of iterations, in which case quit).
       // This step increases the influence of gradient descent and reduce the
       // influence of Gauss-Newton.
       lambdaLg10_++;
       // update lambda according to lambdalog10
-      lambda_plus_one = exp(lambdaLg10_*LOG10) + 1.0;
+      lambda_plus_one_ = exp(lambdaLg10_*LOG10) + 1.0;
       num_retractions_++;
 
       // back off from current parameters to previous ones
@@ -973,8 +918,6 @@ bool LevMarqSparseBundleAdj::optimize(
   printf("[LevMarqSBA]:  Number of retractions=%d, number of good updates=%d\n",
       num_retractions_, num_good_updates_);
 #endif
-  cvReleaseMat(&mat_Jp);
-  cvReleaseMat(&mat_Jc);
   return true;
 }
 
@@ -1127,17 +1070,24 @@ void LevMarqSparseBundleAdj::retrieveOptimizedParams(
 
 }
 
-double LevMarqSparseBundleAdj::costFunction(
-    vector<FramePose *>* free_frames,
-    PointTracks* tracks
-) {
+double LevMarqSparseBundleAdj::costFunction() {
   TIMERSTART2(SBACostFunction);
+  // the tracks are the ones in track_vec_, set up in optimize()
+  runShares(&LevMarqSparseBundleAdj::costShare);
+  double err_norm = 0;
+  BOOST_FOREACH(double cost, share_costs_) {
+    err_norm += cost;
+  }
+  TIMEREND2(SBACostFunction);
+  return err_norm;
+}
+
+void LevMarqSparseBundleAdj::costShare(int share, int begin, int end) {
   double err_norm = 0;
 
   /// For each tracks
-  BOOST_FOREACH(PointTrack* p, tracks->tracks_) {
-    CvMat point = cvMat(1, 1, CV_64FC3, &p->param_);
-
+  for (int ip=begin; ip<end; ip++) {
+    PointTrack* p = track_vec_[ip];
     double px = p->param_.x;
     double py = p->param_.y;
     double pz = p->param_.z;
@@ -1167,8 +1117,7 @@ double LevMarqSparseBundleAdj::costFunction(
     }
   }
 
-  TIMEREND2(SBACostFunction);
-  return err_norm;
+  share_costs_[share] = err_norm;
 }
 
 double LevMarqSparseBundleAdj::getParamChange(const PointTracks* tracks) const {
@@ -441,10 +441,12 @@ bool PathRecon::trackOneFrame(queue<StereoFrame>& inputImageQueue, FrameSeq& fra
         //  note we do not do Levenberg-Marquardt here, as we are not sure if
         //  this is key frame yet.
         TIMERSTART2(PoseEstimateRANSAC);
+        CvTestTimerStartWall(PoseEstimateLatency);
         currFrame->mNumInliers =
           mPoseEstimator.estimate(*currFrame->mKeypoints, *getLastKeyFrame()->mKeypoints,
               *currFrame->mTrackableIndexPairs,
               currFrame->mRot, currFrame->mShift, false);
+        CvTestTimerEndWall(PoseEstimateLatency);
         TIMEREND2(PoseEstimateRANSAC);
 
         currFrame->mInliers0 = NULL;
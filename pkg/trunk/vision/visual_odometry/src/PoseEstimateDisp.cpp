@@ -3,8 +3,11 @@
 using namespace std;
 
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 #include <opencv/cv.h>
+#include <xmmintrin.h>
 
 #include "PoseEstimateDisp.h"
 
@@ -32,7 +35,14 @@ using namespace cv::willow;
 
 
 PoseEstimateDisp::PoseEstimateDisp():
-  PoseParent(), Parent()
+  PoseParent(), Parent(),
+  mPreemptiveRansac(false),
+  mNumRansacThreads(1),
+  mRansacConfidence(0.99),
+  mRansacPoints(NULL),
+  mRansacNumPoints(0),
+  mRansacStride(0),
+  mRansacCapacity(0)
 {
   // overide parent default
   mErrThreshold = 1.5;
@@ -40,6 +50,219 @@ PoseEstimateDisp::PoseEstimateDisp():
 
 PoseEstimateDisp::~PoseEstimateDisp()
 {
+  if (mRansacPoints) cvFree(&mRansacPoints);
+}
+
+void PoseEstimateDisp::setPreemptiveRansac(bool preemptive, int numThreads,
+    double confidence) {
+  mPreemptiveRansac = preemptive;
+  mNumRansacThreads = MAX(numThreads, 1);
+  mRansacConfidence = confidence;
+}
+
+/// A hypothesis of preemptive RANSAC, from a triplet of points
+struct PoseEstimateDisp::RansacHypothesis {
+  /// the 3 points from camera 0 and camera 1, stored in columns
+  double P0[3*3];
+  double P1[3*3];
+  /// rotation, translation and disparity space homography
+  double R[3*3];
+  double T[3];
+  double H[4*4];
+  /// number of inliers, or -1 if dropped
+  int numInliers;
+};
+
+namespace {
+/// number of points scored before checking if a hypothesis can still win
+const int RANSAC_BLOCK_SIZE = 64;
+
+/// Count the inliers of the disparity space homography H, as
+/// PoseEstimateDisp::checkInLiers does, four points at a time.
+/// @return the number of inliers, or -1 as soon as the count cannot exceed
+/// bound.
+int countInliers(const float* points, int stride, int numPoints,
+    const double* H, float threshold, int bound) {
+  const float* u0 = points;
+  const float* v0 = points +   stride;
+  const float* d0 = points + 2*stride;
+  const float* u1 = points + 3*stride;
+  const float* v1 = points + 4*stride;
+  const float* d1 = points + 5*stride;
+  __m128 h[16];
+  for (int i=0; i<16; i++) {
+    h[i] = _mm_set1_ps((float)H[i]);
+  }
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 thresh = _mm_set1_ps(threshold);
+  // clears the sign bit
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+  int numInliers = 0;
+  for (int b=0; b<numPoints; b+=RANSAC_BLOCK_SIZE) {
+    int e = MIN(b+RANSAC_BLOCK_SIZE, numPoints);
+    for (int i=b; i<e; i+=4) {
+      __m128 x = _mm_load_ps(u0+i);
+      __m128 y = _mm_load_ps(v0+i);
+      __m128 z = _mm_load_ps(d0+i);
+      __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h[12], x), _mm_mul_ps(h[13], y)),
+          _mm_add_ps(_mm_mul_ps(h[14], z), h[15]));
+      __m128 scale = _mm_div_ps(one, w);
+      __m128 r, inlier;
+      r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h[0], x), _mm_mul_ps(h[1], y)),
+          _mm_add_ps(_mm_mul_ps(h[2], z), h[3]));
+      r = _mm_sub_ps(_mm_load_ps(u1+i), _mm_mul_ps(r, scale));
+      inlier = _mm_cmple_ps(_mm_and_ps(r, absMask), thresh);
+      r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h[4], x), _mm_mul_ps(h[5], y)),
+          _mm_add_ps(_mm_mul_ps(h[6], z), h[7]));
+      r = _mm_sub_ps(_mm_load_ps(v1+i), _mm_mul_ps(r, scale));
+      inlier = _mm_and_ps(inlier, _mm_cmple_ps(_mm_and_ps(r, absMask), thresh));
+      r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h[8], x), _mm_mul_ps(h[9], y)),
+          _mm_add_ps(_mm_mul_ps(h[10], z), h[11]));
+      r = _mm_sub_ps(_mm_load_ps(d1+i), _mm_mul_ps(r, scale));
+      inlier = _mm_and_ps(inlier, _mm_cmple_ps(_mm_and_ps(r, absMask), thresh));
+      numInliers += __builtin_popcount(_mm_movemask_ps(inlier));
+    }
+    // preemption
+    if (numInliers + numPoints - e <= bound) {
+      return -1;
+    }
+  }
+  return numInliers;
+}
+}
+
+void PoseEstimateDisp::scoreHypotheses(RansacHypothesis* hyps,
+    int begin, int end, int bound) {
+  for (int k=begin; k<end; k++) {
+    RansacHypothesis& hyp = hyps[k];
+    CvMat P0 = cvMat(3, 3, CV_64FC1, hyp.P0);
+    CvMat P1 = cvMat(3, 3, CV_64FC1, hyp.P1);
+    CvMat R  = cvMat(3, 3, CV_64FC1, hyp.R);
+    CvMat T  = cvMat(3, 1, CV_64FC1, hyp.T);
+    CvMat H  = cvMat(4, 4, CV_64FC1, hyp.H);
+    this->estimateLeastSquareInCol(&P0, &P1, &R, &T);
+    this->constructDisparityHomography(&R, &T, &H);
+    hyp.numInliers = countInliers(mRansacPoints, mRansacStride,
+        mRansacNumPoints, hyp.H, (float)mErrThreshold, bound);
+    bound = MAX(bound, hyp.numInliers);
+  }
+}
+
+void PoseEstimateDisp::ransacThread(int thread, int numThreads,
+    RansacHypothesis* hyps, const int* numHyps, const int* bound,
+    const bool* done, boost::barrier* barrier) {
+  while (true) {
+    // wait for the batch
+    barrier->wait();
+    if (*done == true) {
+      break;
+    }
+    scoreHypotheses(hyps, *numHyps*thread/numThreads,
+        *numHyps*(thread+1)/numThreads, *bound);
+    barrier->wait();
+  }
+}
+
+int PoseEstimateDisp::estimatePreemptive(CvMat *xyzs0, CvMat *xyzs1,
+    const CvMat *uvds0, const CvMat *uvds1, CvMat *rot, CvMat *shift) {
+  int numPoints = xyzs0->rows;
+
+  // copy the points into arrays of floats, padded to a multiple of 4.
+  // The padding is never an inlier.
+  int stride = (numPoints + 3) & ~3;
+  if (6*stride > mRansacCapacity) {
+    if (mRansacPoints) cvFree(&mRansacPoints);
+    mRansacPoints = (float *)cvAlloc(6*stride*sizeof(float));
+    mRansacCapacity = 6*stride;
+  }
+  for (int i=0; i<stride; i++) {
+    for (int j=0; j<3; j++) {
+      if (i<numPoints) {
+        mRansacPoints[ j   *stride + i] = cvmGet(uvds0, i, j);
+        mRansacPoints[(j+3)*stride + i] = cvmGet(uvds1, i, j);
+      } else {
+        mRansacPoints[ j   *stride + i] = 0.f;
+        mRansacPoints[(j+3)*stride + i] = NAN;
+      }
+    }
+  }
+  mRansacNumPoints = numPoints;
+  mRansacStride = stride;
+
+  int numThreads = MIN(mNumRansacThreads, RANSAC_BATCH_SIZE);
+  RansacHypothesis hyps[RANSAC_BATCH_SIZE];
+  // shared with the threads
+  int numHyps = 0;
+  int maxNumInLiers = 0;
+  bool done = false;
+  boost::barrier barrier(numThreads);
+  boost::thread_group threads;
+  for (int t=1; t<numThreads; t++) {
+    threads.create_thread(boost::bind(&PoseEstimateDisp::ransacThread, this,
+        t, numThreads, hyps, &numHyps, &maxNumInLiers, &done, &barrier));
+  }
+
+  double _H[16];
+  CvMat H = cvMat(4, 4, CV_64FC1, _H);
+  bool exhausted = false;
+  int numDrawn = 0;
+  while (exhausted == false && numDrawn < mNumRansacIter) {
+    // draw the next batch
+    numHyps = 0;
+    while (numHyps < RANSAC_BATCH_SIZE && numDrawn < mNumRansacIter) {
+      CvMat P0 = cvMat(3, 3, CV_64FC1, hyps[numHyps].P0);
+      CvMat P1 = cvMat(3, 3, CV_64FC1, hyps[numHyps].P1);
+      if (pick3RandomPoints(xyzs0, xyzs1, &P0, &P1) == false) {
+        // we have exhausted all possible combinations of triplet sets
+        exhausted = true;
+        break;
+      }
+      numHyps++;
+      numDrawn++;
+    }
+    if (numHyps == 0) {
+      break;
+    }
+
+    barrier.wait();
+    scoreHypotheses(hyps, 0, numHyps/numThreads, maxNumInLiers);
+    barrier.wait();
+
+    // keep the best R and T. The first of equally good ones wins, as in
+    // the exhaustive RANSAC.
+    for (int k=0; k<numHyps; k++) {
+      if (maxNumInLiers < hyps[k].numInliers) {
+        maxNumInLiers = hyps[k].numInliers;
+        CvMat R = cvMat(3, 3, CV_64FC1, hyps[k].R);
+        CvMat T = cvMat(3, 1, CV_64FC1, hyps[k].T);
+        cvCopy(&R, rot);
+        cvCopy(&T, shift);
+        memcpy(_H, hyps[k].H, sizeof(_H));
+      }
+    }
+
+    // adaptive termination, on the number of draws needed to get a
+    // triplet of inliers with probability mRansacConfidence
+    if (maxNumInLiers > 0) {
+      double w = (double)maxNumInLiers/numPoints;
+      double w3 = w*w*w;
+      if (w3 >= 1. ||
+          numDrawn >= log(1. - mRansacConfidence)/log(1. - w3)) {
+        break;
+      }
+    }
+  }
+
+  done = true;
+  barrier.wait();
+  threads.join_all();
+
+  if (maxNumInLiers == 0) {
+    return 0;
+  }
+  // the count in double precision, as in getInLiers()
+  return checkInLiers((CvMat *)uvds0, (CvMat *)uvds1, &H);
 }
 
 int PoseEstimateDisp::checkInLiers(CvMat *points0, CvMat *points1, CvMat* transformation){
@@ -322,7 +545,9 @@ int PoseEstimateDisp::estimate(CvMat *xyzs0, CvMat *xyzs1,
 
   int maxNumInLiers=0;
   mRandomTripletSetGenerator.reset(0, numPoints-1);
-  if (numRefGrps == 0) {
+  if (numRefGrps == 0 && mPreemptiveRansac == true) {
+    maxNumInLiers = estimatePreemptive(xyzs0, xyzs1, uvds0, uvds1, rot, shift);
+  } else if (numRefGrps == 0) {
     for (int i=0; i< mNumRansacIter; i++) {
 #ifdef DEBUG
       cout << "Iteration: "<< i << endl;
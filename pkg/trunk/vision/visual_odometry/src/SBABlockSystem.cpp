@@ -0,0 +1,280 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "SBABlockSystem.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace cv { namespace willow {
+
+namespace {
+const int N  = SBABlockSystem::BLOCK_SIZE;
+const int NN = SBABlockSystem::BLOCK_ELEMS;
+
+/// In place Cholesky factorization A = U^T U of a 6x6 block. Only the upper
+/// triangle of A is used and overwritten by U.
+/// @return false if A is not positive definite.
+inline bool cholesky6(double* A) {
+  for (int i=0; i<N; i++) {
+    double s = A[i*N+i];
+    for (int k=0; k<i; k++) {
+      s -= A[k*N+i]*A[k*N+i];
+    }
+    if (s <= 0.) {
+      return false;
+    }
+    double d = sqrt(s);
+    double inv = 1./d;
+    A[i*N+i] = d;
+    for (int j=i+1; j<N; j++) {
+      double t = A[i*N+j];
+      for (int k=0; k<i; k++) {
+        t -= A[k*N+i]*A[k*N+j];
+      }
+      A[i*N+j] = t*inv;
+    }
+  }
+  return true;
+}
+
+/// C -= A^T B, all 6x6.
+inline void subAtB6(const double* A, const double* B, double* C) {
+  for (int k=0; k<N; k++) {
+    const double* a = &A[k*N];
+    const double* b = &B[k*N];
+    for (int i=0; i<N; i++) {
+      double aki = a[i];
+      double* c = &C[i*N];
+      for (int j=0; j<N; j++) {
+        c[j] -= aki*b[j];
+      }
+    }
+  }
+}
+
+/// B = U^-T B, for a 6x6 upper triangular U and 6x6 B.
+inline void solveUt6(const double* U, double* B) {
+  for (int i=0; i<N; i++) {
+    double* bi = &B[i*N];
+    for (int k=0; k<i; k++) {
+      double u = U[k*N+i];
+      const double* bk = &B[k*N];
+      for (int j=0; j<N; j++) {
+        bi[j] -= u*bk[j];
+      }
+    }
+    double inv = 1./U[i*N+i];
+    for (int j=0; j<N; j++) {
+      bi[j] *= inv;
+    }
+  }
+}
+
+/// y -= A^T x, for a 6x6 A.
+inline void subAtx6(const double* A, const double* x, double* y) {
+  for (int k=0; k<N; k++) {
+    for (int i=0; i<N; i++) {
+      y[i] -= A[k*N+i]*x[k];
+    }
+  }
+}
+
+/// y -= A x, for a 6x6 A.
+inline void subAx6(const double* A, const double* x, double* y) {
+  for (int i=0; i<N; i++) {
+    for (int j=0; j<N; j++) {
+      y[i] -= A[i*N+j]*x[j];
+    }
+  }
+}
+
+/// b = U^-T b
+inline void solveUtx6(const double* U, double* b) {
+  for (int i=0; i<N; i++) {
+    for (int k=0; k<i; k++) {
+      b[i] -= U[k*N+i]*b[k];
+    }
+    b[i] /= U[i*N+i];
+  }
+}
+
+/// b = U^-1 b
+inline void solveUx6(const double* U, double* b) {
+  for (int i=N-1; i>=0; i--) {
+    for (int j=i+1; j<N; j++) {
+      b[i] -= U[i*N+j]*b[j];
+    }
+    b[i] /= U[i*N+i];
+  }
+}
+}
+
+SBABlockSystem::SBABlockSystem(int max_num_cams):
+  num_cams_(0),
+  max_num_cams_(max_num_cams),
+  blocks_(new double[max_num_cams*max_num_cams*BLOCK_ELEMS]),
+  used_(new bool[max_num_cams*max_num_cams]),
+  rhs_(new double[max_num_cams*BLOCK_SIZE])
+{
+  memset(blocks_, 0, max_num_cams*max_num_cams*BLOCK_ELEMS*sizeof(double));
+  memset(used_, 0, max_num_cams*max_num_cams*sizeof(bool));
+  memset(rhs_, 0, max_num_cams*BLOCK_SIZE*sizeof(double));
+}
+
+SBABlockSystem::~SBABlockSystem() {
+  delete [] blocks_;
+  delete [] used_;
+  delete [] rhs_;
+}
+
+void SBABlockSystem::reset(int num_cams) {
+  for (int k=0; k<max_num_cams_*max_num_cams_; k++) {
+    if (used_[k]) {
+      memset(&blocks_[k*BLOCK_ELEMS], 0, BLOCK_ELEMS*sizeof(double));
+      used_[k] = false;
+    }
+  }
+  num_cams_ = num_cams;
+  memset(rhs_, 0, num_cams*BLOCK_SIZE*sizeof(double));
+}
+
+void SBABlockSystem::add(const SBABlockSystem& other) {
+  for (int k=0; k<max_num_cams_*max_num_cams_; k++) {
+    if (other.used_[k] == false) {
+      continue;
+    }
+    double* block = &blocks_[k*BLOCK_ELEMS];
+    const double* other_block = &other.blocks_[k*BLOCK_ELEMS];
+    if (used_[k]) {
+      for (int i=0; i<BLOCK_ELEMS; i++) {
+        block[i] += other_block[i];
+      }
+    } else {
+      memcpy(block, other_block, BLOCK_ELEMS*sizeof(double));
+      used_[k] = true;
+    }
+  }
+  for (int i=0; i<num_cams_*BLOCK_SIZE; i++) {
+    rhs_[i] += other.rhs_[i];
+  }
+}
+
+/// The factor is A = U^T U, with U block upper triangular. Block (j, i),
+/// i > j, of U is U_jj^-T (A_ji - sum_k U_kj^T U_ki), and it is nonzero only
+/// if A_ji is, or if U_kj and U_ki are for some k < j.
+bool SBABlockSystem::solve(double* x) {
+  const int n = num_cams_;
+  const int m = max_num_cams_;
+
+  // factorization, one block row at a time
+  for (int j=0; j<n; j++) {
+    double* Ujj = &blocks_[(j*m + j)*NN];
+    for (int k=0; k<j; k++) {
+      if (used_[k*m + j]) {
+        const double* Ukj = &blocks_[(k*m + j)*NN];
+        subAtB6(Ukj, Ukj, Ujj);
+      }
+    }
+    if (cholesky6(Ujj) == false) {
+      return false;
+    }
+    for (int i=j+1; i<n; i++) {
+      double* Uji = &blocks_[(j*m + i)*NN];
+      for (int k=0; k<j; k++) {
+        if (used_[k*m + j] && used_[k*m + i]) {
+          if (used_[j*m + i] == false) {
+            // fill-in
+            memset(Uji, 0, NN*sizeof(double));
+            used_[j*m + i] = true;
+          }
+          subAtB6(&blocks_[(k*m + j)*NN], &blocks_[(k*m + i)*NN], Uji);
+        }
+      }
+      if (used_[j*m + i]) {
+        solveUt6(Ujj, Uji);
+      }
+    }
+  }
+
+  // forward substitution, U^T y = b
+  memcpy(x, rhs_, n*N*sizeof(double));
+  for (int j=0; j<n; j++) {
+    for (int k=0; k<j; k++) {
+      if (used_[k*m + j]) {
+        subAtx6(&blocks_[(k*m + j)*NN], &x[k*N], &x[j*N]);
+      }
+    }
+    solveUtx6(&blocks_[(j*m + j)*NN], &x[j*N]);
+  }
+
+  // back substitution, U x = y
+  for (int j=n-1; j>=0; j--) {
+    for (int i=j+1; i<n; i++) {
+      if (used_[j*m + i]) {
+        subAx6(&blocks_[(j*m + i)*NN], &x[i*N], &x[j*N]);
+      }
+    }
+    solveUx6(&blocks_[(j*m + j)*NN], &x[j*N]);
+  }
+  return true;
+}
+
+void SBABlockSystem::print() const {
+  const int m = max_num_cams_;
+  for (int r=0; r<num_cams_*N; r++) {
+    int c0 = r/N;
+    for (int c=0; c<num_cams_*N; c++) {
+      int c1 = c/N;
+      double v = 0.;
+      if (c0 <= c1 && used_[c0*m + c1]) {
+        int i = r%N;
+        int j = c%N;
+        if (c0 < c1 || i <= j) {
+          v = blocks_[(c0*m + c1)*NN + i*N + j];
+        } else {
+          v = blocks_[(c0*m + c1)*NN + j*N + i];
+        }
+      } else if (c0 > c1 && used_[c1*m + c0]) {
+        v = blocks_[(c1*m + c0)*NN + (c%N)*N + r%N];
+      }
+      printf("%12.5e ", v);
+    }
+    printf("| %12.5e\n", rhs_[r]);
+  }
+}
+
+}
+}
@@ -217,6 +217,22 @@ bool CvTest3DPoseEstimate::test() {
         true, false, false);
     break;
   }
+  case BundleAdjBench: {
+    string frame_file("frames101.xml");
+    string point_file("points260.xml");
+    int num_free_frames  = 10;
+    int num_fixed_frames = 5;
+    int num_iterations = 10;
+    // 260 points each, 5200 tracks
+    int num_copies = 20;
+    int max_num_threads = 4;
+    return testBundleAdjBench(point_file, frame_file, num_free_frames,
+        num_fixed_frames, num_iterations, num_copies, max_num_threads);
+    break;
+  }
+  case RansacBench:
+    return testRansacBench(400, .3, 100, 4);
+    break;
   default:
     cout << "Unknown test type: "<<  mTestType << endl;
   }
@@ -1083,6 +1099,277 @@ bool CvTest3DPoseEstimate::testBundleAdj(
 }
 
 
+bool CvTest3DPoseEstimate::testBundleAdjBench(
+    string& points_file, string& frames_file,
+    int num_free_frames, int num_fixed_frames, int num_iterations,
+    int num_copies, int max_num_threads) {
+  bool status = true;
+  // the disturb methods print every frame and point otherwise
+  bool verbose = verbose_;
+  verbose_ = false;
+
+  string points_file_path(input_data_path_);
+  points_file_path.append(points_file);
+  CvMat *points = (CvMat *)cvLoad(points_file_path.c_str());
+  string frames_file_path(input_data_path_);
+  frames_file_path.append(frames_file);
+  CvMat *frames = (CvMat *)cvLoad(frames_file_path.c_str());
+  CvMat cartToDisp;
+  CvMat dispToCart;
+
+  this->setCameraParams(389.0, 389.0, 89.23, 323.42, 323.42, 274.95);
+  this->getProjectionMatrices(&cartToDisp, &dispToCart);
+
+  // copies of the points, each jittered by up to 5 cm
+  CvMat* all_points = cvCreateMat(points->rows*num_copies, 3, CV_64FC1);
+  CvMat* jitter = cvCreateMat(points->rows*num_copies, 3, CV_64FC1);
+  CvRNG rng_state = cvRNG(0xffffffff);
+  cvRandArr(&rng_state, jitter, CV_RAND_UNI, cvScalar(-.05), cvScalar(.05));
+  for (int c=0; c<num_copies; c++) {
+    for (int ipt=0; ipt<points->rows; ipt++) {
+      for (int i=0; i<3; i++) {
+        int r = c*points->rows + ipt;
+        cvmSet(all_points, r, i, cvmGet(points, ipt, i) + cvmGet(jitter, r, i));
+      }
+    }
+  }
+  cvReleaseMat(&jitter);
+
+  // set up cameras
+  vector<FramePose* > frame_poses;
+  int oldest_index = numeric_limits<int>::max();
+  for (int r=0; r<frames->rows; r++) {
+    CvMat param1x6;
+    CvMat param6x1;
+    cvGetSubRect(frames, &param1x6, cvRect(1,r,6,1));
+    cvReshape(&param1x6, &param6x1, 1, 6);
+    int frame_index = cvmGet(frames, r, 0);
+    if (frame_index<oldest_index) {
+      oldest_index = frame_index;
+    }
+
+    FramePose* fp = new FramePose(frame_index);
+    CvMatUtils::transformFromEulerAndShift(&param6x1, &fp->transf_local_to_global_);
+    frame_poses.push_back(fp);
+  }
+  vector<CvMat*> transfs;
+  BOOST_FOREACH(FramePose* fp, frame_poses) {
+    CvMat* transf = cvCreateMat(4, 4, CV_64FC1);
+    cvCopy(&fp->transf_local_to_global_, transf);
+    transfs.push_back(transf);
+  }
+
+  // set up tracks
+  PointTracks tracks;
+  setUpTracks(frame_poses, frames, all_points, cartToDisp, oldest_index, &tracks);
+  // the observations are exact, as in testBundleAdj(). Add some noise.
+  disturbObsvs(&tracks);
+
+  CvTermCriteria term_criteria =
+    cvTermCriteria(CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, num_iterations, DBL_EPSILON);
+
+  int window_size = num_fixed_frames + num_free_frames;
+  int num_windows = (frames->rows - window_size)/num_free_frames + 1;
+  // free frame poses and points after each window with a single thread
+  vector<double> results;
+
+  printf("%d tracks, %d free and %d fixed frames, %d windows\n",
+      (int)tracks.tracks_.size(), num_free_frames, num_fixed_frames, num_windows);
+  printf("threads  ms/window  speedup\n");
+  double time1 = 0.;
+  for (int num_threads=1; num_threads<=max_num_threads; num_threads++) {
+    LevMarqSparseBundleAdj sba(&dispToCart, &cartToDisp,
+        num_free_frames, num_fixed_frames, term_criteria);
+    sba.setNumThreads(num_threads);
+    // same disturbances for each thread count
+    mRng = cvRNG(0xffffffff);
+    int64 ticks = 0;
+    size_t ir = 0;
+    double max_err = 0.;
+
+    for (int w=0; w<num_windows; w++) {
+      int fi = w*num_free_frames;
+      vector<FramePose*> fixed_frames(frame_poses.begin()+fi,
+          frame_poses.begin()+fi+num_fixed_frames);
+      vector<FramePose*> free_frames(frame_poses.begin()+fi+num_fixed_frames,
+          frame_poses.begin()+fi+window_size);
+
+      // start each window from the ground truth, then disturb it
+      for (int f=fi; f<fi+window_size; f++) {
+        cvCopy(transfs[f], &frame_poses[f]->transf_local_to_global_);
+      }
+      int ipt = 0;
+      BOOST_FOREACH(PointTrack* p, tracks.tracks_) {
+        p->coordinates_.x = cvmGet(all_points, ipt, 0);
+        p->coordinates_.y = cvmGet(all_points, ipt, 1);
+        p->coordinates_.z = cvmGet(all_points, ipt, 2);
+        ipt++;
+      }
+      disturbFrames(free_frames);
+      disturbPoints(&tracks);
+
+      int64 t0 = cvGetTickCount();
+      sba.optimize(&free_frames, &fixed_frames, &tracks);
+      ticks += cvGetTickCount() - t0;
+
+      // compare with the single thread result
+      vector<double> result;
+      BOOST_FOREACH(FramePose* fp, free_frames) {
+        for (int i=0; i<16; i++) {
+          result.push_back(fp->transf_local_to_global_data_[i]);
+        }
+      }
+      BOOST_FOREACH(const PointTrack* p, tracks.tracks_) {
+        result.push_back(p->coordinates_.x);
+        result.push_back(p->coordinates_.y);
+        result.push_back(p->coordinates_.z);
+      }
+      BOOST_FOREACH(double v, result) {
+        if (num_threads == 1) {
+          results.push_back(v);
+        } else {
+          max_err = MAX(max_err, fabs(v - results[ir])/MAX(fabs(results[ir]), 1.));
+          ir++;
+        }
+      }
+    }
+
+    double ms = ticks/(cvGetTickFrequency()*1000.)/num_windows;
+    if (num_threads == 1) {
+      time1 = ms;
+    }
+    printf("   %2d   %9.2f   %5.2f\n", num_threads, ms, time1/ms);
+    // summation order differs across threads
+    if (max_err > 1.e-6) {
+      printf("%d threads: max relative difference %e from single thread\n",
+          num_threads, max_err);
+      status = false;
+    }
+  }
+
+  BOOST_FOREACH(FramePose* fp, frame_poses) {
+    delete fp;
+  }
+  BOOST_FOREACH(CvMat* transf, transfs) {
+    cvReleaseMat(&transf);
+  }
+  BOOST_FOREACH(PointTrack* p, tracks.tracks_) {
+    delete p;
+  }
+  tracks.tracks_.clear();
+  cvReleaseMat(&all_points);
+  cvReleaseMat(&frames);
+  cvReleaseMat(&points);
+  verbose_ = verbose;
+
+  return status;
+}
+
+bool CvTest3DPoseEstimate::testRansacBench(int num_points,
+    double outlier_ratio, int num_frames, int max_num_threads) {
+  bool status = true;
+  CvMat* cloud = (CvMat *)cvLoad("Data/obj1_cropped_2000_adjusted.xml");
+  CvMat points0;
+  cvGetRows(cloud, &points0, 0, MIN(num_points, cloud->rows));
+  num_points = points0.rows;
+  int num_outliers = (int)(outlier_ratio*num_points);
+
+  this->setCameraParams(389.0, 389.0, 89.23, 323.42, 323.42, 274.95);
+  PoseEstimateDisp peDisp;
+  peDisp.setCameraParams(Fx_, Fy_, Tx_, Clx_, Crx_, Cy_);
+  CvMat* uvds0  = cvCreateMat(num_points, 3, CV_64FC1);
+  CvMat* points1 = cvCreateMat(num_points, 3, CV_64FC1);
+  CvMat* noise = cvCreateMat(num_points, 3, CV_64FC1);
+  this->cartToDisp(&points0, uvds0);
+
+  // small motions between frames, noisy observations, and outliers
+  // in the first rows
+  vector<CvMat*> uvds1s;
+  for (int f=0; f<num_frames; f++) {
+    CvMat3X3<double>::rotMatrix(CV_PI/60.*randReal(-1., 1.),
+        CV_PI/60.*randReal(-1., 1.), CV_PI/60.*randReal(-1., 1.),
+        mRotData, CvMat3X3<double>::EulerXYZ);
+    cvmSet(&mTrans, 0, 0, randReal(-50., 50.));
+    cvmSet(&mTrans, 1, 0, randReal(-50., 50.));
+    cvmSet(&mTrans, 2, 0, randReal(-50., 50.));
+    transform(&mRot, &points0, &mTrans, points1);
+    CvMat* uvds1 = cvCreateMat(num_points, 3, CV_64FC1);
+    this->cartToDisp(points1, uvds1);
+    cvRandArr(&mRng, noise, CV_RAND_NORMAL, cvScalar(0.), cvScalar(.3));
+    cvAdd(uvds1, noise, uvds1);
+    for (int i=0; i<num_points; i++) {
+      if (i < num_outliers) {
+        cvmSet(uvds1, i, 0, randReal(0., 640.));
+        cvmSet(uvds1, i, 1, randReal(0., 480.));
+        cvmSet(uvds1, i, 2, randReal(1., 60.));
+      }
+      // RANSAC requires positive disparities
+      cvmSet(uvds1, i, 2, MAX(cvmGet(uvds1, i, 2), .1));
+    }
+    uvds1s.push_back(uvds1);
+  }
+
+  double _rot[9], _shift[3];
+  CvMat rot = cvMat(3, 3, CV_64FC1, _rot);
+  CvMat shift = cvMat(3, 1, CV_64FC1, _shift);
+  // rotation and translation of each frame from preemptive RANSAC with a
+  // single thread
+  vector<double> results;
+  double time0 = 0.;
+  double inliers0 = 0.;
+
+  printf("%d points, %d outliers, %d frames\n", num_points, num_outliers, num_frames);
+  printf("RANSAC      threads  ms/frame  inliers  speedup\n");
+  for (int num_threads=0; num_threads<=max_num_threads; num_threads++) {
+    // 0 for exhaustive RANSAC
+    peDisp.setPreemptiveRansac(num_threads > 0, MAX(num_threads, 1));
+    int64 ticks = 0;
+    double inliers = 0.;
+    size_t ir = 0;
+    bool same = true;
+    BOOST_FOREACH(CvMat* uvds1, uvds1s) {
+      int64 t = cvGetTickCount();
+      inliers += peDisp.estimate(uvds0, uvds1, &rot, &shift, false);
+      ticks += cvGetTickCount() - t;
+      for (int i=0; num_threads>0 && i<12; i++) {
+        double v = i<9 ? _rot[i] : _shift[i-9];
+        if (num_threads == 1) {
+          results.push_back(v);
+        } else {
+          same = same && results[ir++] == v;
+        }
+      }
+    }
+    double ms = ticks/(cvGetTickFrequency()*1000.)/num_frames;
+    inliers /= num_frames;
+    if (num_threads == 0) {
+      time0 = ms;
+      inliers0 = inliers;
+    }
+    printf("%-10s     %2d   %7.3f  %7.1f    %5.2f\n",
+        num_threads == 0 ? "exhaustive" : "preemptive", MAX(num_threads, 1),
+        ms, inliers, time0/ms);
+    if (same == false) {
+      printf("%d threads: pose differs from single thread\n", num_threads);
+      status = false;
+    }
+    // preemptive RANSAC stops early, but shall find about as many inliers
+    if (inliers < .95*inliers0) {
+      printf("%d threads: too few inliers\n", num_threads);
+      status = false;
+    }
+  }
+
+  BOOST_FOREACH(CvMat* uvds1, uvds1s) {
+    cvReleaseMat(&uvds1);
+  }
+  cvReleaseMat(&noise);
+  cvReleaseMat(&points1);
+  cvReleaseMat(&uvds0);
+  cvReleaseMat(&cloud);
+  return status;
+}
+
 bool CvTest3DPoseEstimate::testPointClouds(){
     bool status = true;
   CvMat * points0 =  (CvMat *)cvLoad("Data/obj1_cropped_2000_adjusted.xml");
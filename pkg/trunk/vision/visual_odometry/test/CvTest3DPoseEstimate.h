@@ -32,7 +32,11 @@ public:
     	/// bundle adjustment over a sequence of video images
     	VideoBundleAdj,
     	BundleAdj,
-    	BundleAdjUTest
+    	BundleAdjUTest,
+    	/// timing of bundle adjustment over a sliding window, 1..N threads
+    	BundleAdjBench,
+    	/// timing of exhaustive and preemptive RANSAC, 1..N threads
+    	RansacBench
     } TestType;
     typedef enum {
       Indoor1,
@@ -52,6 +56,20 @@ public:
         int num_free_frames, int num_fixed_frames, int num_iterations,
         int repeats,
         bool disturb_frames, bool disturb_points, bool disturb_obsvs);
+    /// Replays the stored sequence with num_copies jittered copies of each
+    /// point, sliding the window over it, and times the bundle adjustment
+    /// with 1 to max_num_threads threads. Fails if any thread count
+    /// does not give the single thread result.
+    bool testBundleAdjBench(
+        string& points_file, string& frames_file,
+        int num_free_frames, int num_fixed_frames, int num_iterations,
+        int num_copies, int max_num_threads);
+    /// Times the RANSAC of PoseEstimateDisp on num_frames synthetic pairs
+    /// of point clouds in disparity space, exhaustive and preemptive with
+    /// 1 to max_num_threads threads. Fails if the number of threads changes
+    /// the result of preemptive RANSAC.
+    bool testRansacBench(int num_points, double outlier_ratio, int num_frames,
+        int max_num_threads);
     bool test();
     TestType mTestType;
 
@@ -65,6 +65,10 @@ int main(int argc, char **argv){
       test3DPoseEstimate.mTestType = CvTest3DPoseEstimate::VideoBundleAdj;
     } else if (strcasecmp(option, "bundle1") == 0) {
       test3DPoseEstimate.mTestType = CvTest3DPoseEstimate::BundleAdj;
+    } else if (strcasecmp(option, "bundlebench") == 0) {
+      test3DPoseEstimate.mTestType = CvTest3DPoseEstimate::BundleAdjBench;
+    } else if (strcasecmp(option, "ransacbench") == 0) {
+      test3DPoseEstimate.mTestType = CvTest3DPoseEstimate::RansacBench;
     } else {
       cerr << "Unknown option: "<<option<<endl;
       exit(1);
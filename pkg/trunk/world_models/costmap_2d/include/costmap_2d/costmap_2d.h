@@ -65,6 +65,10 @@
 #include <string>
 #include <queue>
 
+#include <boost/thread.hpp>
+
+#include <voxel_grid/raytrace.h>
+
 namespace costmap_2d {
 
   typedef unsigned char TICK;
@@ -90,10 +94,22 @@ namespace costmap_2d {
     inline bool operator()(const QueueElement* lhs, const QueueElement* rhs){
       return lhs->distance > rhs->distance;
     }
+
+    inline bool operator()(const QueueElement& lhs, const QueueElement& rhs){
+      return lhs.distance > rhs.distance;
+    }
   };
 
   typedef std::priority_queue< QueueElement*, std::vector<QueueElement*>, QueueElementComparator > QUEUE;
 
+  /**
+   * @brief Selects the structure used to order cells during cost propagation
+   */
+  enum PropagationMode {
+    PRIORITY_QUEUE, /**< Heap of allocated elements, ordered by distance */
+    BUCKET_QUEUE /**< Elements stored by value in buckets, one per distinct cached distance */
+  };
+
 
   class CostMap2D: public ObstacleMapAccessor 
   {
@@ -120,11 +136,19 @@ namespace costmap_2d {
      * @param circumscribedRadius the radius used to indicate objects in the circumscribed circle around the robot
      * @param inscribedRadius the radius used to indicate objects in the inscribed circle around the robot
      * @param weight the scaling factor in the cost function. Should be <=1. Lower values reduce the effective cost
+     * @param obstacleRange the range out to which laser hitpoints will be considered
+     * @param raytraceRange the range out to which free space will be raytraced
+     * @param propagationMode the queue used to order cells during cost propagation
+     * @param incrementalUpdates if true, updates only re-inflate around obstacles added or removed in that update
+     * @param threadCount if greater than 1, updates are split into tiles of rows that are ray-traced and inflated
+     * on this many threads. Not used with incremental updates
      */
     CostMap2D(unsigned int width, unsigned int height, const std::vector<unsigned char>& data, 
 	      double resolution, unsigned char threshold, 
 	      double maxZ = 0.5,  double zLB = 0.15, double zUB = 0.20,
-	      double inflationRadius = 0, double circumscribedRadius = 0, double inscribedRadius = 0, double weight = 1, double obstacleRange = 10.0, double raytraceRange = 10.0);
+	      double inflationRadius = 0, double circumscribedRadius = 0, double inscribedRadius = 0, double weight = 1, double obstacleRange = 10.0, double raytraceRange = 10.0,
+	      PropagationMode propagationMode = PRIORITY_QUEUE, bool incrementalUpdates = false,
+	      unsigned int threadCount = 1);
   
     /**
      * @brief Destructor.
@@ -142,7 +166,8 @@ namespace costmap_2d {
      * @param wx The current x position
      * @param wy The current y position
      * @param cloud holds projected scan data
-     * @param updates holds the updated cell ids and values
+     * @param updates holds the updated cell ids and values. In incremental mode these are taken from
+     * the cells touched by the update rather than from a diff of the whole map
      */
     void updateDynamicObstacles(double wx, double wy,
 				const std::vector<std_msgs::PointCloud*>& clouds,
@@ -174,6 +199,26 @@ namespace costmap_2d {
      */
     double getWeight() const {return weight_;}
 
+    /**
+     * @brief The queue used to order cells during cost propagation
+     */
+    PropagationMode getPropagationMode() const {return propagationMode_;}
+
+    /**
+     * @brief The number of cells visited by the most recent cost propagation
+     */
+    unsigned int getPropagationCount() const {return propagationCount_;}
+
+    /**
+     * @brief True if updates only re-inflate around obstacles added or removed in that update
+     */
+    bool isIncremental() const {return incrementalUpdates_;}
+
+    /**
+     * @brief The number of threads used for tiled updates
+     */
+    unsigned int getThreadCount() const {return threadCount_;}
+
     /**
      * @brief Will reset the cost data
      * @param wx the x position in world coordinates
@@ -196,11 +241,141 @@ namespace costmap_2d {
     void propagateCosts();
 
     /**
-     * @brief Utility to push free space inferred from a laser point hit via ray-tracing
-     * @param The origin from which to trace out
-     * @param The target in map co-ordinates to trace to
+     * @brief Cost propagation draining the distance buckets in increasing order
+     */
+    void propagateCostsByBucket();
+
+    /**
+     * @brief Incremental version of the observation update. Only newly observed obstacles are inflated, and
+     * only the neighbourhoods of obstacles cleared by ray-tracing are recomputed.
+     * @param observations The collection of observations from all data sources
+     */
+    void updateDynamicObstaclesIncrementally(const std::vector<Observation>& observations);
+
+    /**
+     * @brief Tiled version of the observation update. Hit points are collected serially, then tiles of rows are
+     * ray-traced and inflated on a pool of threadCount_ threads. Each tile writes only its own rows.
+     * @param observations The collection of observations from all data sources
+     */
+    void updateDynamicObstaclesTiled(const std::vector<Observation>& observations);
+
+    /**
+     * @brief Buffers for propagating costs within a tile, one set per thread, kept between updates
+     */
+    struct TileWorkspace {
+      std::vector<bool> markers; /**< Marks for the cells of a tile and the rows either side of it */
+      std::vector<unsigned int> markedCells; /**< Offsets of the marked cells, to clear them after propagation */
+      std::vector<QueueElement> heap; /**< Heap ordered by distance, in PRIORITY_QUEUE mode */
+      std::vector< std::vector<QueueElement> > buckets; /**< Buckets indexed by level, in BUCKET_QUEUE mode */
+      unsigned int currentBucket; /**< The bucket being drained */
+      unsigned int rowBegin, rowEnd; /**< Rows of the tile being propagated */
+      unsigned int haloBegin, haloEnd; /**< Rows propagated through, including those either side of the tile */
+    };
+
+    /**
+     * @brief Loop of a persistent worker thread for tiled updates. Waits for each update and processes tiles with
+     * the calling thread until the cost map is destroyed
+     */
+    void tileWorker(unsigned int thread);
+
+    /**
+     * @brief Processing of tiles by one thread. Claims tiles to ray-trace until none remain, waits for all threads,
+     * then claims tiles to inflate
+     */
+    void processTiles(unsigned int thread);
+
+    /**
+     * @brief Clears the cells of the ray updateFreeSpace would trace from (x0, y0) to (x1, y1) that lie in rows [rowBegin, rowEnd)
+     */
+    void updateFreeSpaceInRows(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int rowBegin, unsigned int rowEnd);
+
+    /**
+     * @brief Collect the cells of the ray endpoints of an observation for free space projection
+     * @return false if the observation origin is out of the projection range
+     */
+    bool getRayEndpoints(const Observation& obs, std::vector<voxel_grid::Cell>& endpoints) const;
+
+    /**
+     * @brief Propagates costs from seeds into rows [rowBegin, rowEnd). Propagation also passes through the inflation
+     * radius of rows either side, without writing them, so that obstacles across the tile border are accounted for.
+     * @return The number of cells visited
+     */
+    unsigned int propagateCostsInRows(const std::vector<unsigned int>& seeds, unsigned int rowBegin, unsigned int rowEnd, TileWorkspace& ws);
+
+    /**
+     * @brief Queue a cell of a tile for propagation from a source, in the queue selected by the propagation mode
+     */
+    void enqueueInTile(TileWorkspace& ws, unsigned int source, unsigned int ind);
+
+    /**
+     * @brief Write the cost of a cell dequeued from a tile's queue if it is in the tile, and queue its neighbours
+     */
+    void expandInTile(TileWorkspace& ws, const QueueElement& c);
+
+    /**
+     * @brief Reset the cells within the inflation radius of a removed obstacle to their static values. Cells
+     * that are still obstacles are left alone
+     */
+    void resetNeighbourhood(unsigned int ind);
+
+    /**
+     * @brief Reset the cells of the box [x0, x1] x [y0, y1] to their values in the static map before inflation.
+     * Cells that are still obstacles are left alone, and static obstacles that have been cleared stay clear
+     */
+    void resetRegion(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1);
+
+    /**
+     * @brief Queue every obstacle whose inflation could reach the neighbourhood of a removed obstacle
+     */
+    void enqueueObstaclesAround(unsigned int ind);
+
+    /**
+     * @brief Queue every obstacle in the box [x0, x1] x [y0, y1]
+     */
+    void enqueueObstaclesInRegion(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1);
+
+    /**
+     * @brief Clear a cell seen through by ray-tracing. In incremental mode only obstacles are cleared, and
+     * they are recorded for recomputation of their neighbourhood
+     */
+    void clearCell(unsigned int ind);
+
+    /**
+     * @brief Record the value of a cell before its first change in the current update
+     */
+    void touch(unsigned int ind){
+      if(!touched_[ind]){
+        touched_[ind] = true;
+        touchedCells_.push_back(std::make_pair(ind, costData_[ind]));
+      }
+    }
+
+    /**
+     * @brief Reset markers and touched cells from the last incremental update
+     */
+    void resetIncrementalState();
+
+    /**
+     * @brief Utility to push free space inferred from the laser point hits of an observation via ray-tracing
+     * @param obs The observation, whose origin and points in the projection range are traced between
      */ 
-    void updateFreeSpace(const std_msgs::Point& origin, double wx, double wy);
+    void updateFreeSpace(const Observation& obs);
+
+    /**
+     * @brief Ray-tracing action, clearing cells not marked for cost propagation
+     */
+    class ClearCellAction {
+    public:
+      ClearCellAction(CostMap2D& costMap): costMap_(costMap){}
+
+      inline void operator()(unsigned int offset, unsigned int z){
+        if(!costMap_.marked(offset))
+          costMap_.clearCell(offset);
+      }
+
+    private:
+      CostMap2D& costMap_;
+    };
 
     /**
      * @brief Simple test for a cell having been marked during current propaagtion
@@ -210,7 +385,11 @@ namespace costmap_2d {
     /**
      * @mark a cell
      */
-    void mark(unsigned int ind){xy_markers_[ind] = true;}
+    void mark(unsigned int ind){
+      xy_markers_[ind] = true;
+      if(incrementalUpdates_)
+        markedCells_.push_back(ind);
+    }
     
     /**
      * Utilities for cost propagation
@@ -221,11 +400,13 @@ namespace costmap_2d {
 
     double computeDistance(unsigned int a, unsigned int b) const;
 
+    unsigned int computeLevel(unsigned int a, unsigned int b) const;
+
     unsigned char computeCost(double distance) const;
 
     void updateCellCost(unsigned int ind, unsigned char cost);
 
-    bool in_projection_range(double z){return z >= zLB_ && z <= zUB_;}
+    bool in_projection_range(double z) const {return z >= zLB_ && z <= zUB_;}
 
     const double maxZ_; /**< Points above this will be excluded from consideration */
     const double zLB_; /**< Filters points for free space projection */
@@ -234,16 +415,43 @@ namespace costmap_2d {
     const unsigned int circumscribedRadius_; /**< The radius for the circumscribed radius, in cells */
     const unsigned int inscribedRadius_; /**< The radius for the inscribed radius, in cells */
     const double weight_;  /**< The weighting to apply to a normalized cost value */
+    const PropagationMode propagationMode_; /**< Selects the heap or the bucket queue for cost propagation */
+    const bool incrementalUpdates_; /**< Selects incremental inflation on update */
+    const unsigned int threadCount_; /**< Threads used for tiled updates */
 
     //used squared distance because square root computations are expensive
     double sq_obstacle_range_; /** The range out to which we will consider laser hitpoints **/
     double sq_raytrace_range_; /** The range out to which we will raytrace **/
 
     unsigned char* staticData_; /**< initial static map */
+    unsigned char* baseData_; /**< Static map before inflation, to reset the neighbourhood of removed obstacles in incremental mode */
     bool* xy_markers_; /**< Records time remaining in ticks before expiration of the observation */
     QUEUE queue_; /**< Used for cost propagation */
+    std::vector< std::vector<QueueElement> > buckets_; /**< Used for cost propagation in BUCKET_QUEUE mode, indexed by level */
+    unsigned int currentBucket_; /**< The bucket being drained during propagation */
+    unsigned int propagationCount_; /**< Cells visited by the last propagation */
+
+    bool* touched_; /**< Cells changed during the current incremental update */
+    std::vector< std::pair<unsigned int, unsigned char> > touchedCells_; /**< Touched cells with their values before the update */
+    std::vector<unsigned int> markedCells_; /**< Cells marked during the current incremental update, to reset without a full memset */
+    std::vector<unsigned int> removedObstacles_; /**< Obstacles cleared by ray-tracing in the current incremental update */
+    std::vector<voxel_grid::Cell> rayEndpoints_; /**< Reused buffer of ray endpoints for free space projection */
+
+    unsigned int tileCount_; /**< Number of tiles of rows for tiled updates */
+    unsigned int tileHeight_; /**< Height of each tile in rows. The last may be shorter */
+    unsigned int nextRaytraceTile_; /**< Next tile to be claimed for ray-tracing */
+    unsigned int nextInflationTile_; /**< Next tile to be claimed for inflation */
+    boost::mutex tileMutex_; /**< Guards tile claims and the propagation count during tiled updates */
+    boost::barrier* tileBarrier_; /**< Synchronizes the threads at the start, between the phases and at the end of a tiled update */
+    boost::thread_group tileWorkers_; /**< Threads that process tiles along with the updating thread */
+    bool tileShutdown_; /**< Tells the workers to exit at the start of the next update */
+    const std::vector< std::vector<voxel_grid::Cell> >* tileEndpoints_; /**< Ray endpoints of the current tiled update */
+    const std::vector<unsigned int>* tileSeeds_; /**< Obstacle cells of the current tiled update */
+    std::vector<TileWorkspace> tileWorkspaces_; /**< Propagation buffers of each thread */
 
     double** cachedDistances; /**< Cached distances indexed by dx, dy */  
+    unsigned int** cachedLevels; /**< Index of cachedDistances[dx][dy] in the sorted distinct distances */
+    std::vector<double> distanceLevels_; /**< Sorted distinct values of cachedDistances */
     const unsigned int kernelWidth_; /**< The width of the kernel matrix, which will be square */
     unsigned char* kernelData_; /**< kernel data structure for cost map updates around the robot */
   };
@@ -71,24 +71,40 @@ namespace costmap_2d {
   CostMap2D::CostMap2D(unsigned int width, unsigned int height, const std::vector<unsigned char>& data,
       double resolution, unsigned char threshold, double maxZ, double zLB, double zUB,
       double inflationRadius,	double circumscribedRadius, double inscribedRadius, double weight, 
-      double  obstacleRange, double raytraceRange)
+      double  obstacleRange, double raytraceRange, PropagationMode propagationMode,
+      bool incrementalUpdates, unsigned int threadCount)
     : ObstacleMapAccessor(0, 0, width, height, resolution),
     maxZ_(maxZ), zLB_(zLB), zUB_(zUB),
     inflationRadius_(toCellDistance(inflationRadius, (unsigned int) ceil(width * resolution), resolution)),
     circumscribedRadius_(toCellDistance(circumscribedRadius, inflationRadius_, resolution)),
     inscribedRadius_(toCellDistance(inscribedRadius, circumscribedRadius_, resolution)),
-    weight_(std::max(0.0, std::min(weight, 1.0))), sq_obstacle_range_(obstacleRange * obstacleRange),
+    weight_(std::max(0.0, std::min(weight, 1.0))), propagationMode_(propagationMode),
+    incrementalUpdates_(incrementalUpdates), threadCount_(std::max(threadCount, 1u)), sq_obstacle_range_(obstacleRange * obstacleRange),
     sq_raytrace_range_((raytraceRange / resolution) * (raytraceRange / resolution)), 
-      staticData_(NULL), xy_markers_(NULL), kernelWidth_((circumscribedRadius_ * 2) + 1)
+      staticData_(NULL), baseData_(NULL), xy_markers_(NULL), currentBucket_(0), propagationCount_(0),
+      touched_(NULL), tileCount_(1), tileHeight_(height), nextRaytraceTile_(0), nextInflationTile_(0),
+      tileBarrier_(NULL), tileShutdown_(false), tileEndpoints_(NULL), tileSeeds_(NULL), kernelWidth_((circumscribedRadius_ * 2) + 1)
   {
     if(weight != weight_){
       ROS_INFO("Warning - input weight %f is invalid and has been set to %f\n", weight, weight_);
     }
 
+    // Tiles are kept at least four times the inflation radius tall, so that the rows propagated through but not
+    // written do not dominate the work of a tile. Two tiles per thread balance the load across threads
+    if(threadCount_ > 1 && incrementalUpdates_){
+      ROS_INFO("Warning - tiled updates are not used with incremental updates. Using a single thread\n");
+    }
+    else if(threadCount_ > 1){
+      tileCount_ = std::max(1u, std::min(threadCount_ * 2, height_ / (4 * inflationRadius_ + 1)));
+      tileHeight_ = (height_ + tileCount_ - 1) / tileCount_;
+    }
+
     unsigned int i, j;
     staticData_ = new unsigned char[width_*height_];
     xy_markers_ = new bool[width_*height_];
     memset(xy_markers_, 0, width_ * height_* sizeof(bool));
+    touched_ = new bool[width_*height_];
+    memset(touched_, 0, width_ * height_* sizeof(bool));
 
     // Set up a cache of distance values for a kernel around the robot
     cachedDistances = new double*[inflationRadius_+1];
@@ -97,9 +113,23 @@ namespace costmap_2d {
       for (j=0; j<=i; j++) {
         cachedDistances[i][j] = sqrt (pow(i, 2) + pow(j, 2));
         cachedDistances[j][i] = cachedDistances[i][j];
+        distanceLevels_.push_back(cachedDistances[i][j]);
       }
     }
 
+    // Index each cached distance by its rank among the distinct distances. The bucket queue uses one bucket per level
+    std::sort(distanceLevels_.begin(), distanceLevels_.end());
+    distanceLevels_.erase(std::unique(distanceLevels_.begin(), distanceLevels_.end()), distanceLevels_.end());
+    cachedLevels = new unsigned int*[inflationRadius_+1];
+    for (i=0; i<=inflationRadius_; i++) {
+      cachedLevels[i] = new unsigned int[inflationRadius_+1];
+      for (j=0; j<=inflationRadius_; j++)
+        cachedLevels[i][j] = std::lower_bound(distanceLevels_.begin(), distanceLevels_.end(), cachedDistances[i][j]) - distanceLevels_.begin();
+    }
+
+    if(propagationMode_ == BUCKET_QUEUE)
+      buckets_.resize(distanceLevels_.size());
+
     // Allocate memory for a kernel matrix to be used for map updates aruond the robot
     kernelData_ = new unsigned char[kernelWidth_ * kernelWidth_];
 
@@ -126,21 +156,61 @@ namespace costmap_2d {
       }
     }
 
+    // Keep the obstacles and costs of the static map before inflation, from which incremental updates
+    // recompute the neighbourhood of removed obstacles
+    if(incrementalUpdates_){
+      baseData_ = new unsigned char[width_*height_];
+      memcpy(baseData_, costData_, width_ * height_);
+    }
+
     // Now propagate the costs derived from static data
     propagateCosts();
 
     // Instantiate static data
     memcpy(staticData_, costData_, width_ * height_);
+
+    if(incrementalUpdates_)
+      resetIncrementalState();
+
+    // Start the workers for tiled updates, with buffers for a tile and the rows either side of it
+    if(tileCount_ > 1){
+      tileWorkspaces_.resize(threadCount_);
+      for(unsigned int t = 0; t < threadCount_; t++){
+        TileWorkspace& ws = tileWorkspaces_[t];
+        ws.markers.resize(std::min(tileHeight_ + 2 * inflationRadius_, height_) * width_, false);
+        if(propagationMode_ == BUCKET_QUEUE)
+          ws.buckets.resize(distanceLevels_.size());
+        ws.currentBucket = 0;
+      }
+
+      tileBarrier_ = new boost::barrier(threadCount_);
+      for(unsigned int t = 1; t < threadCount_; t++)
+        tileWorkers_.create_thread(boost::bind(&CostMap2D::tileWorker, this, t));
+    }
   }
 
   CostMap2D::~CostMap2D() {
+    if(tileBarrier_ != NULL){
+      tileShutdown_ = true;
+      tileBarrier_->wait();
+      tileWorkers_.join_all();
+      delete tileBarrier_;
+    }
+
     if(staticData_ != NULL) delete[] staticData_;
+    if(baseData_ != NULL) delete[] baseData_;
     if(xy_markers_ != NULL) delete[] xy_markers_;
+    if(touched_ != NULL) delete[] touched_;
     if(cachedDistances != NULL){
       for (unsigned int i=0; i<=inflationRadius_; i++)
         delete[] cachedDistances[i];
       delete[] cachedDistances;
     }
+    if(cachedLevels != NULL){
+      for (unsigned int i=0; i<=inflationRadius_; i++)
+        delete[] cachedLevels[i];
+      delete[] cachedLevels;
+    }
   }
 
 
@@ -173,6 +243,28 @@ namespace costmap_2d {
 	costData_[costMapIndex] = std::min(costData_[costMapIndex], kernelData_[kernelIndex]);
       }
     }
+
+    // Static obstacles cleared in the kernel still have their inflation in the static map around the kernel, and
+    // cells of the kernel may be below the inflation of the obstacles around them. Recompute the kernel and the
+    // inflation radius around it from the obstacles that remain, so that incremental updates start from costs
+    // consistent with the obstacles in the map
+    if(incrementalUpdates_){
+      resetIncrementalState();
+
+      unsigned int x0 = originX > inflationRadius_ ? originX - inflationRadius_ : 0;
+      unsigned int y0 = originY > inflationRadius_ ? originY - inflationRadius_ : 0;
+      unsigned int x1 = std::min(originX + kernelWidth_ - 1 + inflationRadius_, width_ - 1);
+      unsigned int y1 = std::min(originY + kernelWidth_ - 1 + inflationRadius_, height_ - 1);
+      resetRegion(x0, y0, x1, y1);
+
+      x0 = x0 > inflationRadius_ ? x0 - inflationRadius_ : 0;
+      y0 = y0 > inflationRadius_ ? y0 - inflationRadius_ : 0;
+      x1 = std::min(x1 + inflationRadius_, width_ - 1);
+      y1 = std::min(y1 + inflationRadius_, height_ - 1);
+      enqueueObstaclesInRegion(x0, y0, x1, y1);
+
+      propagateCosts();
+    }
   }
 
   /**
@@ -183,6 +275,16 @@ namespace costmap_2d {
       std::vector<unsigned int>& updates){
     updates.clear();
 
+    // The incremental update records every cell it changes, so there is no need to diff the whole map
+    if(incrementalUpdates_){
+      updateDynamicObstacles(wx, wy, clouds);
+      for(std::vector< std::pair<unsigned int, unsigned char> >::const_iterator it = touchedCells_.begin(); it != touchedCells_.end(); ++it){
+        if(it->second != costData_[it->first])
+          updates.push_back(it->first);
+      }
+      return;
+    }
+
     // Store the current cost data
     unsigned char* oldValues = new unsigned char[width_ * height_];
     memcpy(oldValues, costData_, width_ * height_);
@@ -221,25 +323,24 @@ namespace costmap_2d {
    */
   void CostMap2D::updateDynamicObstacles(double wx, double wy, const std::vector<Observation>& observations)
   {
+    if(incrementalUpdates_){
+      updateDynamicObstaclesIncrementally(observations);
+      return;
+    }
+
+    if(tileCount_ > 1){
+      updateDynamicObstaclesTiled(observations);
+      return;
+    }
+
     // Revert to initial state
     memset(xy_markers_, 0, width_ * height_ * sizeof(bool));
 
     // Now propagate free space. We iterate again over observations, process only those from an origin
     // within a specific range, and a point within a certain z-range. We only want to propagate free space
     // in 2D so keep point and its origin within expected range
-    for(std::vector<Observation>::const_iterator it = observations.begin(); it!= observations.end(); ++it){
-      const Observation& obs = *it;
-      if(!in_projection_range(obs.origin_.z))
-        continue;
-
-      const std_msgs::PointCloud& cloud = *(obs.cloud_);
-      for(size_t i = 0; i < cloud.get_pts_size(); i++) {
-        if(!in_projection_range(cloud.pts[i].z))
-          continue;
-
-        updateFreeSpace(obs.origin_, cloud.pts[i].x, cloud.pts[i].y);
-      }
-    }
+    for(std::vector<Observation>::const_iterator it = observations.begin(); it!= observations.end(); ++it)
+      updateFreeSpace(*it);
 
     // Propagation queue should be empty from completion of last propagation.
     ROS_ASSERT(queue_.empty());
@@ -280,6 +381,392 @@ namespace costmap_2d {
     propagateCosts();
   }
 
+  /**
+   * Obstacles observed in this update are marked before ray-tracing so that they are not cleared by rays passing
+   * through them, and are then unmarked for propagation. Obstacles that were already present keep their inflation,
+   * so only new obstacles are queued. Obstacles that have been cleared have their neighbourhood reset to the static
+   * map and re-inflated from the obstacles remaining around them. The cost of an update is thus proportional to the
+   * number of obstacles that changed, rather than to the number observed.
+   */
+  void CostMap2D::updateDynamicObstaclesIncrementally(const std::vector<Observation>& observations)
+  {
+    resetIncrementalState();
+
+    // Collect the cells hit by obstacle points
+    std::vector<unsigned int> hits;
+    for(std::vector<Observation>::const_iterator it = observations.begin(); it!= observations.end(); ++it){
+      const Observation& obs = *it;
+      const std_msgs::PointCloud& cloud = *(obs.cloud_);
+      for(size_t i = 0; i < cloud.get_pts_size(); i++) {
+        if(cloud.pts[i].z > maxZ_)
+          continue;
+
+        double sq_dist = (cloud.pts[i].x - obs.origin_.x) * (cloud.pts[i].x - obs.origin_.x) 
+          + (cloud.pts[i].y - obs.origin_.y) * (cloud.pts[i].y - obs.origin_.y) 
+          + (cloud.pts[i].z - obs.origin_.z) * (cloud.pts[i].z - obs.origin_.z);
+
+        if(sq_dist >= sq_obstacle_range_)
+          continue;
+
+        unsigned int ind = WC_IND(cloud.pts[i].x, cloud.pts[i].y);
+        if(marked(ind))
+          continue;
+
+        mark(ind);
+        hits.push_back(ind);
+      }
+    }
+
+    // Propagate free space, recording the obstacles that are cleared
+    for(std::vector<Observation>::const_iterator it = observations.begin(); it!= observations.end(); ++it)
+      updateFreeSpace(*it);
+
+    for(std::vector<unsigned int>::const_iterator it = hits.begin(); it != hits.end(); ++it)
+      xy_markers_[*it] = false;
+
+    ROS_ASSERT(queue_.empty());
+
+    // De-inflate around removed obstacles. All neighbourhoods are reset before any are re-inflated, since they may overlap
+    for(std::vector<unsigned int>::const_iterator it = removedObstacles_.begin(); it != removedObstacles_.end(); ++it)
+      resetNeighbourhood(*it);
+
+    for(std::vector<unsigned int>::const_iterator it = removedObstacles_.begin(); it != removedObstacles_.end(); ++it)
+      enqueueObstaclesAround(*it);
+
+    // Inflate new obstacles
+    for(std::vector<unsigned int>::const_iterator it = hits.begin(); it != hits.end(); ++it){
+      unsigned int ind = *it;
+      if(marked(ind) || costData_[ind] == LETHAL_OBSTACLE)
+        continue;
+
+      unsigned int mx, my;
+      IND_MC(ind, mx, my);
+      enqueue(ind, mx, my);
+    }
+
+    propagateCosts();
+  }
+
+  /**
+   * Ray-tracing only ever clears cells, so it commutes with collecting the hit points and can be completed first.
+   * All tiles must be ray-traced before any is inflated, since a ray may clear a cell in one tile that is inflated
+   * from an obstacle in another.
+   */
+  void CostMap2D::updateDynamicObstaclesTiled(const std::vector<Observation>& observations)
+  {
+    memset(xy_markers_, 0, width_ * height_ * sizeof(bool));
+    propagationCount_ = 0;
+
+    // Collect the cells hit by obstacle points. These seed propagation in every tile within reach
+    std::vector<unsigned int> seeds;
+    for(std::vector<Observation>::const_iterator it = observations.begin(); it!= observations.end(); ++it){
+      const Observation& obs = *it;
+      const std_msgs::PointCloud& cloud = *(obs.cloud_);
+      for(size_t i = 0; i < cloud.get_pts_size(); i++) {
+        if(cloud.pts[i].z > maxZ_)
+          continue;
+
+        double sq_dist = (cloud.pts[i].x - obs.origin_.x) * (cloud.pts[i].x - obs.origin_.x) 
+          + (cloud.pts[i].y - obs.origin_.y) * (cloud.pts[i].y - obs.origin_.y) 
+          + (cloud.pts[i].z - obs.origin_.z) * (cloud.pts[i].z - obs.origin_.z);
+
+        if(sq_dist >= sq_obstacle_range_)
+          continue;
+
+        unsigned int ind = WC_IND(cloud.pts[i].x, cloud.pts[i].y);
+        if(marked(ind))
+          continue;
+
+        mark(ind);
+        seeds.push_back(ind);
+      }
+    }
+
+    // Collect the ray endpoints of each observation once, rather than in every tile. The origin is stored first,
+    // followed by the endpoints with duplicates removed
+    std::vector< std::vector<voxel_grid::Cell> > endpoints;
+    for(std::vector<Observation>::const_iterator it = observations.begin(); it!= observations.end(); ++it){
+      if(!getRayEndpoints(*it, rayEndpoints_))
+        continue;
+
+      unsigned int x0, y0;
+      WC_MC(it->origin_.x, it->origin_.y, x0, y0);
+      std::sort(rayEndpoints_.begin(), rayEndpoints_.end(), voxel_grid::BearingOrder(x0, y0));
+      rayEndpoints_.erase(std::unique(rayEndpoints_.begin(), rayEndpoints_.end()), rayEndpoints_.end());
+
+      endpoints.push_back(std::vector<voxel_grid::Cell>(1, voxel_grid::Cell(x0, y0)));
+      endpoints.back().insert(endpoints.back().end(), rayEndpoints_.begin(), rayEndpoints_.end());
+    }
+
+    // Release the workers, and process tiles along with them until all are done
+    nextRaytraceTile_ = 0;
+    nextInflationTile_ = 0;
+    tileEndpoints_ = &endpoints;
+    tileSeeds_ = &seeds;
+    tileBarrier_->wait();
+    processTiles(0);
+    tileBarrier_->wait();
+    tileEndpoints_ = NULL;
+    tileSeeds_ = NULL;
+  }
+
+  void CostMap2D::tileWorker(unsigned int thread){
+    while(true){
+      tileBarrier_->wait();
+      if(tileShutdown_)
+        return;
+
+      processTiles(thread);
+      tileBarrier_->wait();
+    }
+  }
+
+  void CostMap2D::processTiles(unsigned int thread){
+    while(true){
+      unsigned int tile;
+      {
+        boost::mutex::scoped_lock lock(tileMutex_);
+        if(nextRaytraceTile_ >= tileCount_)
+          break;
+        tile = nextRaytraceTile_++;
+      }
+
+      unsigned int rowBegin = tile * tileHeight_;
+      unsigned int rowEnd = std::min(rowBegin + tileHeight_, height_);
+      for(std::vector< std::vector<voxel_grid::Cell> >::const_iterator it = tileEndpoints_->begin(); it!= tileEndpoints_->end(); ++it){
+        const voxel_grid::Cell& origin = it->front();
+        for(std::vector<voxel_grid::Cell>::const_iterator cell = it->begin() + 1; cell != it->end(); ++cell)
+          updateFreeSpaceInRows(origin.x, origin.y, cell->x, cell->y, rowBegin, rowEnd);
+      }
+    }
+
+    tileBarrier_->wait();
+
+    unsigned int count = 0;
+    while(true){
+      unsigned int tile;
+      {
+        boost::mutex::scoped_lock lock(tileMutex_);
+        if(nextInflationTile_ >= tileCount_)
+          break;
+        tile = nextInflationTile_++;
+      }
+
+      unsigned int rowBegin = tile * tileHeight_;
+      unsigned int rowEnd = std::min(rowBegin + tileHeight_, height_);
+      count += propagateCostsInRows(*tileSeeds_, rowBegin, rowEnd, tileWorkspaces_[thread]);
+    }
+
+    boost::mutex::scoped_lock lock(tileMutex_);
+    propagationCount_ += count;
+  }
+
+  /**
+   * The k-th cell of a Bresenham line is k steps along the major axis and (den/2 + k * numadd) / den steps along the
+   * minor axis, so the cells falling in a range of rows can be found without tracing the line from its origin. The
+   * cells visited, and where tracing stops on reaching the raytrace range, are the same as for voxel_grid::raytraceLine.
+   */
+  void CostMap2D::updateFreeSpaceInRows(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, unsigned int rowBegin, unsigned int rowEnd){
+    const long sx = x1 >= x0 ? 1 : -1;
+    const long sy = y1 >= y0 ? 1 : -1;
+    const long deltax = abs((int) x1 - (int) x0);
+    const long deltay = abs((int) y1 - (int) y0);
+    const bool xMajor = deltax >= deltay;
+    const long den = xMajor ? deltax : deltay;
+    const long numadd = xMajor ? deltay : deltax;
+
+    // The range of steps along y, away from the origin, covered by the rows
+    long tA = sy * ((long) rowBegin - (long) y0);
+    long tB = sy * ((long) rowEnd - 1 - (long) y0);
+    long tLo = std::max(std::min(tA, tB), 0L);
+    long tHi = std::max(tA, tB);
+    if(tHi < tLo)
+      return;
+
+    // The range of cells k in [0, den] covered by those steps
+    long kBegin = 0, kEnd = den;
+    if(!xMajor){
+      kBegin = tLo;
+      kEnd = std::min(den, tHi);
+    }
+    else if(numadd == 0){
+      if(tLo > 0)
+        return;
+    }
+    else {
+      // Smallest k with (den/2 + k * numadd) / den >= tLo, and largest with it <= tHi
+      long a = tLo * den - den / 2;
+      kBegin = a <= 0 ? 0 : (a + numadd - 1) / numadd;
+      long b = (tHi + 1) * den - den / 2;
+      kEnd = std::min(den, (b + numadd - 1) / numadd - 1);
+    }
+
+    for(long k = kBegin; k <= kEnd; k++){
+      long minor = den > 0 ? (den / 2 + k * numadd) / den : 0;
+      long dx = xMajor ? k : minor;
+      long dy = xMajor ? minor : k;
+
+      // Distance from the origin grows with k, so the first cell out of range ends the ray
+      if(k > 0 && (double) (dx * dx + dy * dy) >= sq_raytrace_range_)
+        break;
+
+      costData_[MC_IND(x0 + sx * dx, y0 + sy * dy)] = 0;
+    }
+  }
+
+  /**
+   * Mirrors propagateCosts, with a queue and markers local to the thread so that tiles can be processed concurrently.
+   * Cells in the rows either side of the tile are expanded but not written; they are written by the tile that owns
+   * them. The buffers are kept between tiles and updates, and only the marks that were set are cleared.
+   */
+  unsigned int CostMap2D::propagateCostsInRows(const std::vector<unsigned int>& seeds, unsigned int rowBegin, unsigned int rowEnd, TileWorkspace& ws){
+    ws.rowBegin = rowBegin;
+    ws.rowEnd = rowEnd;
+    ws.haloBegin = rowBegin > inflationRadius_ ? rowBegin - inflationRadius_ : 0;
+    ws.haloEnd = std::min(rowEnd + inflationRadius_, height_);
+
+    for(std::vector<unsigned int>::const_iterator it = seeds.begin(); it != seeds.end(); ++it){
+      unsigned int my = *it / width_;
+      if(my >= ws.haloBegin && my < ws.haloEnd)
+        enqueueInTile(ws, *it, *it);
+    }
+
+    unsigned int count = 0;
+    if(propagationMode_ == BUCKET_QUEUE){
+      for(ws.currentBucket = 0; ws.currentBucket < ws.buckets.size(); ws.currentBucket++){
+        std::vector<QueueElement>& bucket = ws.buckets[ws.currentBucket];
+
+        // The bucket may grow while it is drained, so index rather than iterate, and copy the element out
+        for(unsigned int i = 0; i < bucket.size(); i++){
+          const QueueElement c = bucket[i];
+          count++;
+          expandInTile(ws, c);
+        }
+
+        bucket.clear();
+      }
+
+      ws.currentBucket = 0;
+    }
+    else {
+      QueueElementComparator comparator;
+      while(!ws.heap.empty()){
+        std::pop_heap(ws.heap.begin(), ws.heap.end(), comparator);
+        const QueueElement c = ws.heap.back();
+        ws.heap.pop_back();
+        count++;
+        expandInTile(ws, c);
+      }
+    }
+
+    const unsigned int offset = ws.haloBegin * width_;
+    for(std::vector<unsigned int>::const_iterator it = ws.markedCells.begin(); it != ws.markedCells.end(); ++it)
+      ws.markers[*it - offset] = false;
+    ws.markedCells.clear();
+
+    return count;
+  }
+
+  void CostMap2D::enqueueInTile(TileWorkspace& ws, unsigned int source, unsigned int ind){
+    const unsigned int offset = ws.haloBegin * width_;
+    if(ws.markers[ind - offset])
+      return;
+
+    ws.markers[ind - offset] = true;
+    ws.markedCells.push_back(ind);
+
+    if(propagationMode_ == BUCKET_QUEUE){
+      unsigned int level = computeLevel(source, ind);
+      ws.buckets[std::max(level, ws.currentBucket)].push_back(QueueElement(distanceLevels_[level], source, ind));
+    }
+    else {
+      ws.heap.push_back(QueueElement(computeDistance(source, ind), source, ind));
+      std::push_heap(ws.heap.begin(), ws.heap.end(), QueueElementComparator());
+    }
+  }
+
+  void CostMap2D::expandInTile(TileWorkspace& ws, const QueueElement& c){
+    unsigned int mx, my;
+    IND_MC(c.ind, mx, my);
+    if(my >= ws.rowBegin && my < ws.rowEnd)
+      updateCellCost(c.ind, computeCost(c.distance));
+
+    // If distance reached the inflation radius then skip further expansion
+    if(c.distance >= inflationRadius_)
+      return;
+
+    if(mx > 0)
+      enqueueInTile(ws, c.source, c.ind - 1);
+    if(mx < width_ - 1)
+      enqueueInTile(ws, c.source, c.ind + 1);
+    if(my > ws.haloBegin)
+      enqueueInTile(ws, c.source, c.ind - width_);
+    if(my < ws.haloEnd - 1)
+      enqueueInTile(ws, c.source, c.ind + width_);
+  }
+
+  void CostMap2D::resetIncrementalState(){
+    for(std::vector<unsigned int>::const_iterator it = markedCells_.begin(); it != markedCells_.end(); ++it)
+      xy_markers_[*it] = false;
+
+    for(std::vector< std::pair<unsigned int, unsigned char> >::const_iterator it = touchedCells_.begin(); it != touchedCells_.end(); ++it)
+      touched_[it->first] = false;
+
+    markedCells_.clear();
+    touchedCells_.clear();
+    removedObstacles_.clear();
+  }
+
+  void CostMap2D::resetNeighbourhood(unsigned int ind){
+    unsigned int mx, my;
+    IND_MC(ind, mx, my);
+    resetRegion(mx > inflationRadius_ ? mx - inflationRadius_ : 0,
+                my > inflationRadius_ ? my - inflationRadius_ : 0,
+                std::min(mx + inflationRadius_, width_ - 1),
+                std::min(my + inflationRadius_, height_ - 1));
+  }
+
+  /**
+   * Cells are reset to the static map before inflation rather than after, since the inflated static map still
+   * holds the inflation of static obstacles that have since been cleared. Inflation from the obstacles that remain
+   * is restored by re-propagating them.
+   */
+  void CostMap2D::resetRegion(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1){
+    for(unsigned int y = y0; y <= y1; y++){
+      for(unsigned int x = x0; x <= x1; x++){
+        unsigned int i = MC_IND(x, y);
+        if(costData_[i] == LETHAL_OBSTACLE)
+          continue;
+
+        // A static obstacle that has been cleared stays clear
+        unsigned char cost = baseData_[i] == LETHAL_OBSTACLE ? 0 : baseData_[i];
+        if(cost != costData_[i]){
+          touch(i);
+          costData_[i] = cost;
+        }
+      }
+    }
+  }
+
+  void CostMap2D::enqueueObstaclesAround(unsigned int ind){
+    unsigned int mx, my;
+    IND_MC(ind, mx, my);
+    enqueueObstaclesInRegion(mx > 2 * inflationRadius_ ? mx - 2 * inflationRadius_ : 0,
+                             my > 2 * inflationRadius_ ? my - 2 * inflationRadius_ : 0,
+                             std::min(mx + 2 * inflationRadius_, width_ - 1),
+                             std::min(my + 2 * inflationRadius_, height_ - 1));
+  }
+
+  void CostMap2D::enqueueObstaclesInRegion(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1){
+    for(unsigned int y = y0; y <= y1; y++){
+      for(unsigned int x = x0; x <= x1; x++){
+        unsigned int i = MC_IND(x, y);
+        if(costData_[i] == LETHAL_OBSTACLE)
+          enqueue(i, x, y);
+      }
+    }
+  }
+
   void CostMap2D::getOccupiedCellDataIndexList(std::vector<unsigned int>& results) const {
     results.clear();
     unsigned int maxCellCount = getWidth() * getHeight();
@@ -290,9 +777,17 @@ namespace costmap_2d {
   }
 
   void CostMap2D::propagateCosts(){
+    propagationCount_ = 0;
+
+    if(propagationMode_ == BUCKET_QUEUE){
+      propagateCostsByBucket();
+      return;
+    }
+
     while(!queue_.empty()){
       QueueElement* c = queue_.top();
       queue_.pop();
+      propagationCount_++;
       unsigned char cost = computeCost(c->distance);
       updateCellCost(c->ind, cost);  
 
@@ -304,6 +799,34 @@ namespace costmap_2d {
     }
   }
 
+  /**
+   * Buckets are drained in order of increasing distance. Every cell is expanded from a parent at most one cell
+   * closer to its source, so new elements almost always land in a later bucket. Any that would land in an earlier
+   * one are appended to the current bucket instead, so they are still visited. Buckets are cleared but not
+   * released, so their storage is reused by subsequent propagations.
+   */
+  void CostMap2D::propagateCostsByBucket(){
+    for(currentBucket_ = 0; currentBucket_ < buckets_.size(); currentBucket_++){
+      std::vector<QueueElement>& bucket = buckets_[currentBucket_];
+
+      // The bucket may grow while it is drained, so index rather than iterate, and copy the element out
+      for(unsigned int i = 0; i < bucket.size(); i++){
+        const QueueElement c = bucket[i];
+        propagationCount_++;
+        unsigned char cost = computeCost(c.distance);
+        updateCellCost(c.ind, cost);
+
+        // If distance reached the inflation radius then skip further expansion
+        if(c.distance < inflationRadius_)
+          enqueueNeighbors(c.source, c.ind);
+      }
+
+      bucket.clear();
+    }
+
+    currentBucket_ = 0;
+  }
+
   /**
    * @brief It is arguable if this is the correct update rule. We are trying to avoid
    * tracing holes through walls by propagating adjacent cells that are in sensor range through
@@ -312,10 +835,32 @@ namespace costmap_2d {
    */
   void CostMap2D::updateCellCost(unsigned int ind, unsigned char cost){
     //need to check if the cell is unkown because we definitely want to replace it in that case
-    if(costData_[ind] == NO_INFORMATION)
-      costData_[ind] = cost;
-    else
-      costData_[ind] = std::max(cost, costData_[ind]);
+    if(costData_[ind] != NO_INFORMATION)
+      cost = std::max(cost, costData_[ind]);
+
+    if(incrementalUpdates_ && cost != costData_[ind])
+      touch(ind);
+
+    costData_[ind] = cost;
+  }
+
+  void CostMap2D::clearCell(unsigned int ind){
+    if(!incrementalUpdates_){
+      costData_[ind] = 0;
+      return;
+    }
+
+    // Inflated costs are left to be recomputed around the cleared obstacles. Unknown cells
+    // never inflated anything, so they are only recorded for the diff
+    if(costData_[ind] == LETHAL_OBSTACLE){
+      touch(ind);
+      costData_[ind] = 0;
+      removedObstacles_.push_back(ind);
+    }
+    else if(costData_[ind] == NO_INFORMATION){
+      touch(ind);
+      costData_[ind] = 0;
+    }
   }
 
   void CostMap2D::enqueueNeighbors(unsigned int source, unsigned int ind){
@@ -336,8 +881,14 @@ namespace costmap_2d {
     // If the cell is not marked for cost propagation
     unsigned int ind = MC_IND(mx, my);
     if(!marked(ind)){
-      QueueElement* c = new QueueElement(computeDistance(source, ind), source, ind);
-      queue_.push(c);
+      if(propagationMode_ == BUCKET_QUEUE){
+        unsigned int level = computeLevel(source, ind);
+        buckets_[std::max(level, currentBucket_)].push_back(QueueElement(distanceLevels_[level], source, ind));
+      }
+      else {
+        QueueElement* c = new QueueElement(computeDistance(source, ind), source, ind);
+        queue_.push(c);
+      }
       mark(ind);
     }
   }
@@ -358,6 +909,20 @@ namespace costmap_2d {
     return distance;
   }
 
+  /**
+   * Index of the Euclidean distance among the distinct cached distances
+   */
+  unsigned int CostMap2D::computeLevel(unsigned int a, unsigned int b) const{
+    unsigned int mx_a, my_a, mx_b, my_b;
+    IND_MC(a, mx_a, my_a);
+    IND_MC(b, mx_b, my_b);
+    unsigned int dx = abs((int)(mx_a) - (int) mx_b);
+    unsigned int dy = abs((int)(my_a) - (int) my_b);
+
+    ROS_ASSERT((dx <= inflationRadius_) && (dy <= inflationRadius_));
+    return cachedLevels[dx][dy];
+  }
+
   unsigned char CostMap2D::computeCost(double distance) const{
     unsigned char cost = 0;
     if(distance == 0)
@@ -374,88 +939,35 @@ namespace costmap_2d {
 
 
   /**
-   * Utilizes Eitan's implementation of Bresenhams ray tracing algorithm to iterate over the cells between the
-   * origin and the sightline.
+   * Rays from an observation share an origin, so they are traced as a batch. Points projecting to the same cell are
+   * traced once, which for 3D clouds projected to the plane removes most rays.
    */
-  void CostMap2D::updateFreeSpace(const std_msgs::Point& origin, double wx, double wy){
-    unsigned int x, y, x1, y1;
-    WC_MC(origin.x, origin.y, x, y);
-    WC_MC(wx, wy, x1, y1);
-
-    //for determining where we should stop raytracing
-    unsigned int startx = x;
-    unsigned int starty = y;
+  void CostMap2D::updateFreeSpace(const Observation& obs){
+    if(!getRayEndpoints(obs, rayEndpoints_))
+      return;
 
-    unsigned int deltax = abs(x1 - x);        // The difference between the x's
-    unsigned int deltay = abs(y1 - y);        // The difference between the y's
+    unsigned int x0, y0;
+    WC_MC(obs.origin_.x, obs.origin_.y, x0, y0);
+    ClearCellAction clear(*this);
+    voxel_grid::raytraceBatch(clear, x0, y0, 0, rayEndpoints_, width_, sq_raytrace_range_);
+  }
 
-    unsigned int xinc1, xinc2, yinc1, yinc2;
-    unsigned int den, num, numadd, numpixels;
+  bool CostMap2D::getRayEndpoints(const Observation& obs, std::vector<voxel_grid::Cell>& endpoints) const{
+    endpoints.clear();
+    if(!in_projection_range(obs.origin_.z))
+      return false;
 
-    if (x1 >= x)                 // The x-values are increasing
-    {
-      xinc1 = 1;
-      xinc2 = 1;
-    }
-    else                          // The x-values are decreasing
-    {
-      xinc1 = -1;
-      xinc2 = -1;
-    }
-
-    if (y1 >= y)                 // The y-values are increasing
-    {
-      yinc1 = 1;
-      yinc2 = 1;
-    }
-    else                          // The y-values are decreasing
-    {
-      yinc1 = -1;
-      yinc2 = -1;
-    }
+    const std_msgs::PointCloud& cloud = *(obs.cloud_);
+    for(size_t i = 0; i < cloud.get_pts_size(); i++) {
+      if(!in_projection_range(cloud.pts[i].z))
+        continue;
 
-    if (deltax >= deltay)         // There is at least one x-value for every y-value
-    {
-      xinc1 = 0;                  // Don't change the x when numerator >= denominator
-      yinc2 = 0;                  // Don't change the y for every iteration
-      den = deltax;
-      num = deltax / 2;
-      numadd = deltay;
-      numpixels = deltax;         // There are more x-values than y-values
-    }
-    else {
-      xinc2 = 0;                  // Don't change the x for every iteration
-      yinc1 = 0;                  // Don't change the y when numerator >= denominator
-      den = deltay;
-      num = deltay / 2;
-      numadd = deltax;
-      numpixels = deltay;         // There are more y-values than x-values
+      unsigned int mx, my;
+      WC_MC(cloud.pts[i].x, cloud.pts[i].y, mx, my);
+      endpoints.push_back(voxel_grid::Cell(mx, my));
     }
 
-    for (unsigned int curpixel = 0; curpixel <= numpixels; curpixel++){
-      unsigned int index = MC_IND(x, y);
-
-      // Update x and y values
-      num += numadd;              // Increase the numerator by the top of the fraction
-      if (num >= den)             // Check if numerator >= denominator
-      {
-        num -= den;               // Calculate the new numerator value
-        x += xinc1;               // Change the x as appropriate
-        y += yinc1;               // Change the y as appropriate
-      }
-
-      x += xinc2;                 // Change the x as appropriate
-      y += yinc2;                 // Change the y as appropriate
-
-      if(!marked(index))
-        costData_[index] = 0;
-
-      //we want to break out of the loop if we have raytraced far enough
-      double sq_cell_dist = (x - startx) * (x - startx) + (y - starty) * (y - starty);
-      if(sq_cell_dist >= sq_raytrace_range_)
-        break;
-
-    }
+    return true;
   }
 
   CostMapAccessor::CostMapAccessor(const CostMap2D& costMap, double maxSize, double poseX, double poseY)
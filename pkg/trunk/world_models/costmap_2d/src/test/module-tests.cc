@@ -682,6 +682,172 @@ TEST(costmap, test11){
     ASSERT_EQ(map.getCost(i, i), 0);
 }
 
+/**
+ * Test that the bucket queue propagates the same costs as the priority queue
+ */
+TEST(costmap, testBucketQueue){
+  CostMap2D heapMap(100, 100, EMPTY_100_BY_100, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+		    ROBOT_RADIUS * 5.5, ROBOT_RADIUS * 4, ROBOT_RADIUS * 2);
+  CostMap2D bucketMap(100, 100, EMPTY_100_BY_100, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+		      ROBOT_RADIUS * 5.5, ROBOT_RADIUS * 4, ROBOT_RADIUS * 2, 1, 10.0, 10.0, BUCKET_QUEUE);
+  ASSERT_EQ(bucketMap.getPropagationMode(), BUCKET_QUEUE);
+
+  // Obstacles are spaced beyond twice the inflation radius so each inflated cell has a unique nearest source
+  for(unsigned int k = 0; k < 5; k++){
+    std_msgs::PointCloud c0;
+    c0.set_pts_size(25);
+    for(unsigned int i = 0; i < c0.get_pts_size(); i++){
+      c0.pts[i].x = 12 + (i % 5) * 15 + k;
+      c0.pts[i].y = 12 + (i / 5) * 15 + k;
+      c0.pts[i].z = 0;
+    }
+
+    heapMap.updateDynamicObstacles(0, 0, CostMap2D::toVector(c0));
+    bucketMap.updateDynamicObstacles(0, 0, CostMap2D::toVector(c0));
+    ASSERT_EQ(heapMap.getPropagationCount(), bucketMap.getPropagationCount());
+
+    for(unsigned int i = 0; i < 100 * 100; i++)
+      ASSERT_EQ(heapMap[i], bucketMap[i]);
+  }
+}
+
+/**
+ * Test that incremental updates inflate new obstacles, de-inflate cleared ones, and report only changed cells
+ */
+TEST(costmap, testIncrementalUpdates){
+  CostMap2D map(100, 100, EMPTY_100_BY_100, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+		ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS, 1, 10.0, 10.0, PRIORITY_QUEUE, true);
+  CostMap2D fullMap(100, 100, EMPTY_100_BY_100, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+		    ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS);
+  ASSERT_EQ(map.isIncremental(), true);
+
+  // Add an obstacle at 50,50. Inflation should match a full update
+  std_msgs::PointCloud c0;
+  c0.set_pts_size(1);
+  c0.pts[0].x = 50;
+  c0.pts[0].y = 50;
+  c0.pts[0].z = MAX_Z;
+
+  std::vector<unsigned int> updates, fullUpdates;
+  map.updateDynamicObstacles(45, 45, CostMap2D::toVector(c0), updates);
+  fullMap.updateDynamicObstacles(45, 45, CostMap2D::toVector(c0), fullUpdates);
+  ASSERT_EQ(updates.size(), fullUpdates.size());
+  for(unsigned int i = 0; i < 100 * 100; i++)
+    ASSERT_EQ(map[i], fullMap[i]);
+
+  // Observing it again changes nothing, and propagates nothing
+  map.updateDynamicObstacles(45, 45, CostMap2D::toVector(c0), updates);
+  ASSERT_EQ(updates.size(), 0);
+  ASSERT_EQ(map.getPropagationCount(), 0);
+
+  // Trace a ray through the obstacle. It should be removed along with all of its inflation
+  std_msgs::PointCloud c1;
+  c1.set_pts_size(1);
+  c1.pts[0].x = 55;
+  c1.pts[0].y = 55;
+  c1.pts[0].z = MAX_Z;
+  map.updateDynamicObstacles(45, 45, CostMap2D::toVector(c1), updates);
+  ASSERT_EQ(updates.size(), fullUpdates.size());
+  for(unsigned int i = 0; i < 100 * 100; i++)
+    ASSERT_EQ(map[i], 0);
+}
+
+/**
+ * Test that clearing a static obstacle incrementally, and reverting to the static map, leave the same costs as a
+ * full inflation of the obstacles that remain
+ */
+TEST(costmap, testIncrementalRevertToStaticMap){
+  // Static obstacles near the robot at 50,50, one of them inside the kernel kept on revert, and further away
+  std::vector<unsigned char> staticMap(EMPTY_100_BY_100);
+  staticMap[52 + 50 * 100] = CostMap2D::LETHAL_OBSTACLE;
+  staticMap[54 + 53 * 100] = CostMap2D::LETHAL_OBSTACLE;
+  staticMap[20 + 20 * 100] = CostMap2D::LETHAL_OBSTACLE;
+
+  // The same map with the obstacle that the ray below clears
+  std::vector<unsigned char> clearedMap(staticMap);
+  clearedMap[52 + 50 * 100] = 0;
+
+  CostMap2D map(100, 100, staticMap, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+		ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS, 1, 10.0, 10.0, PRIORITY_QUEUE, true);
+
+  // A ray along y = 50 clears the static obstacle at 52,50, and adds obstacles at 56,50 and 50,58
+  std_msgs::PointCloud c0;
+  c0.set_pts_size(2);
+  c0.pts[0].x = 56;
+  c0.pts[0].y = 50;
+  c0.pts[0].z = MAX_Z;
+  c0.pts[1].x = 50;
+  c0.pts[1].y = 58;
+  c0.pts[1].z = MAX_Z;
+  map.updateDynamicObstacles(50, 50, CostMap2D::toVector(c0));
+
+  CostMap2D clearedIncrementalMap(100, 100, clearedMap, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+				  ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS, 1, 10.0, 10.0, PRIORITY_QUEUE, true);
+  clearedIncrementalMap.updateDynamicObstacles(50, 50, CostMap2D::toVector(c0));
+  ASSERT_EQ(map.getCost(52, 50) < CostMap2D::INSCRIBED_INFLATED_OBSTACLE, true);
+  for(unsigned int i = 0; i < 100 * 100; i++)
+    ASSERT_EQ(map[i], clearedIncrementalMap[i]);
+
+  // Reverting removes the dynamic obstacles, and keeps the static obstacle in the kernel cleared
+  map.revertToStaticMap(50, 50);
+  CostMap2D clearedFullMap(100, 100, clearedMap, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+			   ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS);
+  for(unsigned int i = 0; i < 100 * 100; i++)
+    ASSERT_EQ(map[i], clearedFullMap[i]);
+
+  // The next incremental update starts from consistent costs
+  std_msgs::PointCloud c1;
+  c1.set_pts_size(1);
+  c1.pts[0].x = 45;
+  c1.pts[0].y = 50;
+  c1.pts[0].z = MAX_Z;
+  map.updateDynamicObstacles(50, 50, CostMap2D::toVector(c1));
+
+  CostMap2D expectedMap(100, 100, clearedMap, RESOLUTION, THRESHOLD, MAX_Z, MAX_Z, MAX_Z,
+			ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS, 1, 10.0, 10.0, PRIORITY_QUEUE, true);
+  expectedMap.updateDynamicObstacles(50, 50, CostMap2D::toVector(c1));
+  for(unsigned int i = 0; i < 100 * 100; i++)
+    ASSERT_EQ(map[i], expectedMap[i]);
+}
+
+/**
+ * Test that tiled updates on several threads match a single threaded update
+ */
+TEST(costmap, testTiledUpdates){
+  CostMap2D map(100, 100, EMPTY_100_BY_100, RESOLUTION, THRESHOLD, MAX_Z / 2, MAX_Z * 0.6, MAX_Z,
+		ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS, 1, 50.0, 30.0);
+  CostMap2D tiledMap(100, 100, EMPTY_100_BY_100, RESOLUTION, THRESHOLD, MAX_Z / 2, MAX_Z * 0.6, MAX_Z,
+		     ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS, 1, 50.0, 30.0, PRIORITY_QUEUE, false, 4);
+  CostMap2D tiledBucketMap(100, 100, EMPTY_100_BY_100, RESOLUTION, THRESHOLD, MAX_Z / 2, MAX_Z * 0.6, MAX_Z,
+			   ROBOT_RADIUS * 3, ROBOT_RADIUS * 2, ROBOT_RADIUS, 1, 50.0, 30.0, BUCKET_QUEUE, false, 3);
+  ASSERT_EQ(tiledMap.getThreadCount(), 4);
+
+  // Obstacles are spaced beyond twice the inflation radius so each inflated cell has a unique nearest source.
+  // Rays are traced from the centre through the spaces between them
+  for(unsigned int k = 0; k < 5; k++){
+    std_msgs::PointCloud c0;
+    c0.set_pts_size(50);
+    for(unsigned int i = 0; i < 25; i++){
+      c0.pts[i].x = 12 + (i % 5) * 15 + k;
+      c0.pts[i].y = 12 + (i / 5) * 15 + k;
+      c0.pts[i].z = 0;
+    }
+    for(unsigned int i = 25; i < 50; i++){
+      c0.pts[i].x = 5 + (i * 37 + k * 11) % 90;
+      c0.pts[i].y = 5 + (i * 53 + k * 7) % 90;
+      c0.pts[i].z = MAX_Z * 0.8;
+    }
+
+    map.updateDynamicObstacles(50, 50, CostMap2D::toVector(c0));
+    tiledMap.updateDynamicObstacles(50, 50, CostMap2D::toVector(c0));
+    tiledBucketMap.updateDynamicObstacles(50, 50, CostMap2D::toVector(c0));
+    for(unsigned int i = 0; i < 100 * 100; i++){
+      ASSERT_EQ(map[i], tiledMap[i]);
+      ASSERT_EQ(map[i], tiledBucketMap[i]);
+    }
+  }
+}
+
 int main(int argc, char** argv){
   for(unsigned int i = 0; i< GRID_WIDTH * GRID_HEIGHT; i++){
     EMPTY_10_BY_10.push_back(0);
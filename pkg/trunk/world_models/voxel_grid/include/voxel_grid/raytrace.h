@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author: Eric Berger
+ */
+
+#ifndef VOXEL_GRID_RAYTRACE_H
+#define VOXEL_GRID_RAYTRACE_H
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+
+namespace voxel_grid {
+
+  /**
+   * @brief A ray endpoint in cell coordinates
+   */
+  struct Cell {
+    Cell(unsigned int x_, unsigned int y_, unsigned int z_ = 0): x(x_), y(y_), z(z_) {}
+
+    bool operator==(const Cell& rhs) const {
+      return x == rhs.x && y == rhs.y && z == rhs.z;
+    }
+
+    unsigned int x, y, z;
+  };
+
+  /**
+   * @brief Orders ray endpoints by bearing around an origin, so that consecutive rays cover neighbouring cells.
+   * Endpoints on the same bearing are ordered by cell, so duplicates are adjacent
+   */
+  class BearingOrder {
+  public:
+    BearingOrder(unsigned int x0, unsigned int y0): x0_(x0), y0_(y0){}
+
+    bool operator()(const Cell& lhs, const Cell& rhs) const {
+      long long dx_l = (long long) lhs.x - x0_, dy_l = (long long) lhs.y - y0_;
+      long long dx_r = (long long) rhs.x - x0_, dy_r = (long long) rhs.y - y0_;
+      int half_l = half(dx_l, dy_l), half_r = half(dx_r, dy_r);
+      if(half_l != half_r)
+        return half_l < half_r;
+
+      // Within a half plane, the sign of the cross product orders by bearing
+      long long cross = dx_l * dy_r - dy_l * dx_r;
+      if(cross != 0)
+        return cross > 0;
+
+      if(lhs.y != rhs.y)
+        return lhs.y < rhs.y;
+      if(lhs.x != rhs.x)
+        return lhs.x < rhs.x;
+      return lhs.z < rhs.z;
+    }
+
+  private:
+    /**
+     * @brief 0 for the origin itself, 1 for bearings in [0, pi), 2 for [pi, 2 pi)
+     */
+    static int half(long long dx, long long dy){
+      if(dx == 0 && dy == 0)
+        return 0;
+      return (dy > 0 || (dy == 0 && dx > 0)) ? 1 : 2;
+    }
+
+    const unsigned int x0_, y0_;
+  };
+
+  /**
+   * @brief The number of steps along a line of abs_da major steps to visit, such that every cell after the origin
+   * lies within sqMaxRange of it. The minor axes advance by (abs_da / 2 + k * abs_d) / abs_da after k steps, and the
+   * distance grows with k, so the last cell in range is found by bisection.
+   */
+  inline unsigned int clipLine(unsigned int abs_da, unsigned int abs_db, unsigned int abs_dc, double sqMaxRange){
+    double a = abs_da, b = abs_db, c = abs_dc;
+    if(a * a + b * b + c * c < sqMaxRange)
+      return abs_da;
+
+    // Invariant: step lo is in range (or is the origin), step hi is not
+    unsigned int lo = 0, hi = abs_da;
+    while(hi - lo > 1){
+      unsigned int k = lo + (hi - lo) / 2;
+      double ka = k;
+      double kb = (abs_da / 2 + (unsigned long long) k * abs_db) / abs_da;
+      double kc = (abs_da / 2 + (unsigned long long) k * abs_dc) / abs_da;
+      if(ka * ka + kb * kb + kc * kc < sqMaxRange)
+        lo = k;
+      else
+        hi = k;
+    }
+
+    return lo;
+  }
+
+  /**
+   * @brief Walks the cells of the 3D Bresenham line from (x0, y0, z0) to (x1, y1, z1), calling at(offset, z) for
+   * each, where offset = y * stride + x. The walk stops at the last cell within sqMaxRange (in cells squared) of the
+   * origin, which is always visited.
+   *
+   * Each axis is described by its step in offset and in z, so the same loop serves whichever axis is the major one,
+   * and the range is clipped up front rather than tested at each step.
+   */
+  template <class ActionType>
+  inline void raytraceLine(ActionType& at, unsigned int x0, unsigned int y0, unsigned int z0,
+			   unsigned int x1, unsigned int y1, unsigned int z1, unsigned int stride,
+			   double sqMaxRange = std::numeric_limits<double>::max()){
+    int dx = x1 - x0;
+    int dy = y1 - y0;
+    int dz = z1 - z0;
+
+    unsigned int abs_dx = abs(dx);
+    unsigned int abs_dy = abs(dy);
+    unsigned int abs_dz = abs(dz);
+
+    int offset_dx = dx > 0 ? 1 : -1;
+    int offset_dy = (dy > 0 ? 1 : -1) * (int) stride;
+    int offset_dz = dz > 0 ? 1 : -1;
+
+    // Axis a is stepped every cell, b and c when their error accumulates
+    unsigned int abs_da, abs_db, abs_dc;
+    int offset_a, offset_b, offset_c, z_a, z_b, z_c;
+    if(abs_dx >= abs_dy && abs_dx >= abs_dz){
+      abs_da = abs_dx; offset_a = offset_dx; z_a = 0;
+      abs_db = abs_dy; offset_b = offset_dy; z_b = 0;
+      abs_dc = abs_dz; offset_c = 0; z_c = offset_dz;
+    }
+    else if(abs_dy >= abs_dz){
+      abs_da = abs_dy; offset_a = offset_dy; z_a = 0;
+      abs_db = abs_dx; offset_b = offset_dx; z_b = 0;
+      abs_dc = abs_dz; offset_c = 0; z_c = offset_dz;
+    }
+    else{
+      abs_da = abs_dz; offset_a = 0; z_a = offset_dz;
+      abs_db = abs_dx; offset_b = offset_dx; z_b = 0;
+      abs_dc = abs_dy; offset_c = offset_dy; z_c = 0;
+    }
+
+    unsigned int steps = clipLine(abs_da, abs_db, abs_dc, sqMaxRange);
+    unsigned int offset = y0 * stride + x0;
+    unsigned int z = z0;
+    unsigned int error_b = abs_da / 2, error_c = abs_da / 2;
+
+    for(unsigned int i = 0; i < steps; i++){
+      at(offset, z);
+      offset += offset_a;
+      z += z_a;
+      error_b += abs_db;
+      error_c += abs_dc;
+      if(error_b >= abs_da){
+	offset += offset_b;
+	z += z_b;
+	error_b -= abs_da;
+      }
+      if(error_c >= abs_da){
+	offset += offset_c;
+	z += z_c;
+	error_c -= abs_da;
+      }
+    }
+    at(offset, z);
+  }
+
+  /**
+   * @brief Traces rays from one origin to a batch of endpoints, as raytraceLine. Endpoints are sorted by bearing and
+   * rays to the same cell are traced once, so dense clouds cost in proportion to the cells they hit rather than their
+   * points, and consecutive rays share cache lines near the origin.
+   * @param endpoints The ray endpoints. Sorted and deduplicated in place
+   */
+  template <class ActionType>
+  inline void raytraceBatch(ActionType& at, unsigned int x0, unsigned int y0, unsigned int z0,
+			    std::vector<Cell>& endpoints, unsigned int stride,
+			    double sqMaxRange = std::numeric_limits<double>::max()){
+    std::sort(endpoints.begin(), endpoints.end(), BearingOrder(x0, y0));
+    endpoints.erase(std::unique(endpoints.begin(), endpoints.end()), endpoints.end());
+
+    for(std::vector<Cell>::const_iterator it = endpoints.begin(); it != endpoints.end(); ++it)
+      raytraceLine(at, x0, y0, z0, it->x, it->y, it->z, stride, sqMaxRange);
+  }
+}
+
+#endif
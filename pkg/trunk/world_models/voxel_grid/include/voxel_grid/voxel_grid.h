@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author: Eric Berger
+ */
+
+#ifndef VOXEL_GRID_VOXEL_GRID_H
+#define VOXEL_GRID_VOXEL_GRID_H
+
+/**
+   @mainpage
+
+   @htmlinclude manifest.html
+
+   This library provides a 3D voxel grid of arbitrary height. Each voxel is unknown, free or marked. Voxels are
+   packed one bit per plane into words, with each (x, y) column stored contiguously, so lines through the grid and
+   queries on a column touch little memory. Counts of marked and known voxels are kept per column as voxels change,
+   so testing a column and projecting the grid into a 2D cost map do not scan the column.
+*/
+
+#include <voxel_grid/raytrace.h>
+#include <vector>
+#include <stdint.h>
+
+namespace voxel_grid {
+
+  /**
+   * @brief The state of a voxel
+   */
+  enum VoxelStatus {
+    FREE = 0,
+    UNKNOWN = 1,
+    MARKED = 2
+  };
+
+  class VoxelGrid{
+  public:
+    /**
+     * @brief Constructor. All voxels start unknown
+     * @param size_x width of the grid [cells]
+     * @param size_y height of the grid [cells]
+     * @param size_z number of layers in the grid. Any number is supported
+     */
+    VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+    ~VoxelGrid();
+
+    void markVoxel(unsigned int x, unsigned int y, unsigned int z);
+    void clearVoxel(unsigned int x, unsigned int y, unsigned int z);
+ 
+    void markVoxelLine(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1);
+    void clearVoxelLine(unsigned int x0, unsigned int y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1);
+    void clearVoxelLineInMap(unsigned int x0, unsigned int y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1, unsigned char *map_2d);
+
+    /**
+     * @brief Clear the voxels along the rays from an origin to each of a batch of endpoints. Endpoints out of bounds
+     * are skipped. If map_2d is given, columns left without marked voxels are cleared in it as for clearVoxelLineInMap
+     * @param endpoints The ray endpoints. Sorted and deduplicated in place
+     */
+    void clearVoxelLines(unsigned int x0, unsigned int y0, unsigned int z0, std::vector<Cell>& endpoints, unsigned char *map_2d = 0);
+
+    /**
+     * @brief Reset every voxel to unknown
+     */
+    void reset();
+
+    bool getVoxel(unsigned int x, unsigned int y, unsigned int z);
+    VoxelStatus getVoxelStatus(unsigned int x, unsigned int y, unsigned int z);
+    bool getVoxelColumn(unsigned int x, unsigned int y); //Are there any obstacles at that (x, y) location in the grid?
+
+    /**
+     * @brief The number of marked voxels in a column
+     */
+    unsigned int getMarkedCount(unsigned int x, unsigned int y) const {return marked_count_[y * size_x + x];}
+
+    /**
+     * @brief The number of unknown voxels in a column
+     */
+    unsigned int getUnknownCount(unsigned int x, unsigned int y) const {return size_z - known_count_[y * size_x + x];}
+
+    /**
+     * @brief The state of a column: MARKED if any voxel is marked, otherwise UNKNOWN if more than
+     * unknown_threshold voxels are unknown, otherwise FREE
+     */
+    VoxelStatus getColumnStatus(unsigned int x, unsigned int y, unsigned int unknown_threshold) const {
+      unsigned int ind = y * size_x + x;
+      if(marked_count_[ind] > 0)
+        return MARKED;
+      return size_z - known_count_[ind] > unknown_threshold ? UNKNOWN : FREE;
+    }
+
+    /**
+     * @brief Project the grid into a 2D map of size_x by size_y cells, writing the given cost for each column status
+     * @see getColumnStatus
+     */
+    void projectToMap(unsigned char *map_2d, unsigned int unknown_threshold,
+		      unsigned char free_cost, unsigned char unknown_cost, unsigned char marked_cost) const;
+
+    unsigned int sizeX() const {return size_x;}
+    unsigned int sizeY() const {return size_y;}
+    unsigned int sizeZ() const {return size_z;}
+
+    void printVoxelGrid();
+    void printColumnGrid();
+
+  private:
+    class MarkAction;
+    class ClearAction;
+    class ClearInMapAction;
+
+    bool inBounds(unsigned int x, unsigned int y, unsigned int z) const {
+      return x < size_x && y < size_y && z < size_z;
+    }
+
+    /**
+     * @brief Set a voxel, given its column offset, updating the column counts
+     */
+    inline void mark(unsigned int offset, unsigned int z){
+      uint32_t* word = &marked_[offset * words_per_column + (z >> 5)];
+      uint32_t* known = &known_[offset * words_per_column + (z >> 5)];
+      uint32_t bit = 1u << (z & 31);
+      if(!(*known & bit)){
+        *known |= bit;
+        known_count_[offset]++;
+      }
+      if(!(*word & bit)){
+        *word |= bit;
+        marked_count_[offset]++;
+      }
+    }
+
+    inline void clear(unsigned int offset, unsigned int z){
+      uint32_t* word = &marked_[offset * words_per_column + (z >> 5)];
+      uint32_t* known = &known_[offset * words_per_column + (z >> 5)];
+      uint32_t bit = 1u << (z & 31);
+      if(!(*known & bit)){
+        *known |= bit;
+        known_count_[offset]++;
+      }
+      if(*word & bit){
+        *word &= ~bit;
+        marked_count_[offset]--;
+      }
+    }
+
+    unsigned int size_x, size_y, size_z;
+    unsigned int words_per_column; /**< Words of bits per column in each plane */
+    uint32_t *marked_; /**< Bit plane of marked voxels */
+    uint32_t *known_; /**< Bit plane of voxels that are marked or free */
+    unsigned int *marked_count_; /**< Marked voxels per column */
+    unsigned int *known_count_; /**< Known voxels per column */
+  };
+}
+
+#endif
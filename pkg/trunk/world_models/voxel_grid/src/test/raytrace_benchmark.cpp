@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author: Eric Berger
+ */
+
+/**
+ * @file Benchmark comparing per-point and batch ray clearing in the voxel grid, for planar scans (as traced by the
+ * 2D cost map) and for tilted scans through the volume. Reports rays per second for each.
+ */
+
+#include <voxel_grid/voxel_grid.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+const unsigned int SIZE_X(1000);
+const unsigned int SIZE_Y(1000);
+const unsigned int SIZE_Z(32);
+const unsigned int SCAN_COUNT(200);
+const unsigned int POINTS_PER_SCAN(1080);
+const unsigned int TILT_COUNT(8);
+
+using namespace voxel_grid;
+
+double now(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/**
+ * A tilting laser sweep from the centre of the grid against a wall at a range varying with bearing. Each bearing is
+ * swept at several heights. Projected to a plane, as for the 2D cost map, the heights collapse onto shared endpoints
+ */
+void buildScan(std::vector<Cell>& endpoints, unsigned int seed, bool planar){
+  const unsigned int bearings = POINTS_PER_SCAN / TILT_COUNT;
+  srand(seed);
+  endpoints.clear();
+  for(unsigned int i = 0; i < POINTS_PER_SCAN; i++){
+    double theta = 2 * M_PI * (i % bearings) / bearings;
+    double range = 200 + 150 * sin(3 * theta) + (rand() % 2);
+    unsigned int z = planar ? SIZE_Z / 2 : ((i / bearings) * SIZE_Z) / TILT_COUNT;
+    endpoints.push_back(Cell((unsigned int) (SIZE_X / 2 + range * cos(theta)), (unsigned int) (SIZE_Y / 2 + range * sin(theta)), z));
+  }
+}
+
+void run(const char* scene, bool planar){
+  VoxelGrid grid(SIZE_X, SIZE_Y, SIZE_Z);
+  std::vector<Cell> endpoints;
+  unsigned int rays = 0;
+
+  double elapsed = 0;
+  for(unsigned int i = 0; i < SCAN_COUNT; i++){
+    buildScan(endpoints, i, planar);
+    double start = now();
+    for(unsigned int j = 0; j < endpoints.size(); j++)
+      grid.clearVoxelLine(SIZE_X / 2, SIZE_Y / 2, SIZE_Z / 2, endpoints[j].x, endpoints[j].y, endpoints[j].z);
+    elapsed += now() - start;
+    rays += endpoints.size();
+  }
+  printf("%-8s %-10s %10u rays %10.4f sec %14.0f rays/sec\n", scene, "per-point", rays, elapsed, rays / elapsed);
+
+  elapsed = 0;
+  for(unsigned int i = 0; i < SCAN_COUNT; i++){
+    buildScan(endpoints, i, planar);
+    double start = now();
+    grid.clearVoxelLines(SIZE_X / 2, SIZE_Y / 2, SIZE_Z / 2, endpoints);
+    elapsed += now() - start;
+  }
+  printf("%-8s %-10s %10u rays %10.4f sec %14.0f rays/sec\n", scene, "batch", rays, elapsed, rays / elapsed);
+}
+
+int main(int argc, char** argv){
+  run("planar", true);
+  run("volume", false);
+  return 0;
+}
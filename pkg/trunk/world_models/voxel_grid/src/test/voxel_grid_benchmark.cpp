@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author: Eric Berger
+ */
+
+/**
+ * @file Benchmark for the voxel grid on a 1000x1000x64 volume. Reports rates for marking, batch ray clearing,
+ * column occupancy queries and projection into a 2D cost map. Column queries are compared against a scan of the
+ * column's voxels to show the benefit of the maintained per-column counts.
+ */
+
+#include <voxel_grid/voxel_grid.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+const unsigned int SIZE_X(1000);
+const unsigned int SIZE_Y(1000);
+const unsigned int SIZE_Z(64);
+const unsigned int MARK_COUNT(2000000);
+const unsigned int SCAN_COUNT(100);
+const unsigned int POINTS_PER_SCAN(1080);
+const unsigned int SWEEP_COUNT(10);
+
+using namespace voxel_grid;
+
+double now(){
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+void report(const char* name, const char* unit, unsigned int count, double elapsed){
+  printf("%-24s %10u %-8s %10.4f sec %14.0f %s/sec\n", name, count, unit, elapsed, count / elapsed, unit);
+}
+
+/**
+ * A scan through the volume from the centre of the grid, at heights spread over the full column
+ */
+void buildScan(std::vector<Cell>& endpoints, unsigned int seed){
+  srand(seed);
+  endpoints.clear();
+  for(unsigned int i = 0; i < POINTS_PER_SCAN; i++){
+    double theta = 2 * M_PI * i / POINTS_PER_SCAN;
+    double range = 200 + 150 * sin(3 * theta) + (rand() % 2);
+    endpoints.push_back(Cell((unsigned int) (SIZE_X / 2 + range * cos(theta)), (unsigned int) (SIZE_Y / 2 + range * sin(theta)), rand() % SIZE_Z));
+  }
+}
+
+int main(int argc, char** argv){
+  VoxelGrid grid(SIZE_X, SIZE_Y, SIZE_Z);
+
+  srand(0);
+  double start = now();
+  for(unsigned int i = 0; i < MARK_COUNT; i++)
+    grid.markVoxel(rand() % SIZE_X, rand() % SIZE_Y, rand() % SIZE_Z);
+  report("mark", "voxels", MARK_COUNT, now() - start);
+
+  std::vector<Cell> endpoints;
+  unsigned int rays = 0;
+  double elapsed = 0;
+  for(unsigned int i = 0; i < SCAN_COUNT; i++){
+    buildScan(endpoints, i);
+    start = now();
+    grid.clearVoxelLines(SIZE_X / 2, SIZE_Y / 2, SIZE_Z / 2, endpoints);
+    elapsed += now() - start;
+    rays += endpoints.size();
+  }
+  report("batch clear", "rays", rays, elapsed);
+
+  // Column queries by scanning every voxel in the column, as a baseline
+  unsigned int occupied = 0;
+  start = now();
+  for(unsigned int i = 0; i < SWEEP_COUNT; i++){
+    for(unsigned int y = 0; y < SIZE_Y; y++){
+      for(unsigned int x = 0; x < SIZE_X; x++){
+        for(unsigned int z = 0; z < SIZE_Z; z++){
+          if(grid.getVoxel(x, y, z)){
+            occupied++;
+            break;
+          }
+        }
+      }
+    }
+  }
+  report("column scan", "columns", SWEEP_COUNT * SIZE_X * SIZE_Y, now() - start);
+
+  unsigned int counted = 0;
+  start = now();
+  for(unsigned int i = 0; i < SWEEP_COUNT; i++){
+    for(unsigned int y = 0; y < SIZE_Y; y++){
+      for(unsigned int x = 0; x < SIZE_X; x++){
+        if(grid.getVoxelColumn(x, y))
+          counted++;
+      }
+    }
+  }
+  report("column count", "columns", SWEEP_COUNT * SIZE_X * SIZE_Y, now() - start);
+
+  if(occupied != counted)
+    printf("Error, column scan found %u occupied columns but counts found %u.\n", occupied, counted);
+
+  unsigned char* map_2d = new unsigned char[SIZE_X * SIZE_Y];
+  start = now();
+  for(unsigned int i = 0; i < SWEEP_COUNT; i++)
+    grid.projectToMap(map_2d, SIZE_Z / 2, 0, 255, 254);
+  report("project to map", "columns", SWEEP_COUNT * SIZE_X * SIZE_Y, now() - start);
+  delete[] map_2d;
+
+  return 0;
+}
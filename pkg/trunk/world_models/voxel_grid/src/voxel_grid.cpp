@@ -1,330 +1,233 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author: Eric Berger
+ */
+
+#include <voxel_grid/voxel_grid.h>
 #include <stdio.h>
 #include <string.h>
-#include <stdlib.h>
 
-#define sign(x) ((x) > 0 ? 1 : -1)
+namespace voxel_grid {
 
-class VoxelGrid{
-public:
-  VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
-  ~VoxelGrid();
-
-  void markVoxel(unsigned int x, unsigned int y, unsigned int z);
-  void clearVoxel(unsigned int x, unsigned int y, unsigned int z);
- 
-  void markVoxelLine(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1);
-  void clearVoxelLine(unsigned int x0, unsigned int y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1);
-  void clearVoxelLineInMap(unsigned int x0, unsigned int y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1, unsigned char *map_2d);
-
-  bool getVoxel(unsigned int x, unsigned int y, unsigned int z);
-  bool getVoxelColumn(unsigned int x, unsigned int y); //Are there any obstacles at that (x, y) location in the grid?
-
-  void printVoxelGrid();
-  void printColumnGrid();
-
-private:
-  int size_x, size_y, size_z;
-  int *data;
-};
+  /**
+   * Actions applied to the cells of a line by raytraceLine
+   */
+  class VoxelGrid::MarkAction {
+  public:
+    MarkAction(VoxelGrid& grid): grid_(grid){}
+    inline void operator()(unsigned int offset, unsigned int z){
+      grid_.mark(offset, z);
+    }
+  private:
+    VoxelGrid& grid_;
+  };
 
-VoxelGrid::VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
-{
-  this->size_x = size_x; 
-  this->size_y = size_y; 
-  this->size_z = size_z; 
+  class VoxelGrid::ClearAction {
+  public:
+    ClearAction(VoxelGrid& grid): grid_(grid){}
+    inline void operator()(unsigned int offset, unsigned int z){
+      grid_.clear(offset, z);
+    }
+  private:
+    VoxelGrid& grid_;
+  };
 
-  if(size_z > 32)
-    printf("Error, this implementation can only support up to 32 z values"); 
- 
-  data = new int[size_x * size_y];
-  bzero(data, sizeof(int) * size_x * size_y);
-}
+  class VoxelGrid::ClearInMapAction {
+  public:
+    ClearInMapAction(VoxelGrid& grid, unsigned char* map_2d): grid_(grid), map_2d_(map_2d){}
+    inline void operator()(unsigned int offset, unsigned int z){
+      grid_.clear(offset, z);
+      if(grid_.marked_count_[offset] == 0)
+        map_2d_[offset] = 0;
+    }
+  private:
+    VoxelGrid& grid_;
+    unsigned char* map_2d_;
+  };
 
-VoxelGrid::~VoxelGrid()
-{
-  delete(data);
-}
+  VoxelGrid::VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+  {
+    this->size_x = size_x; 
+    this->size_y = size_y; 
+    this->size_z = size_z; 
+    words_per_column = (size_z + 31) / 32;
 
-void VoxelGrid::markVoxel(unsigned int x, unsigned int y, unsigned int z)
-{
-  if(x >= size_x || y >= size_y || z >= size_z){
-    printf("Error, voxel out of bounds.\n");
-    return;
+    marked_ = new uint32_t[size_x * size_y * words_per_column];
+    known_ = new uint32_t[size_x * size_y * words_per_column];
+    marked_count_ = new unsigned int[size_x * size_y];
+    known_count_ = new unsigned int[size_x * size_y];
+    reset();
   }
-  data[y * size_x + x] |= 1<<z;
-}
 
-void VoxelGrid::clearVoxel(unsigned int x, unsigned int y, unsigned int z)
-{
-  if(x >= size_x || y >= size_y || z >= size_z){
-    printf("Error, voxel out of bounds.\n");
-    return;
+  VoxelGrid::~VoxelGrid()
+  {
+    delete[] marked_;
+    delete[] known_;
+    delete[] marked_count_;
+    delete[] known_count_;
   }
-  data[y * size_x + x] &= ~(1<<z);
-}
 
-#define bresenham_3d_macro(abs_da, abs_db, abs_dc, error_b, error_c, inc_a, inc_b, inc_c, mark_voxel) \
-for(int i = 0; i < abs_da; i++){ \
- mark_voxel; \
- inc_a; \
- error_b += abs_db; \
- error_c += abs_dc; \
- if(error_b >= abs_da){ \
-  inc_b; \
-  error_b -= abs_da; \
- } \
- if(error_c >= abs_da){ \
-  inc_c; \
-  error_c -= abs_da; \
- } \
-} \
-mark_voxel; \
-
-void VoxelGrid::markVoxelLine(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1){
-  if(x0 >= size_x || y0 >= size_y || z0 >= size_z || x1>=size_x || y1>=size_y || z1>=size_z){
-    printf("Error, line endpoint out of bounds.\n");
-    return;
+  void VoxelGrid::reset(){
+    bzero(marked_, sizeof(uint32_t) * size_x * size_y * words_per_column);
+    bzero(known_, sizeof(uint32_t) * size_x * size_y * words_per_column);
+    bzero(marked_count_, sizeof(unsigned int) * size_x * size_y);
+    bzero(known_count_, sizeof(unsigned int) * size_x * size_y);
   }
-  int dx = x1 - x0;
-  int dy = y1 - y0;
-  int dz = z1 - z0;
-
-  unsigned int abs_dx = abs(dx);
-  unsigned int abs_dy = abs(dy);
-  unsigned int abs_dz = abs(dz);
 
-  int offset_dx = sign(dx);
-  int offset_dy = sign(dy) * size_x;
-  int shift_dz = sign(dz);
-
-  unsigned int z_mask = 1 << z0;
-  unsigned int offset = y0 * size_x + x0;
-
-  if(abs_dx >= abs_dy && abs_dx >= abs_dz){
-    int error_y = abs_dx/2, error_z = abs_dx/2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dx, abs_dy, abs_dz, error_y, error_z, offset += offset_dx, offset += offset_dy, z_mask <<= 1, data[offset] |= z_mask);
+  void VoxelGrid::markVoxel(unsigned int x, unsigned int y, unsigned int z)
+  {
+    if(!inBounds(x, y, z)){
+      printf("Error, voxel out of bounds.\n");
+      return;
     }
-    else{
-      bresenham_3d_macro(abs_dx, abs_dy, abs_dz, error_y, error_z, offset += offset_dx, offset += offset_dy, z_mask >>= 1, data[offset] |= z_mask);
-    }
-    return;
+    mark(y * size_x + x, z);
   }
-  if(abs_dy >= abs_dz){
-    int error_x = abs_dy / 2, error_z = abs_dy/2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dy, abs_dx, abs_dz, error_x, error_z, offset += offset_dy, offset += offset_dx, z_mask <<= 1, data[offset] |= z_mask);
-    }
-    else{
-      bresenham_3d_macro(abs_dy, abs_dx, abs_dz, error_x, error_z, offset += offset_dy, offset += offset_dx, z_mask >>= 1, data[offset] |= z_mask);
+
+  void VoxelGrid::clearVoxel(unsigned int x, unsigned int y, unsigned int z)
+  {
+    if(!inBounds(x, y, z)){
+      printf("Error, voxel out of bounds.\n");
+      return;
     }
-    return;
+    clear(y * size_x + x, z);
   }
-  else{
-    int error_x = abs_dz / 2, error_y = abs_dz / 2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dz, abs_dx, abs_dy, error_x, error_y, z_mask <<= 1, offset += offset_dx, offset += offset_dy, data[offset] |= z_mask);
-    }
-    else{
-      bresenham_3d_macro(abs_dz, abs_dx, abs_dy, error_x, error_y, z_mask <<= 1, offset += offset_dx, offset += offset_dy, data[offset] |= z_mask);
+
+  void VoxelGrid::markVoxelLine(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1){
+    if(!inBounds(x0, y0, z0) || !inBounds(x1, y1, z1)){
+      printf("Error, line endpoint out of bounds.\n");
+      return;
     }
-    return;
+    MarkAction mark(*this);
+    raytraceLine(mark, x0, y0, z0, x1, y1, z1, size_x);
   }
-}
 
-void VoxelGrid::clearVoxelLine(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1){
-  if(x0 >= size_x || y0 >= size_y || z0 >= size_z || x1>=size_x || y1>=size_y || z1>=size_z){
-    printf("Error, line endpoint out of bounds.\n");
-    return;
+  void VoxelGrid::clearVoxelLine(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1){
+    if(!inBounds(x0, y0, z0) || !inBounds(x1, y1, z1)){
+      printf("Error, line endpoint out of bounds.\n");
+      return;
+    }
+    ClearAction clear(*this);
+    raytraceLine(clear, x0, y0, z0, x1, y1, z1, size_x);
   }
-  int dx = x1 - x0;
-  int dy = y1 - y0;
-  int dz = z1 - z0;
-
-  unsigned int abs_dx = abs(dx);
-  unsigned int abs_dy = abs(dy);
-  unsigned int abs_dz = abs(dz);
-
-  int offset_dx = sign(dx);
-  int offset_dy = sign(dy) * size_x;
-  int shift_dz = sign(dz);
-
-  unsigned int z_mask = 1 << z0;
-  unsigned int offset = y0 * size_x + x0;
 
-  if(abs_dx >= abs_dy && abs_dx >= abs_dz){
-    int error_y = abs_dx/2, error_z = abs_dx/2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dx, abs_dy, abs_dz, error_y, error_z, offset += offset_dx, offset += offset_dy, z_mask <<= 1, data[offset] &= ~z_mask);
+  void VoxelGrid::clearVoxelLineInMap(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1, unsigned char *map_2d){
+    if(map_2d == 0){
+      clearVoxelLine(x0, y0, z0, x1, y1, z1);
+      return;
     }
-    else{
-      bresenham_3d_macro(abs_dx, abs_dy, abs_dz, error_y, error_z, offset += offset_dx, offset += offset_dy, z_mask >>= 1, data[offset] &= ~z_mask);
+    if(!inBounds(x0, y0, z0) || !inBounds(x1, y1, z1)){
+      printf("Error, line endpoint out of bounds.\n");
+      return;
     }
-    return;
+    ClearInMapAction clear(*this, map_2d);
+    raytraceLine(clear, x0, y0, z0, x1, y1, z1, size_x);
   }
-  if(abs_dy >= abs_dz){
-    int error_x = abs_dy / 2, error_z = abs_dy/2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dy, abs_dx, abs_dz, error_x, error_z, offset += offset_dy, offset += offset_dx, z_mask <<= 1, data[offset] &= ~z_mask);
+
+  void VoxelGrid::clearVoxelLines(unsigned int x0, unsigned int y0, unsigned int z0, std::vector<Cell>& endpoints, unsigned char *map_2d){
+    if(!inBounds(x0, y0, z0)){
+      printf("Error, line endpoint out of bounds.\n");
+      return;
     }
-    else{
-      bresenham_3d_macro(abs_dy, abs_dx, abs_dz, error_x, error_z, offset += offset_dy, offset += offset_dx, z_mask >>= 1, data[offset] &= ~z_mask);
+
+    // Drop endpoints out of bounds, as the single line calls would
+    unsigned int n = 0;
+    for(unsigned int i = 0; i < endpoints.size(); i++){
+      if(inBounds(endpoints[i].x, endpoints[i].y, endpoints[i].z))
+        endpoints[n++] = endpoints[i];
     }
-    return;
-  }
-  else{
-    int error_x = abs_dz / 2, error_y = abs_dz / 2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dz, abs_dx, abs_dy, error_x, error_y, z_mask <<= 1, offset += offset_dx, offset += offset_dy, data[offset] &= ~z_mask);
+    endpoints.resize(n, Cell(0, 0, 0));
+
+    if(map_2d == 0){
+      ClearAction clear(*this);
+      raytraceBatch(clear, x0, y0, z0, endpoints, size_x);
     }
-    else{
-      bresenham_3d_macro(abs_dz, abs_dx, abs_dy, error_x, error_y, z_mask <<= 1, offset += offset_dx, offset += offset_dy, data[offset] &= ~z_mask);
+    else {
+      ClearInMapAction clear(*this, map_2d);
+      raytraceBatch(clear, x0, y0, z0, endpoints, size_x);
     }
-    return;
   }
-}
 
-void VoxelGrid::clearVoxelLineInMap(unsigned int x0, unsigned y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1, unsigned char *map_2d){
-  if(map_2d == 0){
-    clearVoxelLine(x0, y0, z0, x1, y1, z1);
-    return;
-  }
-  if(x0 >= size_x || y0 >= size_y || z0 >= size_z || x1>=size_x || y1>=size_y || z1>=size_z){
-    printf("Error, line endpoint out of bounds.\n");
-    return;
+  bool VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
+  {
+    return getVoxelStatus(x, y, z) == MARKED;
   }
-  int dx = x1 - x0;
-  int dy = y1 - y0;
-  int dz = z1 - z0;
-
-  unsigned int abs_dx = abs(dx);
-  unsigned int abs_dy = abs(dy);
-  unsigned int abs_dz = abs(dz);
-
-  int offset_dx = sign(dx);
-  int offset_dy = sign(dy) * size_x;
-  int shift_dz = sign(dz);
 
-  unsigned int z_mask = 1 << z0;
-  unsigned int offset = y0 * size_x + x0;
-
-  if(abs_dx >= abs_dy && abs_dx >= abs_dz){
-    int error_y = abs_dx/2, error_z = abs_dx/2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dx, abs_dy, abs_dz, error_y, error_z, offset += offset_dx, offset += offset_dy, z_mask <<= 1, {data[offset] &= ~z_mask; if(data[offset]==0) map_2d[offset] = 0;});
-    }
-    else{
-      bresenham_3d_macro(abs_dx, abs_dy, abs_dz, error_y, error_z, offset += offset_dx, offset += offset_dy, z_mask >>= 1, {data[offset] &= ~z_mask; if(data[offset]==0) map_2d[offset] = 0;});
-    }
-    return;
-  }
-  if(abs_dy >= abs_dz){
-    int error_x = abs_dy / 2, error_z = abs_dy/2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dy, abs_dx, abs_dz, error_x, error_z, offset += offset_dy, offset += offset_dx, z_mask <<= 1, {data[offset] &= ~z_mask; if(data[offset]==0) map_2d[offset] = 0;});
+  VoxelStatus VoxelGrid::getVoxelStatus(unsigned int x, unsigned int y, unsigned int z)
+  {
+    if(!inBounds(x, y, z)){
+      printf("Error, voxel out of bounds.\n");
+      return UNKNOWN;
     }
-    else{
-      bresenham_3d_macro(abs_dy, abs_dx, abs_dz, error_x, error_z, offset += offset_dy, offset += offset_dx, z_mask >>= 1, {data[offset] &= ~z_mask; if(data[offset]==0) map_2d[offset] = 0;});
-    }
-    return;
+    unsigned int ind = (y * size_x + x) * words_per_column + (z >> 5);
+    uint32_t bit = 1u << (z & 31);
+    if(marked_[ind] & bit)
+      return MARKED;
+    return (known_[ind] & bit) ? FREE : UNKNOWN;
   }
-  else{
-    int error_x = abs_dz / 2, error_y = abs_dz / 2;
-    if(shift_dz > 0){
-      bresenham_3d_macro(abs_dz, abs_dx, abs_dy, error_x, error_y, z_mask <<= 1, offset += offset_dx, offset += offset_dy, {data[offset] &= ~z_mask; if(data[offset]==0) map_2d[offset] = 0;});
-    }
-    else{
-      bresenham_3d_macro(abs_dz, abs_dx, abs_dy, error_x, error_y, z_mask <<= 1, offset += offset_dx, offset += offset_dy, {data[offset] &= ~z_mask; if(data[offset]==0) map_2d[offset] = 0;});
+
+  bool VoxelGrid::getVoxelColumn(unsigned int x, unsigned int y)
+  {
+    if(x >= size_x || y >= size_y){
+      printf("Error, voxel out of bounds.\n");
+      return false;
     }
-    return;
+    return marked_count_[y * size_x + x] > 0;
   }
-}
 
-
-bool VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
-{
-  if(x >= size_x || y >= size_y || z >= size_z){
-    printf("Error, voxel out of bounds.\n");
-    return false;
+  void VoxelGrid::projectToMap(unsigned char *map_2d, unsigned int unknown_threshold,
+			       unsigned char free_cost, unsigned char unknown_cost, unsigned char marked_cost) const {
+    const unsigned char costs[] = {free_cost, unknown_cost, marked_cost};
+    for(unsigned int y = 0; y < size_y; y++){
+      for(unsigned int x = 0; x < size_x; x++)
+        map_2d[y * size_x + x] = costs[getColumnStatus(x, y, unknown_threshold)];
+    }
   }
-  return data[y * size_x + x] & (1<<z); 
-}
 
-bool VoxelGrid::getVoxelColumn(unsigned int x, unsigned int y)
-{
-  if(x >= size_x || y >= size_y){
-    printf("Error, voxel out of bounds.\n");
-    return false;
+  void VoxelGrid::printVoxelGrid(){
+    for(unsigned int z = 0; z < size_z; z++){
+      printf("Layer z = %d:\n",z);
+      for(unsigned int y = 0; y < size_y; y++){
+        for(unsigned int x = 0 ; x < size_x; x++){
+          printf((getVoxel(x, y, z))? "#" : " ");
+        }
+        printf("|\n");
+      } 
+    }
   }
-  return data[y * size_x + x] > 0;
-}
 
-void VoxelGrid::printVoxelGrid(){
-  for(int z = 0; z < size_z; z++){
-    printf("Layer z = %d:\n",z);
-    for(int y = 0; y < size_y; y++){
-      for(int x = 0 ; x < size_x; x++){
-        printf((getVoxel(x, y, z))? "#" : " ");
+  void VoxelGrid::printColumnGrid(){
+    printf("Column view:\n");
+    for(unsigned int y = 0; y < size_y; y++){
+      for(unsigned int x = 0 ; x < size_x; x++){
+        printf((getVoxelColumn(x, y))? "#" : " ");
       }
       printf("|\n");
     } 
   }
 }
-
-void VoxelGrid::printColumnGrid(){
-  printf("Column view:\n");
-  for(int y = 0; y < size_y; y++){
-    for(int x = 0 ; x < size_x; x++){
-      printf((getVoxelColumn(x, y))? "#" : " ");
-    }
-    printf("|\n");
-  } 
-}
-
-int main(int argc, char *argv[]){
-  printf("Initializing voxel grid.\n");
-  int size_x = 50, size_y = 10, size_z = 5;
-  VoxelGrid *v = new VoxelGrid(size_x, size_y, size_z);
-
-  unsigned char *costMap = new unsigned char[size_x * size_y]; //initialize cost map
-  for(int x = 0; x < size_x; x++){
-    for(int y = 0; y < size_y; y++){
-      costMap[y * size_x + x] = 128;
-    }
-  }
-
-
-  //Put a "tabletop" into the scene.  A flat rectangle of set voxels at z = 12.
-  int table_z = 1;
-  int table_x_min = 5, table_x_max = 15;
-  int table_y_min = 0, table_y_max = 3;
-  for(int x = table_x_min; x <= table_x_max; x++){
-    v->markVoxelLine(x, table_y_min, table_z, x, table_y_max, table_z);
-  }
-
-  //Add a few synthetic obstacles (diagonal line on the floor) just to demonstrate line drawing
-  v->markVoxelLine(size_x - 1, size_y - 1, 0, 0, 0, 0);
-
-  //clear a scan next to the table (will clear obstacles out)
-  v->clearVoxelLineInMap(table_x_max + 1, 0, table_z, table_x_max + 1, size_y - 1, table_z, costMap);
-
-  //clear a scan over the table (will not clear obstacles out until it passes the edge of the table)
-  v->clearVoxelLineInMap(table_x_min + 1, 0, table_z + 1, table_x_min + 1, size_y - 1, table_z, costMap);
-
-  //clear a scan through the table (will only clear obstacles where it passes through the table
-  v->clearVoxelLineInMap(table_x_min, table_y_min, 0, table_x_max, table_y_max, size_z - 1, costMap);
-
-  //clear a scan that clears out a whole line of the table, to show that it doesnt clear out the diagonal line underneath it
-  v->clearVoxelLineInMap(table_x_max - 2, 0, table_z, table_x_max - 2, size_y - 1, table_z, costMap);
-
-  //Visualize the output
-  v->printVoxelGrid();
-  v->printColumnGrid();
-
-  printf("CostMap:\n===========\n");
-  for(int y = 0; y < size_y; y++){
-    for(int x = 0; x < size_x; x++){
-      printf((costMap[y * size_x + x] > 0 ? "#" : " "));
-    }printf("|\n");
-  }
-}